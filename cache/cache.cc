@@ -34,7 +34,11 @@ static std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct LRUCacheOptions, high_pri_pool_ratio),
           OptionType::kDouble, OptionVerificationType::kNormal,
           OptionTypeFlags::kMutable,
-          offsetof(struct LRUCacheOptions, high_pri_pool_ratio)}}};
+          offsetof(struct LRUCacheOptions, high_pri_pool_ratio)}},
+        {"frequency_admission",
+         {offsetof(struct LRUCacheOptions, frequency_admission),
+          OptionType::kBoolean, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}}};
 #endif  // ROCKSDB_LITE
 
 Status Cache::CreateFromString(const ConfigOptions& config_options,
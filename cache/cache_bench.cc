@@ -57,6 +57,8 @@ DEFINE_uint32(erase_percent, 1,
               "Ratio of erase to total workload (expressed as a percentage)");
 
 DEFINE_bool(use_clock_cache, false, "");
+DEFINE_bool(use_fast_clock_cache, false,
+            "Use the lock-free clock cache, sized for entries of value_bytes");
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -189,6 +191,9 @@ class CacheBench {
         fprintf(stderr, "Clock cache not supported.\n");
         exit(1);
       }
+    } else if (FLAGS_use_fast_clock_cache) {
+      cache_ = NewFastClockCache(FastClockCacheOptions(
+          FLAGS_cache_size, FLAGS_value_bytes, FLAGS_num_shard_bits));
     } else {
       cache_ = NewLRUCache(FLAGS_cache_size, FLAGS_num_shard_bits);
     }
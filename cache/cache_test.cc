@@ -9,6 +9,7 @@
 
 #include "rocksdb/cache.h"
 
+#include <atomic>
 #include <forward_list>
 #include <functional>
 #include <iostream>
@@ -16,8 +17,10 @@
 #include <vector>
 #include "cache/clock_cache.h"
 #include "cache/lru_cache.h"
+#include "port/port.h"
 #include "test_util/testharness.h"
 #include "util/coding.h"
+#include "util/random.h"
 #include "util/string_util.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -39,6 +42,7 @@ static int DecodeValue(void* v) {
 
 const std::string kLRU = "lru";
 const std::string kClock = "clock";
+const std::string kFastClock = "fast_clock";
 
 void dumbDeleter(const Slice& /*key*/, void* /*value*/) {}
 
@@ -59,6 +63,11 @@ class CacheTest : public testing::TestWithParam<std::string> {
   static const int kCacheSize = 1000;
   static const int kNumShardBits = 4;
 
+  // The clock hand of the fast clock cache visits the entries in the order
+  // of their hash table rather than in the order of insertion, so it takes
+  // more inserts to be sure that it went around the whole table
+  int ChurnFactor() const { return GetParam() == kFastClock ? 4 : 1; }
+
   static const int kCacheSize2 = 100;
   static const int kNumShardBits2 = 2;
 
@@ -83,6 +92,13 @@ class CacheTest : public testing::TestWithParam<std::string> {
     if (type == kClock) {
       return NewClockCache(capacity);
     }
+    if (type == kFastClock) {
+      // With the default estimated charge, as a table slot per unit of
+      // capacity would take gigabytes for the larger caches
+      FastClockCacheOptions co;
+      co.capacity = capacity;
+      return NewFastClockCache(co);
+    }
     return nullptr;
   }
 
@@ -103,6 +119,10 @@ class CacheTest : public testing::TestWithParam<std::string> {
       return NewClockCache(capacity, num_shard_bits, strict_capacity_limit,
                            charge_policy);
     }
+    if (type == kFastClock) {
+      return NewFastClockCache(FastClockCacheOptions(
+          capacity, 1, num_shard_bits, strict_capacity_limit, charge_policy));
+    }
     return nullptr;
   }
 
@@ -152,6 +172,7 @@ class CacheTest : public testing::TestWithParam<std::string> {
 CacheTest* CacheTest::current_;
 
 class LRUCacheTest : public CacheTest {};
+class FastClockCacheTest : public CacheTest {};
 
 TEST_P(CacheTest, UsageTest) {
   // cache is std::shared_ptr and will be automatically cleaned up.
@@ -311,6 +332,36 @@ TEST_P(CacheTest, InsertSameKey) {
   ASSERT_EQ(2, Lookup(1));
 }
 
+TEST_P(CacheTest, LookupBatch) {
+  for (int i = 0; i < 200; i += 2) {
+    Insert(i, i + 1000);
+  }
+  // More keys than ShardedCache groups at once, with misses and a key that
+  // is looked up twice
+  std::vector<std::string> encoded;
+  for (int i = 0; i < 150; i++) {
+    encoded.push_back(EncodeKey(i));
+  }
+  encoded.push_back(EncodeKey(10));
+  std::vector<Slice> keys(encoded.begin(), encoded.end());
+  std::vector<Cache::Handle*> handles(keys.size());
+  cache_->LookupBatch(keys.size(), keys.data(), handles.data());
+  // 75 entries are found, and the one looked up twice is pinned once
+  ASSERT_EQ(75U, cache_->GetPinnedUsage());
+  for (size_t i = 0; i < keys.size(); i++) {
+    const int key = DecodeKey(keys[i]);
+    if (key % 2 == 0) {
+      ASSERT_NE(nullptr, handles[i]);
+      ASSERT_EQ(key + 1000, DecodeValue(cache_->Value(handles[i])));
+      cache_->Release(handles[i]);
+    } else {
+      ASSERT_EQ(nullptr, handles[i]);
+    }
+  }
+  ASSERT_EQ(0U, cache_->GetPinnedUsage());
+  cache_->LookupBatch(0, nullptr, nullptr);
+}
+
 TEST_P(CacheTest, Erase) {
   Erase(200);
   ASSERT_EQ(0U, deleted_keys_.size());
@@ -365,7 +416,7 @@ TEST_P(CacheTest, EvictionPolicy) {
   Insert(200, 201);
 
   // Frequently used entry must be kept around
-  for (int i = 0; i < kCacheSize * 2; i++) {
+  for (int i = 0; i < kCacheSize * 2 * ChurnFactor(); i++) {
     Insert(1000+i, 2000+i);
     ASSERT_EQ(101, Lookup(100));
   }
@@ -389,7 +440,7 @@ TEST_P(CacheTest, ExternalRefPinsEntries) {
     }
     // double cache size because the usage bit in block cache prevents 100 from
     // being evicted in the first kCacheSize iterations
-    for (int j = 0; j < 2 * kCacheSize + 100; j++) {
+    for (int j = 0; j < (2 * kCacheSize + 100) * ChurnFactor(); j++) {
       Insert(1000 + j, 2000 + j);
     }
     if (i < 2) {
@@ -418,7 +469,7 @@ TEST_P(CacheTest, EvictionPolicyRef) {
   Insert(303, 104);
 
   // Insert entries much more than Cache capacity
-  for (int i = 0; i < kCacheSize * 2; i++) {
+  for (int i = 0; i < kCacheSize * 2 * ChurnFactor(); i++) {
     Insert(1000 + i, 2000 + i);
   }
 
@@ -694,6 +745,21 @@ TEST_P(CacheTest, OverCapacity) {
   // cache is under capacity now since elements were released
   ASSERT_EQ(n, cache->GetUsage());
 
+  if (GetParam() == kFastClock) {
+    // The clock hand visits the entries in the order of the hash table, so
+    // any one of them may have been evicted
+    size_t found = 0;
+    for (size_t i = 0; i < n + 1; i++) {
+      auto h = cache->Lookup(ToString(i + 1));
+      if (h) {
+        found++;
+        cache->Release(h);
+      }
+    }
+    ASSERT_EQ(n, found);
+    return;
+  }
+
   // element 0 is evicted and the rest is there
   // This is consistent with the LRU policy since the element 0
   // was released first
@@ -755,15 +821,99 @@ TEST_P(CacheTest, GetCharge) {
   cache_->Release(h1);
 }
 
+namespace {
+struct CountedValue {
+  std::atomic<int> deletes{0};
+};
+
+void CountedDeleter(const Slice& /*key*/, void* value) {
+  static_cast<CountedValue*>(value)->deletes.fetch_add(1);
+}
+}  // namespace
+
+TEST_P(FastClockCacheTest, ConcurrentOps) {
+  // Few keys on a small table, so that the inserts of the same key, the
+  // lookups, the erases and the evictions of the threads race on the same
+  // slots
+  const int kThreads = 8;
+  const int kOpsPerThread = 20000;
+  const int kKeys = 16;
+  std::shared_ptr<Cache> cache = NewCache(8, 0, false);
+  // Every insert has a value of its own, whose deleter must run once
+  std::vector<CountedValue> values(kThreads * kOpsPerThread);
+  std::vector<char> inserted(values.size(), 0);
+
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      Random rnd(301 + t);
+      std::vector<Cache::Handle*> held;
+      for (int i = 0; i < kOpsPerThread; i++) {
+        const size_t v = t * kOpsPerThread + i;
+        const std::string key = EncodeKey(rnd.Uniform(kKeys));
+        Cache::Handle* h = nullptr;
+        switch (rnd.Uniform(4)) {
+          case 0:
+            inserted[v] = 1;
+            EXPECT_OK(cache->Insert(key, &values[v], 1, &CountedDeleter));
+            break;
+          case 1: {
+            inserted[v] = 1;
+            Status s = cache->Insert(key, &values[v], 1, &CountedDeleter, &h);
+            if (!s.ok()) {
+              // The caller keeps the value of a failed insert
+              EXPECT_TRUE(s.IsIncomplete());
+              CountedDeleter(key, &values[v]);
+            }
+            break;
+          }
+          case 2:
+            h = cache->Lookup(key);
+            break;
+          default:
+            cache->Erase(key);
+            break;
+        }
+        if (h != nullptr) {
+          // A referenced entry is never deleted
+          EXPECT_EQ(
+              0, static_cast<CountedValue*>(cache->Value(h))->deletes.load());
+          held.push_back(h);
+        }
+        if (held.size() > 2 || (!held.empty() && rnd.OneIn(2))) {
+          cache->Release(held.front());
+          held.erase(held.begin());
+        }
+      }
+      for (auto h : held) {
+        cache->Release(h);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(0U, cache->GetPinnedUsage());
+  cache->EraseUnRefEntries();
+  ASSERT_EQ(0U, cache->GetUsage());
+  for (size_t v = 0; v < values.size(); v++) {
+    ASSERT_EQ(inserted[v] ? 1 : 0, values[v].deletes.load()) << v;
+  }
+}
+
 #ifdef SUPPORT_CLOCK_CACHE
 std::shared_ptr<Cache> (*new_clock_cache_func)(
     size_t, int, bool, CacheMetadataChargePolicy) = NewClockCache;
 INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest,
-                        testing::Values(kLRU, kClock));
+                        testing::Values(kLRU, kClock, kFastClock));
 #else
-INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest, testing::Values(kLRU));
+INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest,
+                        testing::Values(kLRU, kFastClock));
 #endif  // SUPPORT_CLOCK_CACHE
 INSTANTIATE_TEST_CASE_P(CacheTestInstance, LRUCacheTest, testing::Values(kLRU));
+INSTANTIATE_TEST_CASE_P(CacheTestInstance, FastClockCacheTest,
+                        testing::Values(kFastClock));
 
 }  // namespace ROCKSDB_NAMESPACE
 
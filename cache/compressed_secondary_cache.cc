@@ -0,0 +1,192 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "cache/compressed_secondary_cache.h"
+
+#include <string.h>
+
+#include "util/compression.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// The LZ4 format that records the uncompressed size in the entry
+const uint32_t kCompressFormatVersion = 2;
+
+void DeleteEntry(const Slice& /*key*/, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+bool IsSupportedType(CompressionType type) {
+  switch (type) {
+    case kNoCompression:
+    case kSnappyCompression:
+    case kLZ4Compression:
+    case kZSTD:
+      return CompressionTypeSupported(type);
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+CompressedSecondaryCache::CompressedSecondaryCache(
+    const CompressedSecondaryCacheOptions& opts)
+    : opts_(opts) {
+  LRUCacheOptions cache_opts;
+  cache_opts.capacity = opts.capacity;
+  cache_opts.num_shard_bits = opts.num_shard_bits;
+  // The entries are only ever looked up once, so there is nothing to gain
+  // from a high priority pool
+  cache_opts.high_pri_pool_ratio = 0.0;
+  cache_ = NewLRUCache(cache_opts);
+}
+
+void CompressedSecondaryCache::Compress(const Slice& contents,
+                                        std::string* entry) const {
+  const CompressionType type = opts_.compression_type;
+  entry->assign(1, static_cast<char>(type));
+  std::string compressed;
+  bool ok = false;
+  if (type != kNoCompression) {
+    CompressionOptions compression_opts;
+    CompressionContext context(type);
+    CompressionInfo info(compression_opts, context,
+                         CompressionDict::GetEmptyDict(), type,
+                         0 /* sample_for_compression */);
+    switch (type) {
+      case kSnappyCompression:
+        ok = Snappy_Compress(info, contents.data(), contents.size(),
+                             &compressed);
+        break;
+      case kLZ4Compression:
+        ok = LZ4_Compress(info, kCompressFormatVersion, contents.data(),
+                          contents.size(), &compressed);
+        break;
+      case kZSTD:
+        ok = ZSTD_Compress(info, contents.data(), contents.size(),
+                           &compressed);
+        break;
+      default:
+        assert(false);
+        break;
+    }
+  }
+  // Same threshold as the block based table builder: keep the entry
+  // uncompressed unless compression saves at least 12.5%
+  if (ok &&
+      compressed.size() < contents.size() - (contents.size() / 8u)) {
+    entry->append(compressed);
+  } else {
+    (*entry)[0] = static_cast<char>(kNoCompression);
+    entry->append(contents.data(), contents.size());
+  }
+}
+
+Status CompressedSecondaryCache::Uncompress(const Slice& entry,
+                                            std::unique_ptr<char[]>* contents,
+                                            size_t* size) const {
+  if (entry.empty()) {
+    return Status::Corruption("Empty secondary cache entry");
+  }
+  const CompressionType type = static_cast<CompressionType>(entry[0]);
+  const char* data = entry.data() + 1;
+  const size_t length = entry.size() - 1;
+  if (type == kNoCompression) {
+    contents->reset(new char[length]);
+    memcpy(contents->get(), data, length);
+    *size = length;
+    return Status::OK();
+  }
+
+  if (type == kSnappyCompression) {
+    size_t uncompressed_size = 0;
+    if (!Snappy_GetUncompressedLength(data, length, &uncompressed_size)) {
+      return Status::Corruption("Snappy not supported or corrupted entry");
+    }
+    std::unique_ptr<char[]> buf(new char[uncompressed_size]);
+    if (!Snappy_Uncompress(data, length, buf.get())) {
+      return Status::Corruption("Snappy not supported or corrupted entry");
+    }
+    *contents = std::move(buf);
+    *size = uncompressed_size;
+    return Status::OK();
+  }
+
+  UncompressionContext context(type);
+  UncompressionInfo info(context, UncompressionDict::GetEmptyDict(), type);
+  int uncompressed_size = 0;
+  CacheAllocationPtr buf;
+  switch (type) {
+    case kLZ4Compression:
+      buf = LZ4_Uncompress(info, data, length, &uncompressed_size,
+                           kCompressFormatVersion);
+      break;
+    case kZSTD:
+      buf = ZSTD_Uncompress(info, data, length, &uncompressed_size);
+      break;
+    default:
+      return Status::Corruption("Unknown secondary cache entry compression");
+  }
+  if (!buf) {
+    return Status::Corruption("Corrupted secondary cache entry");
+  }
+  // Without a memory allocator, the buffer was allocated with new[]
+  contents->reset(buf.release());
+  *size = static_cast<size_t>(uncompressed_size);
+  return Status::OK();
+}
+
+Status CompressedSecondaryCache::Insert(const Slice& key,
+                                        const Slice& contents) {
+  std::string* entry = new std::string();
+  Compress(contents, entry);
+  // Without a handle, the cache deletes the entry if it cannot hold it
+  return cache_->Insert(key, entry, entry->size(), &DeleteEntry);
+}
+
+Status CompressedSecondaryCache::Lookup(const Slice& key,
+                                        std::unique_ptr<char[]>* contents,
+                                        size_t* size) {
+  assert(contents != nullptr);
+  assert(size != nullptr);
+  Cache::Handle* handle = cache_->Lookup(key);
+  if (handle == nullptr) {
+    return Status::NotFound();
+  }
+  const std::string* entry =
+      reinterpret_cast<std::string*>(cache_->Value(handle));
+  Status s = Uncompress(*entry, contents, size);
+  // The entry is promoted to the primary cache, so there is no point in
+  // keeping it here
+  cache_->Release(handle, true /* force_erase */);
+  return s;
+}
+
+void CompressedSecondaryCache::Erase(const Slice& key) { cache_->Erase(key); }
+
+std::string CompressedSecondaryCache::GetPrintableOptions() const {
+  std::string ret;
+  ret.append("    compression_type : ");
+  ret.append(CompressionTypeToString(opts_.compression_type));
+  ret.append("\n");
+  ret.append(cache_->GetPrintableOptions());
+  return ret;
+}
+
+std::shared_ptr<SecondaryCache> NewCompressedSecondaryCache(
+    const CompressedSecondaryCacheOptions& opts) {
+  if (!IsSupportedType(opts.compression_type)) {
+    return nullptr;
+  }
+  if (opts.num_shard_bits >= 20) {
+    return nullptr;
+  }
+  return std::make_shared<CompressedSecondaryCache>(opts);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,52 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "rocksdb/cache.h"
+#include "rocksdb/secondary_cache.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// A secondary cache that keeps the contents of its entries compressed in an
+// LRU cache of its own, charged by their compressed size. Every entry starts
+// with a byte that holds the compression type of the rest of the entry, which
+// is kNoCompression if compression does not save enough space.
+class CompressedSecondaryCache : public SecondaryCache {
+ public:
+  explicit CompressedSecondaryCache(
+      const CompressedSecondaryCacheOptions& opts);
+  virtual ~CompressedSecondaryCache() override = default;
+
+  virtual const char* Name() const override {
+    return "CompressedSecondaryCache";
+  }
+
+  virtual Status Insert(const Slice& key, const Slice& contents) override;
+  virtual Status Lookup(const Slice& key, std::unique_ptr<char[]>* contents,
+                        size_t* size) override;
+  virtual void Erase(const Slice& key) override;
+
+  virtual size_t GetUsage() const override { return cache_->GetUsage(); }
+  virtual size_t GetCapacity() const override {
+    return cache_->GetCapacity();
+  }
+
+  virtual std::string GetPrintableOptions() const override;
+
+ private:
+  // Compresses "contents" into "entry", behind the compression type byte
+  void Compress(const Slice& contents, std::string* entry) const;
+  Status Uncompress(const Slice& entry, std::unique_ptr<char[]>* contents,
+                    size_t* size) const;
+
+  const CompressedSecondaryCacheOptions opts_;
+  std::shared_ptr<Cache> cache_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,481 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "cache/fast_clock_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// The layout of FastClockHandle::meta
+const uint64_t kRefMask = (uint64_t{1} << 30) - 1;
+const uint64_t kOneRef = 1;
+const uint64_t kClockBit = uint64_t{1} << 60;
+const uint64_t kVisibleBit = uint64_t{1} << 61;
+const uint64_t kOccupiedBit = uint64_t{1} << 62;
+const uint64_t kShareableBit = uint64_t{1} << 63;
+
+const uint64_t kStateConstruction = kOccupiedBit;
+const uint64_t kStateVisible = kOccupiedBit | kShareableBit | kVisibleBit;
+
+inline uint64_t Refs(uint64_t meta) { return meta & kRefMask; }
+inline bool IsShareable(uint64_t meta) { return (meta & kShareableBit) != 0; }
+inline bool IsVisible(uint64_t meta) { return (meta & kVisibleBit) != 0; }
+
+// The table is sized so that it is this full when the shard is at capacity
+// with entries of the estimated charge
+const double kTargetLoadFactor = 0.7;
+// An insert evicts an entry when the table is this full
+const double kMaxLoadFactor = 0.9;
+const size_t kMinTableSize = 64;
+// The slots that the clock hand claims at a time
+const uint64_t kClockStep = 4;
+
+}  // namespace
+
+FastClockCacheShard::FastClockCacheShard(
+    size_t capacity, size_t estimated_entry_charge, bool strict_capacity_limit,
+    CacheMetadataChargePolicy metadata_charge_policy)
+    : capacity_(capacity),
+      strict_capacity_limit_(strict_capacity_limit),
+      usage_(0),
+      occupancy_(0),
+      clock_pointer_(0) {
+  set_metadata_charge_policy(metadata_charge_policy);
+  const double entries =
+      static_cast<double>(capacity) /
+      static_cast<double>(std::max<size_t>(estimated_entry_charge, 1));
+  const size_t wanted = static_cast<size_t>(entries / kTargetLoadFactor) + 1;
+  table_size_ = kMinTableSize;
+  while (table_size_ < wanted) {
+    table_size_ *= 2;
+  }
+  table_mask_ = table_size_ - 1;
+  occupancy_limit_ = static_cast<size_t>(table_size_ * kMaxLoadFactor);
+  table_ = new FastClockHandle[table_size_];
+}
+
+FastClockCacheShard::~FastClockCacheShard() {
+  for (size_t i = 0; i < table_size_; i++) {
+    FastClockHandle* h = &table_[i];
+    const uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (IsShareable(meta)) {
+      assert(Refs(meta) == 0);
+      (*h->deleter)(h->key(), h->value);
+      delete[] h->key_data;
+    }
+  }
+  delete[] table_;
+}
+
+void FastClockCacheShard::SetCapacity(size_t capacity) {
+  capacity_.store(capacity, std::memory_order_relaxed);
+  const size_t usage = usage_.load(std::memory_order_relaxed);
+  if (usage > capacity) {
+    Evict(usage - capacity, false);
+  }
+}
+
+void FastClockCacheShard::SetStrictCapacityLimit(bool strict_capacity_limit) {
+  strict_capacity_limit_.store(strict_capacity_limit,
+                               std::memory_order_relaxed);
+}
+
+Status FastClockCacheShard::Insert(const Slice& key, uint32_t hash,
+                                   void* value, size_t charge,
+                                   void (*deleter)(const Slice& key,
+                                                   void* value),
+                                   Cache::Handle** handle,
+                                   Cache::Priority priority) {
+  size_t total_charge = charge;
+  if (metadata_charge_policy_ == kFullChargeCacheMetadata) {
+    total_charge += sizeof(FastClockHandle) + key.size();
+  }
+
+  // Make room for the entry
+  const size_t capacity = capacity_.load(std::memory_order_relaxed);
+  const size_t usage = usage_.load(std::memory_order_relaxed);
+  const bool need_slot =
+      occupancy_.load(std::memory_order_relaxed) >= occupancy_limit_;
+  if (usage + total_charge > capacity || need_slot) {
+    Evict(usage + total_charge > capacity ? usage + total_charge - capacity
+                                          : 0,
+          need_slot);
+  }
+
+  // Reserve the charge. An entry that does not fit is dropped as if it was
+  // evicted right away when the caller does not want a handle, and inserted
+  // over the capacity otherwise, unless the limit is strict.
+  const bool strict = strict_capacity_limit_.load(std::memory_order_relaxed);
+  size_t old_usage = usage_.load(std::memory_order_relaxed);
+  while (true) {
+    if (old_usage + total_charge > capacity && (strict || handle == nullptr)) {
+      if (handle == nullptr) {
+        (*deleter)(key, value);
+        return Status::OK();
+      }
+      *handle = nullptr;
+      return Status::Incomplete("Insert failed due to clock cache being full.");
+    }
+    if (usage_.compare_exchange_weak(old_usage, old_usage + total_charge,
+                                     std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  // Claim a slot along the probe sequence of the key
+  const uint32_t increment = ProbeIncrement(hash);
+  size_t index = hash & table_mask_;
+  FastClockHandle* h = nullptr;
+  size_t probes = 0;
+  for (; probes < table_size_; probes++) {
+    FastClockHandle* candidate = &table_[index];
+    const uint64_t old_meta = candidate->meta.fetch_or(
+        kOccupiedBit, std::memory_order_acq_rel);
+    if ((old_meta & kOccupiedBit) == 0) {
+      h = candidate;
+      break;
+    }
+    candidate->displacements.fetch_add(1, std::memory_order_relaxed);
+    index = (index + increment) & table_mask_;
+  }
+  if (h == nullptr) {
+    // The table is full of referenced entries
+    index = hash & table_mask_;
+    for (size_t i = 0; i < probes; i++) {
+      table_[index].displacements.fetch_sub(1, std::memory_order_relaxed);
+      index = (index + increment) & table_mask_;
+    }
+    usage_.fetch_sub(total_charge, std::memory_order_relaxed);
+    if (handle == nullptr) {
+      (*deleter)(key, value);
+      return Status::OK();
+    }
+    *handle = nullptr;
+    return Status::Incomplete(
+        "Insert failed due to the cache table being full.");
+  }
+  occupancy_.fetch_add(1, std::memory_order_relaxed);
+
+  h->hash = hash;
+  h->value = value;
+  h->deleter = deleter;
+  h->key_data = new char[key.size()];
+  memcpy(h->key_data, key.data(), key.size());
+  h->key_length = key.size();
+  h->charge = charge;
+  h->total_charge = total_charge;
+  uint64_t meta = kStateVisible;
+  if (priority == Cache::Priority::HIGH) {
+    meta |= kClockBit;
+  }
+  if (handle != nullptr) {
+    meta += kOneRef;
+    *handle = reinterpret_cast<Cache::Handle*>(h);
+  }
+  h->meta.store(meta, std::memory_order_release);
+
+  // Replace the older entries of the key
+  Status s;
+  FastClockHandle* old;
+  while ((old = FindVisible(key, hash, h)) != nullptr) {
+    MakeInvisible(old);
+    Unref(old, false);
+    s = Status::OkOverwritten();
+  }
+  return s;
+}
+
+FastClockHandle* FastClockCacheShard::FindVisible(const Slice& key,
+                                                  uint32_t hash,
+                                                  const FastClockHandle* skip) {
+  const uint32_t increment = ProbeIncrement(hash);
+  size_t index = hash & table_mask_;
+  for (size_t probes = 0; probes < table_size_; probes++) {
+    FastClockHandle* h = &table_[index];
+    if (h != skip &&
+        IsVisible(h->meta.load(std::memory_order_acquire))) {
+      const uint64_t old_meta =
+          h->meta.fetch_add(kOneRef, std::memory_order_acquire);
+      if (IsShareable(old_meta)) {
+        if (IsVisible(old_meta) && h->hash == hash && h->key() == key) {
+          return h;
+        }
+        Unref(h, false);
+      }
+      // Otherwise the slot changed owner, who discards the increment
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + increment) & table_mask_;
+  }
+  return nullptr;
+}
+
+Cache::Handle* FastClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+  FastClockHandle* h = FindVisible(key, hash, nullptr);
+  if (h == nullptr) {
+    return nullptr;
+  }
+  if ((h->meta.load(std::memory_order_relaxed) & kClockBit) == 0) {
+    h->meta.fetch_or(kClockBit, std::memory_order_relaxed);
+  }
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+bool FastClockCacheShard::Ref(Cache::Handle* handle) {
+  FastClockHandle* h = reinterpret_cast<FastClockHandle*>(handle);
+  // To create another reference - entry must be already externally referenced
+  assert(Refs(h->meta.load(std::memory_order_relaxed)) > 0);
+  h->meta.fetch_add(kOneRef, std::memory_order_relaxed);
+  return true;
+}
+
+bool FastClockCacheShard::Release(Cache::Handle* handle, bool force_erase) {
+  if (handle == nullptr) {
+    return false;
+  }
+  FastClockHandle* h = reinterpret_cast<FastClockHandle*>(handle);
+  // Like LRUCache, free the last reference of an entry when over capacity
+  const bool erase =
+      force_erase || usage_.load(std::memory_order_relaxed) >
+                         capacity_.load(std::memory_order_relaxed);
+  return Unref(h, erase);
+}
+
+bool FastClockCacheShard::Unref(FastClockHandle* h, bool erase) {
+  const uint64_t old_meta =
+      h->meta.fetch_sub(kOneRef, std::memory_order_acq_rel);
+  assert(Refs(old_meta) > 0);
+  if (Refs(old_meta) != 1 || (IsVisible(old_meta) && !erase)) {
+    return false;
+  }
+  return TryFree(h, erase);
+}
+
+bool FastClockCacheShard::TryFree(FastClockHandle* h, bool erase) {
+  uint64_t meta = h->meta.load(std::memory_order_acquire);
+  while (IsShareable(meta) && Refs(meta) == 0 && (!IsVisible(meta) || erase)) {
+    if (h->meta.compare_exchange_weak(meta, kStateConstruction,
+                                      std::memory_order_acq_rel)) {
+      Free(h);
+      return true;
+    }
+  }
+  return false;
+}
+
+void FastClockCacheShard::Free(FastClockHandle* h) {
+  (*h->deleter)(h->key(), h->value);
+  delete[] h->key_data;
+  h->key_data = nullptr;
+  const uint32_t increment = ProbeIncrement(h->hash);
+  size_t index = h->hash & table_mask_;
+  const size_t slot = SlotIndex(h);
+  while (index != slot) {
+    table_[index].displacements.fetch_sub(1, std::memory_order_relaxed);
+    index = (index + increment) & table_mask_;
+  }
+  usage_.fetch_sub(h->total_charge, std::memory_order_relaxed);
+  occupancy_.fetch_sub(1, std::memory_order_relaxed);
+  h->meta.store(0, std::memory_order_release);
+}
+
+bool FastClockCacheShard::MakeInvisible(FastClockHandle* h) {
+  const uint64_t old_meta =
+      h->meta.fetch_and(~kVisibleBit, std::memory_order_acq_rel);
+  return IsVisible(old_meta);
+}
+
+void FastClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+  FastClockHandle* h;
+  while ((h = FindVisible(key, hash, nullptr)) != nullptr) {
+    MakeInvisible(h);
+    Unref(h, false);
+  }
+}
+
+void FastClockCacheShard::Evict(size_t charge, bool need_slot) {
+  size_t freed_charge = 0;
+  bool freed_slot = false;
+  const uint64_t max_visits = 2 * table_size_ + kClockStep;
+  for (uint64_t visits = 0; visits < max_visits; visits += kClockStep) {
+    const uint64_t start =
+        clock_pointer_.fetch_add(kClockStep, std::memory_order_relaxed);
+    for (uint64_t i = start; i < start + kClockStep; i++) {
+      if (freed_charge >= charge && (freed_slot || !need_slot)) {
+        return;
+      }
+      FastClockHandle* h = &table_[i & table_mask_];
+      uint64_t meta = h->meta.load(std::memory_order_acquire);
+      if (!IsVisible(meta) || Refs(meta) != 0) {
+        continue;
+      }
+      if (meta & kClockBit) {
+        // Second chance. A failure means that somebody else touched it.
+        h->meta.compare_exchange_strong(meta, meta & ~kClockBit,
+                                        std::memory_order_relaxed);
+        continue;
+      }
+      if (h->meta.compare_exchange_strong(meta, kStateConstruction,
+                                          std::memory_order_acq_rel)) {
+        freed_charge += h->total_charge;
+        freed_slot = true;
+        Free(h);
+      }
+    }
+  }
+}
+
+size_t FastClockCacheShard::GetUsage() const {
+  return usage_.load(std::memory_order_relaxed);
+}
+
+size_t FastClockCacheShard::GetPinnedUsage() const {
+  // Reading the charge of an entry takes a reference, which is itself
+  // discounted
+  auto* self = const_cast<FastClockCacheShard*>(this);
+  size_t pinned = 0;
+  for (size_t i = 0; i < table_size_; i++) {
+    FastClockHandle* h = &table_[i];
+    const uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (!IsShareable(meta) || Refs(meta) == 0) {
+      continue;
+    }
+    const uint64_t old_meta =
+        h->meta.fetch_add(kOneRef, std::memory_order_acquire);
+    if (IsShareable(old_meta)) {
+      if (Refs(old_meta) > 0) {
+        pinned += h->total_charge;
+      }
+      self->Unref(h, false);
+    }
+  }
+  return pinned;
+}
+
+void FastClockCacheShard::ApplyToAllCacheEntries(void (*callback)(void*,
+                                                                 size_t),
+                                                 bool /*thread_safe*/) {
+  // Every entry is referenced while the callback runs, so that it is safe
+  // without a lock
+  for (size_t i = 0; i < table_size_; i++) {
+    FastClockHandle* h = &table_[i];
+    if (!IsVisible(h->meta.load(std::memory_order_acquire))) {
+      continue;
+    }
+    const uint64_t old_meta =
+        h->meta.fetch_add(kOneRef, std::memory_order_acquire);
+    if (IsShareable(old_meta)) {
+      if (IsVisible(old_meta)) {
+        callback(h->value, h->charge);
+      }
+      Unref(h, false);
+    }
+  }
+}
+
+void FastClockCacheShard::EraseUnRefEntries() {
+  for (size_t i = 0; i < table_size_; i++) {
+    TryFree(&table_[i], true);
+  }
+}
+
+std::string FastClockCacheShard::GetPrintableOptions() const {
+  const int kBufferSize = 200;
+  char buffer[kBufferSize];
+  snprintf(buffer, kBufferSize, "    table_size: %" ROCKSDB_PRIszt "\n",
+           table_size_);
+  return std::string(buffer);
+}
+
+FastClockCache::FastClockCache(size_t capacity, size_t estimated_entry_charge,
+                               int num_shard_bits, bool strict_capacity_limit,
+                               std::shared_ptr<MemoryAllocator> allocator,
+                               CacheMetadataChargePolicy metadata_charge_policy)
+    : ShardedCache(capacity, num_shard_bits, strict_capacity_limit,
+                   std::move(allocator)) {
+  num_shards_ = 1 << num_shard_bits;
+  shards_ = reinterpret_cast<FastClockCacheShard*>(
+      port::cacheline_aligned_alloc(sizeof(FastClockCacheShard) * num_shards_));
+  size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+  for (int i = 0; i < num_shards_; i++) {
+    new (&shards_[i])
+        FastClockCacheShard(per_shard, estimated_entry_charge,
+                            strict_capacity_limit, metadata_charge_policy);
+  }
+}
+
+FastClockCache::~FastClockCache() {
+  if (shards_ != nullptr) {
+    assert(num_shards_ > 0);
+    for (int i = 0; i < num_shards_; i++) {
+      shards_[i].~FastClockCacheShard();
+    }
+    port::cacheline_aligned_free(shards_);
+  }
+}
+
+CacheShard* FastClockCache::GetShard(int shard) {
+  return reinterpret_cast<CacheShard*>(&shards_[shard]);
+}
+
+const CacheShard* FastClockCache::GetShard(int shard) const {
+  return reinterpret_cast<CacheShard*>(&shards_[shard]);
+}
+
+void* FastClockCache::Value(Handle* handle) {
+  return reinterpret_cast<const FastClockHandle*>(handle)->value;
+}
+
+size_t FastClockCache::GetCharge(Handle* handle) const {
+  return reinterpret_cast<const FastClockHandle*>(handle)->charge;
+}
+
+uint32_t FastClockCache::GetHash(Handle* handle) const {
+  return reinterpret_cast<const FastClockHandle*>(handle)->hash;
+}
+
+void FastClockCache::DisownData() {
+// Do not drop data if compile with ASAN to suppress leak warning.
+#if defined(__clang__)
+#if !defined(__has_feature) || !__has_feature(address_sanitizer)
+  shards_ = nullptr;
+  num_shards_ = 0;
+#endif
+#else  // __clang__
+#ifndef __SANITIZE_ADDRESS__
+  shards_ = nullptr;
+  num_shards_ = 0;
+#endif  // !__SANITIZE_ADDRESS__
+#endif  // __clang__
+}
+
+std::shared_ptr<Cache> NewFastClockCache(
+    const FastClockCacheOptions& cache_opts) {
+  if (cache_opts.num_shard_bits >= 20) {
+    return nullptr;  // the cache cannot be sharded into too many fine pieces
+  }
+  if (cache_opts.estimated_entry_charge == 0) {
+    return nullptr;
+  }
+  int num_shard_bits = cache_opts.num_shard_bits;
+  if (num_shard_bits < 0) {
+    num_shard_bits = GetDefaultCacheShardBits(cache_opts.capacity);
+  }
+  return std::make_shared<FastClockCache>(
+      cache_opts.capacity, cache_opts.estimated_entry_charge, num_shard_bits,
+      cache_opts.strict_capacity_limit, cache_opts.memory_allocator,
+      cache_opts.metadata_charge_policy);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,160 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "cache/sharded_cache.h"
+#include "port/port.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// A cache shard that never takes a lock. The entries live in an open
+// addressed hash table of fixed size, which is sized for the capacity of the
+// shard divided by the estimated charge of an entry. Eviction follows the
+// CLOCK algorithm: a lookup sets the clock bit of the entry, and the clock
+// hand clears the bit of the entries it passes and evicts the unreferenced
+// entries that have it cleared.
+//
+// Every slot of the table has a 64-bit meta word that holds the state of the
+// slot, the clock bit and the number of external references:
+//
+// - Empty: the slot is free.
+// - Construction: a thread owns the slot exclusively, to fill or free it.
+//   The references are meaningless.
+// - Visible: the slot holds an entry that lookups can find.
+// - Invisible: the entry was erased or replaced, but it is still referenced.
+//   It is freed by the release of its last reference.
+//
+// A lookup optimistically increments the references of a slot and then
+// checks its state and key, undoing the increment if they do not match. A
+// thread moves a slot from Visible or Invisible to Construction only with a
+// compare-and-swap that expects no references, so that the entry cannot be
+// freed while it is referenced. The increments of lookups that see an Empty
+// or Construction slot are overwritten when the owner publishes the slot.
+//
+// Every slot also counts the entries that were displaced past it when they
+// were inserted, so that a lookup stops probing at the first slot that no
+// entry was displaced past.
+struct FastClockHandle {
+  std::atomic<uint64_t> meta{0};
+  std::atomic<uint32_t> displacements{0};
+  uint32_t hash = 0;
+  void* value = nullptr;
+  void (*deleter)(const Slice&, void* value) = nullptr;
+  char* key_data = nullptr;
+  size_t key_length = 0;
+  size_t charge = 0;
+  // The charge including the metadata, if the metadata is charged
+  size_t total_charge = 0;
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+class ALIGN_AS(CACHE_LINE_SIZE) FastClockCacheShard final : public CacheShard {
+ public:
+  FastClockCacheShard(size_t capacity, size_t estimated_entry_charge,
+                      bool strict_capacity_limit,
+                      CacheMetadataChargePolicy metadata_charge_policy);
+  virtual ~FastClockCacheShard() override;
+
+  virtual void SetCapacity(size_t capacity) override;
+  virtual void SetStrictCapacityLimit(bool strict_capacity_limit) override;
+
+  virtual Status Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Handle** handle,
+                        Cache::Priority priority) override;
+  virtual Cache::Handle* Lookup(const Slice& key, uint32_t hash) override;
+  virtual bool Ref(Cache::Handle* handle) override;
+  virtual bool Release(Cache::Handle* handle,
+                       bool force_erase = false) override;
+  virtual void Erase(const Slice& key, uint32_t hash) override;
+
+  virtual size_t GetUsage() const override;
+  virtual size_t GetPinnedUsage() const override;
+
+  virtual void ApplyToAllCacheEntries(void (*callback)(void*, size_t),
+                                      bool thread_safe) override;
+
+  virtual void EraseUnRefEntries() override;
+
+  virtual std::string GetPrintableOptions() const override;
+
+  size_t GetTableSize() const { return table_size_; }
+  size_t GetOccupancy() const {
+    return occupancy_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Returns the visible entry with the key, with a reference, or nullptr.
+  // Skips the slot "skip".
+  FastClockHandle* FindVisible(const Slice& key, uint32_t hash,
+                               const FastClockHandle* skip);
+  // Drops a reference. Frees the entry if it was the last reference and the
+  // entry is invisible or erase is set. Returns true if it freed the entry.
+  bool Unref(FastClockHandle* h, bool erase);
+  // Frees the entry if nothing references it and it is invisible, or erase
+  // is set
+  bool TryFree(FastClockHandle* h, bool erase);
+  // Frees the entry of a slot in the Construction state
+  void Free(FastClockHandle* h);
+  // Hides the entry from lookups. Returns false if it was already hidden.
+  bool MakeInvisible(FastClockHandle* h);
+  // Runs the clock hand until it has freed at least "charge", and at least
+  // one entry if need_slot is set, or has gone twice around the table
+  void Evict(size_t charge, bool need_slot);
+
+  size_t SlotIndex(const FastClockHandle* h) const {
+    return static_cast<size_t>(h - table_);
+  }
+  static uint32_t ProbeIncrement(uint32_t hash) {
+    // Odd, so that the probes visit every slot of the power-of-two table
+    return ((hash * 0x9E3779B9u) >> 15) | 1;
+  }
+
+  // Not frequently modified data members
+  FastClockHandle* table_;
+  size_t table_size_;
+  size_t table_mask_;
+  // The number of occupied slots above which an insert evicts an entry
+  size_t occupancy_limit_;
+  std::atomic<size_t> capacity_;
+  std::atomic<bool> strict_capacity_limit_;
+
+  // Frequently modified data members, in cache lines of their own
+  ALIGN_AS(CACHE_LINE_SIZE) std::atomic<size_t> usage_;
+  ALIGN_AS(CACHE_LINE_SIZE) std::atomic<size_t> occupancy_;
+  ALIGN_AS(CACHE_LINE_SIZE) std::atomic<uint64_t> clock_pointer_;
+};
+
+class FastClockCache
+#ifdef NDEBUG
+    final
+#endif
+    : public ShardedCache {
+ public:
+  FastClockCache(size_t capacity, size_t estimated_entry_charge,
+                 int num_shard_bits, bool strict_capacity_limit,
+                 std::shared_ptr<MemoryAllocator> memory_allocator = nullptr,
+                 CacheMetadataChargePolicy metadata_charge_policy =
+                     kDontChargeCacheMetadata);
+  virtual ~FastClockCache();
+  virtual const char* Name() const override { return "FastClockCache"; }
+  virtual CacheShard* GetShard(int shard) override;
+  virtual const CacheShard* GetShard(int shard) const override;
+  virtual void* Value(Handle* handle) override;
+  virtual size_t GetCharge(Handle* handle) const override;
+  virtual uint32_t GetHash(Handle* handle) const override;
+  virtual void DisownData() override;
+
+ private:
+  FastClockCacheShard* shards_ = nullptr;
+  int num_shards_ = 0;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -12,12 +12,18 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <string>
 
 #include "util/mutexlock.h"
 
 namespace ROCKSDB_NAMESPACE {
 
+namespace {
+// The frequency sketch is sized for entries of the default block size
+const size_t kSketchEntryCharge = 4096;
+}  // namespace
+
 LRUHandleTable::LRUHandleTable() : list_(nullptr), length_(0), elems_(0) {
   Resize();
 }
@@ -95,18 +101,85 @@ void LRUHandleTable::Resize() {
   length_ = new_length;
 }
 
+void FrequencySketch::Reset(size_t num_entries) {
+  // Small enough for small caches, but not so small that the counters of
+  // rare keys are raised by collisions
+  size_t width = 1024;
+  while (width < num_entries) {
+    width *= 2;
+  }
+  counters_.reset(new uint8_t[kNumRows * width]());
+  width_ = width;
+  mask_ = width - 1;
+  additions_ = 0;
+  sample_size_ = 10 * width;
+}
+
+void FrequencySketch::Indexes(uint32_t hash, size_t* indexes) const {
+  // Double hashing, with both hashes mixed from the key hash
+  uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+  uint32_t a = static_cast<uint32_t>(h >> 32);
+  uint32_t b = static_cast<uint32_t>(h) | 1;
+  for (int i = 0; i < kNumRows; i++) {
+    indexes[i] = i * width_ + ((a + i * b) & mask_);
+  }
+}
+
+void FrequencySketch::Increment(uint32_t hash) {
+  assert(width_ > 0);
+  size_t indexes[kNumRows];
+  Indexes(hash, indexes);
+  uint8_t min_count = kMaxCount;
+  for (int i = 0; i < kNumRows; i++) {
+    min_count = std::min(min_count, counters_[indexes[i]]);
+  }
+  if (min_count < kMaxCount) {
+    for (int i = 0; i < kNumRows; i++) {
+      if (counters_[indexes[i]] == min_count) {
+        counters_[indexes[i]]++;
+      }
+    }
+  }
+  if (++additions_ >= sample_size_) {
+    Halve();
+  }
+}
+
+uint32_t FrequencySketch::Estimate(uint32_t hash) const {
+  assert(width_ > 0);
+  size_t indexes[kNumRows];
+  Indexes(hash, indexes);
+  uint8_t min_count = kMaxCount;
+  for (int i = 0; i < kNumRows; i++) {
+    min_count = std::min(min_count, counters_[indexes[i]]);
+  }
+  return min_count;
+}
+
+void FrequencySketch::Halve() {
+  for (size_t i = 0; i < kNumRows * width_; i++) {
+    counters_[i] >>= 1;
+  }
+  additions_ /= 2;
+}
+
 LRUCacheShard::LRUCacheShard(size_t capacity, bool strict_capacity_limit,
                              double high_pri_pool_ratio,
                              bool use_adaptive_mutex,
-                             CacheMetadataChargePolicy metadata_charge_policy)
+                             CacheMetadataChargePolicy metadata_charge_policy,
+                             SecondaryCache* secondary_cache,
+                             bool frequency_admission)
     : capacity_(0),
       high_pri_pool_usage_(0),
       strict_capacity_limit_(strict_capacity_limit),
       high_pri_pool_ratio_(high_pri_pool_ratio),
       high_pri_pool_capacity_(0),
+      secondary_cache_(secondary_cache),
+      frequency_admission_(frequency_admission),
       usage_(0),
       lru_usage_(0),
-      mutex_(use_adaptive_mutex) {
+      mutex_(use_adaptive_mutex),
+      saves_cv_(&mutex_) {
   set_metadata_charge_policy(metadata_charge_policy);
   // Make empty circular linked list
   lru_.next = &lru_;
@@ -244,21 +317,62 @@ void LRUCacheShard::EvictFromLRU(size_t charge,
     size_t old_total_charge = old->CalcTotalCharge(metadata_charge_policy_);
     assert(usage_ >= old_total_charge);
     usage_ -= old_total_charge;
+    MarkSavePending(old);
     deleted->push_back(old);
   }
 }
 
+void LRUCacheShard::MarkSavePending(LRUHandle* e) {
+  if (secondary_cache_ != nullptr && e->save_to != nullptr) {
+    e->SetSavePending();
+    pending_saves_.push_back(e);
+  }
+}
+
+void LRUCacheShard::SaveToSecondary(LRUHandle* e) {
+  if (secondary_cache_ == nullptr || e->save_to == nullptr) {
+    return;
+  }
+  {
+    MutexLock l(&mutex_);
+    assert(e->IsSavePending());
+    if (e->IsSaveCancelled()) {
+      pending_saves_.erase(
+          std::find(pending_saves_.begin(), pending_saves_.end(), e));
+      return;
+    }
+    e->SetSaving();
+  }
+  // The secondary cache may drop the entry, which only costs a read of the
+  // block if it is needed again
+  secondary_cache_->Insert(e->key(), (*e->save_to)(e->value));
+  MutexLock l(&mutex_);
+  pending_saves_.erase(
+      std::find(pending_saves_.begin(), pending_saves_.end(), e));
+  saves_cv_.SignalAll();
+}
+
+bool LRUCacheShard::Admit(uint32_t hash) {
+  assert(frequency_admission_);
+  assert(lru_.next != &lru_);
+  return sketch_.Estimate(hash) > sketch_.Estimate(lru_.next->hash);
+}
+
 void LRUCacheShard::SetCapacity(size_t capacity) {
   autovector<LRUHandle*> last_reference_list;
   {
     MutexLock l(&mutex_);
     capacity_ = capacity;
     high_pri_pool_capacity_ = capacity_ * high_pri_pool_ratio_;
+    if (frequency_admission_) {
+      sketch_.Reset(capacity_ / kSketchEntryCharge);
+    }
     EvictFromLRU(0, &last_reference_list);
   }
 
   // Free the entries outside of mutex for performance reasons
   for (auto entry : last_reference_list) {
+    SaveToSecondary(entry);
     entry->Free();
   }
 }
@@ -270,6 +384,30 @@ void LRUCacheShard::SetStrictCapacityLimit(bool strict_capacity_limit) {
 
 Cache::Handle* LRUCacheShard::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
+  return reinterpret_cast<Cache::Handle*>(LookupLocked(key, hash));
+}
+
+void LRUCacheShard::LookupBatch(const Slice* keys, const uint32_t* hashes,
+                                const size_t* indexes, size_t num_indexes,
+                                Cache::Handle** handles) {
+  MutexLock l(&mutex_);
+  // The buckets of a large cache are mostly not in the CPU cache. Loading
+  // them all before the first probe overlaps the misses.
+  for (size_t i = 0; i < num_indexes; i++) {
+    table_.Prefetch(hashes[indexes[i]]);
+  }
+  for (size_t i = 0; i < num_indexes; i++) {
+    const size_t index = indexes[i];
+    handles[index] = reinterpret_cast<Cache::Handle*>(
+        LookupLocked(keys[index], hashes[index]));
+  }
+}
+
+LRUHandle* LRUCacheShard::LookupLocked(const Slice& key, uint32_t hash) {
+  if (frequency_admission_) {
+    // Misses count too: a block is inserted after it missed the cache
+    sketch_.Increment(hash);
+  }
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
     assert(e->InCache());
@@ -280,7 +418,7 @@ Cache::Handle* LRUCacheShard::Lookup(const Slice& key, uint32_t hash) {
     e->Ref();
     e->SetHit();
   }
-  return reinterpret_cast<Cache::Handle*>(e);
+  return e;
 }
 
 bool LRUCacheShard::Ref(Cache::Handle* h) {
@@ -305,6 +443,7 @@ bool LRUCacheShard::Release(Cache::Handle* handle, bool force_erase) {
   }
   LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
   bool last_reference = false;
+  bool evicted = false;
   {
     MutexLock l(&mutex_);
     last_reference = e->Unref();
@@ -316,6 +455,10 @@ bool LRUCacheShard::Release(Cache::Handle* handle, bool force_erase) {
         // Take this opportunity and remove the item
         table_.Remove(e->key(), e->hash);
         e->SetInCache(false);
+        evicted = !force_erase;
+        if (evicted) {
+          MarkSavePending(e);
+        }
       } else {
         // Put the item back on the LRU list, and don't free it
         LRU_Insert(e);
@@ -331,6 +474,9 @@ bool LRUCacheShard::Release(Cache::Handle* handle, bool force_erase) {
 
   // Free the entry here outside of mutex for performance reasons
   if (last_reference) {
+    if (evicted) {
+      SaveToSecondary(e);
+    }
     e->Free();
   }
   return last_reference;
@@ -340,6 +486,15 @@ Status LRUCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
                              size_t charge,
                              void (*deleter)(const Slice& key, void* value),
                              Cache::Handle** handle, Cache::Priority priority) {
+  return InsertWithSaveTo(key, hash, value, charge, deleter,
+                          nullptr /* save_to */, handle, priority);
+}
+
+Status LRUCacheShard::InsertWithSaveTo(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value),
+    Cache::SaveToCallback save_to, Cache::Handle** handle,
+    Cache::Priority priority) {
   // Allocate the memory here outside of the mutex
   // If the cache is full, we'll have to release it
   // It shouldn't happen very often though.
@@ -347,9 +502,12 @@ Status LRUCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
       new char[sizeof(LRUHandle) - 1 + key.size()]);
   Status s = Status::OK();
   autovector<LRUHandle*> last_reference_list;
+  // The first num_evicted entries of last_reference_list were evicted
+  size_t num_evicted = 0;
 
   e->value = value;
   e->deleter = deleter;
+  e->save_to = save_to;
   e->charge = charge;
   e->key_length = key.size();
   e->flags = 0;
@@ -364,11 +522,37 @@ Status LRUCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
   {
     MutexLock l(&mutex_);
 
-    // Free the space following strict LRU policy until enough space
-    // is freed or the lru list is empty
-    EvictFromLRU(total_charge, &last_reference_list);
+    // A low priority entry must be looked up more often than the entry it
+    // would evict first, so that entries that are read once, as by a long
+    // scan, do not push out the frequently read ones
+    bool admitted = true;
+    if (frequency_admission_ && priority == Cache::Priority::LOW &&
+        (usage_ + total_charge) > capacity_ && lru_.next != &lru_) {
+      admitted = Admit(hash);
+    }
+
+    if (admitted) {
+      // Free the space following strict LRU policy until enough space
+      // is freed or the lru list is empty
+      EvictFromLRU(total_charge, &last_reference_list);
+      num_evicted = last_reference_list.size();
+    }
 
-    if ((usage_ + total_charge) > capacity_ &&
+    if (!admitted && (handle == nullptr || !strict_capacity_limit_)) {
+      // As if the entry was inserted and erased right away: it is only
+      // referenced by the handle, if there is one. With a strict capacity
+      // limit, the handle cannot be returned over capacity and the insert
+      // fails below.
+      e->SetInCache(false);
+      if (handle == nullptr) {
+        last_reference_list.push_back(e);
+      } else {
+        e->Ref();
+        usage_ += total_charge;
+        *handle = reinterpret_cast<Cache::Handle*>(e);
+      }
+      s = Status::OkNotAdmitted();
+    } else if ((usage_ + total_charge) > capacity_ &&
         (strict_capacity_limit_ || handle == nullptr)) {
       if (handle == nullptr) {
         // Don't insert the entry but still return ok, as if the entry inserted
@@ -409,8 +593,11 @@ Status LRUCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
   }
 
   // Free the entries here outside of mutex for performance reasons
-  for (auto entry : last_reference_list) {
-    entry->Free();
+  for (size_t i = 0; i < last_reference_list.size(); i++) {
+    if (i < num_evicted) {
+      SaveToSecondary(last_reference_list[i]);
+    }
+    last_reference_list[i]->Free();
   }
 
   return s;
@@ -434,6 +621,25 @@ void LRUCacheShard::Erase(const Slice& key, uint32_t hash) {
         last_reference = true;
       }
     }
+    // An evicted entry of the key must not be saved after the key is erased
+    // from the secondary cache: the saves that have not started are
+    // cancelled, the ones that are running waited for
+    bool saving = true;
+    while (saving) {
+      saving = false;
+      for (LRUHandle* p : pending_saves_) {
+        if (p->hash == hash && p->key() == key) {
+          if (p->IsSaving()) {
+            saving = true;
+          } else {
+            p->CancelSave();
+          }
+        }
+      }
+      if (saving) {
+        saves_cv_.Wait();
+      }
+    }
   }
 
   // Free the entry here outside of mutex for performance reasons
@@ -441,6 +647,10 @@ void LRUCacheShard::Erase(const Slice& key, uint32_t hash) {
   if (last_reference) {
     e->Free();
   }
+  // An erased entry must not come back from the secondary cache
+  if (secondary_cache_ != nullptr) {
+    secondary_cache_->Erase(key);
+  }
 }
 
 size_t LRUCacheShard::GetUsage() const {
@@ -459,8 +669,10 @@ std::string LRUCacheShard::GetPrintableOptions() const {
   char buffer[kBufferSize];
   {
     MutexLock l(&mutex_);
-    snprintf(buffer, kBufferSize, "    high_pri_pool_ratio: %.3lf\n",
-             high_pri_pool_ratio_);
+    snprintf(buffer, kBufferSize,
+             "    high_pri_pool_ratio: %.3lf\n"
+             "    frequency_admission: %d\n",
+             high_pri_pool_ratio_, frequency_admission_);
   }
   return std::string(buffer);
 }
@@ -469,9 +681,12 @@ LRUCache::LRUCache(size_t capacity, int num_shard_bits,
                    bool strict_capacity_limit, double high_pri_pool_ratio,
                    std::shared_ptr<MemoryAllocator> allocator,
                    bool use_adaptive_mutex,
-                   CacheMetadataChargePolicy metadata_charge_policy)
+                   CacheMetadataChargePolicy metadata_charge_policy,
+                   std::shared_ptr<SecondaryCache> secondary_cache,
+                   bool frequency_admission)
     : ShardedCache(capacity, num_shard_bits, strict_capacity_limit,
-                   std::move(allocator)) {
+                   std::move(allocator)),
+      secondary_cache_(std::move(secondary_cache)) {
   num_shards_ = 1 << num_shard_bits;
   shards_ = reinterpret_cast<LRUCacheShard*>(
       port::cacheline_aligned_alloc(sizeof(LRUCacheShard) * num_shards_));
@@ -479,7 +694,8 @@ LRUCache::LRUCache(size_t capacity, int num_shard_bits,
   for (int i = 0; i < num_shards_; i++) {
     new (&shards_[i])
         LRUCacheShard(per_shard, strict_capacity_limit, high_pri_pool_ratio,
-                      use_adaptive_mutex, metadata_charge_policy);
+                      use_adaptive_mutex, metadata_charge_policy,
+                      secondary_cache_.get(), frequency_admission);
   }
 }
 
@@ -528,6 +744,15 @@ void LRUCache::DisownData() {
 #endif  // __clang__
 }
 
+Status LRUCache::LookupSecondary(const Slice& key,
+                                 std::unique_ptr<char[]>* contents,
+                                 size_t* size) {
+  if (secondary_cache_ == nullptr) {
+    return Status::NotSupported("Cache has no secondary cache");
+  }
+  return secondary_cache_->Lookup(key, contents, size);
+}
+
 size_t LRUCache::TEST_GetLRUSize() {
   size_t lru_size_of_all_shards = 0;
   for (int i = 0; i < num_shards_; i++) {
@@ -545,31 +770,34 @@ double LRUCache::GetHighPriPoolRatio() {
 }
 
 std::shared_ptr<Cache> NewLRUCache(const LRUCacheOptions& cache_opts) {
-  return NewLRUCache(cache_opts.capacity, cache_opts.num_shard_bits,
-                     cache_opts.strict_capacity_limit,
-                     cache_opts.high_pri_pool_ratio,
-                     cache_opts.memory_allocator, cache_opts.use_adaptive_mutex,
-                     cache_opts.metadata_charge_policy);
-}
-
-std::shared_ptr<Cache> NewLRUCache(
-    size_t capacity, int num_shard_bits, bool strict_capacity_limit,
-    double high_pri_pool_ratio,
-    std::shared_ptr<MemoryAllocator> memory_allocator, bool use_adaptive_mutex,
-    CacheMetadataChargePolicy metadata_charge_policy) {
+  int num_shard_bits = cache_opts.num_shard_bits;
   if (num_shard_bits >= 20) {
     return nullptr;  // the cache cannot be sharded into too many fine pieces
   }
-  if (high_pri_pool_ratio < 0.0 || high_pri_pool_ratio > 1.0) {
+  if (cache_opts.high_pri_pool_ratio < 0.0 ||
+      cache_opts.high_pri_pool_ratio > 1.0) {
     // invalid high_pri_pool_ratio
     return nullptr;
   }
   if (num_shard_bits < 0) {
-    num_shard_bits = GetDefaultCacheShardBits(capacity);
+    num_shard_bits = GetDefaultCacheShardBits(cache_opts.capacity);
   }
   return std::make_shared<LRUCache>(
+      cache_opts.capacity, num_shard_bits, cache_opts.strict_capacity_limit,
+      cache_opts.high_pri_pool_ratio, cache_opts.memory_allocator,
+      cache_opts.use_adaptive_mutex, cache_opts.metadata_charge_policy,
+      cache_opts.secondary_cache, cache_opts.frequency_admission);
+}
+
+std::shared_ptr<Cache> NewLRUCache(
+    size_t capacity, int num_shard_bits, bool strict_capacity_limit,
+    double high_pri_pool_ratio,
+    std::shared_ptr<MemoryAllocator> memory_allocator, bool use_adaptive_mutex,
+    CacheMetadataChargePolicy metadata_charge_policy) {
+  return NewLRUCache(LRUCacheOptions(
       capacity, num_shard_bits, strict_capacity_limit, high_pri_pool_ratio,
-      std::move(memory_allocator), use_adaptive_mutex, metadata_charge_policy);
+      std::move(memory_allocator), use_adaptive_mutex,
+      metadata_charge_policy));
 }
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -8,12 +8,15 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "cache/sharded_cache.h"
 
 #include "port/malloc.h"
 #include "port/port.h"
+#include "rocksdb/secondary_cache.h"
 #include "util/autovector.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -50,6 +53,8 @@ namespace ROCKSDB_NAMESPACE {
 struct LRUHandle {
   void* value;
   void (*deleter)(const Slice&, void* value);
+  // Saves the value to the secondary cache on eviction, if not nullptr
+  Cache::SaveToCallback save_to;
   LRUHandle* next_hash;
   LRUHandle* next;
   LRUHandle* prev;
@@ -69,6 +74,12 @@ struct LRUHandle {
     IN_HIGH_PRI_POOL = (1 << 2),
     // Wwhether this entry has had any lookups (hits).
     HAS_HIT = (1 << 3),
+    // Whether this evicted entry waits to be saved to the secondary cache.
+    SAVE_PENDING = (1 << 4),
+    // Whether it is being saved to the secondary cache.
+    SAVING = (1 << 5),
+    // Whether its key was erased before the save started.
+    SAVE_CANCELLED = (1 << 6),
   };
 
   uint8_t flags;
@@ -95,6 +106,9 @@ struct LRUHandle {
   bool IsHighPri() const { return flags & IS_HIGH_PRI; }
   bool InHighPriPool() const { return flags & IN_HIGH_PRI_POOL; }
   bool HasHit() const { return flags & HAS_HIT; }
+  bool IsSavePending() const { return flags & SAVE_PENDING; }
+  bool IsSaving() const { return flags & SAVING; }
+  bool IsSaveCancelled() const { return flags & SAVE_CANCELLED; }
 
   void SetInCache(bool in_cache) {
     if (in_cache) {
@@ -122,6 +136,10 @@ struct LRUHandle {
 
   void SetHit() { flags |= HAS_HIT; }
 
+  void SetSavePending() { flags |= SAVE_PENDING; }
+  void SetSaving() { flags |= SAVING; }
+  void CancelSave() { flags |= SAVE_CANCELLED; }
+
   void Free() {
     assert(refs == 0);
     if (deleter) {
@@ -158,6 +176,10 @@ class LRUHandleTable {
 
   LRUHandle* Lookup(const Slice& key, uint32_t hash);
   LRUHandle* Insert(LRUHandle* h);
+  // Starts loading the bucket of "hash" into the CPU cache
+  void Prefetch(uint32_t hash) const {
+    PREFETCH(&list_[hash & (length_ - 1)], 0 /* rw */, 1 /* locality */);
+  }
   LRUHandle* Remove(const Slice& key, uint32_t hash);
 
   template <typename T>
@@ -188,12 +210,46 @@ class LRUHandleTable {
   uint32_t elems_;
 };
 
+// A count-min sketch that estimates how often each key was looked up
+// recently, as in TinyLFU. It has four rows of 4-bit saturating counters,
+// stored one per byte. An increment only raises the smallest of the four
+// counters of the key, which keeps the estimate of rare keys low. After
+// ten increments per counter of a row, all counters are halved, so that the
+// estimates follow changes of the workload.
+class FrequencySketch {
+ public:
+  FrequencySketch() : width_(0), mask_(0), additions_(0), sample_size_(0) {}
+
+  // Clears the sketch and sizes it for about "num_entries" distinct keys, with
+  // at least 1024 counters per row
+  void Reset(size_t num_entries);
+  void Increment(uint32_t hash);
+  uint32_t Estimate(uint32_t hash) const;
+
+  size_t width() const { return width_; }
+
+ private:
+  static const int kNumRows = 4;
+  static const uint8_t kMaxCount = 15;
+
+  void Indexes(uint32_t hash, size_t* indexes) const;
+  void Halve();
+
+  std::unique_ptr<uint8_t[]> counters_;
+  size_t width_;
+  size_t mask_;
+  size_t additions_;
+  size_t sample_size_;
+};
+
 // A single shard of sharded cache.
 class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
  public:
   LRUCacheShard(size_t capacity, bool strict_capacity_limit,
                 double high_pri_pool_ratio, bool use_adaptive_mutex,
-                CacheMetadataChargePolicy metadata_charge_policy);
+                CacheMetadataChargePolicy metadata_charge_policy,
+                SecondaryCache* secondary_cache = nullptr,
+                bool frequency_admission = false);
   virtual ~LRUCacheShard() override = default;
 
   // Separate from constructor so caller can easily make an array of LRUCache
@@ -213,7 +269,17 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
                         void (*deleter)(const Slice& key, void* value),
                         Cache::Handle** handle,
                         Cache::Priority priority) override;
+  virtual Status InsertWithSaveTo(const Slice& key, uint32_t hash, void* value,
+                                  size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value),
+                                  Cache::SaveToCallback save_to,
+                                  Cache::Handle** handle,
+                                  Cache::Priority priority) override;
   virtual Cache::Handle* Lookup(const Slice& key, uint32_t hash) override;
+  virtual void LookupBatch(const Slice* keys, const uint32_t* hashes,
+                           const size_t* indexes, size_t num_indexes,
+                           Cache::Handle** handles) override;
   virtual bool Ref(Cache::Handle* handle) override;
   virtual bool Release(Cache::Handle* handle,
                        bool force_erase = false) override;
@@ -256,6 +322,23 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // holding the mutex_
   void EvictFromLRU(size_t charge, autovector<LRUHandle*>* deleted);
 
+  // Lookup() without the locking. Must be called while holding mutex_.
+  LRUHandle* LookupLocked(const Slice& key, uint32_t hash);
+
+  // Marks an entry that was evicted for lack of space to be saved to the
+  // secondary cache, if there is one. Must be called while holding mutex_.
+  void MarkSavePending(LRUHandle* e);
+
+  // Saves an entry that MarkSavePending() marked to the secondary cache,
+  // unless its key was erased since. Must be called without holding mutex_,
+  // before the entry is freed.
+  void SaveToSecondary(LRUHandle* e);
+
+  // Returns whether an entry should be inserted although it evicts the least
+  // recently used entry: only if its key was looked up more often. Must be
+  // called while holding mutex_.
+  bool Admit(uint32_t hash);
+
   // Initialized before use.
   size_t capacity_;
 
@@ -280,6 +363,13 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // Pointer to head of low-pri pool in LRU list.
   LRUHandle* lru_low_pri_;
 
+  // Receives the evicted entries, if not nullptr. Owned by the LRUCache.
+  SecondaryCache* secondary_cache_;
+
+  // Whether low priority entries that would evict other entries are subject
+  // to the admission test of Admit()
+  const bool frequency_admission_;
+
   // ------------^^^^^^^^^^^^^-----------
   // Not frequently modified data members
   // ------------------------------------
@@ -299,10 +389,20 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // Memory size for entries residing only in the LRU list
   size_t lru_usage_;
 
+  // The lookup frequencies of the keys, if frequency_admission_ is set
+  FrequencySketch sketch_;
+
   // mutex_ protects the following state.
   // We don't count mutex_ as the cache's internal state so semantically we
   // don't mind mutex_ invoking the non-const actions.
   mutable port::Mutex mutex_;
+
+  // The entries that wait to be saved to the secondary cache or are being
+  // saved, so that Erase() can cancel or wait for the saves of its key
+  std::vector<LRUHandle*> pending_saves_;
+
+  // Signalled when a save to the secondary cache has finished
+  port::CondVar saves_cv_;
 };
 
 class LRUCache
@@ -316,7 +416,9 @@ class LRUCache
            std::shared_ptr<MemoryAllocator> memory_allocator = nullptr,
            bool use_adaptive_mutex = kDefaultToAdaptiveMutex,
            CacheMetadataChargePolicy metadata_charge_policy =
-               kDontChargeCacheMetadata);
+               kDontChargeCacheMetadata,
+           std::shared_ptr<SecondaryCache> secondary_cache = nullptr,
+           bool frequency_admission = false);
   virtual ~LRUCache();
   virtual const char* Name() const override { return "LRUCache"; }
   virtual CacheShard* GetShard(int shard) override;
@@ -325,6 +427,9 @@ class LRUCache
   virtual size_t GetCharge(Handle* handle) const override;
   virtual uint32_t GetHash(Handle* handle) const override;
   virtual void DisownData() override;
+  virtual Status LookupSecondary(const Slice& key,
+                                 std::unique_ptr<char[]>* contents,
+                                 size_t* size) override;
 
   //  Retrieves number of elements in LRU, for unit test purpose only
   size_t TEST_GetLRUSize();
@@ -334,6 +439,7 @@ class LRUCache
  private:
   LRUCacheShard* shards_ = nullptr;
   int num_shards_ = 0;
+  std::shared_ptr<SecondaryCache> secondary_cache_;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -5,10 +5,17 @@
 
 #include "cache/lru_cache.h"
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <thread>
 #include <vector>
+#include "cache/compressed_secondary_cache.h"
 #include "port/port.h"
 #include "test_util/testharness.h"
+#include "util/compression.h"
+#include "util/random.h"
+#include "util/string_util.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -190,6 +197,366 @@ TEST_F(LRUCacheTest, EntriesWithPriority) {
   ValidateLRUList({"e", "f", "g", "Z", "d"}, 2);
 }
 
+class LRUSecondaryCacheTest : public testing::Test {
+ public:
+  LRUSecondaryCacheTest() {}
+
+  static CompressionType SupportedCompression() {
+    if (LZ4_Supported()) {
+      return kLZ4Compression;
+    }
+    if (ZSTD_Supported()) {
+      return kZSTD;
+    }
+    if (Snappy_Supported()) {
+      return kSnappyCompression;
+    }
+    return kNoCompression;
+  }
+
+  // A value that compresses well, and that is rebuilt from its bytes
+  static std::string* NewValue(char c, size_t size) {
+    std::string* value = new std::string();
+    for (size_t i = 0; i < size; i++) {
+      value->push_back(static_cast<char>(c + (i / 64) % 4));
+    }
+    return value;
+  }
+
+  static void DeleteValue(const Slice& /*key*/, void* value) {
+    delete reinterpret_cast<std::string*>(value);
+  }
+
+  static Slice SaveValue(void* value) {
+    return Slice(*reinterpret_cast<std::string*>(value));
+  }
+
+  void NewCache(size_t capacity, size_t secondary_capacity) {
+    CompressedSecondaryCacheOptions secondary_opts(
+        secondary_capacity, 0 /* num_shard_bits */, SupportedCompression());
+    secondary_ = NewCompressedSecondaryCache(secondary_opts);
+    ASSERT_NE(secondary_, nullptr);
+    LRUCacheOptions opts(capacity, 0 /* num_shard_bits */,
+                         false /* strict_capacity_limit */,
+                         0.0 /* high_pri_pool_ratio */);
+    opts.metadata_charge_policy = kDontChargeCacheMetadata;
+    opts.secondary_cache = secondary_;
+    cache_ = NewLRUCache(opts);
+    ASSERT_NE(cache_, nullptr);
+  }
+
+  Status InsertSaveable(const std::string& key, char c) {
+    std::string* value = NewValue(c, 1000);
+    return cache_->InsertWithSaveTo(key, value, value->size(), &DeleteValue,
+                                    &SaveValue);
+  }
+
+  // Returns the value of key in the secondary cache, or "" if not found
+  std::string LookupSecondary(const std::string& key) {
+    std::unique_ptr<char[]> contents;
+    size_t size = 0;
+    Status s = cache_->LookupSecondary(key, &contents, &size);
+    if (s.IsNotFound()) {
+      return "";
+    }
+    EXPECT_OK(s);
+    return std::string(contents.get(), size);
+  }
+
+  std::shared_ptr<SecondaryCache> secondary_;
+  std::shared_ptr<Cache> cache_;
+};
+
+TEST_F(LRUSecondaryCacheTest, EvictedEntriesAreSaved) {
+  NewCache(2500, 100000);
+  ASSERT_OK(InsertSaveable("a", 'a'));
+  ASSERT_OK(InsertSaveable("b", 'b'));
+  ASSERT_EQ(0U, secondary_->GetUsage());
+  // Evicts "a"
+  ASSERT_OK(InsertSaveable("c", 'c'));
+  ASSERT_GT(secondary_->GetUsage(), 0U);
+  if (SupportedCompression() != kNoCompression) {
+    ASSERT_LT(secondary_->GetUsage(), 1000U);
+  }
+
+  std::unique_ptr<std::string> expected(NewValue('a', 1000));
+  ASSERT_EQ(*expected, LookupSecondary("a"));
+  // The entry was promoted out of the secondary cache
+  ASSERT_EQ("", LookupSecondary("a"));
+  ASSERT_EQ(0U, secondary_->GetUsage());
+  ASSERT_EQ("", LookupSecondary("b"));
+}
+
+TEST_F(LRUSecondaryCacheTest, OnlySaveableEvictedEntriesAreSaved) {
+  NewCache(2500, 100000);
+  std::string* value = NewValue('a', 1000);
+  // Inserted without a SaveToCallback
+  ASSERT_OK(cache_->Insert("a", value, value->size(), &DeleteValue));
+  ASSERT_OK(InsertSaveable("b", 'b'));
+  ASSERT_OK(InsertSaveable("c", 'c'));
+  ASSERT_OK(InsertSaveable("d", 'd'));
+  ASSERT_EQ("", LookupSecondary("a"));
+  ASSERT_NE("", LookupSecondary("b"));
+
+  // Neither erased nor overwritten entries are saved
+  cache_->Erase("c");
+  ASSERT_OK(InsertSaveable("d", 'e'));
+  ASSERT_EQ("", LookupSecondary("c"));
+  ASSERT_EQ("", LookupSecondary("d"));
+
+  // Erase also drops the entry from the secondary cache
+  ASSERT_OK(InsertSaveable("f", 'f'));
+  ASSERT_OK(InsertSaveable("g", 'g'));
+  ASSERT_OK(InsertSaveable("h", 'h'));
+  cache_->Erase("d");
+  ASSERT_EQ("", LookupSecondary("d"));
+}
+
+static std::atomic<bool> save_started{false};
+static std::atomic<bool> save_released{false};
+
+static Slice BlockingSaveValue(void* value) {
+  save_started = true;
+  while (!save_released.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return Slice(*reinterpret_cast<std::string*>(value));
+}
+
+TEST_F(LRUSecondaryCacheTest, EraseWaitsForRunningSave) {
+  NewCache(2500, 100000);
+  std::string* value = NewValue('a', 1000);
+  ASSERT_OK(cache_->InsertWithSaveTo("a", value, value->size(), &DeleteValue,
+                                     &BlockingSaveValue));
+  ASSERT_OK(InsertSaveable("b", 'b'));
+  // Evicts "a", whose save blocks
+  std::thread inserter([this]() { ASSERT_OK(InsertSaveable("c", 'c')); });
+  while (!save_started.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::atomic<bool> erased(false);
+  std::thread eraser([this, &erased]() {
+    cache_->Erase("a");
+    erased = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_FALSE(erased.load());
+  save_released = true;
+  inserter.join();
+  eraser.join();
+  // The save finished before the key was erased from the secondary cache
+  ASSERT_EQ("", LookupSecondary("a"));
+}
+
+TEST_F(LRUSecondaryCacheTest, ReleaseOverCapacitySaves) {
+  NewCache(2500, 100000);
+  std::string* value = NewValue('a', 1000);
+  Cache::Handle* handle = nullptr;
+  ASSERT_OK(cache_->InsertWithSaveTo("a", value, value->size(), &DeleteValue,
+                                     &SaveValue, &handle));
+  ASSERT_OK(InsertSaveable("b", 'b'));
+  cache_->SetCapacity(500);
+  // "b" was evicted by the capacity change, "a" is pinned
+  ASSERT_NE("", LookupSecondary("b"));
+  ASSERT_TRUE(cache_->Release(handle));
+  ASSERT_NE("", LookupSecondary("a"));
+}
+
+TEST_F(LRUSecondaryCacheTest, NoSecondaryCache) {
+  std::shared_ptr<Cache> cache = NewLRUCache(1000);
+  std::unique_ptr<char[]> contents;
+  size_t size = 0;
+  ASSERT_TRUE(cache->LookupSecondary("a", &contents, &size).IsNotSupported());
+}
+
+TEST_F(LRUSecondaryCacheTest, CompressedSecondaryCache) {
+  for (CompressionType type :
+       {kNoCompression, kSnappyCompression, kLZ4Compression, kZSTD}) {
+    CompressedSecondaryCacheOptions opts(10000, 0 /* num_shard_bits */, type);
+    std::shared_ptr<SecondaryCache> secondary =
+        NewCompressedSecondaryCache(opts);
+    if (!CompressionTypeSupported(type)) {
+      ASSERT_EQ(secondary, nullptr);
+      continue;
+    }
+    ASSERT_NE(secondary, nullptr);
+
+    std::unique_ptr<std::string> compressible(NewValue('a', 4000));
+    std::string random;
+    Random rnd(301);
+    for (int i = 0; i < 1000; i++) {
+      random.push_back(static_cast<char>(rnd.Uniform(256)));
+    }
+    ASSERT_OK(secondary->Insert("compressible", *compressible));
+    ASSERT_OK(secondary->Insert("random", random));
+    ASSERT_OK(secondary->Insert("empty", Slice()));
+    if (type != kNoCompression) {
+      ASSERT_LT(secondary->GetUsage(), compressible->size() + random.size());
+    }
+
+    std::unique_ptr<char[]> contents;
+    size_t size = 0;
+    ASSERT_OK(secondary->Lookup("compressible", &contents, &size));
+    ASSERT_EQ(*compressible, std::string(contents.get(), size));
+    ASSERT_OK(secondary->Lookup("random", &contents, &size));
+    ASSERT_EQ(random, std::string(contents.get(), size));
+    ASSERT_OK(secondary->Lookup("empty", &contents, &size));
+    ASSERT_EQ(0U, size);
+    ASSERT_TRUE(secondary->Lookup("random", &contents, &size).IsNotFound());
+    ASSERT_EQ(0U, secondary->GetUsage());
+
+    // Entries are dropped to stay within the capacity
+    for (int i = 0; i < 20; i++) {
+      ASSERT_OK(secondary->Insert(ToString(i), random));
+    }
+    ASSERT_LE(secondary->GetUsage(), secondary->GetCapacity());
+    ASSERT_TRUE(secondary->Lookup("0", &contents, &size).IsNotFound());
+    ASSERT_OK(secondary->Lookup("19", &contents, &size));
+    secondary->Insert("19", random);
+    secondary->Erase("19");
+    ASSERT_TRUE(secondary->Lookup("19", &contents, &size).IsNotFound());
+  }
+}
+
+TEST(FrequencySketchTest, EstimateAndHalve) {
+  FrequencySketch sketch;
+  sketch.Reset(100);
+  ASSERT_EQ(1024U, sketch.width());
+  ASSERT_EQ(0U, sketch.Estimate(1));
+  for (int i = 0; i < 5; i++) {
+    sketch.Increment(1);
+  }
+  sketch.Increment(2);
+  // A count-min sketch never underestimates
+  ASSERT_GE(sketch.Estimate(1), 5U);
+  ASSERT_GE(sketch.Estimate(2), 1U);
+  ASSERT_LT(sketch.Estimate(2), sketch.Estimate(1));
+  // The counters saturate
+  for (int i = 0; i < 100; i++) {
+    sketch.Increment(3);
+  }
+  ASSERT_EQ(15U, sketch.Estimate(3));
+
+  // Every 10 * width increments, the counters are halved
+  for (uint32_t i = 0; i < 10 * 1024 - 106; i++) {
+    sketch.Increment(1000 + i);
+  }
+  ASSERT_LE(sketch.Estimate(3), 7U);
+  ASSERT_GE(sketch.Estimate(3), 1U);
+}
+
+class LRUAdmissionTest : public testing::Test {
+ public:
+  LRUAdmissionTest() {}
+
+  void NewCache(size_t capacity, bool frequency_admission,
+                bool strict_capacity_limit = false) {
+    LRUCacheOptions opts(capacity, 0 /* num_shard_bits */,
+                         strict_capacity_limit,
+                         0.0 /* high_pri_pool_ratio */);
+    opts.metadata_charge_policy = kDontChargeCacheMetadata;
+    opts.frequency_admission = frequency_admission;
+    cache_ = NewLRUCache(opts);
+    ASSERT_NE(cache_, nullptr);
+  }
+
+  // Looks the key up, and inserts it on a miss, as the block cache does
+  bool Read(const std::string& key,
+            Cache::Priority priority = Cache::Priority::LOW) {
+    Cache::Handle* handle = cache_->Lookup(key);
+    if (handle != nullptr) {
+      cache_->Release(handle);
+      return true;
+    }
+    EXPECT_OK(cache_->Insert(key, nullptr, 1, nullptr, nullptr, priority));
+    return false;
+  }
+
+  std::shared_ptr<Cache> cache_;
+};
+
+TEST_F(LRUAdmissionTest, ScanDoesNotEvictHotEntries) {
+  for (bool frequency_admission : {false, true}) {
+    NewCache(10, frequency_admission);
+    // Hot entries, read several times
+    for (int round = 0; round < 4; round++) {
+      for (int i = 0; i < 5; i++) {
+        Read("hot" + ToString(i));
+      }
+    }
+    // A scan reads many entries once
+    for (int i = 0; i < 100; i++) {
+      ASSERT_FALSE(Read("scan" + ToString(i)));
+    }
+    int hits = 0;
+    for (int i = 0; i < 5; i++) {
+      hits += Read("hot" + ToString(i)) ? 1 : 0;
+    }
+    if (frequency_admission) {
+      ASSERT_EQ(5, hits);
+    } else {
+      ASSERT_EQ(0, hits);
+    }
+    ASSERT_LE(cache_->GetUsage(), 10U);
+  }
+}
+
+TEST_F(LRUAdmissionTest, FrequentEntriesAreAdmitted) {
+  NewCache(4, true);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_FALSE(Read("old" + ToString(i)));
+  }
+  // A new entry read as often as the least recently used one is not
+  // admitted, and becomes admissible when it is read more often.
+  ASSERT_FALSE(Read("new"));
+  ASSERT_FALSE(Read("new"));
+  ASSERT_TRUE(Read("new"));
+  // It evicted the least recently used entry
+  ASSERT_FALSE(Read("old0"));
+}
+
+TEST_F(LRUAdmissionTest, NotAdmittedStatus) {
+  NewCache(2, true);
+  ASSERT_FALSE(Read("a"));
+  ASSERT_TRUE(Read("a"));
+  ASSERT_FALSE(Read("b"));
+  ASSERT_TRUE(Read("b"));
+  ASSERT_EQ(2U, cache_->GetUsage());
+
+  // Without a handle, the entry is freed right away
+  ASSERT_TRUE(cache_->Insert("c", nullptr, 1, nullptr).IsOkNotAdmitted());
+  ASSERT_EQ(2U, cache_->GetUsage());
+
+  // With a handle, the entry lives as long as the handle
+  Cache::Handle* handle = nullptr;
+  int value = 7;
+  Status s = cache_->Insert("c", &value, 1, nullptr, &handle);
+  ASSERT_TRUE(s.IsOkNotAdmitted());
+  ASSERT_NE(nullptr, handle);
+  ASSERT_EQ(&value, cache_->Value(handle));
+  ASSERT_EQ(3U, cache_->GetUsage());
+  ASSERT_TRUE(cache_->Release(handle));
+  ASSERT_EQ(2U, cache_->GetUsage());
+  ASSERT_TRUE(Read("a"));
+  ASSERT_TRUE(Read("b"));
+
+  // High priority entries are always admitted
+  ASSERT_OK(cache_->Insert("d", nullptr, 1, nullptr, nullptr,
+                           Cache::Priority::HIGH));
+  ASSERT_TRUE(Read("d"));
+
+  // With a strict capacity limit, a handle over capacity cannot be returned
+  NewCache(2, true, true /* strict_capacity_limit */);
+  ASSERT_FALSE(Read("a"));
+  ASSERT_TRUE(Read("a"));
+  ASSERT_FALSE(Read("b"));
+  ASSERT_TRUE(Read("b"));
+  s = cache_->Insert("c", &value, 1, nullptr, &handle);
+  ASSERT_TRUE(s.IsIncomplete());
+  ASSERT_EQ(nullptr, handle);
+  ASSERT_TRUE(cache_->Insert("c", nullptr, 1, nullptr).IsOkNotAdmitted());
+}
+
 }  // namespace ROCKSDB_NAMESPACE
 
 int main(int argc, char** argv) {
@@ -9,6 +9,7 @@
 
 #include "cache/sharded_cache.h"
 
+#include <algorithm>
 #include <string>
 
 #include "util/mutexlock.h"
@@ -51,11 +52,62 @@ Status ShardedCache::Insert(const Slice& key, void* value, size_t charge,
       ->Insert(key, hash, value, charge, deleter, handle, priority);
 }
 
+Status ShardedCache::InsertWithSaveTo(const Slice& key, void* value,
+                                      size_t charge,
+                                      void (*deleter)(const Slice& key,
+                                                      void* value),
+                                      SaveToCallback save_to, Handle** handle,
+                                      Priority priority) {
+  uint32_t hash = HashSlice(key);
+  return GetShard(Shard(hash))
+      ->InsertWithSaveTo(key, hash, value, charge, deleter, save_to, handle,
+                         priority);
+}
+
 Cache::Handle* ShardedCache::Lookup(const Slice& key, Statistics* /*stats*/) {
   uint32_t hash = HashSlice(key);
   return GetShard(Shard(hash))->Lookup(key, hash);
 }
 
+void CacheShard::LookupBatch(const Slice* keys, const uint32_t* hashes,
+                             const size_t* indexes, size_t num_indexes,
+                             Cache::Handle** handles) {
+  for (size_t i = 0; i < num_indexes; i++) {
+    const size_t index = indexes[i];
+    handles[index] = Lookup(keys[index], hashes[index]);
+  }
+}
+
+void ShardedCache::LookupBatch(size_t num_keys, const Slice* keys,
+                               Handle** handles, Statistics* /*stats*/) {
+  // The keys are grouped by shard in chunks small enough for the hashes and
+  // the order of the keys to live on the stack
+  const size_t kChunkSize = 64;
+  uint32_t hashes[kChunkSize];
+  size_t order[kChunkSize];
+  for (size_t start = 0; start < num_keys; start += kChunkSize) {
+    const size_t n = std::min(kChunkSize, num_keys - start);
+    for (size_t i = 0; i < n; i++) {
+      hashes[i] = HashSlice(keys[start + i]);
+      order[i] = i;
+    }
+    std::sort(order, order + n, [&](size_t a, size_t b) {
+      return Shard(hashes[a]) < Shard(hashes[b]);
+    });
+    size_t i = 0;
+    while (i < n) {
+      const uint32_t shard = Shard(hashes[order[i]]);
+      size_t end = i + 1;
+      while (end < n && Shard(hashes[order[end]]) == shard) {
+        end++;
+      }
+      GetShard(shard)->LookupBatch(keys + start, hashes, order + i, end - i,
+                                   handles + start);
+      i = end;
+    }
+  }
+}
+
 bool ShardedCache::Ref(Handle* handle) {
   uint32_t hash = GetHash(handle);
   return GetShard(Shard(hash))->Ref(handle);
@@ -28,7 +28,21 @@ class CacheShard {
                         size_t charge,
                         void (*deleter)(const Slice& key, void* value),
                         Cache::Handle** handle, Cache::Priority priority) = 0;
+  virtual Status InsertWithSaveTo(const Slice& key, uint32_t hash, void* value,
+                                  size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value),
+                                  Cache::SaveToCallback /*save_to*/,
+                                  Cache::Handle** handle,
+                                  Cache::Priority priority) {
+    return Insert(key, hash, value, charge, deleter, handle, priority);
+  }
   virtual Cache::Handle* Lookup(const Slice& key, uint32_t hash) = 0;
+  // Looks up keys[i], whose hash is hashes[i], into handles[i] for each i in
+  // the first "num_indexes" entries of "indexes"
+  virtual void LookupBatch(const Slice* keys, const uint32_t* hashes,
+                           const size_t* indexes, size_t num_indexes,
+                           Cache::Handle** handles);
   virtual bool Ref(Cache::Handle* handle) = 0;
   virtual bool Release(Cache::Handle* handle, bool force_erase = false) = 0;
   virtual void Erase(const Slice& key, uint32_t hash) = 0;
@@ -72,7 +86,14 @@ class ShardedCache : public Cache {
   virtual Status Insert(const Slice& key, void* value, size_t charge,
                         void (*deleter)(const Slice& key, void* value),
                         Handle** handle, Priority priority) override;
+  virtual Status InsertWithSaveTo(const Slice& key, void* value, size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value),
+                                  SaveToCallback save_to, Handle** handle,
+                                  Priority priority) override;
   virtual Handle* Lookup(const Slice& key, Statistics* stats) override;
+  virtual void LookupBatch(size_t num_keys, const Slice* keys,
+                           Handle** handles, Statistics* stats) override;
   virtual bool Ref(Handle* handle) override;
   virtual bool Release(Handle* handle, bool force_erase = false) override;
   virtual void Erase(const Slice& key) override;
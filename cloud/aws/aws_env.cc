@@ -194,118 +194,6 @@ AwsEnv::AwsEnv(Env* underlying_env, const CloudEnvOptions& _cloud_env_options,
 
 void AwsEnv::Shutdown() { Aws::ShutdownAPI(Aws::SDKOptions()); }
 
-//
-// All db in a bucket are stored in path /.rockset/dbid/<dbid>
-// The value of the object is the pathname where the db resides.
-//
-Status AwsEnv::SaveDbid(const std::string& bucket_name, const std::string& dbid,
-                        const std::string& dirname) {
-  Log(InfoLogLevel::DEBUG_LEVEL, info_log_, "[s3] SaveDbid dbid %s dir '%s'",
-      dbid.c_str(), dirname.c_str());
-
-  std::string dbidkey = dbid_registry_ + dbid;
-  std::unordered_map<std::string, std::string> metadata;
-  metadata["dirname"] = dirname;
-
-  Status st = cloud_env_options.storage_provider->PutCloudObjectMetadata(
-      bucket_name, dbidkey, metadata);
-
-  if (!st.ok()) {
-    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-        "[aws] Bucket %s SaveDbid error in saving dbid %s dirname %s %s",
-        bucket_name.c_str(), dbid.c_str(), dirname.c_str(),
-        st.ToString().c_str());
-  } else {
-    Log(InfoLogLevel::INFO_LEVEL, info_log_,
-        "[aws] Bucket %s SaveDbid dbid %s dirname %s %s", bucket_name.c_str(),
-        dbid.c_str(), dirname.c_str(), "ok");
-  }
-  return st;
-};
-
-//
-// Given a dbid, retrieves its pathname.
-//
-Status AwsEnv::GetPathForDbid(const std::string& bucket,
-                              const std::string& dbid, std::string* dirname) {
-  std::string dbidkey = dbid_registry_ + dbid;
-
-  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
-      "[s3] Bucket %s GetPathForDbid dbid %s", bucket.c_str(), dbid.c_str());
-
-  CloudObjectInformation info;
-  Status st = cloud_env_options.storage_provider->GetCloudObjectMetadata(
-      bucket, dbidkey, &info);
-  if (!st.ok()) {
-    if (st.IsNotFound()) {
-      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-          "[aws] %s GetPathForDbid error non-existent dbid %s %s",
-          bucket.c_str(), dbid.c_str(), st.ToString().c_str());
-    } else {
-      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-          "[aws] %s GetPathForDbid error dbid %s %s", bucket.c_str(),
-          dbid.c_str(), st.ToString().c_str());
-    }
-    return st;
-  }
-
-  // Find "dirname" metadata that stores the pathname of the db
-  const char* kDirnameTag = "dirname";
-  auto it = info.metadata.find(kDirnameTag);
-  if (it != info.metadata.end()) {
-    *dirname = it->second;
-  } else {
-    st = Status::NotFound("GetPathForDbid");
-  }
-  Log(InfoLogLevel::INFO_LEVEL, info_log_, "[aws] %s GetPathForDbid dbid %s %s",
-      bucket.c_str(), dbid.c_str(), st.ToString().c_str());
-  return st;
-}
-
-//
-// Retrieves the list of all registered dbids and their paths
-//
-Status AwsEnv::GetDbidList(const std::string& bucket, DbidList* dblist) {
-  // fetch the list all all dbids
-  std::vector<std::string> dbid_list;
-  Status st = cloud_env_options.storage_provider->ListCloudObjects(
-      bucket, dbid_registry_, &dbid_list);
-  if (!st.ok()) {
-    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-        "[aws] %s GetDbidList error in GetChildrenFromS3 %s", bucket.c_str(),
-        st.ToString().c_str());
-    return st;
-  }
-  // for each dbid, fetch the db directory where the db data should reside
-  for (auto dbid : dbid_list) {
-    std::string dirname;
-    st = GetPathForDbid(bucket, dbid, &dirname);
-    if (!st.ok()) {
-      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-          "[aws] %s GetDbidList error in GetPathForDbid(%s) %s", bucket.c_str(),
-          dbid.c_str(), st.ToString().c_str());
-      return st;
-    }
-    // insert item into result set
-    (*dblist)[dbid] = dirname;
-  }
-  return st;
-}
-
-//
-// Deletes the specified dbid from the registry
-//
-Status AwsEnv::DeleteDbid(const std::string& bucket, const std::string& dbid) {
-  // fetch the list all all dbids
-  std::string dbidkey = dbid_registry_ + dbid;
-  Status st =
-      cloud_env_options.storage_provider->DeleteCloudObject(bucket, dbidkey);
-  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
-      "[aws] %s DeleteDbid DeleteDbid(%s) %s", bucket.c_str(), dbid.c_str(),
-      st.ToString().c_str());
-  return st;
-}
-
 Status AwsEnv::LockFile(const std::string& /*fname*/, FileLock** lock) {
   // there isn's a very good way to atomically check and create
   // a file via libs3
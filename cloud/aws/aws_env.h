@@ -74,15 +74,6 @@ class AwsEnv : public CloudEnvImpl {
 
   std::string GetWALCacheDir();
 
-  // Saves and retrieves the dbid->dirname mapping in S3
-  Status SaveDbid(const std::string& bucket_name, const std::string& dbid,
-                  const std::string& dirname) override;
-  Status GetPathForDbid(const std::string& bucket, const std::string& dbid,
-                        std::string* dirname) override;
-  Status GetDbidList(const std::string& bucket, DbidList* dblist) override;
-  Status DeleteDbid(const std::string& bucket,
-                    const std::string& dbid) override;
-
  private:
   //
   // The AWS credentials are specified to the constructor via
@@ -91,9 +82,6 @@ class AwsEnv : public CloudEnvImpl {
   explicit AwsEnv(Env* underlying_env, const CloudEnvOptions& cloud_options,
                   const std::shared_ptr<Logger>& info_log = nullptr);
 
-  // The pathname that contains a list of all db's inside a bucket.
-  static constexpr const char* dbid_registry_ = "/.rockset/dbid/";
-
   Random64 rng_;
 };
 
@@ -5,8 +5,11 @@
 //
 
 #include <cinttypes>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 #include "cloud/cloud_log_controller_impl.h"
 #include "rocksdb/cloud/cloud_env_options.h"
@@ -24,6 +27,30 @@ namespace kafka {
 /***************************************************/
 /*                KafkaWritableFile                */
 /***************************************************/
+
+// A message whose delivery report is outstanding. The report may arrive
+// after the file is gone.
+struct KafkaDelivery {
+  std::shared_ptr<CloudLogSyncTracker> tracker;
+  uint64_t seq;
+};
+
+class KafkaDeliveryReporter : public RdKafka::DeliveryReportCb {
+ public:
+  void dr_cb(RdKafka::Message& message) override {
+    auto delivery = static_cast<KafkaDelivery*>(message.msg_opaque());
+    if (delivery == nullptr) {
+      return;
+    }
+    Status st;
+    if (message.err() != RdKafka::ERR_NO_ERROR) {
+      st = Status::IOError(message.topic_name(), message.errstr());
+    }
+    delivery->tracker->Acknowledge(delivery->seq, st);
+    delete delivery;
+  }
+};
+
 class KafkaWritableFile : public CloudLogWritableFile {
  public:
   static const std::chrono::microseconds kFlushTimeout;
@@ -31,16 +58,24 @@ class KafkaWritableFile : public CloudLogWritableFile {
   KafkaWritableFile(CloudEnv* env, const std::string& fname,
                     const EnvOptions& options,
                     std::shared_ptr<RdKafka::Producer> producer,
-                    std::shared_ptr<RdKafka::Topic> topic)
+                    std::shared_ptr<RdKafka::Topic> topic,
+                    CloudLogControllerImpl* controller)
       : CloudLogWritableFile(env, fname, options),
         producer_(producer),
         topic_(topic),
+        tracker_(std::make_shared<CloudLogSyncTracker>()),
         current_offset_(0) {
+    batcher_ = controller->NewBatcher(
+        [this](const Slice& message) { return ProduceRaw("Batch", message); });
     Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
         "[kafka] WritableFile opened file %s", fname_.c_str());
   }
 
-  ~KafkaWritableFile() {}
+  ~KafkaWritableFile() {
+    if (batcher_) {
+      batcher_->Stop();
+    }
+  }
   virtual Status Append(const Slice& data);
   virtual Status Close();
   virtual bool IsSyncThreadSafe() const;
@@ -50,9 +85,16 @@ class KafkaWritableFile : public CloudLogWritableFile {
 
  private:
   Status ProduceRaw(const std::string& operation_name, const Slice& message);
+  // Produces the record right away, or adds it to the batch
+  Status Produce(const std::string& operation_name, const Slice& record);
+  // Waits until the broker has acknowledged every message that the file sent
+  // so far. Messages that are sent meanwhile are not waited for.
+  Status WaitForDelivery();
 
   std::shared_ptr<RdKafka::Producer> producer_;
   std::shared_ptr<RdKafka::Topic> topic_;
+  std::shared_ptr<CloudLogSyncTracker> tracker_;
+  std::shared_ptr<CloudLogBatcher> batcher_;
 
   uint64_t current_offset_;
 };
@@ -61,40 +103,43 @@ const std::chrono::microseconds KafkaWritableFile::kFlushTimeout =
 
 Status KafkaWritableFile::ProduceRaw(const std::string& operation_name,
                                      const Slice& message) {
-  if (!status_.ok()) {
-    return status_;
-  }
+  // The delivery report of the message releases it
+  auto opaque = new KafkaDelivery{tracker_, tracker_->Sent()};
 
   RdKafka::ErrorCode resp;
   resp = producer_->produce(
       topic_.get(), RdKafka::Topic::PARTITION_UA /* UnAssigned */,
       RdKafka::Producer::RK_MSG_COPY /* Copy payload */, (void*)message.data(),
-      message.size(), &fname_ /* Partitioning key */, nullptr);
+      message.size(), &fname_ /* Partitioning key */, opaque);
 
   if (resp == RdKafka::ERR_NO_ERROR) {
     Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
         "[kafka] WritableFile %s file %s %ld", fname_.c_str(),
         operation_name.c_str(), message.size());
     return Status::OK();
-  } else if (resp == RdKafka::ERR__QUEUE_FULL) {
-    const std::string formatted_err = RdKafka::err2str(resp);
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kafka] WritableFile src %s %s error %s", fname_.c_str(),
-        operation_name.c_str(), formatted_err.c_str());
-
-    return Status::Busy(topic_->name().c_str(), RdKafka::err2str(resp).c_str());
+  }
+  tracker_->Acknowledge(opaque->seq, Status::OK());
+  delete opaque;
+  const std::string formatted_err = RdKafka::err2str(resp);
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[kafka] WritableFile src %s %s error %s", fname_.c_str(),
+      operation_name.c_str(), formatted_err.c_str());
+  if (resp == RdKafka::ERR__QUEUE_FULL) {
+    return Status::Busy(topic_->name().c_str(), formatted_err.c_str());
   } else {
-    const std::string formatted_err = RdKafka::err2str(resp);
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kafka] WritableFile src %s %s error %s", fname_.c_str(),
-        operation_name.c_str(), formatted_err.c_str());
-
-    return Status::IOError(topic_->name().c_str(),
-                           RdKafka::err2str(resp).c_str());
+    return Status::IOError(topic_->name().c_str(), formatted_err.c_str());
   }
-  current_offset_ += message.size();
+}
 
-  return Status::OK();
+Status KafkaWritableFile::Produce(const std::string& operation_name,
+                                  const Slice& record) {
+  if (!status_.ok()) {
+    return status_;
+  }
+  if (batcher_) {
+    return batcher_->Add(record);
+  }
+  return ProduceRaw(operation_name, record);
 }
 
 Status KafkaWritableFile::Append(const Slice& data) {
@@ -102,7 +147,11 @@ Status KafkaWritableFile::Append(const Slice& data) {
   CloudLogControllerImpl::SerializeLogRecordAppend(
       fname_, data, current_offset_, &serialized_data);
 
-  return ProduceRaw("Append", serialized_data);
+  Status st = Produce("Append", serialized_data);
+  if (st.ok()) {
+    current_offset_ += data.size();
+  }
+  return st;
 }
 
 Status KafkaWritableFile::Close() {
@@ -113,43 +162,60 @@ Status KafkaWritableFile::Close() {
   CloudLogControllerImpl::SerializeLogRecordClosed(fname_, current_offset_,
                                                    &serialized_data);
 
-  return ProduceRaw("Close", serialized_data);
+  Status st = Produce("Close", serialized_data);
+  if (batcher_) {
+    Status ss = batcher_->Stop();
+    if (st.ok()) {
+      st = ss;
+    }
+  }
+  return st;
 }
 
 bool KafkaWritableFile::IsSyncThreadSafe() const { return true; }
 
-Status KafkaWritableFile::Sync() { return Flush(); }
+Status KafkaWritableFile::Sync() {
+  if (batcher_ && status_.ok()) {
+    status_ = batcher_->Send();
+  }
+  return WaitForDelivery();
+}
 
 Status KafkaWritableFile::Flush() {
-  std::chrono::microseconds start(env_->NowMicros());
-
-  bool done = false;
-  bool timeout = false;
-  while (status_.ok() && !(done = (producer_->outq_len() == 0)) &&
-         !(timeout = (std::chrono::microseconds(env_->NowMicros()) - start >
-                      kFlushTimeout))) {
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kafka] WritableFile src %s "
-        "Waiting on flush: Output queue length: %d",
-        fname_.c_str(), producer_->outq_len());
+  if (batcher_) {
+    // The batch is sent when it is full or due, and acknowledged on Sync()
+    return status_;
+  }
+  return WaitForDelivery();
+}
 
-    producer_->poll(500);
+Status KafkaWritableFile::WaitForDelivery() {
+  if (!status_.ok()) {
+    return status_;
   }
+  const uint64_t seq = tracker_->last_sent();
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[kafka] WritableFile src %s "
+      "Waiting on flush: %" PRIu64 " of %" PRIu64 " messages delivered",
+      fname_.c_str(), tracker_->durable(), seq);
+  Status st = tracker_->Wait(seq, kFlushTimeout);
 
-  if (done) {
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kafka] WritableFile src %s Flushed", fname_.c_str());
-  } else if (timeout) {
+  if (st.IsTimedOut()) {
     Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
         "[kafka] WritableFile src %s Flushing timed out after %" PRId64 "us",
         fname_.c_str(), kFlushTimeout.count());
-    status_ = Status::TimedOut();
+    status_ = st;
+  } else if (!st.ok()) {
+    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+        "[kafka] WritableFile src %s Delivery failed: %s", fname_.c_str(),
+        st.ToString().c_str());
+    status_ = st;
   } else {
     Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kafka] WritableFile src %s Flush interrupted", fname_.c_str());
+        "[kafka] WritableFile src %s Flushed", fname_.c_str());
   }
 
-  return status_;
+  return st;
 }
 
 Status KafkaWritableFile::LogDelete() {
@@ -159,7 +225,11 @@ Status KafkaWritableFile::LogDelete() {
   std::string serialized_data;
   CloudLogControllerImpl::SerializeLogRecordDelete(fname_, &serialized_data);
 
-  return ProduceRaw("Delete", serialized_data);
+  Status st = Produce("Delete", serialized_data);
+  if (st.ok() && batcher_) {
+    st = batcher_->Send();
+  }
+  return st;
 }
 
 /***************************************************/
@@ -172,6 +242,10 @@ Status KafkaWritableFile::LogDelete() {
 class KafkaController : public CloudLogControllerImpl {
  public:
   ~KafkaController() {
+    stop_polling_ = true;
+    if (poller_.joinable()) {
+      poller_.join();
+    }
     for (size_t i = 0; i < partitions_.size(); i++) {
       consumer_->stop(consumer_topic_.get(), partitions_[i]->partition());
     }
@@ -205,6 +279,8 @@ class KafkaController : public CloudLogControllerImpl {
  private:
   Status InitializePartitions();
 
+  // Declared before the producer, which refers to it
+  KafkaDeliveryReporter delivery_reporter_;
   std::shared_ptr<RdKafka::Producer> producer_;
   std::shared_ptr<RdKafka::Consumer> consumer_;
 
@@ -214,6 +290,10 @@ class KafkaController : public CloudLogControllerImpl {
   std::shared_ptr<RdKafka::Queue> consuming_queue_;
 
   std::vector<std::shared_ptr<RdKafka::TopicPartition>> partitions_;
+
+  // Serves the delivery reports of the producer
+  std::thread poller_;
+  std::atomic<bool> stop_polling_{false};
 };
 
 Status KafkaController::Initialize(CloudEnv* env) {
@@ -242,6 +322,14 @@ Status KafkaController::Initialize(CloudEnv* env) {
       return s;
     }
   }
+  if (conf->set("dr_cb", &delivery_reporter_, conf_errstr) !=
+      RdKafka::Conf::CONF_OK) {
+    s = Status::InvalidArgument("Failed setting Kafka delivery report callback",
+                                conf_errstr.c_str());
+    Log(InfoLogLevel::ERROR_LEVEL, env->info_log_,
+        "[%s] Kafka conf set error: %s", Name(), s.ToString().c_str());
+    return s;
+  }
 
   producer_.reset(RdKafka::Producer::create(conf.get(), producer_errstr));
   consumer_.reset(RdKafka::Consumer::create(conf.get(), consumer_errstr));
@@ -277,6 +365,14 @@ Status KafkaController::Initialize(CloudEnv* env) {
     assert(producer_topic_ != nullptr);
     assert(consumer_topic_ != nullptr);
     assert(consuming_queue_ != nullptr);
+
+    // Writable files learn that their messages were delivered from the
+    // delivery reports, which are only served by polling the producer
+    poller_ = std::thread([this]() {
+      while (!stop_polling_) {
+        producer_->poll(100);
+      }
+    });
   }
   return s;
 }
@@ -411,7 +507,8 @@ Status KafkaController::InitializePartitions() {
 CloudLogWritableFile* KafkaController::CreateWritableFile(
     const std::string& fname, const EnvOptions& options) {
   return dynamic_cast<CloudLogWritableFile*>(
-      new KafkaWritableFile(env_, fname, options, producer_, producer_topic_));
+      new KafkaWritableFile(env_, fname, options, producer_, producer_topic_,
+                            this));
 }
 
 }  // namespace kafka
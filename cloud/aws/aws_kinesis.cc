@@ -43,7 +43,8 @@ class KinesisWritableFile : public CloudLogWritableFile {
  public:
   KinesisWritableFile(
       CloudEnv* env, const std::string& fname, const EnvOptions& options,
-      const std::shared_ptr<Aws::Kinesis::KinesisClient>& kinesis_client)
+      const std::shared_ptr<Aws::Kinesis::KinesisClient>& kinesis_client,
+      CloudLogControllerImpl* controller)
       : CloudLogWritableFile(env, fname, options),
         kinesis_client_(kinesis_client),
         current_offset_(0) {
@@ -51,32 +52,39 @@ class KinesisWritableFile : public CloudLogWritableFile {
         "[kinesis] WritableFile opened file %s", fname_.c_str());
     std::string bucket = env_->GetSrcBucketName();
     topic_ = Aws::String(bucket.c_str(), bucket.size());
+    batcher_ = controller->NewBatcher(
+        [this](const Slice& message) { return PutRecord("Batch", message); });
+  }
+  virtual ~KinesisWritableFile() {
+    if (batcher_) {
+      batcher_->Stop();
+    }
   }
-  virtual ~KinesisWritableFile() {}
 
   virtual Status Append(const Slice& data) override;
   virtual Status Close() override;
+  virtual Status Sync() override;
   virtual Status LogDelete() override;
 
  private:
+  // Writes a single record to the stream
+  Status PutRecord(const char* operation, const Slice& buffer);
+  // Writes the record right away, or adds it to the batch
+  Status Produce(const char* operation, const Slice& buffer);
+
   std::shared_ptr<Aws::Kinesis::KinesisClient> kinesis_client_;
   Aws::String topic_;
   uint64_t current_offset_;
+  std::shared_ptr<CloudLogBatcher> batcher_;
 };
 
-Status KinesisWritableFile::Append(const Slice& data) {
-  assert(status_.ok());
-
+Status KinesisWritableFile::PutRecord(const char* operation,
+                                      const Slice& buffer) {
   // create write request
   Aws::Kinesis::Model::PutRecordRequest request;
   request.SetStreamName(topic_);
   request.SetPartitionKey(Aws::String(fname_.c_str(), fname_.size()));
-
-  // serialize write record
-  std::string buffer;
-  CloudLogControllerImpl::SerializeLogRecordAppend(fname_, data,
-                                                   current_offset_, &buffer);
-  request.SetData(Aws::Utils::ByteBuffer((const unsigned char*)buffer.c_str(),
+  request.SetData(Aws::Utils::ByteBuffer((const unsigned char*)buffer.data(),
                                          buffer.size()));
 
   // write to stream
@@ -87,51 +95,61 @@ Status KinesisWritableFile::Append(const Slice& data) {
     const Aws::Client::AWSError<Aws::Kinesis::KinesisErrors>& error =
         outcome.GetError();
     Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kinesis] NewWritableFile src %s Append error %s", fname_.c_str(),
+        "[kinesis] WritableFile src %s %s error %s", fname_.c_str(), operation,
         error.GetMessage().c_str());
     return Status::IOError(fname_, error.GetMessage().c_str());
   }
-  current_offset_ += data.size();
   Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-      "[kinesis] WritableFile Append file %s %ld %ld", fname_.c_str(),
-      data.size(), buffer.size());
+      "[kinesis] WritableFile %s file %s %ld", operation, fname_.c_str(),
+      buffer.size());
   return Status::OK();
 }
 
+Status KinesisWritableFile::Produce(const char* operation,
+                                    const Slice& buffer) {
+  if (batcher_) {
+    return batcher_->Add(buffer);
+  }
+  return PutRecord(operation, buffer);
+}
+
+Status KinesisWritableFile::Append(const Slice& data) {
+  assert(status_.ok());
+
+  // serialize write record
+  std::string buffer;
+  CloudLogControllerImpl::SerializeLogRecordAppend(fname_, data,
+                                                   current_offset_, &buffer);
+  Status st = Produce("Append", buffer);
+  if (st.ok()) {
+    current_offset_ += data.size();
+  }
+  return st;
+}
+
 Status KinesisWritableFile::Close() {
   Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
       "[kinesis] S3WritableFile closing %s", fname_.c_str());
   assert(status_.ok());
 
-  // create write request
-  Aws::Kinesis::Model::PutRecordRequest request;
-  request.SetStreamName(topic_);
-  request.SetPartitionKey(Aws::String(fname_.c_str(), fname_.size()));
-
   // serialize write record
   std::string buffer;
   CloudLogControllerImpl::SerializeLogRecordClosed(fname_, current_offset_,
                                                    &buffer);
-  request.SetData(Aws::Utils::ByteBuffer((const unsigned char*)buffer.c_str(),
-                                         buffer.size()));
-
-  // write to stream
-  const auto& outcome = kinesis_client_->PutRecord(request);
-  bool isSuccess = outcome.IsSuccess();
-
-  if (!isSuccess) {
-    const Aws::Client::AWSError<Aws::Kinesis::KinesisErrors>& error =
-        outcome.GetError();
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kinesis] NewWritableFile src %s Close error %s", fname_.c_str(),
-        error.GetMessage().c_str());
-    return Status::IOError(fname_, error.GetMessage().c_str());
+  Status st = Produce("Close", buffer);
+  if (batcher_) {
+    Status ss = batcher_->Stop();
+    if (st.ok()) {
+      st = ss;
+    }
   }
-  current_offset_ += buffer.size();
-  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-      "[kinesis] WritableFile Close file %s %ld", fname_.c_str(),
-      buffer.size());
-  return Status::OK();
+  return st;
+}
+
+Status KinesisWritableFile::Sync() {
+  assert(status_.ok());
+  // Records are acknowledged when PutRecord returns
+  return batcher_ ? batcher_->Send() : status_;
 }
 
 //
@@ -142,33 +160,14 @@ Status KinesisWritableFile::LogDelete() {
       fname_.c_str());
   assert(status_.ok());
 
-  // create write request
-  Aws::Kinesis::Model::PutRecordRequest request;
-  request.SetStreamName(topic_);
-  request.SetPartitionKey(Aws::String(fname_.c_str(), fname_.size()));
-
   // serialize write record
   std::string buffer;
   CloudLogControllerImpl::SerializeLogRecordDelete(fname_, &buffer);
-  request.SetData(Aws::Utils::ByteBuffer((const unsigned char*)buffer.c_str(),
-                                         buffer.size()));
-
-  // write to stream
-  const Aws::Kinesis::Model::PutRecordOutcome& outcome =
-      kinesis_client_->PutRecord(request);
-  bool isSuccess = outcome.IsSuccess();
-
-  if (!isSuccess) {
-    const Aws::Client::AWSError<Aws::Kinesis::KinesisErrors>& error =
-        outcome.GetError();
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[kinesis] LogDelete src %s error %s", fname_.c_str(),
-        error.GetMessage().c_str());
-    return Status::IOError(fname_, error.GetMessage().c_str());
+  Status st = Produce("Delete", buffer);
+  if (st.ok() && batcher_) {
+    st = batcher_->Send();
   }
-  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-      "[kinesis] LogDelete file %s %ld", fname_.c_str(), buffer.size());
-  return Status::OK();
+  return st;
 }
 
 /***************************************************/
@@ -476,7 +475,7 @@ void KinesisController::SeekShards() {
 CloudLogWritableFile* KinesisController::CreateWritableFile(
     const std::string& fname, const EnvOptions& options) {
   return dynamic_cast<CloudLogWritableFile*>(
-      new KinesisWritableFile(env_, fname, options, kinesis_client_));
+      new KinesisWritableFile(env_, fname, options, kinesis_client_, this));
 }
 
 }  // namespace kinesis
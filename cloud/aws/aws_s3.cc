@@ -6,17 +6,23 @@
 //
 #ifdef USE_AWS
 #include <aws/core/Aws.h>
+#include <aws/core/utils/HashingUtils.h>
 #include <aws/core/utils/Outcome.h>
 #include <aws/core/utils/crypto/CryptoStream.h>
 #include <aws/core/utils/memory/stl/AWSStreamFwd.h>
 #include <aws/s3/S3Client.h>
 #include <aws/s3/S3Errors.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
 #include <aws/s3/model/BucketLocationConstraint.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
+#include <aws/s3/model/CompletedMultipartUpload.h>
+#include <aws/s3/model/CompletedPart.h>
 #include <aws/s3/model/CopyObjectRequest.h>
 #include <aws/s3/model/CopyObjectResult.h>
 #include <aws/s3/model/CreateBucketConfiguration.h>
 #include <aws/s3/model/CreateBucketRequest.h>
 #include <aws/s3/model/CreateBucketResult.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
 #include <aws/s3/model/DeleteBucketRequest.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
 #include <aws/s3/model/DeleteObjectResult.h>
@@ -32,6 +38,7 @@
 #include <aws/s3/model/PutObjectRequest.h>
 #include <aws/s3/model/PutObjectResult.h>
 #include <aws/s3/model/ServerSideEncryption.h>
+#include <aws/s3/model/UploadPartRequest.h>
 #include <aws/transfer/TransferManager.h>
 #endif  // USE_AWS
 
@@ -226,6 +233,42 @@ class AwsS3ClientWrapper {
     return handle;
   }
 
+  Aws::S3::Model::CreateMultipartUploadOutcome CreateMultipartUpload(
+      const Aws::S3::Model::CreateMultipartUploadRequest& request) {
+    CloudRequestCallbackGuard t(cloud_request_callback_.get(),
+                                CloudRequestOpType::kWriteOp);
+    auto outcome = client_->CreateMultipartUpload(request);
+    t.SetSuccess(outcome.IsSuccess());
+    return outcome;
+  }
+
+  Aws::S3::Model::UploadPartOutcome UploadPart(
+      const Aws::S3::Model::UploadPartRequest& request, uint64_t size_hint) {
+    CloudRequestCallbackGuard t(cloud_request_callback_.get(),
+                                CloudRequestOpType::kWriteOp, size_hint);
+    auto outcome = client_->UploadPart(request);
+    t.SetSuccess(outcome.IsSuccess());
+    return outcome;
+  }
+
+  Aws::S3::Model::CompleteMultipartUploadOutcome CompleteMultipartUpload(
+      const Aws::S3::Model::CompleteMultipartUploadRequest& request) {
+    CloudRequestCallbackGuard t(cloud_request_callback_.get(),
+                                CloudRequestOpType::kWriteOp);
+    auto outcome = client_->CompleteMultipartUpload(request);
+    t.SetSuccess(outcome.IsSuccess());
+    return outcome;
+  }
+
+  Aws::S3::Model::AbortMultipartUploadOutcome AbortMultipartUpload(
+      const Aws::S3::Model::AbortMultipartUploadRequest& request) {
+    CloudRequestCallbackGuard t(cloud_request_callback_.get(),
+                                CloudRequestOpType::kDeleteOp);
+    auto outcome = client_->AbortMultipartUpload(request);
+    t.SetSuccess(outcome.IsSuccess());
+    return outcome;
+  }
+
   Aws::S3::Model::HeadObjectOutcome HeadObject(
       const Aws::S3::Model::HeadObjectRequest& request) {
     CloudRequestCallbackGuard t(cloud_request_callback_.get(),
@@ -376,6 +419,14 @@ class S3StorageProvider : public CloudStorageProviderImpl {
   Status ListCloudObjects(const std::string& bucket_name,
                           const std::string& object_path,
                           std::vector<std::string>* result) override;
+  Status ListCloudObjectsWithInfo(
+      const std::string& bucket_name, const std::string& object_path,
+      std::vector<std::string>* path_names,
+      std::vector<CloudObjectInformation>* infos) override;
+  Status ListCloudObjectsWithPrefix(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& name_prefix,
+      std::vector<std::string>* path_names) override;
   Status ExistsCloudObject(const std::string& bucket_name,
                            const std::string& object_path) override;
   Status GetCloudObjectSize(const std::string& bucket_name,
@@ -419,6 +470,22 @@ class S3StorageProvider : public CloudStorageProviderImpl {
                           const std::string& bucket_name,
                           const std::string& object_path,
                           uint64_t file_size) override;
+  Status DoCreateMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::unordered_map<std::string, std::string>& metadata,
+      std::string* upload_id) override;
+  Status DoUploadPart(const std::string& bucket_name,
+                      const std::string& object_path,
+                      const std::string& upload_id, int part_number,
+                      const Slice& data, uint32_t crc,
+                      std::string* etag) override;
+  Status DoCompleteMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& upload_id,
+      const std::vector<std::string>& etags) override;
+  Status DoAbortMultipartUpload(const std::string& bucket_name,
+                                const std::string& object_path,
+                                const std::string& upload_id) override;
 
  private:
   // If metadata, size modtime or etag is non-nullptr, returns requested data
@@ -428,6 +495,14 @@ class S3StorageProvider : public CloudStorageProviderImpl {
       uint64_t* size = nullptr, uint64_t* modtime = nullptr,
       std::string* etag = nullptr);
 
+  // Lists the objects below object_path whose names start with name_prefix.
+  // If infos is non-nullptr, also returns their information.
+  Status ListObjects(const std::string& bucket_name,
+                     const std::string& object_path,
+                     const std::string& name_prefix,
+                     std::vector<std::string>* result,
+                     std::vector<CloudObjectInformation>* infos);
+
   // The S3 client
   std::shared_ptr<AwsS3ClientWrapper> s3client_;
 };
@@ -593,6 +668,28 @@ Status S3StorageProvider::DeleteCloudObject(const std::string& bucket_name,
 Status S3StorageProvider::ListCloudObjects(const std::string& bucket_name,
                                            const std::string& object_path,
                                            std::vector<std::string>* result) {
+  return ListCloudObjectsWithInfo(bucket_name, object_path, result, nullptr);
+}
+
+// The information of the objects is part of every page of the listing
+Status S3StorageProvider::ListCloudObjectsWithInfo(
+    const std::string& bucket_name, const std::string& object_path,
+    std::vector<std::string>* result,
+    std::vector<CloudObjectInformation>* infos) {
+  return ListObjects(bucket_name, object_path, "", result, infos);
+}
+
+// S3 filters by the prefix, so only the matching objects are paged through
+Status S3StorageProvider::ListCloudObjectsWithPrefix(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& name_prefix, std::vector<std::string>* result) {
+  return ListObjects(bucket_name, object_path, name_prefix, result, nullptr);
+}
+
+Status S3StorageProvider::ListObjects(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& name_prefix, std::vector<std::string>* result,
+    std::vector<CloudObjectInformation>* infos) {
   // S3 paths don't start with '/'
   auto prefix = ltrim_if(object_path, '/');
   // S3 paths better end with '/', otherwise we might also get a list of files
@@ -609,7 +706,7 @@ Status S3StorageProvider::ListCloudObjects(const std::string& bucket_name,
     request.SetMaxKeys(
         env_->GetCloudEnvOptions().number_objects_listed_in_one_iteration);
 
-    request.SetPrefix(ToAwsString(prefix));
+    request.SetPrefix(ToAwsString(prefix + name_prefix));
     request.SetMarker(marker);
 
     Aws::S3::Model::ListObjectsOutcome outcome =
@@ -639,6 +736,14 @@ Status S3StorageProvider::ListCloudObjects(const std::string& bucket_name,
       }
       auto fname = keystr.substr(prefix.size());
       result->push_back(fname);
+      if (infos != nullptr) {
+        CloudObjectInformation info;
+        info.size = o.GetSize();
+        info.modification_time = o.GetLastModified().Millis();
+        info.content_hash =
+            std::string(o.GetETag().data(), o.GetETag().length());
+        infos->push_back(std::move(info));
+      }
     }
 
     // If there are no more entries, then we are done.
@@ -909,6 +1014,110 @@ Status S3StorageProvider::DoPutCloudObject(const std::string& local_file,
   return Status::OK();
 }
 
+Status S3StorageProvider::DoCreateMultipartUpload(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::unordered_map<std::string, std::string>& metadata,
+    std::string* upload_id) {
+  Aws::S3::Model::CreateMultipartUploadRequest request;
+  Aws::Map<Aws::String, Aws::String> aws_metadata;
+  for (const auto& m : metadata) {
+    aws_metadata[ToAwsString(m.first)] = ToAwsString(m.second);
+  }
+  request.SetBucket(ToAwsString(bucket_name));
+  request.SetKey(ToAwsString(object_path));
+  request.SetMetadata(aws_metadata);
+  SetEncryptionParameters(env_->GetCloudEnvOptions(), request);
+  auto outcome = s3client_->CreateMultipartUpload(request);
+  if (!outcome.IsSuccess()) {
+    const auto& error = outcome.GetError();
+    std::string errmsg(error.GetMessage().c_str(), error.GetMessage().size());
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[s3] CreateMultipartUpload %s/%s error %s", bucket_name.c_str(),
+        object_path.c_str(), errmsg.c_str());
+    return Status::IOError(object_path, errmsg);
+  }
+  const auto& id = outcome.GetResult().GetUploadId();
+  upload_id->assign(id.c_str(), id.size());
+  return Status::OK();
+}
+
+Status S3StorageProvider::DoUploadPart(const std::string& bucket_name,
+                                       const std::string& object_path,
+                                       const std::string& upload_id,
+                                       int part_number, const Slice& data,
+                                       uint32_t /*crc*/, std::string* etag) {
+  // S3 verifies parts by their MD5 rather than by crc32c
+  auto body = Aws::MakeShared<Aws::StringStream>(object_path.c_str());
+  body->write(data.data(), data.size());
+  Aws::S3::Model::UploadPartRequest request;
+  request.SetBucket(ToAwsString(bucket_name));
+  request.SetKey(ToAwsString(object_path));
+  request.SetUploadId(ToAwsString(upload_id));
+  request.SetPartNumber(part_number);
+  request.SetContentLength(data.size());
+  request.SetContentMD5(Aws::Utils::HashingUtils::Base64Encode(
+      Aws::Utils::HashingUtils::CalculateMD5(*body)));
+  body->seekg(0);
+  request.SetBody(body);
+  auto outcome = s3client_->UploadPart(request, data.size());
+  if (!outcome.IsSuccess()) {
+    const auto& error = outcome.GetError();
+    std::string errmsg(error.GetMessage().c_str(), error.GetMessage().size());
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[s3] UploadPart %s/%s part %d error %s", bucket_name.c_str(),
+        object_path.c_str(), part_number, errmsg.c_str());
+    return Status::IOError(object_path, errmsg);
+  }
+  const auto& tag = outcome.GetResult().GetETag();
+  etag->assign(tag.c_str(), tag.size());
+  return Status::OK();
+}
+
+Status S3StorageProvider::DoCompleteMultipartUpload(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& upload_id, const std::vector<std::string>& etags) {
+  Aws::S3::Model::CompletedMultipartUpload upload;
+  for (size_t i = 0; i < etags.size(); i++) {
+    upload.AddParts(Aws::S3::Model::CompletedPart()
+                        .WithPartNumber(static_cast<int>(i + 1))
+                        .WithETag(ToAwsString(etags[i])));
+  }
+  Aws::S3::Model::CompleteMultipartUploadRequest request;
+  request.SetBucket(ToAwsString(bucket_name));
+  request.SetKey(ToAwsString(object_path));
+  request.SetUploadId(ToAwsString(upload_id));
+  request.SetMultipartUpload(upload);
+  auto outcome = s3client_->CompleteMultipartUpload(request);
+  if (!outcome.IsSuccess()) {
+    const auto& error = outcome.GetError();
+    std::string errmsg(error.GetMessage().c_str(), error.GetMessage().size());
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[s3] CompleteMultipartUpload %s/%s error %s", bucket_name.c_str(),
+        object_path.c_str(), errmsg.c_str());
+    return Status::IOError(object_path, errmsg);
+  }
+  return Status::OK();
+}
+
+Status S3StorageProvider::DoAbortMultipartUpload(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& upload_id) {
+  Aws::S3::Model::AbortMultipartUploadRequest request;
+  request.SetBucket(ToAwsString(bucket_name));
+  request.SetKey(ToAwsString(object_path));
+  request.SetUploadId(ToAwsString(upload_id));
+  auto outcome = s3client_->AbortMultipartUpload(request);
+  if (!outcome.IsSuccess()) {
+    const auto& error = outcome.GetError();
+    std::string errmsg(error.GetMessage().c_str(), error.GetMessage().size());
+    Log(InfoLogLevel::WARN_LEVEL, env_->info_log_,
+        "[s3] AbortMultipartUpload %s/%s error %s", bucket_name.c_str(),
+        object_path.c_str(), errmsg.c_str());
+    return Status::IOError(object_path, errmsg);
+  }
+  return Status::OK();
+}
+
 #endif /* USE_AWS */
 
 Status CloudStorageProviderImpl::CreateS3Provider(
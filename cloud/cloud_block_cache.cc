@@ -0,0 +1,657 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_block_cache.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include "monitoring/statistics.h"
+#include "rocksdb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/hash.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+const char* kBlockSuffix = ".blk";
+const char* kTmpSuffix = ".tmp";
+// The names of the blocks, most recently used first
+const char* kOrderFile = "LRU";
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//
+// Reads a cloud object through a CloudBlockCache. A read is split into
+// blocks; the blocks that are not cached are read from the object with one
+// request per run of adjacent blocks and then added to the cache.
+//
+class CloudBlockCacheReadableFile : public CloudStorageReadableFile {
+ public:
+  CloudBlockCacheReadableFile(CloudBlockCache* cache,
+                              std::unique_ptr<CloudStorageReadableFile> file,
+                              const std::string& object,
+                              const std::string& version, uint64_t size)
+      : cache_(cache),
+        file_(std::move(file)),
+        object_(object),
+        version_(version),
+        file_size_(size),
+        offset_(0) {}
+
+  const char* Name() const override { return file_->Name(); }
+
+  Status Read(size_t n, Slice* result, char* scratch) override {
+    Status s = Read(offset_, n, result, scratch);
+    if (s.ok()) {
+      offset_ += result->size();
+    }
+    return s;
+  }
+
+  Status Skip(uint64_t n) override {
+    offset_ = std::min(offset_ + n, file_size_);
+    return Status::OK();
+  }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    *result = Slice();
+    if (offset >= file_size_ || n == 0) {
+      return Status::OK();
+    }
+    n = static_cast<size_t>(std::min<uint64_t>(n, file_size_ - offset));
+    BlockRange range;
+    LookupBlocks(offset, n, &range);
+    for (size_t i = 0; i < range.blocks.size();) {
+      if (range.cached[i]) {
+        i++;
+        continue;
+      }
+      size_t end = i;
+      while (end < range.blocks.size() && !range.cached[end]) {
+        end++;
+      }
+      Status s = ReadBlocks(range.first + i, end - i, &range.blocks[i]);
+      if (!s.ok()) {
+        return s;
+      }
+      i = end;
+    }
+    return CopyBlocks(range, result, scratch);
+  }
+
+  // Serves what it can of the batch from the cache. The runs of missing
+  // blocks of all the requests are read with a single MultiRead() of the
+  // file, which merges nearby runs into one cloud request, and are then
+  // added to the cache.
+  Status MultiRead(ReadRequest* reqs, size_t num_reqs) override {
+    const uint64_t bs = cache_->block_size();
+    std::vector<BlockRange> ranges(num_reqs);
+    std::set<uint64_t> missing;
+    for (size_t i = 0; i < num_reqs; i++) {
+      reqs[i].result = Slice();
+      reqs[i].status = Status::OK();
+      if (reqs[i].offset >= file_size_ || reqs[i].len == 0) {
+        continue;
+      }
+      const size_t n = static_cast<size_t>(
+          std::min<uint64_t>(reqs[i].len, file_size_ - reqs[i].offset));
+      LookupBlocks(reqs[i].offset, n, &ranges[i]);
+      for (size_t b = 0; b < ranges[i].blocks.size(); b++) {
+        if (!ranges[i].cached[b]) {
+          missing.insert(ranges[i].first + b);
+        }
+      }
+    }
+
+    std::vector<ReadRequest> runs;
+    std::vector<uint64_t> run_blocks;
+    for (uint64_t block : missing) {
+      if (!runs.empty() &&
+          runs.back().offset + runs.back().len == block * bs) {
+        runs.back().len += bs;
+      } else {
+        runs.emplace_back();
+        runs.back().offset = block * bs;
+        runs.back().len = bs;
+        run_blocks.push_back(block);
+      }
+    }
+    std::vector<std::string> buffers(runs.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+      runs[i].len = static_cast<size_t>(
+          std::min<uint64_t>(runs[i].len, file_size_ - runs[i].offset));
+      buffers[i].resize(runs[i].len);
+      runs[i].scratch = &buffers[i][0];
+    }
+    if (!runs.empty()) {
+      Status s = file_->MultiRead(runs.data(), runs.size());
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    // The blocks that were read, or the error of the read they were in
+    std::map<uint64_t, Slice> fetched;
+    std::map<uint64_t, Status> failed;
+    for (size_t i = 0; i < runs.size(); i++) {
+      Status s = runs[i].status;
+      if (s.ok() && runs[i].result.size() != runs[i].len) {
+        s = Status::IOError("Short read from cloud storage", object_);
+      }
+      for (uint64_t off = 0; off < runs[i].len; off += bs) {
+        const uint64_t block = run_blocks[i] + off / bs;
+        if (!s.ok()) {
+          failed[block] = s;
+          continue;
+        }
+        Slice b(runs[i].result.data() + off,
+                static_cast<size_t>(std::min<uint64_t>(bs, runs[i].len - off)));
+        fetched[block] = b;
+        // a failure to cache the block does not fail the read
+        cache_->Insert(object_, version_, block, b);
+      }
+    }
+
+    for (size_t i = 0; i < num_reqs; i++) {
+      BlockRange& range = ranges[i];
+      for (size_t b = 0; b < range.blocks.size() && reqs[i].status.ok();
+           b++) {
+        if (range.cached[b]) {
+          continue;
+        }
+        auto it = fetched.find(range.first + b);
+        if (it == fetched.end()) {
+          reqs[i].status = failed[range.first + b];
+        } else {
+          range.blocks[b].assign(it->second.data(), it->second.size());
+        }
+      }
+      if (reqs[i].status.ok() && !range.blocks.empty()) {
+        reqs[i].status = CopyBlocks(range, &reqs[i].result, reqs[i].scratch);
+      }
+    }
+    return Status::OK();
+  }
+
+  // Brings the blocks of the range into the cache, with one request for
+  // every run of missing blocks
+  Status Prefetch(uint64_t offset, size_t n) override {
+    if (offset >= file_size_) {
+      return Status::OK();
+    }
+    std::string buffer(
+        static_cast<size_t>(std::min<uint64_t>(n, file_size_ - offset)), '\0');
+    Slice result;
+    return Read(offset, buffer.size(), &result, &buffer[0]);
+  }
+
+  size_t GetUniqueId(char* id, size_t max_size) const override {
+    return file_->GetUniqueId(id, max_size);
+  }
+
+ private:
+  // The blocks of a range that are looked up in the cache, and the part of
+  // every block that the range covers
+  struct BlockRange {
+    uint64_t first = 0;
+    // The covered part of a cached block, or the whole block once it was
+    // read from cloud storage
+    std::vector<std::string> blocks;
+    std::vector<bool> cached;
+    std::vector<uint64_t> starts;
+    std::vector<size_t> lens;
+  };
+
+  // Only the part of every block that is in the range is read from the
+  // cache. REQUIRES: n > 0 and the range is within the file
+  void LookupBlocks(uint64_t offset, size_t n, BlockRange* range) const {
+    const uint64_t bs = cache_->block_size();
+    range->first = offset / bs;
+    const size_t count =
+        static_cast<size_t>((offset + n - 1) / bs - range->first + 1);
+    range->blocks.resize(count);
+    range->cached.resize(count);
+    range->starts.resize(count);
+    range->lens.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      const uint64_t block_offset = (range->first + i) * bs;
+      range->starts[i] = std::max(offset, block_offset) - block_offset;
+      range->lens[i] =
+          static_cast<size_t>(std::min(offset + n, block_offset + bs) -
+                              block_offset - range->starts[i]);
+      range->cached[i] =
+          cache_->Lookup(object_, version_, range->first + i,
+                         range->starts[i], range->lens[i], &range->blocks[i])
+              .ok() &&
+          range->blocks[i].size() == range->lens[i];
+    }
+  }
+
+  Status CopyBlocks(const BlockRange& range, Slice* result,
+                    char* scratch) const {
+    size_t copied = 0;
+    for (size_t i = 0; i < range.blocks.size(); i++) {
+      const std::string& block = range.blocks[i];
+      // a whole block holds the covered part at its start offset
+      const uint64_t start =
+          block.size() == range.lens[i] ? 0 : range.starts[i];
+      if (block.size() < start + range.lens[i]) {
+        return Status::Corruption("Short block", object_);
+      }
+      memcpy(scratch + copied, block.data() + start, range.lens[i]);
+      copied += range.lens[i];
+    }
+    *result = Slice(scratch, copied);
+    return Status::OK();
+  }
+
+  // Reads count blocks starting at block from cloud storage into blocks[]
+  // and adds them to the cache
+  Status ReadBlocks(uint64_t block, size_t count, std::string* blocks) const {
+    const uint64_t bs = cache_->block_size();
+    const uint64_t start = block * bs;
+    const size_t len =
+        static_cast<size_t>(std::min(count * bs, file_size_ - start));
+    std::string buffer(len, '\0');
+    Slice data;
+    const RandomAccessFile* file = file_.get();
+    Status s = file->Read(start, len, &data, &buffer[0]);
+    if (!s.ok()) {
+      return s;
+    }
+    if (data.size() != len) {
+      return Status::IOError("Short read from cloud storage", object_);
+    }
+    for (size_t i = 0; i < count; i++) {
+      const size_t off = static_cast<size_t>(i * bs);
+      Slice b(data.data() + off, std::min<size_t>(bs, len - off));
+      blocks[i].assign(b.data(), b.size());
+      // a failure to cache the block does not fail the read
+      cache_->Insert(object_, version_, block + i, b);
+    }
+    return s;
+  }
+
+  CloudBlockCache* cache_;
+  std::unique_ptr<CloudStorageReadableFile> file_;
+  const std::string object_;
+  const std::string version_;
+  const uint64_t file_size_;
+  uint64_t offset_;
+};
+}  // namespace
+
+CloudBlockCache::CloudBlockCache(Env* env, const std::string& dir,
+                                 uint64_t capacity, size_t block_size,
+                                 const std::shared_ptr<Logger>& info_log,
+                                 const std::shared_ptr<Statistics>& statistics)
+    : env_(env),
+      dir_(dir),
+      capacity_(capacity),
+      block_size_(block_size),
+      info_log_(info_log),
+      statistics_(statistics),
+      usage_(0),
+      next_tmp_(0),
+      hits_(0),
+      misses_(0),
+      bytes_read_(0),
+      bytes_inserted_(0),
+      evictions_(0) {}
+
+CloudBlockCache::~CloudBlockCache() {
+  SaveOrder();
+  CloudBlockCacheStats stats = GetStats();
+  Log(InfoLogLevel::INFO_LEVEL, info_log_,
+      "[block_cache] %s hits %" PRIu64 " misses %" PRIu64 " bytes read %" PRIu64
+      " bytes inserted %" PRIu64 " evictions %" PRIu64 " usage %" PRIu64,
+      dir_.c_str(), stats.hits, stats.misses, stats.bytes_read,
+      stats.bytes_inserted, stats.evictions, stats.usage);
+}
+
+Status CloudBlockCache::Open(Env* env, const std::string& dir,
+                             uint64_t capacity, size_t block_size,
+                             const std::shared_ptr<Logger>& info_log,
+                             const std::shared_ptr<Statistics>& statistics,
+                             std::unique_ptr<CloudBlockCache>* result) {
+  if (capacity == 0 || block_size == 0) {
+    return Status::InvalidArgument(
+        "Block cache needs a positive capacity and block size");
+  }
+  std::unique_ptr<CloudBlockCache> cache(new CloudBlockCache(
+      env, dir, capacity, block_size, info_log, statistics));
+  Status s = cache->Recover();
+  if (s.ok()) {
+    *result = std::move(cache);
+  }
+  return s;
+}
+
+Status CloudBlockCache::Recover() {
+  Status s = env_->CreateDirIfMissing(dir_);
+  std::vector<Env::FileAttributes> files;
+  if (s.ok()) {
+    s = env_->GetChildrenFileAttributes(dir_, &files);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  // The order that was saved when the cache was closed, if it was
+  const std::string order_file = dir_ + "/" + kOrderFile;
+  std::string order;
+  std::unordered_map<std::string, size_t> ranks;
+  const bool has_order = ReadFileToString(env_, order_file, &order).ok();
+  if (has_order) {
+    size_t pos = 0;
+    while (pos < order.size()) {
+      size_t end = order.find('\n', pos);
+      if (end == std::string::npos) {
+        end = order.size();
+      }
+      ranks.emplace(order.substr(pos, end - pos), ranks.size());
+      pos = end + 1;
+    }
+    // it would be stale after a crash
+    env_->DeleteFile(order_file);
+  }
+
+  // Least recently used first; after a crash, the blocks that were inserted
+  // last are taken as the most recently used ones
+  struct Block {
+    uint64_t recency;
+    std::string name;
+    uint64_t size;
+  };
+  std::vector<Block> blocks;
+  for (const auto& f : files) {
+    if (EndsWith(f.name, kTmpSuffix)) {
+      // left behind by a crash in the middle of an insert
+      env_->DeleteFile(dir_ + "/" + f.name);
+    } else if (EndsWith(f.name, kBlockSuffix)) {
+      uint64_t recency = 0;
+      if (has_order) {
+        auto it = ranks.find(f.name);
+        if (it != ranks.end()) {
+          recency = ranks.size() - it->second;
+        }
+      } else {
+        env_->GetFileModificationTime(dir_ + "/" + f.name, &recency);
+      }
+      blocks.push_back(Block{recency, f.name, f.size_bytes});
+    }
+  }
+  std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+    return a.recency < b.recency || (a.recency == b.recency && a.name < b.name);
+  });
+  std::vector<std::string> evicted;
+  for (const auto& b : blocks) {
+    AddEntryLocked(b.name, b.size, &evicted);
+  }
+  DeleteBlockFiles(evicted);
+  Log(InfoLogLevel::INFO_LEVEL, info_log_,
+      "[block_cache] Opened %s with %" ROCKSDB_PRIszt " blocks, %" PRIu64
+      " bytes",
+      dir_.c_str(), entries_.size(), usage_);
+  return s;
+}
+
+void CloudBlockCache::SaveOrder() {
+  std::string order;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (const auto& name : lru_) {
+      order.append(name);
+      order.push_back('\n');
+    }
+  }
+  const std::string tmp = dir_ + "/" + kOrderFile + kTmpSuffix;
+  Status s = WriteStringToFile(env_, order, tmp, true);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp, dir_ + "/" + kOrderFile);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp);
+    Log(InfoLogLevel::WARN_LEVEL, info_log_,
+        "[block_cache] Unable to save the LRU order of %s: %s", dir_.c_str(),
+        s.ToString().c_str());
+  }
+}
+
+std::string CloudBlockCache::BlockName(const std::string& object,
+                                       uint64_t block) const {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%016" PRIx64 "-%010" PRIu64 "%s",
+           Hash64(object.data(), object.size()), block, kBlockSuffix);
+  return buf;
+}
+
+// Block layout: masked crc32c of the rest of the header, object, version,
+// block number, block size, data size, masked crc32c of every chunk of the
+// data (room for those of a whole block), data
+size_t CloudBlockCache::HeaderSize(const std::string& object,
+                                   const std::string& version) const {
+  const size_t chunks = (block_size_ + kChunkSize - 1) / kChunkSize;
+  return 4 + VarintLength(object.size()) + object.size() +
+         VarintLength(version.size()) + version.size() + 8 + 8 + 4 +
+         4 * chunks;
+}
+
+void CloudBlockCache::AddEntryLocked(const std::string& name, uint64_t size,
+                                     std::vector<std::string>* evicted) {
+  RemoveEntryLocked(name);
+  lru_.push_front(name);
+  entries_[name] = Entry{size, lru_.begin()};
+  usage_ += size;
+  while (usage_ > capacity_ && lru_.size() > 1) {
+    std::string victim = lru_.back();
+    RemoveEntryLocked(victim);
+    evicted->push_back(std::move(victim));
+    evictions_++;
+  }
+}
+
+void CloudBlockCache::RemoveEntryLocked(const std::string& name) {
+  auto it = entries_.find(name);
+  if (it != entries_.end()) {
+    usage_ -= it->second.size;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+  }
+}
+
+void CloudBlockCache::DeleteBlockFiles(const std::vector<std::string>& names) {
+  for (const auto& name : names) {
+    env_->DeleteFile(dir_ + "/" + name);
+  }
+}
+
+void CloudBlockCache::DropBlock(const std::string& name, const Status& s) {
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[block_cache] Dropping unreadable block %s: %s", name.c_str(),
+      s.ToString().c_str());
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    RemoveEntryLocked(name);
+  }
+  env_->DeleteFile(dir_ + "/" + name);
+}
+
+Status CloudBlockCache::Lookup(const std::string& object,
+                               const std::string& version, uint64_t block,
+                               uint64_t offset, size_t n, std::string* data) {
+  const std::string name = BlockName(object, block);
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+      misses_++;
+      RecordTick(statistics_.get(), PERSISTENT_CACHE_MISS);
+      return Status::NotFound();
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+  }
+
+  const size_t header_size = HeaderSize(object, version);
+  std::string header(header_size, '\0');
+  std::unique_ptr<RandomAccessFile> file;
+  Slice input;
+  Status s = env_->NewRandomAccessFile(dir_ + "/" + name, &file, EnvOptions());
+  if (s.ok()) {
+    s = file->Read(0, header_size, &input, &header[0]);
+  }
+  bool valid = s.ok() && input.size() == header_size &&
+               crc32c::Unmask(DecodeFixed32(input.data())) ==
+                   crc32c::Value(input.data() + 4, input.size() - 4);
+  Slice cached_object, cached_version;
+  uint64_t cached_block = 0;
+  uint64_t cached_block_size = 0;
+  uint32_t data_size = 0;
+  if (valid) {
+    input.remove_prefix(4);
+  }
+  valid = valid && GetLengthPrefixedSlice(&input, &cached_object) &&
+          GetLengthPrefixedSlice(&input, &cached_version) &&
+          GetFixed64(&input, &cached_block) &&
+          GetFixed64(&input, &cached_block_size) &&
+          GetFixed32(&input, &data_size) && cached_object == object &&
+          cached_version == version && cached_block == block &&
+          cached_block_size == block_size_ && data_size <= block_size_;
+
+  // Only the chunks that hold the range are read and verified; input holds
+  // their checksums
+  data->clear();
+  const uint64_t end = std::min<uint64_t>(offset + n, data_size);
+  if (valid && offset < end) {
+    const uint64_t first = offset / kChunkSize;
+    const uint64_t last = (end - 1) / kChunkSize;
+    const uint64_t start = first * kChunkSize;
+    const size_t len = static_cast<size_t>(
+        std::min<uint64_t>((last + 1) * kChunkSize, data_size) - start);
+    std::string buffer(len, '\0');
+    Slice chunks;
+    s = file->Read(header_size + start, len, &chunks, &buffer[0]);
+    valid = s.ok() && chunks.size() == len;
+    for (uint64_t c = first; valid && c <= last; c++) {
+      const size_t off = static_cast<size_t>((c - first) * kChunkSize);
+      valid = crc32c::Unmask(DecodeFixed32(input.data() + 4 * c)) ==
+              crc32c::Value(chunks.data() + off,
+                            std::min(kChunkSize, len - off));
+    }
+    if (valid) {
+      data->assign(chunks.data() + (offset - start),
+                   static_cast<size_t>(end - offset));
+    }
+  }
+  if (!valid) {
+    // torn by a crash, evicted while we were reading it, or cached for
+    // another version of the object
+    DropBlock(name, s);
+    misses_++;
+    RecordTick(statistics_.get(), PERSISTENT_CACHE_MISS);
+    return Status::NotFound();
+  }
+  hits_++;
+  RecordTick(statistics_.get(), PERSISTENT_CACHE_HIT);
+  bytes_read_ += data->size();
+  return Status::OK();
+}
+
+Status CloudBlockCache::Insert(const std::string& object,
+                               const std::string& version, uint64_t block,
+                               const Slice& data) {
+  if (data.size() > block_size_) {
+    return Status::InvalidArgument("Block larger than the block size", object);
+  }
+  std::string contents;
+  PutFixed32(&contents, 0);
+  PutLengthPrefixedSlice(&contents, object);
+  PutLengthPrefixedSlice(&contents, version);
+  PutFixed64(&contents, block);
+  PutFixed64(&contents, block_size_);
+  PutFixed32(&contents, static_cast<uint32_t>(data.size()));
+  for (size_t off = 0; off < block_size_; off += kChunkSize) {
+    uint32_t crc = 0;
+    if (off < data.size()) {
+      crc = crc32c::Mask(crc32c::Value(
+          data.data() + off, std::min(kChunkSize, data.size() - off)));
+    }
+    PutFixed32(&contents, crc);
+  }
+  assert(contents.size() == HeaderSize(object, version));
+  EncodeFixed32(&contents[0], crc32c::Mask(crc32c::Value(
+                                  contents.data() + 4, contents.size() - 4)));
+  contents.append(data.data(), data.size());
+  const std::string name = BlockName(object, block);
+  std::string tmp;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    tmp = dir_ + "/" + std::to_string(next_tmp_++) + kTmpSuffix;
+  }
+  // No need to sync: a block that does not survive a crash intact fails its
+  // checksum on the next lookup.
+  Status s = WriteStringToFile(env_, contents, tmp, false);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp, dir_ + "/" + name);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp);
+    Log(InfoLogLevel::WARN_LEVEL, info_log_,
+        "[block_cache] Unable to cache block %s of %s: %s", name.c_str(),
+        object.c_str(), s.ToString().c_str());
+    return s;
+  }
+  std::vector<std::string> evicted;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    AddEntryLocked(name, contents.size(), &evicted);
+  }
+  DeleteBlockFiles(evicted);
+  bytes_inserted_ += data.size();
+  return s;
+}
+
+void CloudBlockCache::Erase(const std::string& object) {
+  const std::string prefix = BlockName(object, 0).substr(0, 17);
+  std::vector<std::string> erased;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto it = entries_.lower_bound(prefix);
+         it != entries_.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0;
+         it = entries_.lower_bound(prefix)) {
+      erased.push_back(it->first);
+      RemoveEntryLocked(erased.back());
+    }
+  }
+  DeleteBlockFiles(erased);
+}
+
+CloudBlockCacheStats CloudBlockCache::GetStats() {
+  CloudBlockCacheStats stats;
+  stats.hits = hits_.load();
+  stats.misses = misses_.load();
+  stats.bytes_read = bytes_read_.load();
+  stats.bytes_inserted = bytes_inserted_.load();
+  stats.evictions = evictions_.load();
+  std::lock_guard<std::mutex> lk(mutex_);
+  stats.usage = usage_;
+  return stats;
+}
+
+std::unique_ptr<CloudStorageReadableFile> CloudBlockCache::NewReadableFile(
+    std::unique_ptr<CloudStorageReadableFile> file, const std::string& object,
+    const std::string& version, uint64_t size) {
+  return std::unique_ptr<CloudStorageReadableFile>(
+      new CloudBlockCacheReadableFile(this, std::move(file), object, version,
+                                      size));
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,143 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rocksdb/cloud/cloud_storage_provider.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Env;
+class Logger;
+class Statistics;
+
+struct CloudBlockCacheStats {
+  // Blocks that were served from the cache
+  uint64_t hits = 0;
+  // Blocks that had to be read from cloud storage
+  uint64_t misses = 0;
+  // Bytes served from the cache
+  uint64_t bytes_read = 0;
+  // Bytes read from cloud storage and added to the cache
+  uint64_t bytes_inserted = 0;
+  // Blocks evicted to stay within the capacity
+  uint64_t evictions = 0;
+  // Bytes currently used by the cache on local storage
+  uint64_t usage = 0;
+};
+
+//
+// A read-through cache of fixed size blocks of cloud objects, kept in a
+// directory on local storage. It is used for sst files that are not kept
+// locally (keep_local_sst_files is false), so that repeated reads of the same
+// block do not go to cloud storage again.
+//
+// Every block is a file of its own that is written to a temporary name and
+// renamed into place, and that carries the name and version of the object it
+// belongs to plus a checksum of every kChunkSize bytes of its data, so that a
+// lookup only reads and verifies the chunks that it returns. The cache
+// directory therefore needs no separate metadata: after a restart the blocks
+// are found by listing the directory, and a block that was torn by a crash
+// fails its checksum and is dropped.
+//
+// Blocks are evicted in LRU order once their total size exceeds the capacity.
+// The order is saved when the cache is closed; after a crash it is derived
+// from the modification times of the blocks instead. The directory must not
+// be shared with another cache.
+//
+// Hits and misses are also recorded in the statistics, if any, as
+// PERSISTENT_CACHE_HIT and PERSISTENT_CACHE_MISS.
+//
+class CloudBlockCache {
+ public:
+  static Status Open(Env* env, const std::string& dir, uint64_t capacity,
+                     size_t block_size, const std::shared_ptr<Logger>& info_log,
+                     const std::shared_ptr<Statistics>& statistics,
+                     std::unique_ptr<CloudBlockCache>* result);
+  ~CloudBlockCache();
+
+  size_t block_size() const { return block_size_; }
+
+  // Reads up to n bytes at offset within a block of the object; fewer if
+  // the block is shorter. version identifies the contents of the object;
+  // blocks that were cached for another version are not returned.
+  // Returns NotFound if the block is not cached.
+  Status Lookup(const std::string& object, const std::string& version,
+                uint64_t block, uint64_t offset, size_t n, std::string* data);
+
+  // Adds a block of the object to the cache, evicting others if needed
+  Status Insert(const std::string& object, const std::string& version,
+                uint64_t block, const Slice& data);
+
+  // Drops every cached block of the object
+  void Erase(const std::string& object);
+
+  CloudBlockCacheStats GetStats();
+
+  // Returns a file that reads the object through the cache
+  std::unique_ptr<CloudStorageReadableFile> NewReadableFile(
+      std::unique_ptr<CloudStorageReadableFile> file, const std::string& object,
+      const std::string& version, uint64_t size);
+
+ private:
+  struct Entry {
+    uint64_t size;
+    std::list<std::string>::iterator lru;
+  };
+
+  // The data of a block is checksummed in chunks of this size
+  static const size_t kChunkSize = 4096;
+
+  CloudBlockCache(Env* env, const std::string& dir, uint64_t capacity,
+                  size_t block_size, const std::shared_ptr<Logger>& info_log,
+                  const std::shared_ptr<Statistics>& statistics);
+
+  Status Recover();
+  // Saves the LRU order for the next Recover()
+  void SaveOrder();
+  std::string BlockName(const std::string& object, uint64_t block) const;
+  // The size of the header of the blocks of the object
+  size_t HeaderSize(const std::string& object,
+                    const std::string& version) const;
+  // Drops a block that cannot be read
+  void DropBlock(const std::string& name, const Status& s);
+  // Adds or updates an entry and returns the files to evict. REQUIRES: mutex_
+  void AddEntryLocked(const std::string& name, uint64_t size,
+                      std::vector<std::string>* evicted);
+  void RemoveEntryLocked(const std::string& name);
+  void DeleteBlockFiles(const std::vector<std::string>& names);
+
+  Env* env_;
+  const std::string dir_;
+  const uint64_t capacity_;
+  const size_t block_size_;
+  std::shared_ptr<Logger> info_log_;
+  std::shared_ptr<Statistics> statistics_;
+
+  std::mutex mutex_;
+  // The cached blocks by file name, so that the blocks of an object are
+  // adjacent
+  std::map<std::string, Entry> entries_;
+  // Most recently used first
+  std::list<std::string> lru_;
+  uint64_t usage_;
+  uint64_t next_tmp_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> bytes_read_;
+  std::atomic<uint64_t> bytes_inserted_;
+  std::atomic<uint64_t> evictions_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,331 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_deletion_queue.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "logging/logging.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/string_util.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+const uint32_t kJournalVersion = 1;
+// The changes of the queue are written to the journal this long after the
+// first of them
+const uint64_t kJournalDelayMicros = 1000000;
+// A failed deletion or journal write is retried after this long
+const uint64_t kRetryMicros = 60 * 1000000;
+// The objects of a batch per deletion thread
+const size_t kBatchPerThread = 8;
+}  // namespace
+
+CloudDeletionQueue::CloudDeletionQueue(Env* env, int num_threads,
+                                       uint64_t max_per_sec,
+                                       DeleteFunction delete_fn,
+                                       const std::shared_ptr<Logger>& info_log)
+    : env_(env),
+      num_threads_(std::max(num_threads, 1)),
+      max_per_sec_(max_per_sec),
+      delete_fn_(std::move(delete_fn)),
+      info_log_(info_log),
+      grace_(std::chrono::hours(1)),
+      journal_dirty_(false),
+      next_batch_micros_(0),
+      journal_due_micros_(0),
+      version_(0),
+      busy_(false),
+      stop_(false),
+      batch_taken_(0),
+      batch_done_(0) {
+  thread_ = std::thread([this]() { Run(); });
+  // The thread that runs the queue deletes objects as well
+  for (int i = 1; i < num_threads_; i++) {
+    delete_threads_.emplace_back([this]() { DeleteThread(); });
+  }
+}
+
+CloudDeletionQueue::~CloudDeletionQueue() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+  }
+  thread_.join();
+  for (auto& t : delete_threads_) {
+    t.join();
+  }
+  if (journal_fn_ && journal_dirty_) {
+    std::string contents;
+    EncodeJournal(deadlines_, &contents);
+    Status st = journal_fn_(contents);
+    Log(InfoLogLevel::INFO_LEVEL, info_log_,
+        "[deletion_queue] Journaled %" ROCKSDB_PRIszt
+        " pending deletions at close: %s",
+        deadlines_.size(), st.ToString().c_str());
+  }
+}
+
+void CloudDeletionQueue::SetGracePeriod(std::chrono::microseconds grace) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  grace_ = grace;
+}
+
+void CloudDeletionQueue::EnableJournal(JournalFunction journal_fn) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  journal_fn_ = std::move(journal_fn);
+  // The journal of the earlier instance is replaced right away
+  journal_dirty_ = true;
+  journal_due_micros_ = 0;
+  version_++;
+  cv_.notify_all();
+}
+
+void CloudDeletionQueue::Queue(const std::string& name, uint64_t deadline) {
+  if (!deadlines_.emplace(name, deadline).second) {
+    return;
+  }
+  by_deadline_.emplace(deadline, name);
+  if (!journal_dirty_) {
+    journal_dirty_ = true;
+    journal_due_micros_ = env_->NowMicros() + kJournalDelayMicros;
+  }
+  version_++;
+  cv_.notify_all();
+}
+
+void CloudDeletionQueue::Add(const std::string& name) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  Queue(name, env_->NowMicros() + static_cast<uint64_t>(grace_.count()));
+}
+
+Status CloudDeletionQueue::Recover(const Slice& journal,
+                                   const LiveFunction& is_live) {
+  std::map<std::string, uint64_t> deadlines;
+  Status st = DecodeJournal(journal, &deadlines);
+  if (!st.ok()) {
+    return st;
+  }
+  size_t skipped = 0;
+  std::lock_guard<std::mutex> lk(mutex_);
+  for (const auto& d : deadlines) {
+    if (is_live(d.first)) {
+      skipped++;
+    } else {
+      Queue(d.first, d.second);
+    }
+  }
+  Log(InfoLogLevel::INFO_LEVEL, info_log_,
+      "[deletion_queue] Recovered %" ROCKSDB_PRIszt
+      " pending deletions, skipped %" ROCKSDB_PRIszt " of live files",
+      deadlines.size() - skipped, skipped);
+  return Status::OK();
+}
+
+bool CloudDeletionQueue::Remove(const std::string& name) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = deadlines_.find(name);
+  if (it == deadlines_.end()) {
+    // It may wait in the batch that is being deleted
+    for (size_t i = batch_taken_; i < batch_.size(); i++) {
+      if (batch_[i] == name) {
+        batch_[i].clear();
+        return true;
+      }
+    }
+    return false;
+  }
+  by_deadline_.erase(std::make_pair(it->second, name));
+  deadlines_.erase(it);
+  if (!journal_dirty_) {
+    journal_dirty_ = true;
+    journal_due_micros_ = env_->NowMicros() + kJournalDelayMicros;
+  }
+  version_++;
+  cv_.notify_all();
+  return true;
+}
+
+size_t CloudDeletionQueue::NumPending() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return deadlines_.size();
+}
+
+void CloudDeletionQueue::TEST_WaitForIdle() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  cv_.wait(lk, [this]() {
+    const uint64_t now = env_->NowMicros();
+    const bool due =
+        !by_deadline_.empty() && by_deadline_.begin()->first <= now;
+    return !busy_ && !due && !(journal_fn_ && journal_dirty_);
+  });
+}
+
+void CloudDeletionQueue::Run() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (!stop_) {
+    const uint64_t now = env_->NowMicros();
+    if (journal_fn_ && journal_dirty_ && journal_due_micros_ <= now) {
+      std::string contents;
+      EncodeJournal(deadlines_, &contents);
+      const uint64_t version = version_;
+      busy_ = true;
+      lk.unlock();
+      Status st = journal_fn_(contents);
+      lk.lock();
+      busy_ = false;
+      if (!st.ok()) {
+        Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+            "[deletion_queue] Unable to write the journal: %s",
+            st.ToString().c_str());
+        journal_due_micros_ = env_->NowMicros() + kRetryMicros;
+      } else if (version == version_) {
+        journal_dirty_ = false;
+      }
+      cv_.notify_all();
+      continue;
+    }
+
+    if (!by_deadline_.empty() && by_deadline_.begin()->first <= now &&
+        next_batch_micros_ <= now) {
+      size_t limit = kBatchPerThread * static_cast<size_t>(num_threads_);
+      if (max_per_sec_ > 0) {
+        limit = static_cast<size_t>(std::min<uint64_t>(limit, max_per_sec_));
+      }
+      std::vector<std::string> names;
+      while (names.size() < limit && !by_deadline_.empty() &&
+             by_deadline_.begin()->first <= now) {
+        names.push_back(by_deadline_.begin()->second);
+        deadlines_.erase(names.back());
+        by_deadline_.erase(by_deadline_.begin());
+      }
+      if (!journal_dirty_) {
+        journal_dirty_ = true;
+        journal_due_micros_ = now + kJournalDelayMicros;
+      }
+      version_++;
+      busy_ = true;
+      const size_t count = names.size();
+      auto failed = DeleteBatch(&lk, std::move(names));
+      busy_ = false;
+      for (const auto& name : failed) {
+        Queue(name, env_->NowMicros() + kRetryMicros);
+      }
+      if (max_per_sec_ > 0) {
+        next_batch_micros_ = now + count * 1000000 / max_per_sec_;
+      }
+      Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+          "[deletion_queue] Deleted %" ROCKSDB_PRIszt
+          " objects, %" ROCKSDB_PRIszt " failed, %" ROCKSDB_PRIszt " pending",
+          count - failed.size(), failed.size(), deadlines_.size());
+      cv_.notify_all();
+      continue;
+    }
+
+    // Sleep until the next deletion or journal write is due
+    uint64_t wake = port::kMaxUint64;
+    if (!by_deadline_.empty()) {
+      wake = std::max(by_deadline_.begin()->first, next_batch_micros_);
+    }
+    if (journal_fn_ && journal_dirty_) {
+      wake = std::min(wake, journal_due_micros_);
+    }
+    if (wake == port::kMaxUint64) {
+      cv_.wait(lk);
+    } else if (wake > now) {
+      cv_.wait_for(lk, std::chrono::microseconds(wake - now));
+    }
+  }
+}
+
+void CloudDeletionQueue::DeleteThread() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    cv_.wait(lk, [this]() { return stop_ || batch_taken_ < batch_.size(); });
+    if (batch_taken_ < batch_.size()) {
+      DeleteNext(&lk);
+    } else {
+      return;
+    }
+  }
+}
+
+std::vector<std::string> CloudDeletionQueue::DeleteBatch(
+    std::unique_lock<std::mutex>* lk, std::vector<std::string> names) {
+  batch_ = std::move(names);
+  batch_taken_ = 0;
+  batch_done_ = 0;
+  batch_failed_.clear();
+  cv_.notify_all();
+  while (batch_taken_ < batch_.size()) {
+    DeleteNext(lk);
+  }
+  cv_.wait(*lk, [this]() { return batch_done_ == batch_.size(); });
+  batch_.clear();
+  batch_taken_ = 0;
+  batch_done_ = 0;
+  return std::move(batch_failed_);
+}
+
+void CloudDeletionQueue::DeleteNext(std::unique_lock<std::mutex>* lk) {
+  const std::string name = batch_[batch_taken_++];
+  Status st;
+  // An empty name was cancelled by Remove()
+  if (!name.empty()) {
+    lk->unlock();
+    st = delete_fn_(name);
+    lk->lock();
+  }
+  if (!st.ok() && !st.IsNotFound()) {
+    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+        "[deletion_queue] Unable to delete %s: %s", name.c_str(),
+        st.ToString().c_str());
+    batch_failed_.push_back(name);
+  }
+  if (++batch_done_ == batch_.size()) {
+    cv_.notify_all();
+  }
+}
+
+void CloudDeletionQueue::EncodeJournal(
+    const std::map<std::string, uint64_t>& deadlines, std::string* dst) {
+  PutVarint32(dst, kJournalVersion);
+  PutVarint64(dst, deadlines.size());
+  for (const auto& d : deadlines) {
+    PutLengthPrefixedSlice(dst, d.first);
+    PutVarint64(dst, d.second);
+  }
+}
+
+Status CloudDeletionQueue::DecodeJournal(
+    Slice input, std::map<std::string, uint64_t>* deadlines) {
+  const Status corrupt = Status::Corruption("Invalid deletion journal");
+  uint32_t version = 0;
+  uint64_t count = 0;
+  if (!GetVarint32(&input, &version)) {
+    return corrupt;
+  }
+  if (version != kJournalVersion) {
+    return Status::NotSupported("Unknown deletion journal version",
+                                ToString(version));
+  }
+  if (!GetVarint64(&input, &count)) {
+    return corrupt;
+  }
+  for (uint64_t i = 0; i < count; i++) {
+    Slice name;
+    uint64_t deadline = 0;
+    if (!GetLengthPrefixedSlice(&input, &name) ||
+        !GetVarint64(&input, &deadline)) {
+      return corrupt;
+    }
+    (*deadlines)[name.ToString()] = deadline;
+  }
+  return Status::OK();
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
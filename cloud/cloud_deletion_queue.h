@@ -0,0 +1,139 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rocksdb/env.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Logger;
+
+//
+// Deletes the objects of the files that a db dropped, once they have been
+// obsolete for a grace period, so that clones that are being created from
+// an older MANIFEST can still fetch them.
+//
+// The queue is kept in a journal object next to the objects of the db. The
+// deletions that are pending when the db is closed or crashes are carried
+// out by the next instance of the db, instead of leaking their objects until
+// a full scan of the bucket finds them. The objects that are due are deleted
+// in batches by num_threads threads, at most max_per_sec a second. The
+// threads live as long as the queue.
+//
+class CloudDeletionQueue {
+ public:
+  // Deletes one object. NotFound counts as deleted.
+  using DeleteFunction = std::function<Status(const std::string& name)>;
+  // Returns true if the object is still referenced by the db
+  using LiveFunction = std::function<bool(const std::string& name)>;
+  // Replaces the journal with the given contents
+  using JournalFunction = std::function<Status(const std::string& contents)>;
+
+  CloudDeletionQueue(Env* env, int num_threads, uint64_t max_per_sec,
+                     DeleteFunction delete_fn,
+                     const std::shared_ptr<Logger>& info_log);
+
+  // Stops the deletions and writes the journal of the pending ones
+  ~CloudDeletionQueue();
+
+  // Sets the time that an object is kept after it was queued
+  void SetGracePeriod(std::chrono::microseconds grace);
+
+  // Journals the queue from now on. Call it once, after Recover().
+  void EnableJournal(JournalFunction journal_fn);
+
+  // Queues the deletion of the object after the grace period. An object that
+  // is already queued keeps its deadline.
+  void Add(const std::string& name);
+
+  // Takes the deletions of a journal written by an earlier instance, with
+  // their deadlines. The objects that is_live() reports as referenced are
+  // skipped, since the journal can be newer than the MANIFEST that the db
+  // recovered from.
+  Status Recover(const Slice& journal, const LiveFunction& is_live);
+
+  // Cancels the deletion of the object, which was written again, if it is
+  // queued or waits in the batch that is being deleted. A deletion that has
+  // already started cannot be cancelled. Returns true if it was cancelled.
+  bool Remove(const std::string& name);
+
+  // The deletions that are queued
+  size_t NumPending();
+
+  // Blocks until no deletion is due and the journal is up to date
+  void TEST_WaitForIdle();
+
+  static void EncodeJournal(const std::map<std::string, uint64_t>& deadlines,
+                            std::string* dst);
+  static Status DecodeJournal(Slice input,
+                              std::map<std::string, uint64_t>* deadlines);
+
+ private:
+  void Run();
+  // The loop of the deletion threads other than the one running Run()
+  void DeleteThread();
+  // Deletes the names together with the deletion threads. Returns the ones
+  // that failed.
+  // REQUIRES: lk holds mutex_
+  std::vector<std::string> DeleteBatch(std::unique_lock<std::mutex>* lk,
+                                       std::vector<std::string> names);
+  // Deletes the next object of the batch
+  // REQUIRES: lk holds mutex_, an object of the batch has not been taken
+  void DeleteNext(std::unique_lock<std::mutex>* lk);
+  void Queue(const std::string& name, uint64_t deadline);
+
+  Env* env_;
+  const int num_threads_;
+  const uint64_t max_per_sec_;
+  DeleteFunction delete_fn_;
+  JournalFunction journal_fn_;
+  std::shared_ptr<Logger> info_log_;
+
+  std::mutex mutex_;
+  // Signalled when a deletion is queued, the journal changes, a batch
+  // completes or the queue stops
+  std::condition_variable cv_;
+  std::chrono::microseconds grace_;
+  // The deadline of every queued object, and the queued objects by deadline
+  std::map<std::string, uint64_t> deadlines_;
+  std::set<std::pair<uint64_t, std::string>> by_deadline_;
+  // The journal does not match the queue
+  bool journal_dirty_;
+  // The time after which the next batch may start, to keep to max_per_sec
+  uint64_t next_batch_micros_;
+  // The time at which the journal is written after a change, so that the
+  // changes of a burst are written together
+  uint64_t journal_due_micros_;
+  // Counts the changes of the queue, to tell whether the journal that is
+  // being written is still up to date
+  uint64_t version_;
+  // A batch is being deleted or the journal written
+  bool busy_;
+  bool stop_;
+  // The batch that is being deleted, the number of its objects that have
+  // been taken and deleted by the threads, and those that failed. Remove()
+  // clears the names that have not been taken yet.
+  std::vector<std::string> batch_;
+  size_t batch_taken_;
+  size_t batch_done_;
+  std::vector<std::string> batch_failed_;
+  std::thread thread_;
+  std::vector<std::thread> delete_threads_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -131,6 +131,35 @@ Status CloudEnv::NewAwsEnv(
   return NewAwsEnv(base_env, options, logger, cenv);
 }
 
+Status CloudEnv::NewCloudEnv(Env* base_env, const CloudEnvOptions& options,
+                             const std::shared_ptr<Logger>& logger,
+                             CloudEnv** cenv) {
+  *cenv = nullptr;
+  // Dump out cloud env options
+  options.Dump(logger.get());
+
+  // If underlying env is not defined, then use PosixEnv
+  if (!base_env) {
+    base_env = Env::Default();
+  }
+  std::unique_ptr<CloudEnvImpl> cloud(
+      new CloudEnvImpl(options, base_env, logger));
+  Status st = cloud->Prepare();
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, logger,
+        "[cloud_env] NewCloudEnv Unable to create environment %s",
+        st.ToString().c_str());
+    return st;
+  }
+  // start the purge thread only if there is a destination bucket
+  if (options.dest_bucket.IsValid() && options.run_purger) {
+    CloudEnvImpl* raw = cloud.get();
+    cloud->purge_thread_ = std::thread([raw] { raw->Purger(); });
+  }
+  *cenv = cloud.release();
+  return st;
+}
+
 #ifndef USE_AWS
 Status CloudEnv::NewAwsEnv(Env* /*base_env*/,
                            const CloudEnvOptions& /*options*/,
@@ -3,10 +3,14 @@
 
 #include "cloud/cloud_env_impl.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <set>
 
+#include "cloud/cloud_block_cache.h"
 #include "cloud/cloud_env_wrapper.h"
-#include "cloud/cloud_scheduler.h"
+#include "cloud/cloud_prefetcher.h"
+#include "cloud/cloud_upload_pipeline.h"
 #include "cloud/filename.h"
 #include "cloud/manifest_reader.h"
 #include "env/composite_env_wrapper.h"
@@ -26,21 +30,44 @@ namespace ROCKSDB_NAMESPACE {
 CloudEnvImpl::CloudEnvImpl(const CloudEnvOptions& opts, Env* base,
                            const std::shared_ptr<Logger>& l)
     : CloudEnv(opts, base, l), purger_is_running_(true) {
-  scheduler_ = CloudScheduler::Get();
+  deletion_queue_.reset(new CloudDeletionQueue(
+      base_env_, cloud_env_options.deletion_threads,
+      cloud_env_options.max_deletions_per_sec,
+      [this](const std::string& name) {
+        const std::string object = destname(name);
+        Status st = cloud_env_options.storage_provider->DeleteCloudObject(
+            GetDestBucketName(), object);
+        if (metadata_cache_ && (st.ok() || st.IsNotFound())) {
+          metadata_cache_->Erase(GetDestBucketName(), object);
+        } else if (metadata_cache_) {
+          // A failed deletion may or may not have removed the object
+          metadata_cache_->Invalidate(GetDestBucketName(), object);
+        }
+        return st;
+      },
+      info_log_));
+  if (cloud_env_options.use_object_metadata_cache) {
+    metadata_cache_.reset(new CloudMetadataCache(
+        base_env_, cloud_env_options.object_metadata_cache_ttl_millis * 1000,
+        cloud_env_options.object_metadata_cache_capacity));
+  }
+  if (cloud_env_options.async_upload_threads > 0) {
+    upload_pipeline_.reset(new CloudUploadPipeline(
+        cloud_env_options.async_upload_threads,
+        cloud_env_options.max_pending_uploads, info_log_));
+  }
 }
 
 CloudEnvImpl::~CloudEnvImpl() {
+  // Stop the downloads and drain the uploads first; they may still reference
+  // the storage provider
+  prefetcher_.reset();
+  upload_pipeline_.reset();
   if (cloud_env_options.cloud_log_controller) {
     cloud_env_options.cloud_log_controller->StopTailingStream();
   }
-  {
-    std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-    using std::swap;
-    for (auto& e : files_to_delete_) {
-      scheduler_->CancelJob(e.second);
-    }
-    files_to_delete_.clear();
-  }
+  // The deletions that are not due yet are left to the journal
+  deletion_queue_.reset();
   StopPurger();
 }
 
@@ -57,15 +84,39 @@ Status CloudEnvImpl::ExistsCloudObject(const std::string& fname) {
   return st;
 }
 
-Status CloudEnvImpl::GetCloudObject(const std::string& fname) {
+Status CloudEnvImpl::GetCloudObject(const std::string& fname,
+                                    uint64_t size) {
   Status st = Status::NotFound();
   if (HasDestBucket()) {
-    st = cloud_env_options.storage_provider->GetCloudObject(
-        GetDestBucketName(), destname(fname), fname);
+    st = DownloadCloudObject(GetDestBucketName(), destname(fname), fname,
+                             size);
   }
   if (st.IsNotFound() && HasSrcBucket() && !SrcMatchesDest()) {
-    st = cloud_env_options.storage_provider->GetCloudObject(
-        GetSrcBucketName(), srcname(fname), fname);
+    st = DownloadCloudObject(GetSrcBucketName(), srcname(fname), fname,
+                             size);
+  }
+  return st;
+}
+
+Status CloudEnvImpl::DownloadCloudObject(const std::string& bucket,
+                                         const std::string& object,
+                                         const std::string& fname,
+                                         uint64_t size) {
+  const int kMaxAttempts = 3;
+  bool manifest = (GetFileType(fname) == RocksDBFileType::kManifestFile);
+  Status st;
+  for (int attempt = 1; attempt <= kMaxAttempts; attempt++) {
+    st = cloud_env_options.storage_provider->GetCloudObjectOfSize(
+        bucket, object, fname, size);
+    if (st.ok() && manifest) {
+      // TryAgain means that the full MANIFEST was uploaded again while we
+      // were applying its deltas; download the new one.
+      st = ManifestReader::ApplyManifestDeltas(this, bucket, object, fname,
+                                               attempt == kMaxAttempts);
+    }
+    if (!st.IsTryAgain()) {
+      break;
+    }
   }
   return st;
 }
@@ -103,8 +154,8 @@ Status CloudEnvImpl::ListCloudObjects(const std::string& path,
   Status st;
   // Fetch the list of children from both cloud buckets
   if (HasSrcBucket()) {
-    st = cloud_env_options.storage_provider->ListCloudObjects(
-        GetSrcBucketName(), GetSrcObjectPath(), result);
+    st = ListAndCacheCloudObjects(GetSrcBucketName(), GetSrcObjectPath(),
+                                  !SrcMatchesDest(), result);
     if (!st.ok()) {
       Log(InfoLogLevel::ERROR_LEVEL, info_log_,
           "[%s] GetChildren src bucket %s %s error from %s %s", Name(),
@@ -114,8 +165,8 @@ Status CloudEnvImpl::ListCloudObjects(const std::string& path,
     }
   }
   if (HasDestBucket() && !SrcMatchesDest()) {
-    st = cloud_env_options.storage_provider->ListCloudObjects(
-        GetDestBucketName(), GetDestObjectPath(), result);
+    st = ListAndCacheCloudObjects(GetDestBucketName(), GetDestObjectPath(),
+                                  false /* foreign */, result);
     if (!st.ok()) {
       Log(InfoLogLevel::ERROR_LEVEL, info_log_,
           "[%s] GetChildren dest bucket %s %s error from %s %s", Name(),
@@ -128,18 +179,74 @@ Status CloudEnvImpl::ListCloudObjects(const std::string& path,
 
 Status CloudEnvImpl::NewCloudReadableFile(
     const std::string& fname, std::unique_ptr<CloudStorageReadableFile>* result,
-    const EnvOptions& options) {
+    const EnvOptions& options, uint64_t size) {
+  if (HasDestBucket() && HasSrcBucket() && !SrcMatchesDest()) {
+    // Only the metadata request tells which of the buckets has the file
+    size = 0;
+  }
   Status st = Status::NotFound();
   if (HasDestBucket()) {  // read from destination
-    st = cloud_env_options.storage_provider->NewCloudReadableFile(
-        GetDestBucketName(), destname(fname), result, options);
+    st = cloud_env_options.storage_provider->NewCloudReadableFileOfSize(
+        GetDestBucketName(), destname(fname), size, result, options);
     if (st.ok()) {
       return st;
     }
   }
   if (HasSrcBucket() && !SrcMatchesDest()) {  // read from src bucket
-    st = cloud_env_options.storage_provider->NewCloudReadableFile(
-        GetSrcBucketName(), srcname(fname), result, options);
+    st = cloud_env_options.storage_provider->NewCloudReadableFileOfSize(
+        GetSrcBucketName(), srcname(fname), size, result, options);
+  }
+  return st;
+}
+
+Status CloudEnvImpl::ListAndCacheCloudObjects(
+    const std::string& bucket, const std::string& object_path, bool foreign,
+    std::vector<std::string>* result) {
+  if (metadata_cache_ &&
+      metadata_cache_->GetListing(bucket, object_path, result)) {
+    return Status::OK();
+  }
+  auto provider = cloud_env_options.storage_provider;
+  std::vector<std::string> names;
+  std::vector<CloudObjectInformation> infos;
+  Status st =
+      provider->ListCloudObjectsWithInfo(bucket, object_path, &names, &infos);
+  if (st.IsNotSupported()) {
+    return provider->ListCloudObjects(bucket, object_path, result);
+  } else if (!st.ok()) {
+    return st;
+  }
+  if (metadata_cache_) {
+    metadata_cache_->AddListing(bucket, object_path, names, infos, foreign);
+  }
+  result->insert(result->end(), names.begin(), names.end());
+  return st;
+}
+
+Status CloudEnvImpl::LookupCloudObjectInfo(const std::string& fname,
+                                           CloudObjectInformation* info) {
+  Status st = Status::NotFound();
+  if (HasDestBucket()) {
+    st = metadata_cache_->Lookup(GetDestBucketName(), destname(fname), info);
+    if (!st.IsNotFound()) {
+      return st;
+    }
+  }
+  if (HasSrcBucket() && !SrcMatchesDest()) {
+    st = metadata_cache_->Lookup(GetSrcBucketName(), srcname(fname), info);
+  }
+  return st;
+}
+
+Status CloudEnvImpl::GetCloudObjectSizeCached(const std::string& fname,
+                                              uint64_t* remote_size) {
+  CloudObjectInformation info;
+  Status st = LookupCloudObjectInfo(fname, &info);
+  if (st.IsIncomplete()) {
+    return GetCloudObjectSize(fname, remote_size);
+  }
+  if (st.ok()) {
+    *remote_size = info.size;
   }
   return st;
 }
@@ -163,6 +270,10 @@ Status CloudEnvImpl::NewSequentialFile(const std::string& logical_fname,
   }
 
   if (sstfile || manifest || identity) {
+    auto prefetcher = sstfile ? GetPrefetcher() : nullptr;
+    if (prefetcher) {
+      prefetcher->Claim(fname);
+    }
     // We read first from local storage and then from cloud storage.
     st = base_env_->NewSequentialFile(fname, result, options);
 
@@ -231,6 +342,13 @@ Status CloudEnvImpl::NewRandomAccessFile(
   }
 
   if (sstfile || manifest || identity) {
+    auto prefetcher = sstfile ? GetPrefetcher() : nullptr;
+    if (prefetcher) {
+      // Either wait for the prefetch of the file or take it over
+      prefetcher->Claim(fname);
+    }
+    // The size from the MANIFEST spares asking cloud storage for it
+    const uint64_t size = sstfile ? GetSstFileSize(fname) : 0;
     // Read from local storage and then from cloud storage.
     st = base_env_->NewRandomAccessFile(fname, result, options);
 
@@ -242,7 +360,7 @@ Status CloudEnvImpl::NewRandomAccessFile(
     if (cloud_env_options.keep_local_sst_files || !sstfile) {
       if (!st.ok()) {
         // copy the file to the local storage if keep_local_sst_files is true
-        st = GetCloudObject(fname);
+        st = GetCloudObject(fname, size);
         if (st.ok()) {
           // we successfully copied the file, try opening it locally now
           st = base_env_->NewRandomAccessFile(fname, result, options);
@@ -250,7 +368,10 @@ Status CloudEnvImpl::NewRandomAccessFile(
       }
       // If we are being paranoic, then we validate that our file size is
       // the same as in cloud storage.
-      if (st.ok() && sstfile && cloud_env_options.validate_filesize) {
+      // A file that is still being uploaded in the background is not in
+      // cloud storage yet, so there is nothing to validate against.
+      if (st.ok() && sstfile && cloud_env_options.validate_filesize &&
+          !(upload_pipeline_ && upload_pipeline_->IsPending(fname))) {
         uint64_t remote_size = 0;
         uint64_t local_size = 0;
         Status stax = base_env_->GetFileSize(fname, &local_size);
@@ -258,8 +379,13 @@ Status CloudEnvImpl::NewRandomAccessFile(
           return stax;
         }
         stax = Status::NotFound();
-        if (HasDestBucket()) {
-          stax = GetCloudObjectSize(fname, &remote_size);
+        if (size > 0) {
+          // The MANIFEST has the size of the file that was uploaded, so
+          // there is no need to ask cloud storage
+          remote_size = size;
+          stax = Status::OK();
+        } else if (HasDestBucket()) {
+          stax = GetCloudObjectSizeCached(fname, &remote_size);
         }
         if (stax.IsNotFound() && !HasDestBucket()) {
           // It is legal for file to not be present in storage provider if
@@ -278,7 +404,7 @@ Status CloudEnvImpl::NewRandomAccessFile(
       // true, we will never use CloudReadableFile to read; we copy the file
       // locally and read using base_env.
       std::unique_ptr<CloudStorageReadableFile> file;
-      st = NewCloudReadableFile(fname, &file, options);
+      st = NewCloudReadableFile(fname, &file, options, size);
       if (st.ok()) {
         result->reset(file.release());
       }
@@ -315,9 +441,19 @@ Status CloudEnvImpl::NewWritableFile(const std::string& logical_fname,
   Status s;
 
   if (HasDestBucket() && (sstfile || identity || manifest)) {
+    if (sstfile) {
+      std::lock_guard<std::mutex> lk(sst_objects_mutex_);
+      if (sst_object_namer_) {
+        std::string named = sst_object_namer_(fname);
+        if (!named.empty()) {
+          sst_objects_[basename(fname)] = std::move(named);
+        }
+      }
+    }
+    const std::string object = destname(fname);
     std::unique_ptr<CloudStorageWritableFile> f;
     cloud_env_options.storage_provider->NewCloudWritableFile(
-        fname, GetDestBucketName(), destname(fname), &f, options);
+        fname, GetDestBucketName(), object, &f, options);
     s = f->status();
     if (!s.ok()) {
       Log(InfoLogLevel::ERROR_LEVEL, info_log_,
@@ -372,7 +508,14 @@ Status CloudEnvImpl::FileExists(const std::string& logical_fname) {
   if (sstfile || manifest || identity) {
     // We read first from local storage and then from cloud storage.
     st = base_env_->FileExists(fname);
-    if (st.IsNotFound()) {
+    if (st.IsNotFound() && sstfile &&
+        cloud_env_options.use_object_metadata_cache) {
+      CloudObjectInformation info;
+      st = LookupCloudObjectInfo(fname, &info);
+      if (st.IsIncomplete()) {
+        st = ExistsCloudObject(fname);
+      }
+    } else if (st.IsNotFound()) {
       st = ExistsCloudObject(fname);
     }
   } else if (logfile && !cloud_env_options.keep_local_log_files) {
@@ -456,6 +599,8 @@ Status CloudEnvImpl::GetFileSize(const std::string& logical_fname,
   if (sstfile) {
     if (base_env_->FileExists(fname).ok()) {
       st = base_env_->GetFileSize(fname, size);
+    } else if (cloud_env_options.use_object_metadata_cache) {
+      st = GetCloudObjectSizeCached(fname, size);
     } else {
       st = GetCloudObjectSize(fname, size);
     }
@@ -483,6 +628,14 @@ Status CloudEnvImpl::GetFileModificationTime(const std::string& logical_fname,
   if (sstfile) {
     if (base_env_->FileExists(fname).ok()) {
       st = base_env_->GetFileModificationTime(fname, time);
+    } else if (cloud_env_options.use_object_metadata_cache) {
+      CloudObjectInformation info;
+      st = LookupCloudObjectInfo(fname, &info);
+      if (st.ok()) {
+        *time = info.modification_time;
+      } else if (st.IsIncomplete()) {
+        st = GetCloudObjectModificationTime(fname, time);
+      }
     } else {
       st = GetCloudObjectModificationTime(fname, time);
     }
@@ -694,6 +847,23 @@ Status CloudEnvImpl::DeleteFile(const std::string& logical_fname) {
   Status st;
   // Delete from destination bucket and local dir
   if (sstfile || manifest || identity) {
+    if (sstfile && upload_pipeline_) {
+      // no point in finishing the upload of a file that is going away
+      upload_pipeline_->Cancel(fname);
+    }
+    auto prefetcher = sstfile ? GetPrefetcher() : nullptr;
+    if (prefetcher) {
+      // so that the file is not downloaded again after it is deleted
+      prefetcher->Claim(fname);
+    }
+    if (sstfile && sst_block_cache_ && HasDestBucket()) {
+      sst_block_cache_->Erase(GetDestBucketName() + pathsep +
+                              destname(fname));
+    }
+    if (sstfile) {
+      std::lock_guard<std::mutex> lk(sst_sizes_mutex_);
+      sst_file_sizes_.erase(fname);
+    }
     if (HasDestBucket()) {
       // add the remote file deletion to the queue
       st = DeleteCloudFileFromDest(basename(fname));
@@ -727,58 +897,89 @@ Status CloudEnvImpl::DeleteFile(const std::string& logical_fname) {
 }
 
 void CloudEnvImpl::RemoveFileFromDeletionQueue(const std::string& filename) {
-  std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-  auto itr = files_to_delete_.find(filename);
-  if (itr != files_to_delete_.end()) {
-    scheduler_->CancelJob(itr->second);
-    files_to_delete_.erase(itr);
-  }
+  deletion_queue_->Remove(filename);
 }
 
 Status CloudEnvImpl::CopyLocalFileToDest(const std::string& local_name,
                                          const std::string& dest_name) {
   RemoveFileFromDeletionQueue(basename(local_name));
-  return cloud_env_options.storage_provider->PutCloudObject(
+  Status st = cloud_env_options.storage_provider->PutCloudObject(
       local_name, GetDestBucketName(), dest_name);
+  CacheUploadedObject(local_name, dest_name, st);
+  return st;
 }
 
-Status CloudEnvImpl::DeleteCloudFileFromDest(const std::string& fname) {
-  assert(HasDestBucket());
-  auto base = basename(fname);
-  // add the job to delete the file in 1 hour
-  auto doDeleteFile = [this, base](void*) {
-    {
-      std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-      auto itr = files_to_delete_.find(base);
-      if (itr == files_to_delete_.end()) {
-        // File was removed from files_to_delete_, do not delete!
-        return;
-      }
-      files_to_delete_.erase(itr);
-    }
-    auto path = GetDestObjectPath() + "/" + base;
-    // we are ready to delete the file!
-    auto st = cloud_env_options.storage_provider->DeleteCloudObject(
-        GetDestBucketName(), path);
-    if (!st.ok() && !st.IsNotFound()) {
-      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
-          "[%s] DeleteFile file %s error %s", Name(), path.c_str(),
-          st.ToString().c_str());
+void CloudEnvImpl::CacheUploadedObject(const std::string& local_name,
+                                       const std::string& dest_name,
+                                       const Status& upload_status) {
+  CloudObjectInformation info;
+  const bool uploaded = upload_status.ok() &&
+                        base_env_->GetFileSize(local_name, &info.size).ok();
+  if (uploaded && GetFileType(local_name) == RocksDBFileType::kSstFile) {
+    std::lock_guard<std::mutex> lk(sst_sizes_mutex_);
+    sst_file_sizes_[local_name] = info.size;
+  }
+  if (!metadata_cache_) {
+    return;
+  }
+  info.modification_time = base_env_->NowMicros() / 1000;
+  if (uploaded) {
+    metadata_cache_->Add(GetDestBucketName(), dest_name, info,
+                         false /* expires */);
+  } else {
+    // A failed upload may or may not have replaced the object
+    metadata_cache_->Invalidate(GetDestBucketName(), dest_name);
+  }
+}
+
+Status CloudEnvImpl::CopyLocalFileToDestAsync(const std::string& local_name,
+                                              const std::string& dest_name) {
+  if (!upload_pipeline_) {
+    return Status::NotSupported("No upload pipeline", local_name);
+  }
+  RemoveFileFromDeletionQueue(basename(local_name));
+  auto upload = [this, local_name, dest_name]() {
+    Status st = cloud_env_options.storage_provider->PutCloudObject(
+        local_name, GetDestBucketName(), dest_name);
+    CacheUploadedObject(local_name, dest_name, st);
+    if (st.ok() && !cloud_env_options.keep_local_sst_files) {
+      // the file is readable from cloud storage now. Open readers keep
+      // their handle to the local copy.
+      base_env_->DeleteFile(local_name);
     }
+    Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+        "[cloud_env_impl] Background upload of %s to %s %s",
+        local_name.c_str(), dest_name.c_str(), st.ToString().c_str());
+    return st;
   };
-  {
-    std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-    if (files_to_delete_.find(base) != files_to_delete_.end()) {
-      // already in the queue
-      return Status::OK();
-    }
+  return upload_pipeline_->Enqueue(local_name, upload);
+}
+
+Status CloudEnvImpl::WaitForPendingUploads() {
+  if (!upload_pipeline_) {
+    return Status::OK();
   }
-  {
-    std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-    auto handle = scheduler_->ScheduleJob(file_deletion_delay_,
-                                          std::move(doDeleteFile), nullptr);
-    files_to_delete_.emplace(base, std::move(handle));
+  return upload_pipeline_->WaitForPending();
+}
+
+void CloudEnvImpl::WrapCloudReadableFile(
+    const std::string& bucket, const std::string& object_path, uint64_t size,
+    std::unique_ptr<CloudStorageReadableFile>* file) {
+  if (sst_block_cache_ && IsSstFile(RemoveEpoch(basename(object_path)))) {
+    // An sst object is never rewritten under the same name, so its size is
+    // enough to tell a stale block apart. The content hash is not known when
+    // the file is opened without a metadata request.
+    *file = sst_block_cache_->NewReadableFile(
+        std::move(*file), bucket + pathsep + object_path, ToString(size),
+        size);
   }
+}
+
+Status CloudEnvImpl::DeleteCloudFileFromDest(const std::string& fname) {
+  assert(HasDestBucket());
+  // The object is deleted after a grace period, and only then dropped from
+  // the metadata cache
+  deletion_queue_->Add(basename(fname));
   return Status::OK();
 }
 
@@ -1029,8 +1230,15 @@ std::string CloudEnvImpl::srcname(const std::string& localname) {
 //
 std::string CloudEnvImpl::destname(const std::string& localname) {
   assert(cloud_env_options.dest_bucket.IsValid());
-  return cloud_env_options.dest_bucket.GetObjectPath() + "/" +
-         basename(localname);
+  std::string base = basename(localname);
+  {
+    std::lock_guard<std::mutex> lk(sst_objects_mutex_);
+    auto it = sst_objects_.find(base);
+    if (it != sst_objects_.end()) {
+      return it->second;
+    }
+  }
+  return cloud_env_options.dest_bucket.GetObjectPath() + "/" + base;
 }
 
 //
@@ -1464,6 +1672,9 @@ Status CloudEnvImpl::LoadCloudManifest(const std::string& local_dbname,
       // Rolls the new epoch in CLOUDMANIFEST
       st = RollNewEpoch(local_dbname);
     }
+    if (st.ok() && !read_only && HasDestBucket()) {
+      st = RecoverDeletionJournal(local_dbname);
+    }
     if (!st.ok()) {
       return st;
     }
@@ -1482,6 +1693,114 @@ Status CloudEnvImpl::LoadCloudManifest(const std::string& local_dbname,
   return st;
 }
 
+Status CloudEnvImpl::LoadSstFiles(const std::string& local_dbname) {
+  if (GetCloudType() == CloudType::kCloudNone) {
+    return Status::OK();
+  }
+  // The dummy MANIFEST name is remapped to the MANIFEST of the current epoch,
+  // which LoadCloudManifest() has made local unless this is a new database
+  const std::string manifest = RemapFilename(local_dbname + "/MANIFEST-000001");
+  if (base_env_->FileExists(manifest).IsNotFound()) {
+    return Status::OK();
+  }
+  std::vector<ManifestReader::LiveFile> live;
+  Status st =
+      ManifestReader::GetLiveFilesFromManifest(base_env_, manifest, &live);
+  if (!st.ok()) {
+    return st;
+  }
+  {
+    std::lock_guard<std::mutex> lk(sst_sizes_mutex_);
+    for (const auto& f : live) {
+      sst_file_sizes_[RemapFilename(
+          MakeTableFileName(local_dbname, f.number))] = f.size;
+    }
+  }
+  if (cloud_env_options.sst_prefetch_threads <= 0 ||
+      !cloud_env_options.keep_local_sst_files) {
+    return Status::OK();
+  }
+
+  // L0 files are searched by every read and the last level holds most of the
+  // index and filter blocks, so fetch those first. Newer L0 files before
+  // older ones.
+  int last_level = 0;
+  for (const auto& f : live) {
+    last_level = std::max(last_level, f.level);
+  }
+  auto priority = [last_level](const ManifestReader::LiveFile& f) {
+    if (f.level == 0) {
+      return 0;
+    }
+    return f.level == last_level ? 1 : f.level + 1;
+  };
+  std::sort(live.begin(), live.end(),
+            [&](const ManifestReader::LiveFile& a,
+                const ManifestReader::LiveFile& b) {
+              int pa = priority(a), pb = priority(b);
+              if (pa != pb) {
+                return pa < pb;
+              }
+              return pa == 0 ? a.number > b.number : a.number < b.number;
+            });
+
+  std::vector<std::string> fnames;
+  uint64_t total_size = 0;
+  for (const auto& f : live) {
+    std::string fname =
+        RemapFilename(MakeTableFileName(local_dbname, f.number));
+    if (base_env_->FileExists(fname).IsNotFound()) {
+      fnames.push_back(fname);
+      total_size += f.size;
+    }
+  }
+  std::shared_ptr<CloudPrefetcher> prefetcher;
+  if (!fnames.empty()) {
+    prefetcher = std::make_shared<CloudPrefetcher>(
+        cloud_env_options.sst_prefetch_threads,
+        [this](const std::string& fname) {
+          if (base_env_->FileExists(fname).ok()) {
+            return Status::OK();
+          }
+          return GetCloudObject(fname, GetSstFileSize(fname));
+        },
+        info_log_);
+    prefetcher->Add(fnames);
+  }
+  {
+    // The previous prefetcher stops when its last user lets go of it,
+    // outside of the lock
+    std::lock_guard<std::mutex> lk(prefetcher_mutex_);
+    prefetcher_.swap(prefetcher);
+  }
+  if (fnames.empty()) {
+    return Status::OK();
+  }
+  Log(InfoLogLevel::INFO_LEVEL, info_log_,
+      "[%s] Prefetching %" ROCKSDB_PRIszt " of %" ROCKSDB_PRIszt
+      " live sst files, %" PRIu64 " bytes",
+      Name(), fnames.size(), live.size(), total_size);
+  return Status::OK();
+}
+
+uint64_t CloudEnvImpl::GetSstFileSize(const std::string& fname) {
+  std::lock_guard<std::mutex> lk(sst_sizes_mutex_);
+  auto it = sst_file_sizes_.find(fname);
+  return it == sst_file_sizes_.end() ? 0 : it->second;
+}
+
+std::shared_ptr<CloudPrefetcher> CloudEnvImpl::GetPrefetcher() {
+  std::lock_guard<std::mutex> lk(prefetcher_mutex_);
+  return prefetcher_;
+}
+
+void CloudEnvImpl::TEST_WaitForSstPrefetch() {
+  auto prefetcher = GetPrefetcher();
+  if (prefetcher) {
+    prefetcher->WaitForAll();
+  }
+}
+
 //
 // Create appropriate files in the clone dir
 //
@@ -1666,6 +1985,125 @@ Status CloudEnvImpl::SanitizeDirectory(const DBOptions& options,
   return st;
 }
 
+//
+// All db in a bucket are stored in path /.rockset/dbid/<dbid>
+// The value of the object is the pathname where the db resides.
+//
+Status CloudEnvImpl::SaveDbid(const std::string& bucket_name,
+                              const std::string& dbid,
+                              const std::string& dirname) {
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[cloud_env_impl] SaveDbid dbid %s dir '%s'", dbid.c_str(),
+      dirname.c_str());
+
+  std::string dbidkey = dbid_registry_ + dbid;
+  std::unordered_map<std::string, std::string> metadata;
+  metadata["dirname"] = dirname;
+
+  Status st = cloud_env_options.storage_provider->PutCloudObjectMetadata(
+      bucket_name, dbidkey, metadata);
+
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+        "[cloud_env_impl] Bucket %s SaveDbid error in saving dbid %s "
+        "dirname %s %s",
+        bucket_name.c_str(), dbid.c_str(), dirname.c_str(),
+        st.ToString().c_str());
+  } else {
+    Log(InfoLogLevel::INFO_LEVEL, info_log_,
+        "[cloud_env_impl] Bucket %s SaveDbid dbid %s dirname %s %s",
+        bucket_name.c_str(), dbid.c_str(), dirname.c_str(), "ok");
+  }
+  return st;
+}
+
+//
+// Given a dbid, retrieves its pathname.
+//
+Status CloudEnvImpl::GetPathForDbid(const std::string& bucket,
+                                    const std::string& dbid,
+                                    std::string* dirname) {
+  std::string dbidkey = dbid_registry_ + dbid;
+
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[cloud_env_impl] Bucket %s GetPathForDbid dbid %s", bucket.c_str(),
+      dbid.c_str());
+
+  CloudObjectInformation info;
+  Status st = cloud_env_options.storage_provider->GetCloudObjectMetadata(
+      bucket, dbidkey, &info);
+  if (!st.ok()) {
+    if (st.IsNotFound()) {
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[cloud_env_impl] %s GetPathForDbid error non-existent dbid %s %s",
+          bucket.c_str(), dbid.c_str(), st.ToString().c_str());
+    } else {
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[cloud_env_impl] %s GetPathForDbid error dbid %s %s", bucket.c_str(),
+          dbid.c_str(), st.ToString().c_str());
+    }
+    return st;
+  }
+
+  // Find "dirname" metadata that stores the pathname of the db
+  const char* kDirnameTag = "dirname";
+  auto it = info.metadata.find(kDirnameTag);
+  if (it != info.metadata.end()) {
+    *dirname = it->second;
+  } else {
+    st = Status::NotFound("GetPathForDbid");
+  }
+  Log(InfoLogLevel::INFO_LEVEL, info_log_,
+      "[cloud_env_impl] %s GetPathForDbid dbid %s %s", bucket.c_str(),
+      dbid.c_str(), st.ToString().c_str());
+  return st;
+}
+
+//
+// Retrieves the list of all registered dbids and their paths
+//
+Status CloudEnvImpl::GetDbidList(const std::string& bucket, DbidList* dblist) {
+  // fetch the list all all dbids
+  std::vector<std::string> dbid_list;
+  Status st = cloud_env_options.storage_provider->ListCloudObjects(
+      bucket, dbid_registry_, &dbid_list);
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+        "[cloud_env_impl] %s GetDbidList error in ListCloudObjects %s",
+        bucket.c_str(), st.ToString().c_str());
+    return st;
+  }
+  // for each dbid, fetch the db directory where the db data should reside
+  for (auto dbid : dbid_list) {
+    std::string dirname;
+    st = GetPathForDbid(bucket, dbid, &dirname);
+    if (!st.ok()) {
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[cloud_env_impl] %s GetDbidList error in GetPathForDbid(%s) %s",
+          bucket.c_str(), dbid.c_str(), st.ToString().c_str());
+      return st;
+    }
+    // insert item into result set
+    (*dblist)[dbid] = dirname;
+  }
+  return st;
+}
+
+//
+// Deletes the specified dbid from the registry
+//
+Status CloudEnvImpl::DeleteDbid(const std::string& bucket,
+                                const std::string& dbid) {
+  // fetch the list all all dbids
+  std::string dbidkey = dbid_registry_ + dbid;
+  Status st =
+      cloud_env_options.storage_provider->DeleteCloudObject(bucket, dbidkey);
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[cloud_env_impl] %s DeleteDbid DeleteDbid(%s) %s", bucket.c_str(),
+      dbid.c_str(), st.ToString().c_str());
+  return st;
+}
+
 Status CloudEnvImpl::FetchCloudManifest(const std::string& local_dbname,
                                         bool force) {
   std::string cloudmanifest = CloudManifestFile(local_dbname);
@@ -1796,6 +2234,65 @@ Status CloudEnvImpl::RollNewEpoch(const std::string& local_dbname) {
   return Status::OK();
 }
 
+Status CloudEnvImpl::RecoverDeletionJournal(const std::string& local_dbname) {
+  auto provider = cloud_env_options.storage_provider;
+  const std::string object = DeletionJournalFile(GetDestObjectPath());
+  const std::string local = DeletionJournalFile(local_dbname);
+  Status st = provider->GetCloudObject(GetDestBucketName(), object, local);
+  if (st.ok()) {
+    std::string journal;
+    st = ReadFileToString(base_env_, local, &journal);
+    // The journal is written apart from the MANIFEST, so it can name files
+    // that the recovered MANIFEST still references, e.g. after a crash
+    // between the two writes. The dummy MANIFEST name is remapped to the
+    // MANIFEST of the current epoch, which RollNewEpoch() has made local.
+    std::set<uint64_t> live;
+    if (st.ok()) {
+      std::vector<ManifestReader::LiveFile> files;
+      Status s = ManifestReader::GetLiveFilesFromManifest(
+          this, local_dbname + "/MANIFEST-000001", &files);
+      if (s.ok()) {
+        for (const auto& f : files) {
+          live.insert(f.number);
+        }
+      } else if (!s.IsNotFound()) {
+        base_env_->DeleteFile(local);
+        return s;
+      }
+    }
+    if (st.ok()) {
+      st = deletion_queue_->Recover(journal, [&live](const std::string& name) {
+        uint64_t number;
+        FileType type;
+        return ParseFileName(RemoveEpoch(name), &number, &type) &&
+               type == kTableFile && live.count(number) > 0;
+      });
+    }
+    if (!st.ok()) {
+      // The objects leak until the purger finds them
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[cloud_env_impl] Unable to recover deletion journal %s: %s",
+          object.c_str(), st.ToString().c_str());
+    }
+  } else if (!st.IsNotFound()) {
+    return st;
+  }
+  base_env_->DeleteFile(local);
+
+  Env* env = base_env_;
+  const std::string bucket = GetDestBucketName();
+  deletion_queue_->EnableJournal(
+      [env, provider, bucket, object, local](const std::string& contents) {
+        Status s = WriteStringToFile(env, contents, local, true);
+        if (s.ok()) {
+          s = provider->PutCloudObject(local, bucket, object);
+        }
+        env->DeleteFile(local);
+        return s;
+      });
+  return Status::OK();
+}
+
 Status CloudEnvImpl::Prepare() {
   Header(info_log_, "     %s.src_bucket_name: %s", Name(),
          cloud_env_options.src_bucket.GetBucketName().c_str());
@@ -1836,6 +2333,16 @@ Status CloudEnvImpl::Prepare() {
             "Log controller required for remote log files");
       }
     }
+    if (s.ok() && !cloud_env_options.keep_local_sst_files &&
+        !cloud_env_options.sst_block_cache_path.empty() &&
+        cloud_env_options.sst_block_cache_size > 0) {
+      s = CloudBlockCache::Open(base_env_,
+                                cloud_env_options.sst_block_cache_path,
+                                cloud_env_options.sst_block_cache_size,
+                                cloud_env_options.sst_block_cache_block_size,
+                                info_log_, cloud_env_options.statistics,
+                                &sst_block_cache_);
+    }
   }
   return s;
 }
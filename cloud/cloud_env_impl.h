@@ -3,17 +3,25 @@
 #pragma once
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
+#include "cloud/cloud_deletion_queue.h"
 #include "cloud/cloud_manifest.h"
+#include "cloud/cloud_metadata_cache.h"
 #include "rocksdb/cloud/cloud_env_options.h"
+#include "rocksdb/cloud/cloud_storage_provider.h"
 #include "rocksdb/env.h"
 #include "rocksdb/status.h"
 
 namespace ROCKSDB_NAMESPACE {
-class CloudScheduler;
+class CloudBlockCache;
+class CloudMetadataCache;
+class CloudPrefetcher;
 class CloudStorageReadableFile;
+class CloudUploadPipeline;
 
 //
 // The Cloud environment
@@ -101,6 +109,14 @@ class CloudEnvImpl : public CloudEnv {
     return base_env_->GetThreadPoolQueueLen(pri);
   }
 
+  Status LockFile(const std::string& fname, FileLock** lock) override {
+    return base_env_->LockFile(fname, lock);
+  }
+
+  Status UnlockFile(FileLock* lock) override {
+    return base_env_->UnlockFile(lock);
+  }
+
   virtual Status GetTestDirectory(std::string* path) override {
     return base_env_->GetTestDirectory(path);
   }
@@ -143,9 +159,23 @@ class CloudEnvImpl : public CloudEnv {
     return base_env_->GetThreadID();
   }
 
+  // Saves and retrieves the dbid->dirname mapping in cloud storage
+  Status SaveDbid(const std::string& bucket_name, const std::string& dbid,
+                  const std::string& dirname) override;
+  Status GetPathForDbid(const std::string& bucket, const std::string& dbid,
+                        std::string* dirname) override;
+  Status GetDbidList(const std::string& bucket, DbidList* dblist) override;
+  Status DeleteDbid(const std::string& bucket,
+                    const std::string& dbid) override;
+
   Status SanitizeDirectory(const DBOptions& options,
                            const std::string& clone_name, bool read_only);
   Status LoadCloudManifest(const std::string& local_dbname, bool read_only);
+  // Records the sizes of the live sst files of the db, so that opening them
+  // from cloud storage needs no metadata request, and starts downloading
+  // them in the background if sst_prefetch_threads is set.
+  // REQUIRES: LoadCloudManifest() was called.
+  Status LoadSstFiles(const std::string& local_dbname);
   // The separator used to separate dbids while creating the dbid of a clone
   static constexpr const char* DBID_SEPARATOR = "rockset";
 
@@ -225,19 +255,73 @@ class CloudEnvImpl : public CloudEnv {
   Status CopyLocalFileToDest(const std::string& local_name,
                              const std::string& cloud_name) override;
 
+  // The local copy is deleted once the upload finishes unless
+  // keep_local_sst_files is set.
+  Status CopyLocalFileToDestAsync(const std::string& local_name,
+                                  const std::string& cloud_name) override;
+
+  // Retries the uploads that failed first. Returns the error of an upload
+  // that still failed, if any.
+  Status WaitForPendingUploads() override;
+
+  // Reads sst objects through the sst block cache, if there is one.
+  void WrapCloudReadableFile(
+      const std::string& bucket, const std::string& object_path,
+      uint64_t size, std::unique_ptr<CloudStorageReadableFile>* file) override;
+
+  // Forgets what the metadata cache knows of an object of the destination
+  // bucket that was written without this env, like by a compaction worker
+  void InvalidateObjectMetadata(const std::string& object) {
+    if (metadata_cache_) {
+      metadata_cache_->Invalidate(GetDestBucketName(), object);
+    }
+  }
+
+  // Returns the hit and miss counts of the cloud object metadata cache
+  CloudMetadataCacheStats GetObjectMetadataCacheStats() {
+    return metadata_cache_ ? metadata_cache_->GetStats()
+                           : CloudMetadataCacheStats();
+  }
+
+  // Returns the cache of sst blocks read from cloud storage, or null if
+  // there is none (see CloudEnvOptions::sst_block_cache_path).
+  CloudBlockCache* GetSstBlockCache() const { return sst_block_cache_.get(); }
+
+  // Names the objects that the sst files created from now on are uploaded
+  // to, in place of their names in the destination object path. An empty
+  // name keeps that name. The files are read, sized and deleted at these
+  // objects for as long as the env lives.
+  void SetSstObjectNamer(
+      std::function<std::string(const std::string& fname)> namer) {
+    std::lock_guard<std::mutex> lk(sst_objects_mutex_);
+    sst_object_namer_ = std::move(namer);
+  }
+
+  // Blocks until every sst file queued by LoadSstFiles() is local
+  void TEST_WaitForSstPrefetch();
+
   void RemoveFileFromDeletionQueue(const std::string& filename);
 
   void TEST_SetFileDeletionDelay(std::chrono::seconds delay) {
-    std::lock_guard<std::mutex> lk(files_to_delete_mutex_);
-    file_deletion_delay_ = delay;
+    deletion_queue_->SetGracePeriod(delay);
   }
 
+  // Blocks until no deletion of an obsolete file is due
+  void TEST_WaitForDeletions() { deletion_queue_->TEST_WaitForIdle(); }
+
  protected:
   // Checks to see if the input fname exists in the dest or src bucket
   Status ExistsCloudObject(const std::string& fname);
 
-  // Gets the cloud object fname from the dest or src bucket
-  Status GetCloudObject(const std::string& fname);
+  // Gets the cloud object fname from the dest or src bucket. size is the
+  // size of the object if it is known, e.g. from the MANIFEST, or zero.
+  Status GetCloudObject(const std::string& fname, uint64_t size = 0);
+
+  // Downloads object from bucket into the local file fname. A MANIFEST is
+  // completed with the deltas that were uploaded after it.
+  Status DownloadCloudObject(const std::string& bucket,
+                             const std::string& object,
+                             const std::string& fname, uint64_t size);
 
   // Gets the size of the named cloud object from the dest or src bucket
   Status GetCloudObjectSize(const std::string& fname, uint64_t* remote_size);
@@ -251,10 +335,30 @@ class CloudEnvImpl : public CloudEnv {
   Status ListCloudObjects(const std::string& path,
                           std::vector<std::string>* result);
 
-  // Returns a CloudStorageReadableFile from the dest or src bucket
+  // Lists the objects below object_path in bucket and remembers their
+  // information for later lookups. A foreign bucket is one that other dbs
+  // write to, so what is known about it expires. With
+  // use_object_metadata_cache, a listing that has not expired is reused.
+  Status ListAndCacheCloudObjects(const std::string& bucket,
+                                  const std::string& object_path, bool foreign,
+                                  std::vector<std::string>* result);
+
+  // Looks up the information of the cloud object of fname in the metadata
+  // cache, first in the dest and then in the src bucket. Returns Incomplete
+  // if the cache does not know whether the object exists.
+  Status LookupCloudObjectInfo(const std::string& fname,
+                               CloudObjectInformation* info);
+
+  // Gets the size of the named cloud object from the metadata cache, or else
+  // from the dest or src bucket
+  Status GetCloudObjectSizeCached(const std::string& fname,
+                                  uint64_t* remote_size);
+
+  // Returns a CloudStorageReadableFile from the dest or src bucket. A size
+  // that is not zero is the known size of the file.
   Status NewCloudReadableFile(const std::string& fname,
                               std::unique_ptr<CloudStorageReadableFile>* result,
-                              const EnvOptions& options);
+                              const EnvOptions& options, uint64_t size = 0);
 
   // Copy IDENTITY file to cloud storage. Update dbid registry.
   Status SaveIdentityToCloud(const std::string& localfile,
@@ -285,6 +389,9 @@ class CloudEnvImpl : public CloudEnv {
   Status FetchCloudManifest(const std::string& local_dbname, bool force);
 
   Status RollNewEpoch(const std::string& local_dbname);
+  // Takes the deletions that an earlier instance of the db journaled, and
+  // journals the deletion queue from now on
+  Status RecoverDeletionJournal(const std::string& local_dbname);
   // The dbid of the source database that is cloned
   std::string src_dbid_;
 
@@ -299,7 +406,20 @@ class CloudEnvImpl : public CloudEnv {
   bool purger_is_running_;
   std::thread purge_thread_;
 
-  std::shared_ptr<CloudScheduler> scheduler_;
+  // Uploads sst files in the background. Null unless async_upload_threads > 0
+  std::unique_ptr<CloudUploadPipeline> upload_pipeline_;
+
+  // Caches blocks of the sst files that are read from cloud storage
+  std::unique_ptr<CloudBlockCache> sst_block_cache_;
+
+  // Downloads the live sst files after open. Null unless sst_prefetch_threads
+  // is set and a db with sst files was opened. It is replaced when another
+  // db is opened, so users take a reference with GetPrefetcher().
+  std::mutex prefetcher_mutex_;
+  std::shared_ptr<CloudPrefetcher> prefetcher_;
+
+  // The pathname that contains a list of all db's inside a bucket.
+  static constexpr const char* dbid_registry_ = "/.rockset/dbid/";
 
   // A background thread that deletes orphaned objects in cloud storage
   void Purger();
@@ -308,16 +428,39 @@ class CloudEnvImpl : public CloudEnv {
  private:
   Status writeCloudManifest(CloudManifest* manifest, const std::string& fname);
   std::string generateNewEpochId();
+  // Updates the metadata cache and the known size of an sst file after an
+  // upload of local_name
+  void CacheUploadedObject(const std::string& local_name,
+                           const std::string& dest_name,
+                           const Status& upload_status);
+  // The current prefetcher, if any
+  std::shared_ptr<CloudPrefetcher> GetPrefetcher();
+  // The size of the sst file as recorded in the MANIFEST or on upload, or
+  // zero if it is not known
+  uint64_t GetSstFileSize(const std::string& fname);
+
   std::unique_ptr<CloudManifest> cloud_manifest_;
+  std::mutex sst_sizes_mutex_;
+  // The sizes of the live sst files by their local names
+  std::unordered_map<std::string, uint64_t> sst_file_sizes_;
+  std::mutex sst_objects_mutex_;
+  std::function<std::string(const std::string& fname)> sst_object_namer_;
+  // The objects that the namer gave to sst files, by the basenames of the
+  // files
+  std::unordered_map<std::string, std::string> sst_objects_;
   // This runs only in tests when we want to disable cloud manifest
   // functionality
   bool test_disable_cloud_manifest_{false};
 
   // scratch space in local dir
   static constexpr const char* SCRATCH_LOCAL_DIR = "/tmp";
-  std::mutex files_to_delete_mutex_;
-  std::chrono::seconds file_deletion_delay_ = std::chrono::hours(1);
-  std::unordered_map<std::string, int> files_to_delete_;
+  // Deletes the objects of obsolete files after a grace period
+  std::unique_ptr<CloudDeletionQueue> deletion_queue_;
+
+  // The information of the sst objects in cloud storage, kept up to date by
+  // the uploads and deletions of this env. Null unless
+  // use_object_metadata_cache is set.
+  std::unique_ptr<CloudMetadataCache> metadata_cache_;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
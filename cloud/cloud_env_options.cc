@@ -7,6 +7,7 @@
 #include "cloud/cloud_env_wrapper.h"
 #include "cloud/db_cloud_impl.h"
 #include "rocksdb/env.h"
+#include "util/compression.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -33,6 +34,54 @@ void CloudEnvOptions::Dump(Logger* log) const {
          use_aws_transfer_manager ? "true" : "false");
   Header(log, "           COptions.number_objects_listed_in_one_iteration: %d",
          number_objects_listed_in_one_iteration);
+  Header(log, "               COptions.async_upload_threads: %d",
+         async_upload_threads);
+  Header(log, "                COptions.max_pending_uploads: %d",
+         max_pending_uploads);
+  Header(log, "              COptions.manifest_delta_upload: %s",
+         manifest_delta_upload ? "true" : "false");
+  Header(log, "  COptions.manifest_delta_compaction_trigger: %d",
+         manifest_delta_compaction_trigger);
+  Header(log, "               COptions.sst_block_cache_path: %s",
+         sst_block_cache_path.c_str());
+  Header(log, "               COptions.sst_block_cache_size: %" PRIu64,
+         sst_block_cache_size);
+  Header(log, "         COptions.sst_block_cache_block_size: %" ROCKSDB_PRIszt,
+         sst_block_cache_block_size);
+  Header(log, "                         COptions.statistics: %p",
+         statistics.get());
+  Header(log, "                 COptions.min_readahead_size: %" ROCKSDB_PRIszt,
+         min_readahead_size);
+  Header(log, "                 COptions.max_readahead_size: %" ROCKSDB_PRIszt,
+         max_readahead_size);
+  Header(log, "                   COptions.transfer_threads: %d",
+         transfer_threads);
+  Header(log, "                 COptions.transfer_part_size: %" PRIu64,
+         transfer_part_size);
+  Header(log, "               COptions.sst_prefetch_threads: %d",
+         sst_prefetch_threads);
+  Header(log, "          COptions.use_object_metadata_cache: %s",
+         use_object_metadata_cache ? "true" : "false");
+  Header(log, "   COptions.object_metadata_cache_ttl_millis: %" PRIu64,
+         object_metadata_cache_ttl_millis);
+  Header(log, "     COptions.object_metadata_cache_capacity: %" ROCKSDB_PRIszt,
+         object_metadata_cache_capacity);
+  Header(log, "                     COptions.log_batch_size: %" ROCKSDB_PRIszt,
+         log_batch_size);
+  Header(log, "             COptions.log_batch_delay_micros: %" PRIu64,
+         log_batch_delay_micros);
+  Header(log, "                    COptions.log_compression: %s",
+         CompressionTypeToString(log_compression).c_str());
+  Header(log, "                  COptions.log_apply_threads: %d",
+         log_apply_threads);
+  Header(log, "                   COptions.deletion_threads: %d",
+         deletion_threads);
+  Header(log, "              COptions.max_deletions_per_sec: %" PRIu64,
+         max_deletions_per_sec);
+  Header(log, "                  COptions.scheduler_threads: %d",
+         scheduler_threads);
+  Header(log, "    COptions.scheduler_stats_dump_period_sec: %u",
+         scheduler_stats_dump_period_sec);
 }
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,253 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_log_applier.h"
+
+#include <cinttypes>
+
+#include "cloud/cloud_log_controller_impl.h"
+#include "port/port.h"
+#include "rocksdb/env.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+CloudLogApplier::CloudLogApplier(Env* env, int num_threads,
+                                 const std::shared_ptr<Logger>& info_log)
+    : env_(env),
+      info_log_(info_log),
+      records_behind_(0),
+      bytes_behind_(0),
+      shutting_down_(false),
+      records_applied_(0),
+      bytes_applied_(0),
+      writes_(0) {
+  for (int i = 0; i < num_threads; i++) {
+    threads_.emplace_back([this]() { WorkerThread(); });
+  }
+}
+
+CloudLogApplier::~CloudLogApplier() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    shutting_down_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  ApplyPending();
+}
+
+Status CloudLogApplier::Add(uint32_t operation, const std::string& pathname,
+                            uint64_t offset_in_file, uint64_t file_size,
+                            const Slice& data) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  File& file = files_[pathname];
+  file.pending.push_back(
+      Record{operation, offset_in_file, file_size, data.ToString()});
+  records_behind_++;
+  bytes_behind_ += data.size();
+  if (!file.scheduled) {
+    file.scheduled = true;
+    ready_.push_back(pathname);
+    lk.unlock();
+    work_cv_.notify_one();
+  }
+  return Status::OK();
+}
+
+Status CloudLogApplier::ApplyPending() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (!ready_.empty()) {
+    ApplyNextLocked(&lk);
+  }
+  return TakeErrorsLocked();
+}
+
+Status CloudLogApplier::WaitForApplied() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (threads_.empty()) {
+    while (!ready_.empty()) {
+      ApplyNextLocked(&lk);
+    }
+  }
+  done_cv_.wait(lk, [this]() { return records_behind_ == 0; });
+  return TakeErrorsLocked();
+}
+
+Status CloudLogApplier::TakeErrorsLocked() {
+  if (errors_.empty()) {
+    return Status::OK();
+  }
+  Status st = errors_.begin()->second;
+  if (errors_.size() > 1) {
+    st = Status::IOError("Failed to apply the records of " +
+                             std::to_string(errors_.size()) + " files",
+                         st.ToString());
+  }
+  errors_.clear();
+  return st;
+}
+
+CloudLogTailerStats CloudLogApplier::GetStats() {
+  CloudLogTailerStats stats;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stats.records_behind = records_behind_;
+    stats.bytes_behind = bytes_behind_;
+  }
+  stats.records_applied = records_applied_.load();
+  stats.bytes_applied = bytes_applied_.load();
+  stats.writes = writes_.load();
+  return stats;
+}
+
+void CloudLogApplier::WorkerThread() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    work_cv_.wait(lk, [this]() { return shutting_down_ || !ready_.empty(); });
+    if (ready_.empty()) {
+      // shutting down and every ready file has been applied
+      return;
+    }
+    ApplyNextLocked(&lk);
+  }
+}
+
+void CloudLogApplier::ApplyNextLocked(std::unique_lock<std::mutex>* lk) {
+  const std::string pathname = std::move(ready_.front());
+  ready_.pop_front();
+  auto it = files_.find(pathname);
+  File* file = &it->second;
+  std::deque<Record> records;
+  records.swap(file->pending);
+
+  lk->unlock();
+  Status st = ApplyRecords(pathname, file, records);
+  lk->lock();
+
+  for (const auto& r : records) {
+    records_behind_--;
+    bytes_behind_ -= r.data.size();
+  }
+  if (!st.ok()) {
+    errors_.emplace(pathname, st);
+  }
+  if (!file->pending.empty()) {
+    // More records arrived meanwhile
+    ready_.push_back(pathname);
+    work_cv_.notify_one();
+  } else {
+    file->scheduled = false;
+    if (!file->fd) {
+      files_.erase(it);
+    }
+  }
+  done_cv_.notify_all();
+}
+
+Status CloudLogApplier::ApplyRecords(const std::string& pathname, File* file,
+                                     const std::deque<Record>& records) {
+  Status st;
+  auto keep_first = [&st](const Status& s) {
+    if (st.ok() && !s.ok()) {
+      st = s;
+    }
+  };
+  // The appends at adjacent offsets that are not written yet
+  std::string buffer;
+  uint64_t buffer_offset = 0;
+  for (const auto& r : records) {
+    if (r.operation == CloudLogControllerImpl::kAppend) {
+      if (!buffer.empty() &&
+          r.offset_in_file != buffer_offset + buffer.size()) {
+        keep_first(Write(pathname, file, buffer_offset, buffer));
+        buffer.clear();
+      }
+      if (buffer.empty()) {
+        buffer_offset = r.offset_in_file;
+      }
+      buffer.append(r.data);
+    } else {
+      if (!buffer.empty()) {
+        keep_first(Write(pathname, file, buffer_offset, buffer));
+        buffer.clear();
+      }
+      if (r.operation == CloudLogControllerImpl::kDelete) {
+        if (file->fd) {
+          Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+              "[log_applier] Delete file %s, but it is still open."
+              " Closing it now..",
+              pathname.c_str());
+          file->fd->Close();
+          file->fd.reset();
+        }
+        Status s = env_->DeleteFile(pathname);
+        Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+            "[log_applier] Deleted file: %s %s", pathname.c_str(),
+            s.ToString().c_str());
+        if (!s.IsNotFound()) {
+          keep_first(s);
+        }
+      } else if (r.operation == CloudLogControllerImpl::kClosed) {
+        Status s;
+        if (file->fd) {
+          s = file->fd->Close();
+          file->fd.reset();
+        }
+        Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+            "[log_applier] Closed file %s %s", pathname.c_str(),
+            s.ToString().c_str());
+        keep_first(s);
+      } else {
+        Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+            "[log_applier] Unknown operation '%x': File %s", r.operation,
+            pathname.c_str());
+        keep_first(Status::IOError("Unknown operation"));
+      }
+    }
+    records_applied_++;
+    bytes_applied_ += r.data.size();
+  }
+  if (!buffer.empty()) {
+    keep_first(Write(pathname, file, buffer_offset, buffer));
+  }
+  return st;
+}
+
+Status CloudLogApplier::Write(const std::string& pathname, File* file,
+                              uint64_t offset, const Slice& data) {
+  Status st;
+  // If this file is not yet open, open it and keep it open
+  if (!file->fd) {
+    st = env_->NewRandomRWFile(pathname, &file->fd, EnvOptions());
+    if (!st.ok()) {
+      // create the file
+      std::unique_ptr<WritableFile> tmp_writable_file;
+      env_->NewWritableFile(pathname, &tmp_writable_file, EnvOptions());
+      tmp_writable_file.reset();
+      // Try again.
+      st = env_->NewRandomRWFile(pathname, &file->fd, EnvOptions());
+    }
+    if (!st.ok()) {
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[log_applier] Unable to open cached file %s: %s", pathname.c_str(),
+          st.ToString().c_str());
+      return st;
+    }
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[log_applier] Appending %" ROCKSDB_PRIszt
+      " bytes to %s at offset %" PRIu64,
+      data.size(), pathname.c_str(), offset);
+  st = file->fd->Write(offset, data);
+  writes_++;
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+        "[log_applier] Error writing to cached file %s: %s", pathname.c_str(),
+        st.ToString().c_str());
+  }
+  return st;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,113 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rocksdb/cloud/cloud_log_controller.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Env;
+class Logger;
+class RandomRWFile;
+
+//
+// Applies the records of a cloud log stream to the local cache of the log
+// files.
+//
+// The records are queued per file. All the records that are queued for a
+// file when it is applied are applied together, so appends at adjacent
+// offsets become a single write, and the files stay open until they are
+// closed or deleted. The records of different files are applied in parallel
+// by num_threads threads, those of one file in the order they were added.
+// Without threads, the records are applied by ApplyPending().
+//
+// An error only fails the record that caused it: the records after it, of
+// the same file and of the others, are still applied. The first error of
+// every file that failed is reported by the next ApplyPending() or
+// WaitForApplied(), and then forgotten.
+//
+class CloudLogApplier {
+ public:
+  CloudLogApplier(Env* env, int num_threads,
+                  const std::shared_ptr<Logger>& info_log);
+
+  // Applies the records that are queued and stops the threads
+  ~CloudLogApplier();
+
+  // Queues a record for the cached file at pathname. data is the payload of
+  // an append, file_size the size of a closed file.
+  Status Add(uint32_t operation, const std::string& pathname,
+             uint64_t offset_in_file, uint64_t file_size, const Slice& data);
+
+  // Applies the queued records in the calling thread
+  Status ApplyPending();
+
+  // Waits until every record that was queued before has been applied
+  Status WaitForApplied();
+
+  CloudLogTailerStats GetStats();
+
+ private:
+  struct Record {
+    uint32_t operation;
+    uint64_t offset_in_file;
+    uint64_t file_size;
+    std::string data;
+  };
+  struct File {
+    std::deque<Record> pending;
+    std::unique_ptr<RandomRWFile> fd;
+    // The file is queued in ready_ or being applied. Only the thread that
+    // applies a file uses its fd.
+    bool scheduled = false;
+  };
+
+  void WorkerThread();
+  // Applies the records of the file at the front of ready_. REQUIRES: mutex_
+  void ApplyNextLocked(std::unique_lock<std::mutex>* lk);
+  // Applies every record, and returns the first error
+  Status ApplyRecords(const std::string& pathname, File* file,
+                      const std::deque<Record>& records);
+  // Returns and forgets the errors. REQUIRES: mutex_
+  Status TakeErrorsLocked();
+  Status Write(const std::string& pathname, File* file, uint64_t offset,
+               const Slice& data);
+
+  Env* env_;
+  std::shared_ptr<Logger> info_log_;
+
+  std::mutex mutex_;
+  // Signalled when a file becomes ready or the applier is shutting down
+  std::condition_variable work_cv_;
+  // Signalled when the records of a file were applied
+  std::condition_variable done_cv_;
+  std::map<std::string, File> files_;
+  // The files that have records queued and are not being applied
+  std::deque<std::string> ready_;
+  uint64_t records_behind_;
+  uint64_t bytes_behind_;
+  // The first error of every file that failed
+  std::map<std::string, Status> errors_;
+  bool shutting_down_;
+
+  std::atomic<uint64_t> records_applied_;
+  std::atomic<uint64_t> bytes_applied_;
+  std::atomic<uint64_t> writes_;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
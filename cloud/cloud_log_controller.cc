@@ -12,13 +12,141 @@
 
 #include "cloud/cloud_log_controller_impl.h"
 #include "cloud/filename.h"
+#include "options/cf_options.h"
 #include "rocksdb/cloud/cloud_env_options.h"
 #include "rocksdb/status.h"
+#include "table/block_based/block_based_table_builder.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/compression.h"
 #include "util/stderr_logger.h"
 #include "util/string_util.h"
 
 namespace ROCKSDB_NAMESPACE {
+namespace {
+// Batches are compressed like the blocks of format_version 2 tables
+const uint32_t kBatchFormatVersion = 2;
+}  // namespace
+
+CloudLogBatcher::CloudLogBatcher(
+    const CloudEnvOptions& options,
+    const std::shared_ptr<CloudScheduler>& scheduler, SendType send)
+    : batch_size_(options.log_batch_size),
+      batch_delay_(options.log_batch_delay_micros),
+      compression_(options.log_compression),
+      scheduler_(scheduler),
+      send_(std::move(send)),
+      timer_(-1) {}
+
+CloudLogBatcher::~CloudLogBatcher() {
+  if (timer_ >= 0) {
+    scheduler_->CancelJob(timer_);
+  }
+}
+
+Status CloudLogBatcher::Add(const Slice& record) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!status_.ok()) {
+    return status_;
+  } else if (!send_) {
+    return Status::IOError("Log file is closed");
+  }
+  PutLengthPrefixedSlice(&records_, record);
+  if (records_.size() >= batch_size_) {
+    return SendLocked();
+  }
+  if (timer_ < 0) {
+    std::weak_ptr<CloudLogBatcher> weak = shared_from_this();
+    timer_ = scheduler_->ScheduleJob(
+        batch_delay_,
+        [weak](void*) {
+          auto batcher = weak.lock();
+          if (batcher) {
+            batcher->Send();
+          }
+        },
+        nullptr, "log_batch");
+  }
+  return status_;
+}
+
+Status CloudLogBatcher::Send() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return SendLocked();
+}
+
+Status CloudLogBatcher::Stop() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  Status st = SendLocked();
+  send_ = nullptr;
+  return st;
+}
+
+Status CloudLogBatcher::SendLocked() {
+  if (timer_ >= 0) {
+    scheduler_->CancelJob(timer_);
+    timer_ = -1;
+  }
+  if (records_.empty() || !send_ || !status_.ok()) {
+    return status_;
+  }
+  std::string message;
+  CloudLogControllerImpl::SerializeLogRecordBatch(records_, compression_,
+                                                  &message);
+  records_.clear();
+  status_ = send_(message);
+  return status_;
+}
+
+CloudLogSyncTracker::CloudLogSyncTracker() : last_sent_(0), durable_(0) {}
+
+uint64_t CloudLogSyncTracker::Sent() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return ++last_sent_;
+}
+
+void CloudLogSyncTracker::Acknowledge(uint64_t seq, const Status& status) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!status.ok() && status_.ok()) {
+      status_ = status;
+    }
+    if (seq != durable_ + 1) {
+      acknowledged_.insert(seq);
+      return;
+    }
+    durable_ = seq;
+    auto it = acknowledged_.begin();
+    while (it != acknowledged_.end() && *it == durable_ + 1) {
+      durable_ = *it;
+      it = acknowledged_.erase(it);
+    }
+  }
+  cv_.notify_all();
+}
+
+uint64_t CloudLogSyncTracker::last_sent() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return last_sent_;
+}
+
+uint64_t CloudLogSyncTracker::durable() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return durable_;
+}
+
+Status CloudLogSyncTracker::Wait(uint64_t seq,
+                                 std::chrono::microseconds timeout) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  bool done = cv_.wait_for(lk, timeout, [this, seq]() {
+    return durable_ >= seq || !status_.ok();
+  });
+  if (!status_.ok()) {
+    return status_;
+  }
+  return done ? Status::OK() : Status::TimedOut();
+}
+
 CloudLogWritableFile::CloudLogWritableFile(CloudEnv* env,
                                            const std::string& fname,
                                            const EnvOptions& /*options*/)
@@ -62,6 +190,29 @@ Status CloudLogControllerImpl::Initialize(CloudEnv* env) {
   if (st.ok()) {
     st = env_->GetBaseEnv()->CreateDirIfMissing(cache_dir_);
   }
+  // Batches are uncompressed without statistics
+  DBOptions db_options;
+  db_options.env = env_;
+  uncompression_options_.reset(new ImmutableCFOptions(
+      ImmutableDBOptions(db_options), ColumnFamilyOptions()));
+  const CloudEnvOptions& cloud_env_options = env_->GetCloudEnvOptions();
+  scheduler_ = CloudScheduler::Get(cloud_env_options.scheduler_threads);
+  if (cloud_env_options.scheduler_stats_dump_period_sec > 0) {
+    // Cancelled when the scheduler goes away with the controller
+    CloudScheduler* scheduler = scheduler_.get();
+    std::shared_ptr<Logger> info_log = env_->info_log_;
+    const std::chrono::seconds period(
+        cloud_env_options.scheduler_stats_dump_period_sec);
+    scheduler_->ScheduleRecurringJob(
+        period, period,
+        [scheduler, info_log](void*) {
+          scheduler->LogJobStats(info_log.get());
+        },
+        nullptr, "stats_dump");
+  }
+  applier_.reset(new CloudLogApplier(
+      env_->GetBaseEnv(), env_->GetCloudEnvOptions().log_apply_threads,
+      env_->info_log_));
   return st;
 }
 
@@ -120,13 +271,66 @@ bool CloudLogControllerImpl::ExtractLogRecord(
   return true;
 }
 
+Status CloudLogControllerImpl::ExtractLogBatch(const Slice& input,
+                                               std::string* records) const {
+  Slice in = input;
+  Slice payload;
+  if (in.size() < 1) {
+    return Status::Corruption("Truncated log batch");
+  }
+  const CompressionType type = static_cast<CompressionType>(in[0]);
+  in.remove_prefix(1);
+  if (!GetLengthPrefixedSlice(&in, &payload)) {
+    return Status::Corruption("Truncated log batch");
+  }
+  if (type == kNoCompression) {
+    records->assign(payload.data(), payload.size());
+    return Status::OK();
+  }
+  UncompressionContext context(type);
+  UncompressionInfo info(context, UncompressionDict::GetEmptyDict(), type);
+  BlockContents contents;
+  Status st = UncompressBlockContentsForCompressionType(
+      info, payload.data(), payload.size(), &contents,
+      GetCompressFormatForVersion(type, kBatchFormatVersion),
+      *uncompression_options_);
+  if (st.ok()) {
+    records->assign(contents.data.data(), contents.data.size());
+  }
+  return st;
+}
+
 Status CloudLogControllerImpl::Apply(const Slice& in) {
+  Status st = AddRecords(in);
+  if (st.ok() && env_->GetCloudEnvOptions().log_apply_threads == 0) {
+    st = applier_->ApplyPending();
+  }
+  return st;
+}
+
+Status CloudLogControllerImpl::AddRecords(const Slice& in) {
+  Slice batch = in;
+  uint32_t batch_operation;
+  if (GetVarint32(&batch, &batch_operation) && batch_operation == kBatch) {
+    std::string records;
+    Status st = ExtractLogBatch(batch, &records);
+    Slice input(records);
+    Slice record;
+    while (st.ok() && !input.empty()) {
+      if (!GetLengthPrefixedSlice(&input, &record)) {
+        st = Status::Corruption("Bad record in log batch");
+      } else {
+        st = AddRecords(record);
+      }
+    }
+    return st;
+  }
+
   uint32_t operation;
   uint64_t offset_in_file;
   uint64_t file_size;
   Slice original_pathname;
   Slice payload;
-  Status st;
   bool ret = ExtractLogRecord(in, &operation, &original_pathname,
                               &offset_in_file, &file_size, &payload);
   if (!ret) {
@@ -135,87 +339,19 @@ Status CloudLogControllerImpl::Apply(const Slice& in) {
 
   // Convert original pathname to a local file path.
   std::string pathname = GetCachePath(original_pathname);
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[%s] Tailer: Operation %x of %" ROCKSDB_PRIszt
+      " bytes on %s at offset %" PRIu64,
+      Name(), operation, payload.size(), pathname.c_str(), offset_in_file);
+  return applier_->Add(operation, pathname, offset_in_file, file_size,
+                       payload);
+}
 
-  // Apply operation on cache file.
-  if (operation == kAppend) {
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[%s] Tailer: Appending %ld bytes to %s at offset %" PRIu64, Name(),
-        payload.size(), pathname.c_str(), offset_in_file);
-
-    auto iter = cache_fds_.find(pathname);
-
-    // If this file is not yet open, open it and store it in cache.
-    if (iter == cache_fds_.end()) {
-      std::unique_ptr<RandomRWFile> result;
-      st = env_->GetBaseEnv()->NewRandomRWFile(pathname, &result, EnvOptions());
-
-      if (!st.ok()) {
-        // create the file
-        std::unique_ptr<WritableFile> tmp_writable_file;
-        env_->GetBaseEnv()->NewWritableFile(pathname, &tmp_writable_file,
-                                            EnvOptions());
-        tmp_writable_file.reset();
-        // Try again.
-        st = env_->GetBaseEnv()->NewRandomRWFile(pathname, &result,
-                                                 EnvOptions());
-      }
-
-      if (st.ok()) {
-        cache_fds_[pathname] = std::move(result);
-        Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-            "[%s] Tailer: Successfully opened file %s and cached", Name(),
-            pathname.c_str());
-      } else {
-        return st;
-      }
-    }
-
-    RandomRWFile* fd = cache_fds_[pathname].get();
-    st = fd->Write(offset_in_file, payload);
-    if (!st.ok()) {
-      Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-          "[%s] Tailer: Error writing to cached file %s: %s", pathname.c_str(),
-          Name(), st.ToString().c_str());
-    }
-  } else if (operation == kDelete) {
-    // Delete file from cache directory.
-    auto iter = cache_fds_.find(pathname);
-    if (iter != cache_fds_.end()) {
-      Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-          "[%s] Tailer: Delete file %s, but it is still open."
-          " Closing it now..",
-          Name(), pathname.c_str());
-      RandomRWFile* fd = iter->second.get();
-      fd->Close();
-      cache_fds_.erase(iter);
-    }
-
-    st = env_->GetBaseEnv()->DeleteFile(pathname);
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[%s] Tailer: Deleted file: %s %s", Name(), pathname.c_str(),
-        st.ToString().c_str());
-
-    if (st.IsNotFound()) {
-      st = Status::OK();
-    }
-  } else if (operation == kClosed) {
-    auto iter = cache_fds_.find(pathname);
-    if (iter != cache_fds_.end()) {
-      RandomRWFile* fd = iter->second.get();
-      st = fd->Close();
-      cache_fds_.erase(iter);
-    }
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[%s] Tailer: Closed file %s %s", Name(), pathname.c_str(),
-        st.ToString().c_str());
-  } else {
-    st = Status::IOError("Unknown operation");
-    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
-        "[%s] Tailer: Unknown operation '%x': File %s %s", Name(), operation,
-        pathname.c_str(), st.ToString().c_str());
+CloudLogTailerStats CloudLogControllerImpl::GetTailerStats() {
+  if (!applier_) {
+    return CloudLogTailerStats();
   }
-
-  return st;
+  return applier_->GetStats();
 }
 
 void CloudLogControllerImpl::SerializeLogRecordAppend(const Slice& filename,
@@ -257,6 +393,38 @@ void CloudLogControllerImpl::SerializeLogRecordDelete(
   PutLengthPrefixedSlice(out, filename);
 }
 
+void CloudLogControllerImpl::SerializeLogRecordBatch(
+    const Slice& records, CompressionType compression, std::string* out) {
+  // write the operation type
+  PutVarint32(out, kBatch);
+
+  std::string compressed;
+  Slice payload = records;
+  CompressionType type = compression;
+  if (type != kNoCompression) {
+    CompressionOptions opts;
+    CompressionContext context(type);
+    CompressionInfo info(opts, context, CompressionDict::GetEmptyDict(), type,
+                         0 /* sample_for_compression */);
+    payload = CompressBlock(records, info, &type, kBatchFormatVersion,
+                            false /* do_sample */, &compressed, nullptr,
+                            nullptr);
+  }
+
+  // write out the compression and the records
+  out->push_back(static_cast<char>(type));
+  PutLengthPrefixedSlice(out, payload);
+}
+
+std::shared_ptr<CloudLogBatcher> CloudLogControllerImpl::NewBatcher(
+    CloudLogBatcher::SendType send) {
+  if (env_->GetCloudEnvOptions().log_batch_size == 0) {
+    return nullptr;
+  }
+  return std::make_shared<CloudLogBatcher>(env_->GetCloudEnvOptions(),
+                                           scheduler_, std::move(send));
+}
+
 Status CloudLogControllerImpl::StartTailingStream(const std::string& topic) {
   if (tid_) {
     return Status::Busy("Tailer already started");
@@ -3,13 +3,131 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
 #include <thread>
 
+#include "cloud/cloud_log_applier.h"
+#include "cloud/cloud_scheduler.h"
 #include "rocksdb/cloud/cloud_log_controller.h"
+#include "rocksdb/options.h"
 
 namespace ROCKSDB_NAMESPACE {
 class CloudEnv;
 class CloudEnvOptions;
+struct ImmutableCFOptions;
+
+//
+// Packs the records of a cloud log file into batches, so that many appends
+// cost a single message (see CloudEnvOptions::log_batch_size). Batches are
+// passed to send() in order and one at a time. Full batches are sent by the
+// thread that adds to them, others by a timer once they are
+// log_batch_delay_micros old.
+//
+// The timer may still hold on to the batcher after the file is gone, so the
+// file calls Stop() before it is destroyed.
+//
+class CloudLogBatcher : public std::enable_shared_from_this<CloudLogBatcher> {
+ public:
+  typedef std::function<Status(const Slice& message)> SendType;
+
+  CloudLogBatcher(const CloudEnvOptions& options,
+                  const std::shared_ptr<CloudScheduler>& scheduler,
+                  SendType send);
+  ~CloudLogBatcher();
+
+  // Adds a serialized record to the batch and sends the batch if it is full
+  Status Add(const Slice& record);
+
+  // Sends the records that are pending, if any
+  Status Send();
+
+  // Sends the records that are pending and stops sending any more
+  Status Stop();
+
+ private:
+  // REQUIRES: mutex_
+  Status SendLocked();
+
+  const size_t batch_size_;
+  const std::chrono::microseconds batch_delay_;
+  const CompressionType compression_;
+  std::shared_ptr<CloudScheduler> scheduler_;
+
+  std::mutex mutex_;
+  SendType send_;
+  // The length prefixed records of the batch
+  std::string records_;
+  // The timer that sends the batch, if one is scheduled
+  long timer_;
+  // The first error of send(), after which nothing is sent any more
+  Status status_;
+};
+
+//
+// Tracks the messages that a cloud log file sent by sequence number, so that
+// a sync only waits for the messages that were sent before it. The syncs of
+// concurrent writers are outstanding at the same time and each completes as
+// soon as its own messages are acknowledged, instead of queueing behind the
+// round trips of the others.
+//
+// Acknowledgements may arrive in any order, and after the file is gone. A
+// message is durable once it and every message before it were acknowledged.
+//
+class CloudLogSyncTracker {
+ public:
+  CloudLogSyncTracker();
+
+  // Returns the sequence number of a new message, starting at 1
+  uint64_t Sent();
+
+  // Records the acknowledgement of a message. The first failure is returned
+  // by every later Wait(). A message that could not be sent at all is
+  // acknowledged with OK, since its writer got the error already.
+  void Acknowledge(uint64_t seq, const Status& status);
+
+  // The sequence number of the last message that was sent
+  uint64_t last_sent();
+
+  // Every message up to this one was acknowledged
+  uint64_t durable();
+
+  // Waits until every message up to seq was acknowledged
+  Status Wait(uint64_t seq, std::chrono::microseconds timeout);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t last_sent_;
+  uint64_t durable_;
+  // The messages after durable_ that were acknowledged out of order
+  std::set<uint64_t> acknowledged_;
+  Status status_;
+};
+
+// The behavior of the stream that the local log controller emulates. The
+// defaults emulate nothing.
+struct LocalLogControllerOptions {
+  // Every message is acknowledged ack_latency_micros plus a uniformly
+  // distributed extra of up to ack_latency_jitter_micros after it was sent
+  uint64_t ack_latency_micros = 0;
+  uint64_t ack_latency_jitter_micros = 0;
+  // The bytes per second that the messages of the controller share. They are
+  // sent one after the other. Zero means unlimited.
+  int64_t bandwidth_bytes_per_sec = 0;
+  // A reorder_probability fraction of the messages takes another
+  // reorder_delay_micros, so that messages sent after them are acknowledged
+  // first. The tailers still see the messages in the order they were sent,
+  // once all of them were acknowledged, like the messages of a Kafka
+  // partition.
+  double reorder_probability = 0;
+  uint64_t reorder_delay_micros = 0;
+  // Seed of the random latencies and reordering, so that runs can be repeated
+  uint64_t seed = 301;
+};
 
 class CloudLogControllerImpl : public CloudLogController {
  public:
@@ -20,10 +138,17 @@ class CloudLogControllerImpl : public CloudLogController {
       std::shared_ptr<CloudLogController>* result);
   static Status CreateKafkaController(
       std::shared_ptr<CloudLogController>* result);
+  // Creates a controller whose stream is kept in memory, so that remote log
+  // files can be benchmarked without Kinesis or Kafka. The controllers of the
+  // process share the stream of a topic, which lives as long as one of them.
+  static Status CreateLocalController(
+      std::shared_ptr<CloudLogController>* result,
+      const LocalLogControllerOptions& options = LocalLogControllerOptions());
 
   static const uint32_t kAppend = 0x1;  // add a new record to a logfile
   static const uint32_t kDelete = 0x2;  // delete a log file
   static const uint32_t kClosed = 0x4;  // closing a file
+  static const uint32_t kBatch = 0x8;   // several records, maybe compressed
 
   CloudLogControllerImpl();
   virtual ~CloudLogControllerImpl();
@@ -34,6 +159,7 @@ class CloudLogControllerImpl : public CloudLogController {
 
   // Directory where files are cached locally.
   const std::string& GetCacheDir() const override { return cache_dir_; }
+  CloudLogTailerStats GetTailerStats() override;
   Status const status() const override { return status_; }
   virtual Status StartTailingStream(const std::string& topic) override;
   void StopTailingStream() override;
@@ -44,6 +170,16 @@ class CloudLogControllerImpl : public CloudLogController {
                                        uint64_t file_size, std::string* out);
   static void SerializeLogRecordDelete(const std::string& filename,
                                        std::string* out);
+  // Packs records, a concatenation of length prefixed serialized records,
+  // into a single record. The batch is compressed unless the compression is
+  // not supported or does not pay off.
+  static void SerializeLogRecordBatch(const Slice& records,
+                                      CompressionType compression,
+                                      std::string* out);
+
+  // Returns a batcher that sends the records of a file with send, or nullptr
+  // if records are not batched
+  std::shared_ptr<CloudLogBatcher> NewBatcher(CloudLogBatcher::SendType send);
   Status GetFileModificationTime(const std::string& fname,
                                  uint64_t* time) override;
   Status NewSequentialFile(const std::string& fname,
@@ -68,15 +204,25 @@ class CloudLogControllerImpl : public CloudLogController {
   static bool ExtractLogRecord(const Slice& input, uint32_t* operation,
                                Slice* filename, uint64_t* offset_in_file,
                                uint64_t* file_size, Slice* data);
+  // Extracts the records of a batch, without the leading operation
+  Status ExtractLogBatch(const Slice& input, std::string* records) const;
   CloudEnv* env_;
+  // The options that the batches are uncompressed with
+  std::unique_ptr<ImmutableCFOptions> uncompression_options_;
   Status status_;
   std::string cache_dir_;
-  // A cache of pathnames to their open file _escriptors
-  std::map<std::string, std::unique_ptr<RandomRWFile>> cache_fds_;
+  // Applies the records of the stream to the cached files
+  std::unique_ptr<CloudLogApplier> applier_;
 
+  // Queues the records of a message for the applier, and applies them unless
+  // the applier has threads of its own
   Status Apply(const Slice& data);
+  Status AddRecords(const Slice& data);
   bool IsRunning() const { return running_; }
 
+  // Sends the batches of the log files that are due
+  std::shared_ptr<CloudScheduler> scheduler_;
+
  private:
   // Background thread to tail stream
   std::unique_ptr<std::thread> tid_;
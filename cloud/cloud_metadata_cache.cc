@@ -0,0 +1,160 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_metadata_cache.h"
+
+#include "rocksdb/env.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+CloudMetadataCache::CloudMetadataCache(Env* env, uint64_t ttl_micros,
+                                       size_t capacity)
+    : env_(env), ttl_micros_(ttl_micros), capacity_(capacity) {}
+
+std::string CloudMetadataCache::Key(const std::string& bucket,
+                                    const std::string& path) {
+  return bucket + "/" + path;
+}
+
+void CloudMetadataCache::Insert(const std::string& key,
+                                const CloudObjectInformation& info,
+                                uint64_t expires_at) {
+  auto it = objects_.find(key);
+  if (it != objects_.end()) {
+    it->second.info = info;
+    it->second.expires_at = expires_at;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return;
+  }
+  lru_.push_front(key);
+  objects_[key] = Entry{info, expires_at, lru_.begin()};
+  while (objects_.size() > capacity_) {
+    objects_.erase(lru_.back());
+    lru_.pop_back();
+  }
+}
+
+void CloudMetadataCache::Remove(const std::string& key) {
+  auto it = objects_.find(key);
+  if (it != objects_.end()) {
+    lru_.erase(it->second.lru);
+    objects_.erase(it);
+  }
+}
+
+void CloudMetadataCache::SplitObject(const std::string& bucket,
+                                     const std::string& object,
+                                     std::string* listing_key,
+                                     std::string* name) {
+  auto slash = object.rfind('/');
+  if (slash == std::string::npos) {
+    *listing_key = Key(bucket, "");
+    *name = object;
+  } else {
+    *listing_key = Key(bucket, object.substr(0, slash));
+    *name = object.substr(slash + 1);
+  }
+}
+
+void CloudMetadataCache::AddListing(
+    const std::string& bucket, const std::string& prefix,
+    const std::vector<std::string>& names,
+    const std::vector<CloudObjectInformation>& infos, bool expires) {
+  const uint64_t now = env_->NowMicros();
+  std::lock_guard<std::mutex> lk(mutex_);
+  Listing& listing = listings_[Key(bucket, prefix)];
+  listing.names.clear();
+  listing.names.insert(names.begin(), names.end());
+  listing.expires_at = now + ttl_micros_;
+  for (size_t i = 0; i < names.size() && i < infos.size(); i++) {
+    Insert(Key(bucket, prefix + "/" + names[i]), infos[i],
+           expires ? now + ttl_micros_ : 0);
+  }
+}
+
+bool CloudMetadataCache::GetListing(const std::string& bucket,
+                                    const std::string& prefix,
+                                    std::vector<std::string>* names) {
+  const uint64_t now = env_->NowMicros();
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = listings_.find(Key(bucket, prefix));
+  if (it == listings_.end() || it->second.expires_at <= now) {
+    stats_.listing_misses++;
+    return false;
+  }
+  stats_.listing_hits++;
+  names->insert(names->end(), it->second.names.begin(),
+                it->second.names.end());
+  return true;
+}
+
+void CloudMetadataCache::Add(const std::string& bucket,
+                             const std::string& object,
+                             const CloudObjectInformation& info, bool expires) {
+  std::string listing_key, name;
+  SplitObject(bucket, object, &listing_key, &name);
+  const uint64_t expires_at = expires ? env_->NowMicros() + ttl_micros_ : 0;
+  std::lock_guard<std::mutex> lk(mutex_);
+  Insert(Key(bucket, object), info, expires_at);
+  auto it = listings_.find(listing_key);
+  if (it != listings_.end()) {
+    it->second.names.insert(name);
+  }
+}
+
+void CloudMetadataCache::Erase(const std::string& bucket,
+                               const std::string& object) {
+  std::string listing_key, name;
+  SplitObject(bucket, object, &listing_key, &name);
+  std::lock_guard<std::mutex> lk(mutex_);
+  Remove(Key(bucket, object));
+  auto it = listings_.find(listing_key);
+  if (it != listings_.end()) {
+    it->second.names.erase(name);
+  }
+}
+
+void CloudMetadataCache::Invalidate(const std::string& bucket,
+                                    const std::string& object) {
+  std::string listing_key, name;
+  SplitObject(bucket, object, &listing_key, &name);
+  std::lock_guard<std::mutex> lk(mutex_);
+  Remove(Key(bucket, object));
+  // The listing cannot tell whether the object exists any more
+  listings_.erase(listing_key);
+}
+
+Status CloudMetadataCache::Lookup(const std::string& bucket,
+                                  const std::string& object,
+                                  CloudObjectInformation* info) {
+  std::string listing_key, name;
+  SplitObject(bucket, object, &listing_key, &name);
+  const uint64_t now = env_->NowMicros();
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = objects_.find(Key(bucket, object));
+  if (it != objects_.end()) {
+    if (it->second.expires_at == 0 || it->second.expires_at > now) {
+      stats_.hits++;
+      *info = it->second.info;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      return Status::OK();
+    }
+    lru_.erase(it->second.lru);
+    objects_.erase(it);
+  }
+  auto lit = listings_.find(listing_key);
+  if (lit != listings_.end() && lit->second.expires_at > now &&
+      lit->second.names.count(name) == 0) {
+    stats_.hits++;
+    return Status::NotFound(object);
+  }
+  stats_.misses++;
+  return Status::Incomplete();
+}
+
+CloudMetadataCacheStats CloudMetadataCache::GetStats() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return stats_;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,119 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rocksdb/cloud/cloud_storage_provider.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Env;
+
+struct CloudMetadataCacheStats {
+  // Object lookups answered by the cache
+  uint64_t hits = 0;
+  // Object lookups that had to go to cloud storage
+  uint64_t misses = 0;
+  // Listings answered by the cache
+  uint64_t listing_hits = 0;
+  // Listings that had to go to cloud storage
+  uint64_t listing_misses = 0;
+};
+
+//
+// Remembers the information of cloud objects and the listings of the
+// prefixes they live in, so that existence, size and modification time
+// lookups do not each cost a request to cloud storage.
+//
+// The cache is only coherent for objects that are never rewritten under the
+// same name, and whose uploads and deletions are reported with Add() and
+// Erase(). Entries that were added with expires set, such as the ones of a
+// bucket that other dbs write to, are dropped ttl microseconds after they
+// were added. Listings always expire, since they include objects that the
+// cache is not told about.
+//
+// At most capacity objects are remembered; the least recently used one is
+// dropped to make room for another. A dropped object is looked up in cloud
+// storage again.
+//
+class CloudMetadataCache {
+ public:
+  CloudMetadataCache(Env* env, uint64_t ttl_micros, size_t capacity);
+
+  // Records the complete listing of the objects below prefix. names are
+  // relative to prefix.
+  void AddListing(const std::string& bucket, const std::string& prefix,
+                  const std::vector<std::string>& names,
+                  const std::vector<CloudObjectInformation>& infos,
+                  bool expires);
+
+  // Returns the names of the last listing of prefix, including the objects
+  // that were added or erased since. Returns false if there is no listing or
+  // it has expired.
+  bool GetListing(const std::string& bucket, const std::string& prefix,
+                  std::vector<std::string>* names);
+
+  // Records that the object exists with the given information
+  void Add(const std::string& bucket, const std::string& object,
+           const CloudObjectInformation& info, bool expires);
+
+  // Records that the object was deleted
+  void Erase(const std::string& bucket, const std::string& object);
+
+  // Forgets everything about the object, including whether it exists
+  void Invalidate(const std::string& bucket, const std::string& object);
+
+  // Returns OK and the information of the object if it is known to exist,
+  // NotFound if a listing of its prefix shows that it does not, and
+  // Incomplete if the cache does not know.
+  Status Lookup(const std::string& bucket, const std::string& object,
+                CloudObjectInformation* info);
+
+  CloudMetadataCacheStats GetStats();
+
+ private:
+  struct Entry {
+    CloudObjectInformation info;
+    // 0 if the entry does not expire
+    uint64_t expires_at;
+    std::list<std::string>::iterator lru;
+  };
+  struct Listing {
+    std::set<std::string> names;
+    uint64_t expires_at;
+  };
+
+  static std::string Key(const std::string& bucket, const std::string& path);
+  // Inserts or replaces the entry of key and drops the least recently used
+  // ones beyond the capacity
+  // REQUIRES: mutex_
+  void Insert(const std::string& key, const CloudObjectInformation& info,
+              uint64_t expires_at);
+  // REQUIRES: mutex_
+  void Remove(const std::string& key);
+  // Splits object into the key of the listing it belongs to and its name
+  // relative to the listed prefix
+  static void SplitObject(const std::string& bucket, const std::string& object,
+                          std::string* listing_key, std::string* name);
+
+  Env* env_;
+  const uint64_t ttl_micros_;
+  const size_t capacity_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> objects_;
+  // The keys of objects_, most recently used first
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Listing> listings_;
+  CloudMetadataCacheStats stats_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
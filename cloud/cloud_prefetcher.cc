@@ -0,0 +1,84 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_prefetcher.h"
+
+#include <algorithm>
+
+#include "rocksdb/env.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+CloudPrefetcher::CloudPrefetcher(
+    int num_threads, std::function<Status(const std::string&)> fetch,
+    const std::shared_ptr<Logger>& info_log)
+    : fetch_(std::move(fetch)), info_log_(info_log), shutting_down_(false) {
+  for (int i = 0; i < std::max(num_threads, 1); i++) {
+    threads_.emplace_back([this]() { WorkerThread(); });
+  }
+}
+
+CloudPrefetcher::~CloudPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    shutting_down_ = true;
+    queue_.clear();
+    queued_.clear();
+  }
+  work_cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void CloudPrefetcher::Add(const std::vector<std::string>& fnames) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (const auto& fname : fnames) {
+      if (queued_.insert(fname).second) {
+        queue_.push_back(fname);
+      }
+    }
+  }
+  work_cv_.notify_all();
+}
+
+void CloudPrefetcher::Claim(const std::string& fname) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  if (queued_.erase(fname) > 0) {
+    queue_.erase(std::find(queue_.begin(), queue_.end(), fname));
+    return;
+  }
+  done_cv_.wait(lk, [&]() { return active_.count(fname) == 0; });
+}
+
+void CloudPrefetcher::WaitForAll() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_cv_.wait(lk, [this]() { return queue_.empty() && active_.empty(); });
+}
+
+void CloudPrefetcher::WorkerThread() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    work_cv_.wait(lk, [this]() { return shutting_down_ || !queue_.empty(); });
+    if (shutting_down_) {
+      return;
+    }
+    std::string fname = std::move(queue_.front());
+    queue_.pop_front();
+    queued_.erase(fname);
+    active_.insert(fname);
+    lk.unlock();
+    Status st = fetch_(fname);
+    if (!st.ok()) {
+      Log(InfoLogLevel::WARN_LEVEL, info_log_,
+          "[prefetcher] Prefetch of %s failed: %s", fname.c_str(),
+          st.ToString().c_str());
+    }
+    lk.lock();
+    active_.erase(fname);
+    done_cv_.notify_all();
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
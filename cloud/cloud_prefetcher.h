@@ -0,0 +1,77 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Logger;
+
+//
+// Downloads a list of files from cloud storage on a pool of background
+// threads, in the order in which they were added.
+//
+// A reader that needs one of the files before the prefetcher got to it calls
+// Claim(): a file that is still queued is handed over to the caller, which
+// fetches it itself, and a file that is being downloaded is waited for. This
+// way a file is never fetched twice and the reader never waits behind the
+// rest of the queue.
+//
+// Failed downloads are logged and otherwise ignored; the file is fetched on
+// demand when it is opened.
+//
+class CloudPrefetcher {
+ public:
+  CloudPrefetcher(int num_threads,
+                  std::function<Status(const std::string&)> fetch,
+                  const std::shared_ptr<Logger>& info_log);
+
+  // Drops the files that have not been started yet and waits for the
+  // running downloads to finish.
+  ~CloudPrefetcher();
+
+  // Queues the files for download, in priority order
+  void Add(const std::vector<std::string>& fnames);
+
+  // Removes fname from the queue. If it is being downloaded, waits until
+  // the download has finished.
+  void Claim(const std::string& fname);
+
+  // Blocks until every queued file has been downloaded
+  void WaitForAll();
+
+ private:
+  void WorkerThread();
+
+  std::function<Status(const std::string&)> fetch_;
+  std::shared_ptr<Logger> info_log_;
+
+  std::mutex mutex_;
+  // Signalled when files are queued or the prefetcher is shutting down
+  std::condition_variable work_cv_;
+  // Signalled when a download finishes
+  std::condition_variable done_cv_;
+
+  std::deque<std::string> queue_;
+  // Files in queue_
+  std::set<std::string> queued_;
+  // Files that are being downloaded
+  std::set<std::string> active_;
+  bool shutting_down_;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -2,221 +2,533 @@
 #ifndef ROCKSDB_LITE
 #include "cloud/cloud_scheduler.h"
 
+#include <algorithm>
+#include <cinttypes>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include "rocksdb/env.h"
 
 namespace ROCKSDB_NAMESPACE {
 
+namespace {
+// The wheel has a level for every byte of a 64-bit microsecond tick
+const int kLevelBits = 8;
+const int kSlotsPerLevel = 1 << kLevelBits;
+const int kLevels = 64 / kLevelBits;
+const int kWordsPerLevel = kSlotsPerLevel / 64;
+}  // namespace
+
 struct ScheduledJob {
-  ScheduledJob(long _id, std::chrono::steady_clock::time_point _when,
-               std::chrono::microseconds _frequency,
-               std::function<void(void*)> _callback, void* _arg)
+  enum State { kWaiting, kReady, kRunning };
+
+  ScheduledJob(long _id, uint64_t _when, std::chrono::microseconds _frequency,
+               std::function<void(void*)> _callback, void* _arg,
+               CloudSchedulerJobStats* _stats)
       : id(_id),
         when(_when),
         frequency(_frequency),
         callback(_callback),
-        arg(_arg) {}
+        arg(_arg),
+        stats(_stats) {}
 
   long id;
-  std::chrono::steady_clock::time_point when;
+  // The tick at which the job is due
+  uint64_t when;
   std::chrono::microseconds frequency;
   std::function<void(void*)> callback;
   void* arg;
+  CloudSchedulerJobStats* stats;
+  State state = kWaiting;
+  bool canceled = false;
+  // The slot of the wheel that holds the job while it is waiting, and its
+  // neighbours in the slot
+  int level = 0;
+  int slot = 0;
+  ScheduledJob* prev = nullptr;
+  ScheduledJob* next = nullptr;
 };
 
-struct Comp {
-  bool operator()(const ScheduledJob& a, const ScheduledJob& b) const {
-    return a.when < b.when;
-  }
-};
-
+//
+// Keeps the waiting jobs in a hierarchical timer wheel, so that scheduling
+// and canceling a job take constant time however many jobs are waiting.
+//
+// Ticks are microseconds since the scheduler started. A job is kept at the
+// level of the most significant byte in which its tick differs from the
+// current tick of the wheel, in the slot of that byte of its tick. When the
+// wheel reaches the start of a slot, the jobs in the slot move to lower
+// levels, until they reach the current tick and are handed to the workers.
+// The wheel only stops at the slots that hold jobs, which it finds through a
+// bitmap of the occupied slots of every level.
+//
 class CloudSchedulerImpl : public CloudScheduler {
  public:
-  CloudSchedulerImpl();
+  explicit CloudSchedulerImpl(int num_workers);
   ~CloudSchedulerImpl();
   long ScheduleJob(std::chrono::microseconds when,
-                   std::function<void(void*)> callback, void* arg) override;
+                   std::function<void(void*)> callback, void* arg,
+                   const std::string& job_type) override;
   long ScheduleRecurringJob(std::chrono::microseconds when,
                             std::chrono::microseconds frequency,
-                            std::function<void(void*)> callback,
-                            void* arg) override;
+                            std::function<void(void*)> callback, void* arg,
+                            const std::string& job_type) override;
   bool CancelJob(long handle) override;
+  std::map<std::string, CloudSchedulerJobStats> GetJobStats() override;
+
+  // Grows the pool to num_workers workers
+  void AddWorkers(int num_workers);
 
  private:
-  void DoWork();
+  uint64_t NowTicks() const;
+  long AddJob(std::chrono::microseconds when,
+              std::chrono::microseconds frequency,
+              std::function<void(void*)> callback, void* arg,
+              const std::string& job_type);
+  // Puts the job in its slot, or in the ready queue if it is due
+  void Place(ScheduledJob* job);
+  void Unlink(ScheduledJob* job);
+  void MakeReady(ScheduledJob* job);
+  // Returns false if the wheel is empty. Otherwise returns the tick of the
+  // first slot that holds jobs, with its level and slot.
+  bool NextTick(uint64_t* tick, int* level, int* slot) const;
+  // Moves the wheel to the last slot that starts no later than now
+  void Advance(uint64_t now);
+  void TimerLoop();
+  void WorkerLoop();
+
+  const std::chrono::steady_clock::time_point start_;
   long next_id_;
 
   std::mutex mutex_;
   // Notified when the earliest job to be scheduled has changed.
   std::condition_variable jobs_changed_cv_;
-  std::multiset<ScheduledJob, Comp> scheduled_jobs_;
+  // Notified when a job is ready to run
+  std::condition_variable ready_cv_;
+  uint64_t current_tick_;
+  ScheduledJob* slots_[kLevels][kSlotsPerLevel];
+  uint64_t occupied_[kLevels][kWordsPerLevel];
+  std::unordered_map<long, std::unique_ptr<ScheduledJob>> jobs_;
+  std::deque<ScheduledJob*> ready_;
+  std::map<std::string, CloudSchedulerJobStats> stats_;
   bool shutting_down_{false};
 
   std::unique_ptr<std::thread> thread_;
+  std::vector<std::thread> workers_;
 };
 
 // Implementation of a CloudScheduler that keeps track of the jobs
 // it scheduled.  Only cleans up those jobs on exit or cancel.
+// The callbacks only reference the shared state, so that the destructor can
+// wait for the ones that are running without racing with those that are about
+// to start; no callback runs once the destructor has returned.
 class LocalCloudScheduler : public CloudScheduler {
  public:
   LocalCloudScheduler(const std::shared_ptr<CloudScheduler>& scheduler,
                       long local_id)
-      : scheduler_(scheduler), next_local_id_(local_id) {}
+      : scheduler_(scheduler), state_(std::make_shared<State>()) {
+    state_->next_local_id = local_id;
+  }
   ~LocalCloudScheduler() override {
-    for (const auto job : jobs_) {
+    std::unique_lock<std::mutex> lk(state_->mutex);
+    state_->shutting_down = true;
+    for (const auto& job : state_->jobs) {
       scheduler_->CancelJob(job.second);
     }
-    jobs_.clear();
+    state_->jobs.clear();
+    state_->idle_cv.wait(lk, [this]() { return state_->running == 0; });
   }
 
   long ScheduleJob(std::chrono::microseconds when,
-                   std::function<void(void*)> callback, void* arg) override {
-    std::lock_guard<std::mutex> lk(job_mutex_);
-    long local_id = next_local_id_++;
-    auto job = [this, local_id, callback](void* a) {
-      callback(a);
-      std::lock_guard<std::mutex> cblk(job_mutex_);
-      jobs_.erase(local_id);
-    };
-    jobs_[local_id] = scheduler_->ScheduleJob(when, job, arg);
+                   std::function<void(void*)> callback, void* arg,
+                   const std::string& job_type) override {
+    std::lock_guard<std::mutex> lk(state_->mutex);
+    long local_id = state_->next_local_id++;
+    state_->jobs[local_id] = scheduler_->ScheduleJob(
+        when, Wrap(local_id, std::move(callback), false), arg, job_type);
     return local_id;
   }
 
   long ScheduleRecurringJob(std::chrono::microseconds when,
                             std::chrono::microseconds frequency,
-                            std::function<void(void*)> callback,
-                            void* arg) override {
-    auto job = scheduler_->ScheduleRecurringJob(when, frequency, callback, arg);
-    std::lock_guard<std::mutex> lk(job_mutex_);
-    long local_id = next_local_id_++;
-    jobs_[local_id] = job;
+                            std::function<void(void*)> callback, void* arg,
+                            const std::string& job_type) override {
+    std::lock_guard<std::mutex> lk(state_->mutex);
+    long local_id = state_->next_local_id++;
+    state_->jobs[local_id] = scheduler_->ScheduleRecurringJob(
+        when, frequency, Wrap(local_id, std::move(callback), true), arg,
+        job_type);
     return local_id;
   }
   // Cancels the job referred to by handle if it is active and associated with
   // this scheduler
   bool CancelJob(long handle) override {
-    std::lock_guard<std::mutex> lk(job_mutex_);
-    const auto& it = jobs_.find(handle);
-    if (it != jobs_.end()) {
-      jobs_.erase(it);
-      return scheduler_->CancelJob(it->second);
+    std::lock_guard<std::mutex> lk(state_->mutex);
+    const auto& it = state_->jobs.find(handle);
+    if (it != state_->jobs.end()) {
+      long job = it->second;
+      state_->jobs.erase(it);
+      return scheduler_->CancelJob(job);
     } else {
       return false;
     }
   }
 
+  // The statistics are those of all the schedulers that share the timer
+  std::map<std::string, CloudSchedulerJobStats> GetJobStats() override {
+    return scheduler_->GetJobStats();
+  }
+
  private:
-  std::mutex job_mutex_;
+  struct State {
+    std::mutex mutex;
+    // Notified when no callback is running
+    std::condition_variable idle_cv;
+    long next_local_id = 0;
+    std::unordered_map<long, long> jobs;
+    int running = 0;
+    bool shutting_down = false;
+  };
+
+  // Returns a callback that only runs the job while it is scheduled
+  std::function<void(void*)> Wrap(long local_id,
+                                  std::function<void(void*)> callback,
+                                  bool recurring) {
+    std::shared_ptr<State> state = state_;
+    return [state, local_id, callback, recurring](void* a) {
+      {
+        std::lock_guard<std::mutex> lk(state->mutex);
+        auto it = state->jobs.find(local_id);
+        if (state->shutting_down || it == state->jobs.end()) {
+          return;
+        }
+        // Like the jobs of the shared scheduler, a job that is running can
+        // no longer be canceled unless it recurs
+        if (!recurring) {
+          state->jobs.erase(it);
+        }
+        state->running++;
+      }
+      callback(a);
+      std::lock_guard<std::mutex> lk(state->mutex);
+      if (--state->running == 0) {
+        state->idle_cv.notify_all();
+      }
+    };
+  }
+
   std::shared_ptr<CloudScheduler> scheduler_;
-  long next_local_id_;
-  std::unordered_map<long, long> jobs_;
+  std::shared_ptr<State> state_;
 };
 
-std::shared_ptr<CloudScheduler> CloudScheduler::Get() {
+constexpr int CloudScheduler::kDefaultNumWorkers;
+
+void CloudScheduler::LogJobStats(Logger* info_log) {
+  for (const auto& it : GetJobStats()) {
+    const CloudSchedulerJobStats& stats = it.second;
+    Log(InfoLogLevel::INFO_LEVEL, info_log,
+        "[scheduler] %s: scheduled %" PRIu64 " run %" PRIu64
+        " canceled %" PRIu64 " waiting %" PRIu64 " ready %" PRIu64
+        " (max %" PRIu64 "), start delay total %" PRIu64 " max %" PRIu64
+        " micros, run total %" PRIu64 " max %" PRIu64 " micros",
+        it.first.c_str(), stats.num_scheduled, stats.num_run,
+        stats.num_canceled, stats.num_waiting, stats.num_ready,
+        stats.max_ready, stats.total_start_delay_micros,
+        stats.max_start_delay_micros, stats.total_run_micros,
+        stats.max_run_micros);
+  }
+}
+
+std::shared_ptr<CloudScheduler> CloudScheduler::Get(int num_workers) {
   static std::shared_ptr<CloudSchedulerImpl> scheduler =
-      std::make_shared<CloudSchedulerImpl>();
+      std::make_shared<CloudSchedulerImpl>(kDefaultNumWorkers);
   static long local_scheduler_id = 0;
 
+  scheduler->AddWorkers(num_workers);
   std::shared_ptr<CloudScheduler> result =
       std::make_shared<LocalCloudScheduler>(scheduler, local_scheduler_id);
   local_scheduler_id += 10000;
   return result;
 }
 
-CloudSchedulerImpl::CloudSchedulerImpl() {
+std::shared_ptr<CloudScheduler> CloudScheduler::New(int num_workers) {
+  return std::make_shared<CloudSchedulerImpl>(num_workers);
+}
+
+CloudSchedulerImpl::CloudSchedulerImpl(int num_workers)
+    : start_(std::chrono::steady_clock::now()), current_tick_(0) {
   next_id_ = 1;
-  auto lambda = [this]() { DoWork(); };
+  for (int l = 0; l < kLevels; l++) {
+    std::fill(slots_[l], slots_[l] + kSlotsPerLevel, nullptr);
+    std::fill(occupied_[l], occupied_[l] + kWordsPerLevel, 0);
+  }
+  auto lambda = [this]() { TimerLoop(); };
   thread_.reset(new std::thread(lambda));
+  AddWorkers(std::max(num_workers, 1));
+}
+
+void CloudSchedulerImpl::AddWorkers(int num_workers) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  while (workers_.size() < static_cast<size_t>(std::max(num_workers, 0)) &&
+         !shutting_down_) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
 }
 
 CloudSchedulerImpl::~CloudSchedulerImpl() {
   {
     std::lock_guard<std::mutex> lk(mutex_);
     shutting_down_ = true;
-    scheduled_jobs_.clear();
     jobs_changed_cv_.notify_all();
+    ready_cv_.notify_all();
   }
   if (thread_ && thread_->joinable()) {
     thread_->join();
   }
   thread_.reset();
+  for (auto& w : workers_) {
+    w.join();
+  }
+  workers_.clear();
+  ready_.clear();
+  jobs_.clear();
+}
+
+uint64_t CloudSchedulerImpl::NowTicks() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start_)
+      .count();
 }
 
 long CloudSchedulerImpl::ScheduleJob(std::chrono::microseconds when,
                                      std::function<void(void*)> callback,
-                                     void* arg) {
-  std::lock_guard<std::mutex> lk(mutex_);
-  long id = next_id_++;
-
-  auto time = std::chrono::steady_clock::now() + when;
-  auto itr = scheduled_jobs_.emplace(id, time, std::chrono::microseconds(0),
-                                     callback, arg);
-
-  if (itr == scheduled_jobs_.begin()) {
-    jobs_changed_cv_.notify_all();
-  }
-  return id;
+                                     void* arg, const std::string& job_type) {
+  return AddJob(when, std::chrono::microseconds(0), std::move(callback), arg,
+                job_type);
 }
 
 long CloudSchedulerImpl::ScheduleRecurringJob(
     std::chrono::microseconds when, std::chrono::microseconds frequency,
-    std::function<void(void*)> callback, void* arg) {
+    std::function<void(void*)> callback, void* arg,
+    const std::string& job_type) {
+  return AddJob(when, frequency, std::move(callback), arg, job_type);
+}
+
+long CloudSchedulerImpl::AddJob(std::chrono::microseconds when,
+                                std::chrono::microseconds frequency,
+                                std::function<void(void*)> callback, void* arg,
+                                const std::string& job_type) {
+  const uint64_t tick =
+      NowTicks() + static_cast<uint64_t>(std::max<int64_t>(when.count(), 0));
   std::lock_guard<std::mutex> lk(mutex_);
   long id = next_id_++;
+  CloudSchedulerJobStats* stats = &stats_[job_type];
+  stats->num_scheduled++;
+  ScheduledJob* job = new ScheduledJob(id, tick, frequency,
+                                       std::move(callback), arg, stats);
+  jobs_[id].reset(job);
 
-  auto time = std::chrono::steady_clock::now() + when;
-  auto itr = scheduled_jobs_.emplace(id, time, frequency, callback, arg);
-  if (itr == scheduled_jobs_.begin()) {
-    jobs_changed_cv_.notify_all();
+  uint64_t first = 0;
+  int level, slot;
+  const bool had_jobs = NextTick(&first, &level, &slot);
+  Place(job);
+  if (job->state == ScheduledJob::kWaiting) {
+    stats->num_waiting++;
+    if (!had_jobs || tick < first) {
+      jobs_changed_cv_.notify_all();
+    }
   }
   return id;
 }
 
 bool CloudSchedulerImpl::CancelJob(long id) {
   std::lock_guard<std::mutex> lk(mutex_);
-  for (auto it = scheduled_jobs_.begin(); it != scheduled_jobs_.end(); ++it) {
-    if (it->id == id) {
-      bool is_first = (it == scheduled_jobs_.begin());
-      scheduled_jobs_.erase(it);
-      if (is_first) {
-        jobs_changed_cv_.notify_all();
-      }
+  auto it = jobs_.find(id);
+  if (it == jobs_.end() || it->second->canceled) {
+    return false;
+  }
+  ScheduledJob* job = it->second.get();
+  switch (job->state) {
+    case ScheduledJob::kWaiting:
+      // The timer wakes up for nothing if this was the first job, which is
+      // cheaper than finding the next one
+      Unlink(job);
+      job->stats->num_waiting--;
+      job->stats->num_canceled++;
+      jobs_.erase(it);
       return true;
+    case ScheduledJob::kReady:
+      // The worker drops it
+      job->canceled = true;
+      job->stats->num_canceled++;
+      return true;
+    case ScheduledJob::kRunning:
+      // A running recurring job is not run again
+      if (job->frequency.count() > 0) {
+        job->canceled = true;
+        job->stats->num_canceled++;
+        return true;
+      }
+      return false;
+  }
+  return false;
+}
+
+std::map<std::string, CloudSchedulerJobStats>
+CloudSchedulerImpl::GetJobStats() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return stats_;
+}
+
+void CloudSchedulerImpl::Place(ScheduledJob* job) {
+  if (job->when <= current_tick_) {
+    MakeReady(job);
+    return;
+  }
+  const uint64_t diff = job->when ^ current_tick_;
+  const int level = (63 - __builtin_clzll(diff)) / kLevelBits;
+  const int slot = static_cast<int>((job->when >> (level * kLevelBits)) &
+                                    (kSlotsPerLevel - 1));
+  job->state = ScheduledJob::kWaiting;
+  job->level = level;
+  job->slot = slot;
+  job->prev = nullptr;
+  job->next = slots_[level][slot];
+  if (job->next != nullptr) {
+    job->next->prev = job;
+  }
+  slots_[level][slot] = job;
+  occupied_[level][slot / 64] |= uint64_t{1} << (slot % 64);
+}
+
+void CloudSchedulerImpl::Unlink(ScheduledJob* job) {
+  if (job->prev != nullptr) {
+    job->prev->next = job->next;
+  } else {
+    slots_[job->level][job->slot] = job->next;
+    if (job->next == nullptr) {
+      occupied_[job->level][job->slot / 64] &=
+          ~(uint64_t{1} << (job->slot % 64));
+    }
+  }
+  if (job->next != nullptr) {
+    job->next->prev = job->prev;
+  }
+  job->prev = job->next = nullptr;
+}
+
+void CloudSchedulerImpl::MakeReady(ScheduledJob* job) {
+  job->state = ScheduledJob::kReady;
+  ready_.push_back(job);
+  job->stats->num_ready++;
+  job->stats->max_ready =
+      std::max(job->stats->max_ready, job->stats->num_ready);
+  ready_cv_.notify_one();
+}
+
+bool CloudSchedulerImpl::NextTick(uint64_t* tick, int* level,
+                                  int* slot) const {
+  // A job at a lower level is due before any job at a higher one
+  for (int l = 0; l < kLevels; l++) {
+    for (int w = 0; w < kWordsPerLevel; w++) {
+      if (occupied_[l][w] != 0) {
+        const int s = w * 64 + __builtin_ctzll(occupied_[l][w]);
+        const int shift = (l + 1) * kLevelBits;
+        const uint64_t high =
+            shift >= 64 ? 0 : (current_tick_ >> shift) << shift;
+        *tick = high | (static_cast<uint64_t>(s) << (l * kLevelBits));
+        *level = l;
+        *slot = s;
+        return true;
+      }
     }
   }
   return false;
 }
 
-void CloudSchedulerImpl::DoWork() {
+void CloudSchedulerImpl::Advance(uint64_t now) {
+  uint64_t tick;
+  int level, slot;
+  while (NextTick(&tick, &level, &slot) && tick <= now) {
+    current_tick_ = tick;
+    ScheduledJob* job = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    occupied_[level][slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    while (job != nullptr) {
+      ScheduledJob* next = job->next;
+      Place(job);
+      if (job->state == ScheduledJob::kReady) {
+        job->stats->num_waiting--;
+      }
+      job = next;
+    }
+  }
+}
+
+void CloudSchedulerImpl::TimerLoop() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (!shutting_down_) {
+    Advance(NowTicks());
+    uint64_t tick;
+    int level, slot;
+    if (!NextTick(&tick, &level, &slot)) {
+      jobs_changed_cv_.wait(lk);
+    } else {
+      jobs_changed_cv_.wait_until(lk,
+                                  start_ + std::chrono::microseconds(tick));
+    }
+  }
+}
+
+void CloudSchedulerImpl::WorkerLoop() {
+  std::unique_lock<std::mutex> lk(mutex_);
   while (true) {
-    std::unique_lock<std::mutex> lk(mutex_);
+    ready_cv_.wait(lk, [this]() { return shutting_down_ || !ready_.empty(); });
     if (shutting_down_) {
       break;
     }
-    if (scheduled_jobs_.empty()) {
-      jobs_changed_cv_.wait(lk);
-      continue;
-    }
-    auto earliest_job = scheduled_jobs_.begin();
-    auto earliest_job_time = earliest_job->when;
-    if (earliest_job_time >= std::chrono::steady_clock::now()) {
-      jobs_changed_cv_.wait_until(lk, earliest_job_time);
+    ScheduledJob* job = ready_.front();
+    ready_.pop_front();
+    CloudSchedulerJobStats* stats = job->stats;
+    stats->num_ready--;
+    if (job->canceled) {
+      jobs_.erase(job->id);
       continue;
     }
+    job->state = ScheduledJob::kRunning;
+    const uint64_t start = NowTicks();
+    const uint64_t delay = start > job->when ? start - job->when : 0;
+    stats->total_start_delay_micros += delay;
+    stats->max_start_delay_micros =
+        std::max(stats->max_start_delay_micros, delay);
+
     // invoke the function
     lk.unlock();
-
-    earliest_job->callback(earliest_job->arg);
-
+    job->callback(job->arg);
+    const uint64_t end = NowTicks();
     lk.lock();
-    if (earliest_job->frequency.count() > 0) {
-      ScheduledJob new_job = *earliest_job;
-      new_job.when = std::chrono::steady_clock::now() + new_job.frequency;
-      scheduled_jobs_.emplace(new_job);
+
+    stats->num_run++;
+    stats->total_run_micros += end - start;
+    stats->max_run_micros = std::max(stats->max_run_micros, end - start);
+    if (job->frequency.count() > 0 && !job->canceled && !shutting_down_) {
+      job->when = end + job->frequency.count();
+      uint64_t first = 0;
+      int level, slot;
+      const bool had_jobs = NextTick(&first, &level, &slot);
+      Place(job);
+      if (job->state == ScheduledJob::kWaiting) {
+        stats->num_waiting++;
+        if (!had_jobs || job->when < first) {
+          jobs_changed_cv_.notify_all();
+        }
+      }
+    } else {
+      jobs_.erase(job->id);
     }
-    scheduled_jobs_.erase(earliest_job);
   }
 }
 }  // namespace ROCKSDB_NAMESPACE
@@ -2,9 +2,12 @@
 
 #pragma once
 #include <chrono>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <utility>
 
 #include "rocksdb/rocksdb_namespace.h"
@@ -12,16 +15,41 @@
 
 namespace ROCKSDB_NAMESPACE {
 #ifndef ROCKSDB_LITE
+class Logger;
+
+// The statistics of the jobs of one type
+struct CloudSchedulerJobStats {
+  uint64_t num_scheduled = 0;
+  uint64_t num_run = 0;
+  uint64_t num_canceled = 0;
+  // The jobs that are waiting for their time, and the ones that are due but
+  // waiting for a worker
+  uint64_t num_waiting = 0;
+  uint64_t num_ready = 0;
+  uint64_t max_ready = 0;
+  // The time between a job becoming due and a worker starting it
+  uint64_t total_start_delay_micros = 0;
+  uint64_t max_start_delay_micros = 0;
+  // The time that the callbacks took
+  uint64_t total_run_micros = 0;
+  uint64_t max_run_micros = 0;
+};
+
 // Class for scheduling jobs to run on a separate thread
 class CloudScheduler {
  public:
+  // The workers of the scheduler returned by Get(), unless more are asked for
+  static constexpr int kDefaultNumWorkers = 4;
+
   virtual ~CloudScheduler() {}
 
   // Schedules a job to run after "when" microseconds have elapsed,
   // invoking the specified callback with the specified arg
-  // Returns a handle to the scheduled job so that it may be canceled
+  // Returns a handle to the scheduled job so that it may be canceled.
+  // The statistics of the job are kept under job_type.
   virtual long ScheduleJob(std::chrono::microseconds when,
-                           std::function<void(void *)> callback, void *arg) = 0;
+                           std::function<void(void *)> callback, void *arg,
+                           const std::string &job_type = "default") = 0;
 
   // Schedules a job to run after "when" microseconds have elapsed,
   // invoking the specified callback with the specified arg
@@ -31,15 +59,30 @@ class CloudScheduler {
   virtual long ScheduleRecurringJob(std::chrono::microseconds when,
                                     std::chrono::microseconds frequency,
                                     std::function<void(void *)> callback,
-                                    void *arg) = 0;
+                                    void *arg,
+                                    const std::string &job_type =
+                                        "default") = 0;
 
   // Cancels the job represented by handle.  Returns true if the job
   // was canceled, false otherwise.
   virtual bool CancelJob(long handle) = 0;
 
+  // Returns the statistics of the jobs of the scheduler, by job type
+  virtual std::map<std::string, CloudSchedulerJobStats> GetJobStats() = 0;
+
+  // Writes the statistics of GetJobStats() to the info log
+  void LogJobStats(Logger* info_log);
+
   // Returns a new instance of a cloud scheduler.  The caller is responsible
   // for freeing the scheduler when it is no longer required.
-  static std::shared_ptr<CloudScheduler> Get();
+  // The instances share a single timer and a pool of workers, which grows to
+  // the largest num_workers that any caller asked for.
+  static std::shared_ptr<CloudScheduler> Get(
+      int num_workers = kDefaultNumWorkers);
+
+  // Returns a scheduler with its own timer and num_workers workers, so that
+  // its jobs cannot be delayed by the jobs of other schedulers
+  static std::shared_ptr<CloudScheduler> New(int num_workers);
 };
 #endif  // ROCKSDB_LITE
 }  // namespace ROCKSDB_NAMESPACE
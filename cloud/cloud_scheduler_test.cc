@@ -2,118 +2,281 @@
 
 #include "cloud/cloud_scheduler.h"
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include "test_util/testharness.h"
 
 namespace ROCKSDB_NAMESPACE {
 
+// Records the runs of jobs, so that the tests wait for the runs that they
+// expect instead of sleeping for a fixed time
+class JobRecorder {
+ public:
+  std::function<void(void *)> Job(int id) {
+    return [this, id](void *) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      runs_.push_back(id);
+      counts_[id]++;
+      cv_.notify_all();
+    };
+  }
+
+  int Count(int id) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return counts_[id];
+  }
+
+  std::vector<int> Runs() {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return runs_;
+  }
+
+  // Returns false if job id has not run n times within the timeout
+  bool WaitFor(int id, int n) {
+    std::unique_lock<std::mutex> lk(mutex_);
+    return cv_.wait_for(lk, std::chrono::seconds(10),
+                        [this, id, n]() { return counts_[id] >= n; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<int> runs_;
+  std::map<int, int> counts_;
+};
+
+// Returns false if cond does not hold within the timeout
+bool WaitUntil(const std::function<bool()> &cond) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!cond()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return true;
+}
+
 class CloudSchedulerTest : public testing::Test {
  public:
   CloudSchedulerTest() { scheduler_ = CloudScheduler::Get(); }
   ~CloudSchedulerTest() {}
 
+  // Declared first, so that the jobs of scheduler_ are done with it before
+  // it goes away
+  JobRecorder recorder_;
   std::shared_ptr<CloudScheduler> scheduler_;
 };
 
 TEST_F(CloudSchedulerTest, TestSchedule) {
-  static int job1 = 1;
-  static int job2 = 1;
-  auto doJob = [](void *arg) { (*(reinterpret_cast<int *>(arg)))++; };
-
-  scheduler_->ScheduleJob(std::chrono::microseconds(100), doJob, &job1);
-  scheduler_->ScheduleJob(std::chrono::microseconds(300), doJob, &job2);
-
-  usleep(200);
-  ASSERT_EQ(job2, 1);
-  ASSERT_EQ(job1, 2);
-  usleep(200);
-  ASSERT_EQ(job2, 2);
-  ASSERT_EQ(job1, 2);
-
-  scheduler_->ScheduleJob(std::chrono::microseconds(300), doJob, &job1);
-  scheduler_->ScheduleJob(std::chrono::microseconds(100), doJob, &job2);
-  usleep(200);
-  ASSERT_EQ(job1, 2);
-  ASSERT_EQ(job2, 3);
-  usleep(200);
-  ASSERT_EQ(job1, 3);
-  ASSERT_EQ(job2, 3);
+  scheduler_->ScheduleJob(std::chrono::microseconds(100), recorder_.Job(1),
+                          nullptr);
+  scheduler_->ScheduleJob(std::chrono::microseconds(50000), recorder_.Job(2),
+                          nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(2, 1));
+  ASSERT_EQ(recorder_.Runs(), std::vector<int>({1, 2}));
+
+  scheduler_->ScheduleJob(std::chrono::microseconds(50000), recorder_.Job(1),
+                          nullptr);
+  scheduler_->ScheduleJob(std::chrono::microseconds(100), recorder_.Job(2),
+                          nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(1, 2));
+  ASSERT_EQ(recorder_.Runs(), std::vector<int>({1, 2, 2, 1}));
 }
 
 TEST_F(CloudSchedulerTest, TestCancel) {
-  static int job1 = 1;
-  static int job2 = 0;
-  auto doJob = [](void *arg) { (*(reinterpret_cast<int *>(arg)))++; };
-
-  auto handle1 =
-      scheduler_->ScheduleJob(std::chrono::microseconds(100), doJob, &job1);
-  auto handle2 =
-      scheduler_->ScheduleJob(std::chrono::microseconds(200), doJob, &job2);
+  auto handle1 = scheduler_->ScheduleJob(std::chrono::microseconds(100),
+                                         recorder_.Job(1), nullptr);
+  auto handle2 = scheduler_->ScheduleJob(std::chrono::microseconds(200),
+                                         recorder_.Job(2), nullptr);
   ASSERT_TRUE(scheduler_->CancelJob(handle2));
-  usleep(300);
-  ASSERT_EQ(job1, 2);
-  ASSERT_EQ(job2, 0);
+  // Runs after the canceled job would have
+  scheduler_->ScheduleJob(std::chrono::microseconds(300), recorder_.Job(3),
+                          nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(3, 1));
+  ASSERT_EQ(recorder_.Runs(), std::vector<int>({1, 3}));
   ASSERT_FALSE(scheduler_->CancelJob(handle1));
   ASSERT_FALSE(scheduler_->CancelJob(handle2));
 }
 
 TEST_F(CloudSchedulerTest, TestRecurring) {
-  int job1 = 1;
-  int job2 = 1;
-  auto doJob1 = [&job1](void *) { job1++; };
-  auto doJob2 = [&job2](void *) { job2++; };
-
-  auto handle1 = scheduler_->ScheduleRecurringJob(std::chrono::microseconds(10),
-                                                  std::chrono::microseconds(50),
-                                                  doJob1, nullptr);
-  scheduler_->ScheduleRecurringJob(std::chrono::microseconds(120),
-                                   std::chrono::microseconds(100), doJob2,
-                                   nullptr);
-  usleep(700);
-  ASSERT_GE(job2, 4);
-  ASSERT_GT(job1, job2);
+  auto handle1 = scheduler_->ScheduleRecurringJob(
+      std::chrono::microseconds(10), std::chrono::microseconds(1000),
+      recorder_.Job(1), nullptr);
+  scheduler_->ScheduleRecurringJob(std::chrono::microseconds(1200),
+                                   std::chrono::microseconds(20000),
+                                   recorder_.Job(2), nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(2, 4));
+  ASSERT_GT(recorder_.Count(1), recorder_.Count(2));
   ASSERT_TRUE(scheduler_->CancelJob(handle1));
-  auto old1 = job1;
-  auto old2 = job2;
-  usleep(200);
-  ASSERT_EQ(job1, old1);
-  ASSERT_GT(job2, old2);
+  // A run that had started when the job was canceled may still finish
+  ASSERT_TRUE(recorder_.WaitFor(2, 5));
+  auto old1 = recorder_.Count(1);
+  ASSERT_TRUE(recorder_.WaitFor(2, 7));
+  ASSERT_EQ(recorder_.Count(1), old1);
 }
 
 TEST_F(CloudSchedulerTest, TestMultipleSchedulers) {
   auto scheduler2 = CloudScheduler::Get();
 
-  int job1 = 1;
-  int job2 = 1;
-  auto doJob1 = [&job1](void *) { job1++; };
-  auto doJob2 = [&job2](void *) { job2++; };
-
-  auto handle1 =
-      scheduler_->ScheduleJob(std::chrono::microseconds(120), doJob1, nullptr);
-  auto handle2 =
-      scheduler2->ScheduleJob(std::chrono::microseconds(120), doJob2, nullptr);
+  auto handle1 = scheduler_->ScheduleJob(std::chrono::microseconds(120),
+                                         recorder_.Job(1), nullptr);
+  auto handle2 = scheduler2->ScheduleJob(std::chrono::microseconds(120),
+                                         recorder_.Job(2), nullptr);
   ASSERT_FALSE(scheduler_->CancelJob(handle2));
   ASSERT_FALSE(scheduler2->CancelJob(handle1));
   ASSERT_TRUE(scheduler2->CancelJob(handle2));
   ASSERT_FALSE(scheduler2->CancelJob(handle2));
-  usleep(200);
-  ASSERT_EQ(job1, 2);
-  ASSERT_EQ(job2, 1);
+  ASSERT_TRUE(recorder_.WaitFor(1, 1));
+  ASSERT_EQ(recorder_.Count(2), 0);
 
   scheduler_->ScheduleRecurringJob(std::chrono::microseconds(40),
-                                   std::chrono::microseconds(20), doJob1,
-                                   nullptr);
+                                   std::chrono::microseconds(20),
+                                   recorder_.Job(1), nullptr);
   scheduler2->ScheduleRecurringJob(std::chrono::microseconds(50),
-                                   std::chrono::microseconds(20), doJob2,
-                                   nullptr);
+                                   std::chrono::microseconds(20),
+                                   recorder_.Job(2), nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(2, 1));
+  // Waits for the jobs of scheduler2 that are running
   scheduler2.reset();
-  auto old1 = job1;
-  auto old2 = job2;
-  usleep(200);
-  ASSERT_EQ(job2, old2);
-  ASSERT_GT(job1, old1);
+  auto old1 = recorder_.Count(1);
+  auto old2 = recorder_.Count(2);
+  ASSERT_TRUE(recorder_.WaitFor(1, old1 + 10));
+  ASSERT_EQ(recorder_.Count(2), old2);
+}
+
+TEST_F(CloudSchedulerTest, TestDestroyWhileRunning) {
+  auto scheduler = CloudScheduler::Get();
+  std::atomic<bool> release(false);
+  std::atomic<bool> done(false);
+  scheduler->ScheduleJob(
+      std::chrono::microseconds(0),
+      [&](void *) {
+        recorder_.Job(1)(nullptr);
+        while (!release.load()) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        done = true;
+      },
+      nullptr);
+  scheduler->ScheduleRecurringJob(std::chrono::microseconds(0),
+                                  std::chrono::microseconds(10),
+                                  recorder_.Job(2), nullptr);
+  ASSERT_TRUE(recorder_.WaitFor(1, 1));
+  ASSERT_TRUE(recorder_.WaitFor(2, 1));
+  std::thread releaser([&release]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    release = true;
+  });
+  // Waits for the job that is running, and no job runs afterwards
+  scheduler.reset();
+  ASSERT_TRUE(done.load());
+  auto old2 = recorder_.Count(2);
+  releaser.join();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  ASSERT_EQ(recorder_.Count(2), old2);
+}
+
+TEST_F(CloudSchedulerTest, TestManyJobs) {
+  auto scheduler = CloudScheduler::New(4);
+  const int kNumJobs = 10000;
+  std::atomic<int> runs(0);
+  auto doJob = [&runs](void *) { runs++; };
+
+  std::vector<long> handles;
+  for (int i = 0; i < kNumJobs; i++) {
+    // Spread the jobs over several levels of the timer wheel
+    handles.push_back(scheduler->ScheduleJob(
+        std::chrono::microseconds(1000000 + (i * 7919) % 100000), doJob,
+        nullptr, "many"));
+  }
+  int canceled = 0;
+  for (int i = 0; i < kNumJobs; i += 2) {
+    if (scheduler->CancelJob(handles[i])) {
+      canceled++;
+    }
+  }
+  ASSERT_EQ(canceled, kNumJobs / 2);
+  // The statistics of a run are updated once its callback has returned
+  ASSERT_TRUE(WaitUntil([&]() {
+    return scheduler->GetJobStats()["many"].num_run ==
+           static_cast<uint64_t>(kNumJobs - canceled);
+  }));
+  ASSERT_EQ(runs.load(), kNumJobs - canceled);
+
+  auto stats = scheduler->GetJobStats();
+  ASSERT_EQ(stats.size(), 1u);
+  const auto &many = stats["many"];
+  ASSERT_EQ(many.num_scheduled, static_cast<uint64_t>(kNumJobs));
+  ASSERT_EQ(many.num_canceled, static_cast<uint64_t>(canceled));
+  ASSERT_EQ(many.num_run, static_cast<uint64_t>(kNumJobs - canceled));
+  ASSERT_EQ(many.num_waiting, 0u);
+  ASSERT_EQ(many.num_ready, 0u);
+}
+
+TEST_F(CloudSchedulerTest, TestSlowJob) {
+  auto scheduler = CloudScheduler::New(2);
+  std::atomic<bool> release(false);
+  scheduler->ScheduleJob(
+      std::chrono::microseconds(0),
+      [&release](void *) {
+        while (!release.load()) {
+          usleep(100);
+        }
+      },
+      nullptr, "slow");
+  for (int i = 0; i < 10; i++) {
+    scheduler->ScheduleJob(std::chrono::microseconds(100 * i),
+                           recorder_.Job(1), nullptr, "fast");
+  }
+  // The other worker runs the fast jobs while the slow one blocks
+  ASSERT_TRUE(recorder_.WaitFor(1, 10));
+  ASSERT_TRUE(WaitUntil(
+      [&]() { return scheduler->GetJobStats()["fast"].num_run == 10u; }));
+  ASSERT_EQ(scheduler->GetJobStats()["slow"].num_run, 0u);
+  // Keeps the slow job running for a while before it is released
+  usleep(100000);
+  release = true;
+  ASSERT_TRUE(WaitUntil(
+      [&]() { return scheduler->GetJobStats()["slow"].num_run == 1u; }));
+  ASSERT_GE(scheduler->GetJobStats()["slow"].max_run_micros, 100000u);
+}
+
+TEST_F(CloudSchedulerTest, TestGrowSharedPool) {
+  const int kWorkers = CloudScheduler::kDefaultNumWorkers + 2;
+  auto scheduler = CloudScheduler::Get(kWorkers);
+  std::atomic<bool> release(false);
+  std::atomic<int> blocked(0);
+  // Blocks more workers than the default pool has
+  for (int i = 0; i < kWorkers - 1; i++) {
+    scheduler->ScheduleJob(
+        std::chrono::microseconds(0),
+        [&release, &blocked](void *) {
+          blocked++;
+          while (!release.load()) {
+            usleep(100);
+          }
+        },
+        nullptr, "blocking");
+  }
+  ASSERT_TRUE(WaitUntil([&]() { return blocked.load() == kWorkers - 1; }));
+  scheduler->ScheduleJob(std::chrono::microseconds(0), recorder_.Job(1),
+                         nullptr, "fast");
+  ASSERT_TRUE(recorder_.WaitFor(1, 1));
+  release = true;
+  ASSERT_TRUE(WaitUntil([&]() {
+    return scheduler->GetJobStats()["blocking"].num_run ==
+           static_cast<uint64_t>(kWorkers - 1);
+  }));
 }
 
 }  //  namespace ROCKSDB_NAMESPACE
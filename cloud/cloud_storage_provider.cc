@@ -3,19 +3,26 @@
 
 #include "rocksdb/cloud/cloud_storage_provider.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <set>
 
 #include "cloud/cloud_env_impl.h"
 #include "cloud/cloud_storage_provider_impl.h"
 #include "cloud/filename.h"
+#include "cloud/manifest_reader.h"
+#include "env/composite_env_wrapper.h"
+#include "file/file_util.h"
 #include "file/filename.h"
 #include "rocksdb/cloud/cloud_env_options.h"
 #include "rocksdb/env.h"
 #include "rocksdb/options.h"
 #include "rocksdb/status.h"
 #include "util/coding.h"
+#include "util/crc32c.h"
 #include "util/stderr_logger.h"
 #include "util/string_util.h"
 
@@ -29,7 +36,9 @@ CloudStorageReadableFileImpl::CloudStorageReadableFileImpl(
       bucket_(bucket),
       fname_(fname),
       offset_(0),
-      file_size_(file_size) {
+      file_size_(file_size),
+      min_readahead_(0),
+      max_readahead_(0) {
   Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
       "[%s] CloudReadableFile opening file %s", Name(), fname_.c_str());
 }
@@ -75,18 +84,227 @@ Status CloudStorageReadableFileImpl::Read(uint64_t offset, size_t n,
         " trimmed size %ld",
         Name(), fname_.c_str(), offset, n);
   }
-  uint64_t bytes_read;
-  Status st = DoCloudRead(offset, n, scratch, &bytes_read);
+  uint64_t bytes_read = 0;
+  size_t readahead = 0;
+  {
+    std::lock_guard<std::mutex> lk(readahead_mutex_);
+    const bool found = FindStreamLocked(offset);
+    ReadaheadStream& stream = streams_.front();
+    // Serve what we can from the data that was read ahead
+    const uint64_t buffered_end = stream.buffer_offset + stream.buffer.size();
+    if (offset >= stream.buffer_offset && offset < buffered_end) {
+      bytes_read = std::min<uint64_t>(n, buffered_end - offset);
+      memcpy(scratch, stream.buffer.data() + (offset - stream.buffer_offset),
+             static_cast<size_t>(bytes_read));
+    }
+    const bool sequential =
+        bytes_read > 0 || (found && offset == stream.next_offset);
+    stream.next_offset = offset + n;
+    if (bytes_read < n) {
+      // The buffer is read past, drop it before reading the next one
+      std::string().swap(stream.buffer);
+      if (!sequential || max_readahead_ == 0) {
+        stream.readahead_size = 0;
+      } else if (stream.readahead_size == 0) {
+        stream.readahead_size = std::min(min_readahead_, max_readahead_);
+      } else {
+        stream.readahead_size =
+            std::min(stream.readahead_size * 2, max_readahead_);
+      }
+      // The buffers of all the readers of the file stay within
+      // max_readahead_ together
+      const size_t buffered = BufferedLocked();
+      readahead = std::min(stream.readahead_size,
+                           max_readahead_ - std::min(buffered, max_readahead_));
+    }
+  }
+
+  Status st;
+  const uint64_t remaining_offset = offset + bytes_read;
+  const size_t remaining = n - static_cast<size_t>(bytes_read);
+  if (remaining > 0 && readahead <= remaining) {
+    uint64_t r = 0;
+    st = ReadRange(remaining_offset, remaining, scratch + bytes_read, &r);
+    bytes_read += r;
+  } else if (remaining > 0) {
+    // Read ahead, and keep what the caller did not ask for
+    std::string buffer(static_cast<size_t>(std::min<uint64_t>(
+                           readahead, file_size_ - remaining_offset)),
+                       '\0');
+    uint64_t r = 0;
+    st = ReadRange(remaining_offset, buffer.size(), &buffer[0], &r);
+    if (st.ok()) {
+      buffer.resize(static_cast<size_t>(r));
+      const size_t k = std::min<size_t>(remaining, buffer.size());
+      memcpy(scratch + bytes_read, buffer.data(), k);
+      bytes_read += k;
+      std::lock_guard<std::mutex> lk(readahead_mutex_);
+      // The reader may have been dropped meanwhile, find it again by where
+      // its read ends
+      FindStreamLocked(offset + n);
+      ReadaheadStream& stream = streams_.front();
+      stream.buffer.swap(buffer);
+      stream.buffer_offset = remaining_offset;
+      stream.readahead_size = std::max(stream.readahead_size, readahead);
+    }
+  }
   if (st.ok()) {
     *result = Slice(scratch, bytes_read);
     Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
         "[%s] CloudReadableFile file %s filesize %" PRIu64 " read %" PRIu64
-        " bytes",
-        Name(), fname_.c_str(), file_size_, bytes_read);
+        " bytes readahead %" ROCKSDB_PRIszt,
+        Name(), fname_.c_str(), file_size_, bytes_read, readahead);
+  }
+  return st;
+}
+
+Status CloudStorageReadableFileImpl::ReadRange(uint64_t offset, size_t n,
+                                               char* scratch,
+                                               uint64_t* bytes_read) const {
+  *bytes_read = 0;
+  while (*bytes_read < n) {
+    uint64_t r = 0;
+    Status st = DoCloudRead(offset + *bytes_read,
+                            n - static_cast<size_t>(*bytes_read),
+                            scratch + *bytes_read, &r);
+    if (!st.ok()) {
+      return st;
+    }
+    if (r == 0) {
+      break;
+    }
+    *bytes_read += r;
+  }
+  return Status::OK();
+}
+
+Status CloudStorageReadableFileImpl::MultiRead(ReadRequest* reqs,
+                                               size_t num_reqs) {
+  std::vector<size_t> order(num_reqs);
+  for (size_t i = 0; i < num_reqs; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [reqs](size_t a, size_t b) {
+    return reqs[a].offset < reqs[b].offset;
+  });
+
+  size_t i = 0;
+  while (i < num_reqs) {
+    ReadRequest& first = reqs[order[i]];
+    const uint64_t start = first.offset;
+    uint64_t end = start + first.len;
+    size_t j = i + 1;
+    while (max_readahead_ > 0 && j < num_reqs) {
+      const ReadRequest& next = reqs[order[j]];
+      const uint64_t merged_end = std::max(end, next.offset + next.len);
+      if (next.offset > end + min_readahead_ ||
+          merged_end - start > max_readahead_) {
+        break;
+      }
+      end = merged_end;
+      j++;
+    }
+    if (j == i + 1 || start >= file_size_) {
+      for (size_t k = i; k < j; k++) {
+        ReadRequest& req = reqs[order[k]];
+        req.status = Read(req.offset, req.len, &req.result, req.scratch);
+      }
+      i = j;
+      continue;
+    }
+
+    // One cloud request for the whole range; the gaps are read and dropped
+    end = std::min(end, file_size_);
+    std::string buffer(static_cast<size_t>(end - start), '\0');
+    uint64_t bytes_read = 0;
+    Status st = ReadRange(start, buffer.size(), &buffer[0], &bytes_read);
+    Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+        "[%s] CloudReadableFile file %s merged %" ROCKSDB_PRIszt
+        " reads into one of %" PRIu64 " bytes at offset %" PRIu64 ": %s",
+        Name(), fname_.c_str(), j - i, end - start, start,
+        st.ToString().c_str());
+    for (size_t k = i; k < j; k++) {
+      ReadRequest& req = reqs[order[k]];
+      req.status = st;
+      req.result = Slice();
+      if (st.ok() && req.offset < start + bytes_read) {
+        const size_t len = static_cast<size_t>(
+            std::min<uint64_t>(req.len, start + bytes_read - req.offset));
+        memcpy(req.scratch, buffer.data() + (req.offset - start), len);
+        req.result = Slice(req.scratch, len);
+      }
+    }
+    i = j;
+  }
+  return Status::OK();
+}
+
+Status CloudStorageReadableFileImpl::Prefetch(uint64_t offset, size_t n) {
+  if (offset >= file_size_ || n == 0) {
+    return Status::OK();
+  }
+  n = static_cast<size_t>(std::min<uint64_t>(n, file_size_ - offset));
+  {
+    std::lock_guard<std::mutex> lk(readahead_mutex_);
+    for (const auto& stream : streams_) {
+      if (offset >= stream.buffer_offset &&
+          offset + n <= stream.buffer_offset + stream.buffer.size()) {
+        return Status::OK();
+      }
+    }
+  }
+  std::string buffer(n, '\0');
+  uint64_t bytes_read = 0;
+  Status st = ReadRange(offset, n, &buffer[0], &bytes_read);
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[%s] CloudReadableFile file %s prefetched %" PRIu64
+      " bytes at offset %" PRIu64 ": %s",
+      Name(), fname_.c_str(), bytes_read, offset, st.ToString().c_str());
+  if (st.ok()) {
+    buffer.resize(static_cast<size_t>(bytes_read));
+    std::lock_guard<std::mutex> lk(readahead_mutex_);
+    // The reads that follow are served from the buffer, in any order, until
+    // one reads past it or the reader is dropped for others
+    FindStreamLocked(offset);
+    ReadaheadStream& stream = streams_.front();
+    stream.buffer.swap(buffer);
+    stream.buffer_offset = offset;
+    stream.readahead_size = 0;
   }
   return st;
 }
 
+bool CloudStorageReadableFileImpl::FindStreamLocked(uint64_t offset) const {
+  for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+    if (offset == it->next_offset ||
+        (offset >= it->buffer_offset &&
+         offset < it->buffer_offset + it->buffer.size())) {
+      streams_.splice(streams_.begin(), streams_, it);
+      return true;
+    }
+  }
+  if (streams_.size() >= kMaxReadaheadStreams) {
+    streams_.pop_back();
+  }
+  streams_.emplace_front();
+  return false;
+}
+
+size_t CloudStorageReadableFileImpl::BufferedLocked() const {
+  size_t buffered = 0;
+  for (const auto& stream : streams_) {
+    buffered += stream.buffer.size();
+  }
+  return buffered;
+}
+
+void CloudStorageReadableFileImpl::SetReadahead(size_t min_readahead,
+                                                size_t max_readahead) {
+  std::lock_guard<std::mutex> lk(readahead_mutex_);
+  min_readahead_ = min_readahead;
+  max_readahead_ = max_readahead;
+}
+
 Status CloudStorageReadableFileImpl::Skip(uint64_t n) {
   Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
       "[%s] CloudReadableFile file %s skip %" PRIu64, Name(), fname_.c_str(),
@@ -107,7 +325,9 @@ CloudStorageWritableFileImpl::CloudStorageWritableFileImpl(
     : env_(env),
       fname_(local_fname),
       bucket_(bucket),
-      cloud_fname_(cloud_fname) {
+      cloud_fname_(cloud_fname),
+      manifest_uploaded_size_(0),
+      manifest_uploaded_crc_(0) {
   auto fname_no_epoch = RemoveEpoch(fname_);
   // Is this a manifest file?
   is_manifest_ = IsManifestFile(fname_no_epoch);
@@ -151,9 +371,11 @@ CloudStorageWritableFileImpl::~CloudStorageWritableFileImpl() {
   if (local_file_ != nullptr) {
     Close();
   }
+  WaitForManifestCompaction();
 }
 
 Status CloudStorageWritableFileImpl::Close() {
+  WaitForManifestCompaction();
   if (local_file_ == nullptr) {  // already closed
     return status_;
   }
@@ -171,7 +393,24 @@ Status CloudStorageWritableFileImpl::Close() {
   }
   local_file_.reset();
 
-  if (!is_manifest_) {
+  // Hand the file to the background uploader, if there is one, which also
+  // deletes the local copy once it is in cloud storage. The next MANIFEST
+  // sync waits for it.
+  if (is_manifest_) {
+    return Status::OK();
+  }
+  status_ = env_->CopyLocalFileToDestAsync(fname_, cloud_fname_);
+  if (!status_.IsNotSupported()) {
+    if (!status_.ok()) {
+      Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+          "[%s] CloudWritableFile closing failed to queue upload of %s: %s",
+          Name(), fname_.c_str(), status_.ToString().c_str());
+      return status_;
+    }
+    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+        "[%s] CloudWritableFile closed file %s, upload queued", Name(),
+        fname_.c_str());
+  } else {
     status_ = env_->CopyLocalFileToDest(fname_, cloud_fname_);
     if (!status_.ok()) {
       Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
@@ -216,9 +455,19 @@ Status CloudStorageWritableFileImpl::Sync() {
     tmp_file_.clear();
   }
 
+  // The MANIFEST must never reference an sst file that is not in cloud
+  // storage yet, so wait for the background uploads first.
+  if (is_manifest_ && stat.ok()) {
+    stat = env_->WaitForPendingUploads();
+  }
+
   // We copy MANIFEST to cloud on every Sync()
   if (is_manifest_ && stat.ok()) {
-    stat = env_->CopyLocalFileToDest(fname_, cloud_fname_);
+    if (env_->GetCloudEnvOptions().manifest_delta_upload) {
+      stat = UploadManifestDelta();
+    } else {
+      stat = env_->CopyLocalFileToDest(fname_, cloud_fname_);
+    }
     if (stat.ok()) {
       Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
           "[%s] CloudWritableFile made manifest %s durable to "
@@ -235,8 +484,167 @@ Status CloudStorageWritableFileImpl::Sync() {
   return stat;
 }
 
+namespace {
+// Computes the crc32c of the first size bytes of a local file
+Status ComputeFileChecksum(Env* env, const std::string& fname, uint64_t size,
+                           uint32_t* crc) {
+  std::unique_ptr<SequentialFile> file;
+  Status s = env->NewSequentialFile(fname, &file, EnvOptions());
+  const size_t kBufferSize = 1024 * 1024;
+  std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+  *crc = 0;
+  while (s.ok() && size > 0) {
+    Slice chunk;
+    s = file->Read(static_cast<size_t>(std::min<uint64_t>(size, kBufferSize)),
+                   &chunk, buffer.get());
+    if (s.ok() && chunk.empty()) {
+      s = Status::Corruption("File is shorter than expected", fname);
+    }
+    if (s.ok()) {
+      *crc = crc32c::Extend(*crc, chunk.data(), chunk.size());
+      size -= chunk.size();
+    }
+  }
+  return s;
+}
+}  // namespace
+
+Status CloudStorageWritableFileImpl::UploadManifestDelta() {
+  auto provider = env_->GetCloudEnvOptions().storage_provider;
+  Env* local_env = env_->GetBaseEnv();
+  const uint64_t size = local_file_->GetFileSize();
+  if (size == manifest_uploaded_size_) {
+    return Status::OK();
+  }
+  Status st;
+  if (manifest_uploaded_size_ == 0) {
+    // The first sync of a new MANIFEST uploads all of it. The deltas of an
+    // earlier MANIFEST with the same name do not apply to it; readers detect
+    // that by their checksums, but there is no point in keeping them.
+    std::vector<std::string> stale;
+    st = ManifestReader::ListManifestDeltas(env_, bucket_, cloud_fname_,
+                                            &stale);
+    if (st.ok()) {
+      st = env_->CopyLocalFileToDest(fname_, cloud_fname_);
+    }
+    if (st.ok()) {
+      st = ComputeFileChecksum(local_env, fname_, size,
+                               &manifest_uploaded_crc_);
+    }
+    if (!st.ok()) {
+      return st;
+    }
+    for (const auto& d : stale) {
+      provider->DeleteCloudObject(bucket_, d);
+    }
+    manifest_uploaded_size_ = size;
+    return st;
+  }
+
+  // Upload the bytes appended since the previous sync
+  const uint64_t offset = manifest_uploaded_size_;
+  const size_t length = static_cast<size_t>(size - offset);
+  std::string data;
+  ManifestReader::EncodeDeltaHeader(offset, length, manifest_uploaded_crc_,
+                                    &data);
+  {
+    std::unique_ptr<RandomAccessFile> file;
+    st = local_env->NewRandomAccessFile(fname_, &file, EnvOptions());
+    if (!st.ok()) {
+      return st;
+    }
+    std::unique_ptr<char[]> scratch(new char[length]);
+    Slice payload;
+    st = file->Read(offset, length, &payload, scratch.get());
+    if (st.ok() && payload.size() != length) {
+      st = Status::IOError("Short read of MANIFEST", fname_);
+    }
+    if (!st.ok()) {
+      return st;
+    }
+    data.append(payload.data(), payload.size());
+  }
+  const std::string tmp = fname_ + ".delta.tmp";
+  const std::string delta = ManifestDeltaFile(cloud_fname_, offset);
+  st = WriteStringToFile(local_env, data, tmp, false);
+  if (st.ok()) {
+    st = provider->PutCloudObject(tmp, bucket_, delta);
+  }
+  local_env->DeleteFile(tmp);
+  if (!st.ok()) {
+    return st;
+  }
+  manifest_uploaded_crc_ = crc32c::Extend(
+      manifest_uploaded_crc_, data.data() + ManifestReader::kDeltaHeaderSize,
+      length);
+  manifest_uploaded_size_ = size;
+  manifest_deltas_.push_back(delta);
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[%s] CloudWritableFile uploaded manifest delta %s with %" ROCKSDB_PRIszt
+      " bytes",
+      Name(), delta.c_str(), length);
+
+  if (manifest_deltas_.size() >=
+      static_cast<size_t>(std::max(
+          env_->GetCloudEnvOptions().manifest_delta_compaction_trigger, 1))) {
+    // At most one compaction at a time
+    WaitForManifestCompaction();
+    std::vector<std::string> deltas;
+    deltas.swap(manifest_deltas_);
+    manifest_compaction_ = std::thread(
+        [this, size, deltas]() { CompactManifestDeltas(size, deltas); });
+  }
+  return st;
+}
+
+void CloudStorageWritableFileImpl::CompactManifestDeltas(
+    uint64_t size, std::vector<std::string> deltas) {
+  // Upload the first size bytes of the MANIFEST, which cover all the deltas,
+  // and only then delete the deltas.
+  Env* local_env = env_->GetBaseEnv();
+  auto provider = env_->GetCloudEnvOptions().storage_provider;
+  const std::string tmp = fname_ + ".compact.tmp";
+  LegacyFileSystemWrapper fs(local_env);
+  Status st = CopyFile(&fs, fname_, tmp, size, false);
+  if (st.ok()) {
+    st = provider->PutCloudObject(tmp, bucket_, cloud_fname_);
+  }
+  local_env->DeleteFile(tmp);
+  if (st.ok()) {
+    for (const auto& d : deltas) {
+      provider->DeleteCloudObject(bucket_, d);
+    }
+  }
+  Log(st.ok() ? InfoLogLevel::INFO_LEVEL : InfoLogLevel::ERROR_LEVEL,
+      env_->info_log_,
+      "[%s] CloudWritableFile uploaded full manifest %s (%" PRIu64
+      " bytes) replacing %" ROCKSDB_PRIszt " deltas: %s",
+      Name(), cloud_fname_.c_str(), size, deltas.size(),
+      st.ToString().c_str());
+}
+
+void CloudStorageWritableFileImpl::WaitForManifestCompaction() {
+  if (manifest_compaction_.joinable()) {
+    manifest_compaction_.join();
+  }
+}
+
 CloudStorageProvider::~CloudStorageProvider() {}
 
+Status CloudStorageProvider::ListCloudObjectsWithInfo(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    std::vector<std::string>* /*path_names*/,
+    std::vector<CloudObjectInformation>* /*infos*/) {
+  return Status::NotSupported("ListCloudObjectsWithInfo", Name());
+}
+
+Status CloudStorageProvider::ListCloudObjectsWithPrefix(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::string& /*name_prefix*/,
+    std::vector<std::string>* /*path_names*/) {
+  return Status::NotSupported("ListCloudObjectsWithPrefix", Name());
+}
+
 Status CloudStorageProvider::Prepare(CloudEnv* env) {
   Status st;
   if (env->HasDestBucket()) {
@@ -266,7 +674,16 @@ Status CloudStorageProvider::Prepare(CloudEnv* env) {
 
 CloudStorageProviderImpl::CloudStorageProviderImpl() : rng_(time(nullptr)) {}
 
-CloudStorageProviderImpl::~CloudStorageProviderImpl() {}
+uint64_t CloudStorageProviderImpl::NextRandom() {
+  std::lock_guard<std::mutex> lk(rng_mutex_);
+  return rng_.Next();
+}
+
+CloudStorageProviderImpl::~CloudStorageProviderImpl() {
+  if (transfer_pool_) {
+    transfer_pool_->JoinAllThreads();
+  }
+}
 
 Status CloudStorageProviderImpl::Prepare(CloudEnv* env) {
   status_ = Initialize(env);
@@ -281,6 +698,11 @@ Status CloudStorageProviderImpl::Prepare(CloudEnv* env) {
 
 Status CloudStorageProviderImpl::Initialize(CloudEnv* env) {
   env_ = env;
+  const int threads = env->GetCloudEnvOptions().transfer_threads;
+  if (threads > 1 && !transfer_pool_) {
+    // The thread that starts a transfer moves parts as well
+    transfer_pool_.reset(NewThreadPool(threads - 1));
+  }
   return Status::OK();
 }
 
@@ -288,26 +710,63 @@ Status CloudStorageProviderImpl::NewCloudReadableFile(
     const std::string& bucket, const std::string& fname,
     std::unique_ptr<CloudStorageReadableFile>* result,
     const EnvOptions& options) {
-  CloudObjectInformation info;
-  Status st = GetCloudObjectMetadata(bucket, fname, &info);
+  return NewCloudReadableFileOfSize(bucket, fname, 0, result, options);
+}
 
-  if (!st.ok()) {
-    return st;
+Status CloudStorageProviderImpl::NewCloudReadableFileOfSize(
+    const std::string& bucket, const std::string& fname, uint64_t size,
+    std::unique_ptr<CloudStorageReadableFile>* result,
+    const EnvOptions& options) {
+  CloudObjectInformation info;
+  Status st;
+  if (size > 0) {
+    // The size is known, so there is no need for a metadata request
+    info.size = size;
+  } else {
+    st = GetCloudObjectMetadata(bucket, fname, &info);
+    if (!st.ok()) {
+      return st;
+    }
+  }
+  st = DoNewCloudReadableFile(bucket, fname, info.size, info.content_hash,
+                              result, options);
+  if (st.ok()) {
+    const auto& cloud_options = env_->GetCloudEnvOptions();
+    static_cast<CloudStorageReadableFileImpl*>(result->get())
+        ->SetReadahead(cloud_options.min_readahead_size,
+                       cloud_options.max_readahead_size);
   }
-  return DoNewCloudReadableFile(bucket, fname, info.size, info.content_hash,
-                                result, options);
+  if (st.ok()) {
+    env_->WrapCloudReadableFile(bucket, fname, info.size, result);
+  }
+  return st;
 }
 
 Status CloudStorageProviderImpl::GetCloudObject(
     const std::string& bucket_name, const std::string& object_path,
     const std::string& local_destination) {
+  return GetCloudObjectOfSize(bucket_name, object_path, local_destination, 0);
+}
+
+Status CloudStorageProviderImpl::GetCloudObjectOfSize(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& local_destination, uint64_t size) {
   Env* localenv = env_->GetBaseEnv();
   std::string tmp_destination =
-      local_destination + ".tmp-" + std::to_string(rng_.Next());
+      local_destination + ".tmp-" + std::to_string(NextRandom());
 
-  uint64_t remote_size;
-  Status s =
-      DoGetCloudObject(bucket_name, object_path, tmp_destination, &remote_size);
+  const auto& cloud_options = env_->GetCloudEnvOptions();
+  uint64_t remote_size = size;
+  Status s;
+  if (cloud_options.transfer_threads > 0 &&
+      cloud_options.transfer_part_size > 0 &&
+      size > cloud_options.transfer_part_size) {
+    s = ParallelGetCloudObject(bucket_name, object_path, tmp_destination,
+                               &remote_size);
+  } else {
+    s = DoGetCloudObject(bucket_name, object_path, tmp_destination,
+                         &remote_size);
+  }
   if (!s.ok()) {
     localenv->DeleteFile(tmp_destination);
     return s;
@@ -358,7 +817,322 @@ Status CloudStorageProviderImpl::PutCloudObject(
     return Status::IOError(local_file + " Zero size.");
   }
 
+  const auto& cloud_options = env_->GetCloudEnvOptions();
+  if (cloud_options.transfer_threads > 0 &&
+      cloud_options.transfer_part_size > 0 &&
+      fsize > cloud_options.transfer_part_size) {
+    st = ParallelPutCloudObject(local_file, bucket_name, object_path, fsize);
+    if (!st.IsNotSupported()) {
+      return st;
+    }
+  }
   return DoPutCloudObject(local_file, bucket_name, object_path, fsize);
 }
 
+namespace {
+// Number of attempts to transfer a part before the transfer fails
+const int kMaxPartAttempts = 3;
+
+// The metadata entry that holds the part size and the crc32c of every part
+// of an object that was uploaded in parts, as "<part size>:<crc>,<crc>,...".
+// Object metadata is small, so the entry is left out for objects with too
+// many parts.
+const char* const kPartChecksumsKey = "part-crc32c";
+const size_t kMaxPartChecksumsSize = 1024;
+
+std::string EncodePartChecksums(uint64_t part_size,
+                                const std::vector<uint32_t>& crcs) {
+  std::string result = ToString(part_size) + ":";
+  char buf[16];
+  for (size_t i = 0; i < crcs.size(); i++) {
+    snprintf(buf, sizeof(buf), "%s%08x", i > 0 ? "," : "", crcs[i]);
+    result.append(buf);
+  }
+  return result;
+}
+
+bool DecodePartChecksums(const std::string& value, uint64_t* part_size,
+                         std::vector<uint32_t>* crcs) {
+  auto colon = value.find(':');
+  if (colon == std::string::npos || colon == 0) {
+    return false;
+  }
+  *part_size = strtoull(value.substr(0, colon).c_str(), nullptr, 10);
+  crcs->clear();
+  for (size_t pos = colon + 1; pos < value.size(); pos += 9) {
+    if (pos + 8 > value.size()) {
+      return false;
+    }
+    crcs->push_back(
+        static_cast<uint32_t>(strtoul(value.substr(pos, 8).c_str(), nullptr,
+                                      16)));
+  }
+  return *part_size > 0;
+}
+
+// The state of a transfer, shared with the pool threads that work on it. A
+// pool thread that starts after the transfer is over finds no part left.
+struct TransferState {
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t num_parts = 0;
+  size_t next_part = 0;
+  // Parts that are being transferred
+  size_t running = 0;
+  bool failed = false;
+  Status result;
+  std::function<Status(size_t)> transfer;
+  std::shared_ptr<Logger> info_log;
+  std::string name;
+};
+
+void TransferWorker(TransferState* state) {
+  std::unique_lock<std::mutex> lk(state->mutex);
+  while (!state->failed && state->next_part < state->num_parts) {
+    const size_t part = state->next_part++;
+    state->running++;
+    lk.unlock();
+    Status s;
+    for (int attempt = 1; attempt <= kMaxPartAttempts; attempt++) {
+      s = state->transfer(part);
+      if (s.ok() || s.IsNotFound()) {
+        break;
+      }
+      Log(InfoLogLevel::WARN_LEVEL, state->info_log,
+          "[transfer] %s part %" ROCKSDB_PRIszt " attempt %d failed: %s",
+          state->name.c_str(), part, attempt, s.ToString().c_str());
+    }
+    lk.lock();
+    state->running--;
+    if (!s.ok() && !state->failed) {
+      state->result = s;
+      state->failed = true;
+    }
+    state->cv.notify_all();
+  }
+}
+}  // namespace
+
+Status CloudStorageProviderImpl::TransferParts(
+    size_t num_parts, const std::function<Status(size_t)>& transfer,
+    const std::string& name) {
+  auto state = std::make_shared<TransferState>();
+  state->num_parts = num_parts;
+  state->transfer = transfer;
+  state->info_log = env_->info_log_;
+  state->name = name;
+  if (transfer_pool_ && num_parts > 1) {
+    const size_t helpers = std::min(
+        static_cast<size_t>(transfer_pool_->GetBackgroundThreads()),
+        num_parts - 1);
+    for (size_t i = 0; i < helpers; i++) {
+      transfer_pool_->SubmitJob([state]() { TransferWorker(state.get()); });
+    }
+  }
+  TransferWorker(state.get());
+  // No part is started once they have all been taken or one has failed, so
+  // the transfer is over when the running ones are done
+  std::unique_lock<std::mutex> lk(state->mutex);
+  state->cv.wait(lk, [&state]() { return state->running == 0; });
+  return state->result;
+}
+
+Status CloudStorageProviderImpl::ParallelGetCloudObject(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& local_path, uint64_t* size) {
+  // The metadata has the checksums of the parts, if the object was uploaded
+  // in parts, and its actual size
+  CloudObjectInformation info;
+  Status st = GetCloudObjectMetadata(bucket_name, object_path, &info);
+  if (!st.ok()) {
+    return st;
+  }
+  *size = info.size;
+  uint64_t part_size = env_->GetCloudEnvOptions().transfer_part_size;
+  std::vector<uint32_t> crcs;
+  auto it = info.metadata.find(kPartChecksumsKey);
+  uint64_t uploaded_part_size = 0;
+  if (it != info.metadata.end() &&
+      DecodePartChecksums(it->second, &uploaded_part_size, &crcs) &&
+      crcs.size() ==
+          (info.size + uploaded_part_size - 1) / uploaded_part_size) {
+    // Download the parts that were uploaded, so that they can be verified
+    part_size = uploaded_part_size;
+  } else {
+    crcs.clear();
+  }
+
+  std::unique_ptr<CloudStorageReadableFile> cloud_file;
+  st = DoNewCloudReadableFile(bucket_name, object_path, info.size,
+                              info.content_hash, &cloud_file, EnvOptions());
+  std::unique_ptr<RandomRWFile> local_file;
+  if (st.ok()) {
+    // the parts are written in place; create the file first
+    std::unique_ptr<WritableFile> creator;
+    st = env_->GetBaseEnv()->NewWritableFile(local_path, &creator,
+                                             EnvOptions());
+    if (st.ok()) {
+      st = creator->Close();
+    }
+  }
+  if (st.ok()) {
+    st = env_->GetBaseEnv()->NewRandomRWFile(local_path, &local_file,
+                                             EnvOptions());
+  }
+  if (!st.ok()) {
+    return st;
+  }
+  const RandomAccessFile* source = cloud_file.get();
+  const uint64_t object_size = info.size;
+  auto download_part = [&](size_t part) {
+    const uint64_t offset = part * part_size;
+    const size_t len =
+        static_cast<size_t>(std::min(part_size, object_size - offset));
+    std::unique_ptr<char[]> buffer(new char[len]);
+    Slice data;
+    Status s = source->Read(offset, len, &data, buffer.get());
+    if (s.ok() && data.size() != len) {
+      s = Status::IOError("Short read of part of " + object_path);
+    }
+    if (s.ok() && !crcs.empty() &&
+        crc32c::Value(data.data(), data.size()) != crcs[part]) {
+      s = Status::Corruption("Checksum mismatch in part of " + object_path);
+    }
+    if (s.ok()) {
+      s = local_file->Write(offset, data);
+    }
+    return s;
+  };
+  const size_t num_parts =
+      static_cast<size_t>((object_size + part_size - 1) / part_size);
+  st = TransferParts(num_parts, download_part,
+                     bucket_name + pathsep + object_path);
+  if (st.ok()) {
+    st = local_file->Sync();
+  }
+  Status cs = local_file->Close();
+  if (st.ok()) {
+    st = cs;
+  }
+  Log(InfoLogLevel::INFO_LEVEL, env_->info_log_,
+      "[%s] ParallelGetCloudObject %s/%s size %" PRIu64 " in %" ROCKSDB_PRIszt
+      " parts%s: %s",
+      Name(), bucket_name.c_str(), object_path.c_str(), object_size,
+      num_parts, crcs.empty() ? "" : " verified", st.ToString().c_str());
+  return st;
+}
+
+Status CloudStorageProviderImpl::ParallelPutCloudObject(
+    const std::string& local_file, const std::string& bucket_name,
+    const std::string& object_path, uint64_t size) {
+  const auto& cloud_options = env_->GetCloudEnvOptions();
+  const uint64_t part_size = cloud_options.transfer_part_size;
+  std::unique_ptr<RandomAccessFile> file;
+  Status st =
+      env_->GetBaseEnv()->NewRandomAccessFile(local_file, &file, EnvOptions());
+  if (!st.ok()) {
+    return st;
+  }
+  const size_t num_parts =
+      static_cast<size_t>((size + part_size - 1) / part_size);
+
+  // The checksums of the parts go into the metadata, which is set when the
+  // upload is created, so they are computed first
+  std::unordered_map<std::string, std::string> metadata;
+  std::vector<uint32_t> crcs;
+  if (num_parts * 9 + 24 <= kMaxPartChecksumsSize) {
+    const size_t kChunkSize = 1024 * 1024;
+    std::unique_ptr<char[]> buffer(new char[kChunkSize]);
+    crcs.resize(num_parts, 0);
+    for (uint64_t offset = 0; st.ok() && offset < size;) {
+      const size_t part = static_cast<size_t>(offset / part_size);
+      const uint64_t part_end = std::min(size, (part + 1) * part_size);
+      const size_t len = static_cast<size_t>(
+          std::min<uint64_t>(kChunkSize, part_end - offset));
+      Slice data;
+      st = file->Read(offset, len, &data, buffer.get());
+      if (st.ok() && data.size() != len) {
+        st = Status::IOError("Short read of " + local_file);
+      }
+      if (st.ok()) {
+        crcs[part] = crc32c::Extend(crcs[part], data.data(), data.size());
+        offset += len;
+      }
+    }
+    if (!st.ok()) {
+      return st;
+    }
+    metadata[kPartChecksumsKey] = EncodePartChecksums(part_size, crcs);
+  }
+
+  std::string upload_id;
+  st = DoCreateMultipartUpload(bucket_name, object_path, metadata, &upload_id);
+  if (!st.ok()) {
+    return st;
+  }
+  std::vector<std::string> etags(num_parts);
+  auto upload_part = [&](size_t part) {
+    const uint64_t offset = part * part_size;
+    const size_t len =
+        static_cast<size_t>(std::min(part_size, size - offset));
+    std::unique_ptr<char[]> buffer(new char[len]);
+    Slice data;
+    Status s = file->Read(offset, len, &data, buffer.get());
+    if (s.ok() && data.size() != len) {
+      s = Status::IOError("Short read of part of " + local_file);
+    }
+    const uint32_t crc =
+        s.ok() ? crc32c::Value(data.data(), data.size()) : 0;
+    if (s.ok() && !crcs.empty() && crc != crcs[part]) {
+      s = Status::Corruption("Part changed while uploading " + local_file);
+    }
+    if (s.ok()) {
+      s = DoUploadPart(bucket_name, object_path, upload_id,
+                       static_cast<int>(part + 1), data, crc, &etags[part]);
+    }
+    return s;
+  };
+  st = TransferParts(num_parts, upload_part,
+                     bucket_name + pathsep + object_path);
+  if (st.ok()) {
+    st = DoCompleteMultipartUpload(bucket_name, object_path, upload_id, etags);
+  }
+  if (!st.ok()) {
+    DoAbortMultipartUpload(bucket_name, object_path, upload_id);
+  }
+  Log(InfoLogLevel::INFO_LEVEL, env_->info_log_,
+      "[%s] ParallelPutCloudObject %s/%s size %" PRIu64 " in %" ROCKSDB_PRIszt
+      " parts: %s",
+      Name(), bucket_name.c_str(), object_path.c_str(), size, num_parts,
+      st.ToString().c_str());
+  return st;
+}
+
+Status CloudStorageProviderImpl::DoCreateMultipartUpload(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::unordered_map<std::string, std::string>& /*metadata*/,
+    std::string* /*upload_id*/) {
+  return Status::NotSupported("Multipart upload", Name());
+}
+
+Status CloudStorageProviderImpl::DoUploadPart(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::string& /*upload_id*/, int /*part_number*/,
+    const Slice& /*data*/, uint32_t /*crc*/, std::string* /*etag*/) {
+  return Status::NotSupported("Multipart upload", Name());
+}
+
+Status CloudStorageProviderImpl::DoCompleteMultipartUpload(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::string& /*upload_id*/,
+    const std::vector<std::string>& /*etags*/) {
+  return Status::NotSupported("Multipart upload", Name());
+}
+
+Status CloudStorageProviderImpl::DoAbortMultipartUpload(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::string& /*upload_id*/) {
+  return Status::NotSupported("Multipart upload", Name());
+}
+
 }  // namespace ROCKSDB_NAMESPACE
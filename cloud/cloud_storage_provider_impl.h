@@ -3,7 +3,16 @@
 #pragma once
 
 #ifndef ROCKSDB_LITE
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "rocksdb/cloud/cloud_storage_provider.h"
+#include "rocksdb/threadpool.h"
 #include "util/random.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -19,8 +28,25 @@ class CloudStorageReadableFileImpl : public CloudStorageReadableFile {
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const override;
 
+  // Serves a batch of reads with as few cloud requests as possible by
+  // merging requests whose ranges are close to each other
+  virtual Status MultiRead(ReadRequest* reqs, size_t num_reqs) override;
+
+  // Reads the range with a single cloud request and serves the reads that
+  // fall into it from memory, until a read outside of it. Opening a table
+  // prefetches its tail, so that the footer, meta blocks, index and filter
+  // cost one request.
+  virtual Status Prefetch(uint64_t offset, size_t n) override;
+
   virtual Status Skip(uint64_t n) override;
 
+  // Sequential reads start reading ahead min_readahead bytes, and double the
+  // readahead on every further sequential read up to max_readahead bytes,
+  // which also bounds the data read ahead for all readers of the file.
+  // Reads in a MultiRead batch that are at most min_readahead bytes apart are
+  // merged, up to max_readahead bytes. A max_readahead of zero disables both.
+  void SetReadahead(size_t min_readahead, size_t max_readahead);
+
  protected:
   virtual Status DoCloudRead(uint64_t offset, size_t n, char* scratch,
                              uint64_t* bytes_read) const = 0;
@@ -30,6 +56,42 @@ class CloudStorageReadableFileImpl : public CloudStorageReadableFile {
   std::string fname_;
   uint64_t offset_;
   uint64_t file_size_;
+
+ private:
+  // Reads exactly n bytes unless the end of the file is reached
+  Status ReadRange(uint64_t offset, size_t n, char* scratch,
+                   uint64_t* bytes_read) const;
+
+  size_t min_readahead_;
+  size_t max_readahead_;
+
+  // A sequential reader of the file. Every reader reads ahead on its own,
+  // so that interleaved scans of the same file, e.g. by concurrent
+  // iterators, do not reset each other's readahead.
+  struct ReadaheadStream {
+    // Where the previous read ended; a read that starts there is sequential
+    uint64_t next_offset = 0;
+    // The current readahead size, zero if the reads are not sequential
+    size_t readahead_size = 0;
+    // Data that was read ahead and the offset it starts at
+    uint64_t buffer_offset = 0;
+    std::string buffer;
+  };
+
+  // The number of readers that are tracked; the least recently used one is
+  // dropped to make room for a new one
+  static const size_t kMaxReadaheadStreams = 4;
+
+  // Moves the reader that the read at offset continues, or whose buffer
+  // holds offset, to the front of streams_, or adds a new one there.
+  // Returns whether the reader was found. REQUIRES: readahead_mutex_
+  bool FindStreamLocked(uint64_t offset) const;
+  // The bytes buffered by all readers. REQUIRES: readahead_mutex_
+  size_t BufferedLocked() const;
+
+  mutable std::mutex readahead_mutex_;
+  // Most recently used first
+  mutable std::list<ReadaheadStream> streams_;
 };
 
 // Appends to a file in S3.
@@ -45,6 +107,23 @@ class CloudStorageWritableFileImpl : public CloudStorageWritableFile {
   std::string cloud_fname_;
   bool is_manifest_;
 
+  // State of the MANIFEST in cloud storage when it is uploaded as deltas
+  // (see CloudEnvOptions::manifest_delta_upload). The number of bytes that
+  // are in cloud storage, and their crc32c.
+  uint64_t manifest_uploaded_size_;
+  uint32_t manifest_uploaded_crc_;
+  // Deltas uploaded since the last full MANIFEST
+  std::vector<std::string> manifest_deltas_;
+  // Uploads the full MANIFEST in the background every
+  // manifest_delta_compaction_trigger deltas
+  std::thread manifest_compaction_;
+
+  // Uploads the part of the MANIFEST that was appended since the previous
+  // sync, or all of it on the first sync
+  Status UploadManifestDelta();
+  void CompactManifestDeltas(uint64_t size, std::vector<std::string> deltas);
+  void WaitForManifestCompaction();
+
  public:
   CloudStorageWritableFileImpl(CloudEnv* env, const std::string& local_fname,
                                const std::string& bucket,
@@ -95,18 +174,56 @@ class CloudStorageWritableFileImpl : public CloudStorageWritableFile {
   virtual Status Close() override;
 };
 
+// The behavior of a remote object store that the local storage provider
+// emulates, so that the cloud paths can be benchmarked and stress tested
+// without a cloud account. The defaults emulate nothing.
+struct LocalStorageProviderOptions {
+  // Every request takes latency_micros plus a uniformly distributed extra of
+  // up to latency_jitter_micros
+  uint64_t latency_micros = 0;
+  uint64_t latency_jitter_micros = 0;
+  // A tail_latency_probability fraction of the requests takes another
+  // tail_latency_micros
+  double tail_latency_probability = 0;
+  uint64_t tail_latency_micros = 0;
+  // The bytes per second that all object reads and writes share. Zero means
+  // unlimited.
+  int64_t bandwidth_bytes_per_sec = 0;
+  // The fraction of the object requests that fail with an IOError
+  double failure_rate = 0;
+  // Written objects are left out of listings for this long, like in an
+  // eventually consistent object store
+  uint64_t list_visibility_delay_micros = 0;
+  // Seed of the random latencies and failures, so that runs can be repeated
+  uint64_t seed = 301;
+};
+
 // All writes to this DB can be configured to be persisted
 // in cloud storage.
 //
 class CloudStorageProviderImpl : public CloudStorageProvider {
  public:
   static Status CreateS3Provider(std::shared_ptr<CloudStorageProvider>* result);
+  // Creates a provider that stores every bucket as a directory below root.
+  // Listings are returned in pages of number_objects_listed_in_one_iteration
+  // objects, each of which counts as a request.
+  static Status CreateLocalProvider(
+      const std::string& root, std::shared_ptr<CloudStorageProvider>* result,
+      const LocalStorageProviderOptions& options =
+          LocalStorageProviderOptions());
 
   CloudStorageProviderImpl();
   virtual ~CloudStorageProviderImpl();
   Status GetCloudObject(const std::string& bucket_name,
                         const std::string& object_path,
                         const std::string& local_destination) override;
+  // Objects larger than transfer_part_size are downloaded in parts on
+  // transfer_threads threads. Objects of unknown size are downloaded in one
+  // request, without looking up their size first.
+  Status GetCloudObjectOfSize(const std::string& bucket_name,
+                              const std::string& object_path,
+                              const std::string& local_destination,
+                              uint64_t size) override;
   Status PutCloudObject(const std::string& local_file,
                         const std::string& bucket_name,
                         const std::string& object_path) override;
@@ -114,10 +231,16 @@ class CloudStorageProviderImpl : public CloudStorageProvider {
                               const std::string& fname,
                               std::unique_ptr<CloudStorageReadableFile>* result,
                               const EnvOptions& options) override;
+  Status NewCloudReadableFileOfSize(
+      const std::string& bucket, const std::string& fname, uint64_t size,
+      std::unique_ptr<CloudStorageReadableFile>* result,
+      const EnvOptions& options) override;
   virtual Status Prepare(CloudEnv* env) override;
 
  protected:
-  Random64 rng_;
+  // Returns a random number, e.g. to name temporary files. Thread-safe.
+  uint64_t NextRandom();
+
   virtual Status Initialize(CloudEnv* env);
 
   virtual Status DoNewCloudReadableFile(
@@ -136,8 +259,58 @@ class CloudStorageProviderImpl : public CloudStorageProvider {
                                   const std::string& bucket_name,
                                   uint64_t file_size) = 0;
 
+  // Multipart upload. A provider that supports it lets large objects be
+  // uploaded as parts in parallel (see CloudEnvOptions::transfer_threads).
+  // The parts are numbered from 1 and the crc32c of each part is passed
+  // along so that the provider can have it verified on arrival. The metadata
+  // is stored with the object once it is complete. The default
+  // implementations return NotSupported, in which case the object is uploaded
+  // with DoPutCloudObject().
+  virtual Status DoCreateMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::unordered_map<std::string, std::string>& metadata,
+      std::string* upload_id);
+  virtual Status DoUploadPart(const std::string& bucket_name,
+                              const std::string& object_path,
+                              const std::string& upload_id, int part_number,
+                              const Slice& data, uint32_t crc,
+                              std::string* etag);
+  virtual Status DoCompleteMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& upload_id, const std::vector<std::string>& etags);
+  virtual Status DoAbortMultipartUpload(const std::string& bucket_name,
+                                        const std::string& object_path,
+                                        const std::string& upload_id);
+
   CloudEnv* env_;
   Status status_;
+
+ private:
+  std::mutex rng_mutex_;
+  Random64 rng_;
+
+  // Download and upload of an object in parts of transfer_part_size bytes on
+  // the transfer threads. The crc32c of every part is stored in the metadata
+  // of the object, if it fits, and verified by the download. The download
+  // sets size to the size of the object in cloud storage.
+  Status ParallelGetCloudObject(const std::string& bucket_name,
+                                const std::string& object_path,
+                                const std::string& local_path, uint64_t* size);
+  Status ParallelPutCloudObject(const std::string& local_file,
+                                const std::string& bucket_name,
+                                const std::string& object_path, uint64_t size);
+
+  // Calls transfer(part) for every part in [0, num_parts) on the calling
+  // thread and up to transfer_threads - 1 threads of the transfer pool,
+  // retrying each part a few times. Returns the first error; the parts that
+  // have not started yet are skipped once a part has failed.
+  Status TransferParts(size_t num_parts,
+                       const std::function<Status(size_t)>& transfer,
+                       const std::string& name);
+
+  // The threads that transfer parts, shared by all transfers. Null unless
+  // transfer_threads is set.
+  std::unique_ptr<ThreadPool> transfer_pool_;
 };
 }  // namespace ROCKSDB_NAMESPACE
 
@@ -0,0 +1,182 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/cloud_upload_pipeline.h"
+
+#include <algorithm>
+
+#include "rocksdb/env.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+const int CloudUploadPipeline::kMaxAttempts;
+
+CloudUploadPipeline::CloudUploadPipeline(
+    int num_threads, int max_pending, const std::shared_ptr<Logger>& info_log,
+    std::chrono::microseconds retry_backoff)
+    : info_log_(info_log),
+      max_pending_(static_cast<size_t>(std::max(max_pending, 1))),
+      retry_backoff_(retry_backoff),
+      next_ticket_(0),
+      shutting_down_(false) {
+  for (int i = 0; i < std::max(num_threads, 1); i++) {
+    threads_.emplace_back([this]() { WorkerThread(); });
+  }
+}
+
+CloudUploadPipeline::~CloudUploadPipeline() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    shutting_down_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  for (const auto& it : failed_) {
+    Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+        "[upload_pipeline] Dropping failed upload of %s: %s",
+        it.second.fname.c_str(), it.second.status.ToString().c_str());
+  }
+}
+
+Status CloudUploadPipeline::Enqueue(const std::string& fname,
+                                    std::function<Status()> upload) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_cv_.wait(lk, [this]() { return outstanding_.size() < max_pending_; });
+  uint64_t ticket = next_ticket_++;
+  outstanding_[ticket] =
+      Upload{fname,        std::move(upload), false, false, 0,
+             Status::OK(), std::chrono::steady_clock::time_point()};
+  queue_.push_back(ticket);
+  lk.unlock();
+  work_cv_.notify_one();
+  return Status::OK();
+}
+
+void CloudUploadPipeline::Cancel(const std::string& fname) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  for (auto& it : outstanding_) {
+    if (it.second.fname == fname) {
+      it.second.cancelled = true;
+    }
+  }
+  for (auto it = failed_.begin(); it != failed_.end();) {
+    if (it->second.fname == fname) {
+      it = failed_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  // A cancelled upload that waits to be retried is dropped right away
+  work_cv_.notify_all();
+  done_cv_.wait(lk, [this, &fname]() {
+    for (const auto& it : outstanding_) {
+      if (it.second.fname == fname && it.second.running) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+bool CloudUploadPipeline::IsPending(const std::string& fname) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  for (const auto& it : outstanding_) {
+    if (it.second.fname == fname && !it.second.cancelled) {
+      return true;
+    }
+  }
+  for (const auto& it : failed_) {
+    if (it.second.fname == fname) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Status CloudUploadPipeline::WaitForPending() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  // The failed uploads keep their tickets, so that they are waited for
+  if (!failed_.empty()) {
+    for (auto& it : failed_) {
+      it.second.attempts = 0;
+      it.second.not_before = std::chrono::steady_clock::time_point();
+      queue_.push_back(it.first);
+      outstanding_[it.first] = std::move(it.second);
+    }
+    failed_.clear();
+    work_cv_.notify_all();
+  }
+  const uint64_t barrier = next_ticket_;
+  done_cv_.wait(lk, [this, barrier]() {
+    return outstanding_.empty() || outstanding_.begin()->first >= barrier;
+  });
+  if (!failed_.empty() && failed_.begin()->first < barrier) {
+    return failed_.begin()->second.status;
+  }
+  return Status::OK();
+}
+
+void CloudUploadPipeline::WorkerThread() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    work_cv_.wait(lk, [this]() { return shutting_down_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      // shutting down and every queued upload has been drained
+      return;
+    }
+    // Pick the first upload that is not waiting for its retry. A shutdown
+    // does not wait for the backoff.
+    const auto now = std::chrono::steady_clock::now();
+    auto next = queue_.end();
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (auto q = queue_.begin(); q != queue_.end(); ++q) {
+      const Upload& u = outstanding_.find(*q)->second;
+      if (u.cancelled || shutting_down_ || u.not_before <= now) {
+        next = q;
+        break;
+      }
+      earliest = std::min(earliest, u.not_before);
+    }
+    if (next == queue_.end()) {
+      work_cv_.wait_until(lk, earliest);
+      continue;
+    }
+    uint64_t ticket = *next;
+    queue_.erase(next);
+    auto it = outstanding_.find(ticket);
+    Upload& upload = it->second;
+    Status st;
+    if (!upload.cancelled) {
+      // Only this thread erases the upload
+      upload.running = true;
+      lk.unlock();
+      st = upload.fn();
+      lk.lock();
+      upload.running = false;
+    }
+    if (!st.ok() && !upload.cancelled) {
+      upload.attempts++;
+      upload.status = st;
+      Log(InfoLogLevel::ERROR_LEVEL, info_log_,
+          "[upload_pipeline] Upload of %s failed, attempt %d: %s",
+          upload.fname.c_str(), upload.attempts, st.ToString().c_str());
+      if (upload.attempts < kMaxAttempts) {
+        // retried under the same ticket, so that it is still waited for
+        upload.not_before = std::chrono::steady_clock::now() +
+                            retry_backoff_ * (1 << (upload.attempts - 1));
+        queue_.push_back(ticket);
+        work_cv_.notify_all();
+      } else {
+        failed_[ticket] = std::move(upload);
+        outstanding_.erase(it);
+      }
+    } else {
+      outstanding_.erase(it);
+    }
+    done_cv_.notify_all();
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
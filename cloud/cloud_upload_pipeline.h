@@ -0,0 +1,106 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class Logger;
+
+//
+// Runs file uploads to cloud storage on a small pool of background threads.
+//
+// The number of uploads that are queued or running is bounded by
+// max_pending; Enqueue() blocks the caller once the bound is reached, so a
+// writer that outpaces the network is throttled instead of accumulating an
+// unbounded backlog of local files.
+//
+// An upload that fails is retried up to kMaxAttempts times, after a delay
+// that starts at retry_backoff and doubles with every attempt, so that
+// throttling by the object store is not answered by an immediate retry. If
+// it still fails, it is kept and its error returned by WaitForPending(), which
+// retries it again first; the uploads of other files are not affected. An
+// upload is only dropped once it succeeds or is cancelled.
+//
+class CloudUploadPipeline {
+ public:
+  static const int kMaxAttempts = 3;
+
+  CloudUploadPipeline(int num_threads, int max_pending,
+                      const std::shared_ptr<Logger>& info_log,
+                      std::chrono::microseconds retry_backoff =
+                          std::chrono::milliseconds(100));
+
+  // Waits for all queued uploads to finish and stops the worker threads.
+  ~CloudUploadPipeline();
+
+  // Queues the upload of fname. The upload function is invoked on one of the
+  // worker threads, and again if it fails.
+  Status Enqueue(const std::string& fname, std::function<Status()> upload);
+
+  // Cancels every upload of fname. An upload that has not started yet, or
+  // that failed, is dropped. An upload that is running cannot be stopped;
+  // Cancel() waits for it to finish, so that the caller can delete what it
+  // uploaded.
+  void Cancel(const std::string& fname);
+
+  // Returns true if an upload of fname is queued, running or failed.
+  bool IsPending(const std::string& fname);
+
+  // Retries the uploads that failed, and blocks until they and every upload
+  // that was queued before this call have finished. Returns the error of an
+  // upload that still failed, if any.
+  Status WaitForPending();
+
+ private:
+  struct Upload {
+    std::string fname;
+    std::function<Status()> fn;
+    bool cancelled;
+    bool running;
+    int attempts;
+    Status status;
+    // The upload is not retried before this time
+    std::chrono::steady_clock::time_point not_before;
+  };
+
+  void WorkerThread();
+
+  std::shared_ptr<Logger> info_log_;
+  const size_t max_pending_;
+  const std::chrono::microseconds retry_backoff_;
+
+  std::mutex mutex_;
+  // Signalled when an upload is queued or the pipeline is shutting down
+  std::condition_variable work_cv_;
+  // Signalled when an upload finishes
+  std::condition_variable done_cv_;
+
+  // Uploads that are queued or running, keyed by the order of Enqueue()
+  std::map<uint64_t, Upload> outstanding_;
+  // Uploads that have not been picked up by a worker yet, or that wait to be
+  // retried
+  std::deque<uint64_t> queue_;
+  // Uploads that failed kMaxAttempts times, keyed by their last ticket
+  std::map<uint64_t, Upload> failed_;
+  uint64_t next_ticket_;
+  bool shutting_down_;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -4,6 +4,8 @@
 #include "cloud/db_cloud_impl.h"
 
 #include <cinttypes>
+#include <functional>
+#include <unordered_map>
 
 #include "cloud/aws/aws_env.h"
 #include "cloud/filename.h"
@@ -50,6 +52,76 @@ class ConstantSizeSstFileManager : public SstFileManagerImpl {
  private:
   const int64_t constant_file_size_;
 };
+
+// Lists the objects below object_path with their information. Returns OK
+// and nothing if the provider cannot list the information.
+Status ListObjectInfos(
+    CloudStorageProvider* provider, const std::string& bucket,
+    const std::string& object_path,
+    std::unordered_map<std::string, CloudObjectInformation>* objects) {
+  std::vector<std::string> names;
+  std::vector<CloudObjectInformation> infos;
+  Status st =
+      provider->ListCloudObjectsWithInfo(bucket, object_path, &names, &infos);
+  if (st.IsNotSupported()) {
+    return Status::OK();
+  } else if (!st.ok()) {
+    return st;
+  }
+  for (size_t i = 0; i < names.size(); i++) {
+    (*objects)[names[i]] = std::move(infos[i]);
+  }
+  return Status::OK();
+}
+
+// Whether two objects have the same contents, as far as their information
+// tells. Content hashes are compared when both objects have one.
+bool SameObject(const CloudObjectInformation& a,
+                const CloudObjectInformation& b) {
+  return a.size == b.size &&
+         (a.content_hash.empty() || b.content_hash.empty() ||
+          a.content_hash == b.content_hash);
+}
+
+// Calls fn for every index below n on up to num_threads threads. Returns the
+// first error, after which no more indexes are started.
+Status RunInParallel(size_t n, int num_threads,
+                     const std::function<Status(size_t)>& fn) {
+  std::atomic<size_t> next{0};
+  std::mutex mutex;
+  Status result;
+  auto worker = [&]() {
+    while (true) {
+      size_t i = next.fetch_add(1);
+      if (i >= n) {
+        break;
+      }
+      Status st = fn(i);
+      if (!st.ok()) {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (result.ok()) {
+          result = st;
+        }
+        next = n;
+        break;
+      }
+    }
+  };
+  const size_t thread_count =
+      std::min(n, static_cast<size_t>(std::max(1, num_threads)));
+  if (thread_count <= 1) {
+    worker();
+  } else {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  return result;
+}
 }  // namespace
 
 DBCloudImpl::DBCloudImpl(DB* db) : DBCloud(db), cenv_(nullptr) {}
@@ -125,6 +197,9 @@ Status DBCloud::Open(const Options& opt, const std::string& local_dbname,
   if (st.ok()) {
     st = cenv->LoadCloudManifest(local_dbname, read_only);
   }
+  if (st.ok()) {
+    st = cenv->LoadSstFiles(local_dbname);
+  }
   if (!st.ok()) {
     return st;
   }
@@ -283,6 +358,7 @@ Status DBCloudImpl::DoCheckpointToCloud(
   uint64_t manifest_file_size{0};
   auto cenv = static_cast<CloudEnvImpl*>(GetEnv());
   auto base_env = cenv->GetBaseEnv();
+  auto provider = cenv->GetCloudEnvOptions().storage_provider.get();
 
   auto st =
       GetLiveFiles(live_files, &manifest_file_size, options.flush_memtable);
@@ -290,7 +366,39 @@ Status DBCloudImpl::DoCheckpointToCloud(
     return st;
   }
 
+  // The objects that the destination has already
+  std::unordered_map<std::string, CloudObjectInformation> existing;
+  if (options.skip_existing_files) {
+    st = ListObjectInfos(provider, destination.GetBucketName(),
+                         destination.GetObjectPath(), &existing);
+    if (!st.ok()) {
+      return st;
+    }
+  }
+
+  // The sst files of the db that are in cloud storage are copied from there
+  // without passing through this host
+  std::string db_bucket, db_object_path;
+  if (cenv->HasDestBucket()) {
+    db_bucket = cenv->GetDestBucketName();
+    db_object_path = cenv->GetDestObjectPath();
+  } else if (cenv->HasSrcBucket()) {
+    db_bucket = cenv->GetSrcBucketName();
+    db_object_path = cenv->GetSrcObjectPath();
+  }
+  std::unordered_map<std::string, CloudObjectInformation> db_objects;
+  if (!db_bucket.empty()) {
+    st = ListObjectInfos(provider, db_bucket, db_object_path, &db_objects);
+    if (!st.ok()) {
+      return st;
+    }
+  }
+
+  // Pairs of the source and the destination name
   std::vector<std::pair<std::string, std::string>> files_to_copy;
+  std::vector<std::pair<std::string, std::string>> objects_to_copy;
+  size_t skipped = 0;
+  uint64_t skipped_bytes = 0;
   for (auto& f : live_files) {
     uint64_t number = 0;
     FileType type;
@@ -303,7 +411,30 @@ Status DBCloudImpl::DoCheckpointToCloud(
       continue;
     }
     auto remapped_fname = cenv->RemapFilename(f);
-    files_to_copy.emplace_back(remapped_fname, remapped_fname);
+    const std::string name = basename(remapped_fname);
+    auto src = db_objects.find(name);
+    auto dest = existing.find(name);
+    if (dest != existing.end()) {
+      bool same = false;
+      if (src != db_objects.end()) {
+        same = SameObject(src->second, dest->second);
+      } else {
+        uint64_t size = 0;
+        same = base_env->GetFileSize(GetName() + "/" + remapped_fname, &size)
+                   .ok() &&
+               size == dest->second.size;
+      }
+      if (same) {
+        skipped++;
+        skipped_bytes += dest->second.size;
+        continue;
+      }
+    }
+    if (src != db_objects.end()) {
+      objects_to_copy.emplace_back(db_object_path + "/" + name, name);
+    } else {
+      files_to_copy.emplace_back(remapped_fname, remapped_fname);
+    }
   }
 
   // IDENTITY file
@@ -331,52 +462,38 @@ Status DBCloudImpl::DoCheckpointToCloud(
   // CLOUDMANIFEST file
   files_to_copy.emplace_back(CloudManifestFile(""), CloudManifestFile(""));
 
-  std::atomic<size_t> next_file_to_copy{0};
-  int thread_count = std::max(1, options.thread_count);
-  std::vector<Status> thread_statuses;
-  thread_statuses.resize(thread_count);
-
-  auto do_copy = [&](size_t threadId) {
-    auto& provider = cenv->GetCloudEnvOptions().storage_provider;
-    while (true) {
-      size_t idx = next_file_to_copy.fetch_add(1);
-      if (idx >= files_to_copy.size()) {
-        break;
-      }
-
-      auto& f = files_to_copy[idx];
-      auto copy_st = provider->PutCloudObject(
-          GetName() + "/" + f.first, destination.GetBucketName(),
-          destination.GetObjectPath() + "/" + f.second);
-      if (!copy_st.ok()) {
-        thread_statuses[threadId] = std::move(copy_st);
-        break;
-      }
-    }
-  };
-
-  if (thread_count == 1) {
-    do_copy(0);
-  } else {
-    std::vector<std::thread> threads;
-    for (int i = 0; i < thread_count; ++i) {
-      threads.emplace_back([&, i]() { do_copy(i); });
-    }
-    for (auto& t : threads) {
-      t.join();
-    }
-  }
-
-  for (auto& s : thread_statuses) {
-    if (!s.ok()) {
-      st = s;
-      break;
-    }
+  // The copies within cloud storage run next to the uploads
+  Status copy_st;
+  std::thread copier([&]() {
+    copy_st = RunInParallel(
+        objects_to_copy.size(), options.copy_thread_count, [&](size_t i) {
+          const auto& o = objects_to_copy[i];
+          return provider->CopyCloudObject(
+              db_bucket, o.first, destination.GetBucketName(),
+              destination.GetObjectPath() + "/" + o.second);
+        });
+  });
+  st = RunInParallel(
+      files_to_copy.size(), options.thread_count, [&](size_t i) {
+        const auto& f = files_to_copy[i];
+        return provider->PutCloudObject(
+            GetName() + "/" + f.first, destination.GetBucketName(),
+            destination.GetObjectPath() + "/" + f.second);
+      });
+  copier.join();
+  if (st.ok()) {
+    st = copy_st;
   }
-
   if (!st.ok()) {
     return st;
   }
+  Log(InfoLogLevel::INFO_LEVEL, cenv->info_log_,
+      "[db_cloud] CheckpointToCloud %s/%s: copied %" ROCKSDB_PRIszt
+      " sst files in cloud storage, uploaded %" ROCKSDB_PRIszt
+      " files, skipped %" ROCKSDB_PRIszt " sst files of %" PRIu64 " bytes",
+      destination.GetBucketName().c_str(),
+      destination.GetObjectPath().c_str(), objects_to_copy.size(),
+      files_to_copy.size(), skipped, skipped_bytes);
 
   // Ignore errors
   base_env->DeleteFile(tmp_manifest_fname);
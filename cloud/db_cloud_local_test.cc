@@ -0,0 +1,1377 @@
+// Copyright (c) 2017 Rockset
+
+#ifndef ROCKSDB_LITE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "cloud/cloud_block_cache.h"
+#include "cloud/cloud_deletion_queue.h"
+#include "cloud/cloud_env_impl.h"
+#include "cloud/cloud_log_applier.h"
+#include "cloud/cloud_log_controller_impl.h"
+#include "cloud/cloud_metadata_cache.h"
+#include "cloud/cloud_storage_provider_impl.h"
+#include "cloud/cloud_upload_pipeline.h"
+#include "cloud/filename.h"
+#include "rocksdb/cloud/db_cloud.h"
+#include "rocksdb/options.h"
+#include "rocksdb/statistics.h"
+#include "rocksdb/status.h"
+#include "test_util/testharness.h"
+#include "util/compression.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// Runs DBCloud on top of the local storage provider, so that it does not need
+// any cloud credentials.
+class CloudLocalTest : public testing::Test {
+ public:
+  CloudLocalTest() {
+    Random64 rng(time(nullptr));
+    test_id_ = std::to_string(rng.Next());
+    base_env_ = Env::Default();
+    dbname_ = test::TmpDir() + "/db_cloud_local-" + test_id_;
+    bucket_root_ = test::TmpDir() + "/db_cloud_local_bucket-" + test_id_;
+
+    cloud_env_options_.src_bucket.SetBucketName("localtest");
+    cloud_env_options_.src_bucket.SetObjectPath("db_cloud_local");
+    cloud_env_options_.dest_bucket = cloud_env_options_.src_bucket;
+    options_.create_if_missing = true;
+
+    DestroyDir(dbname_);
+    DestroyDir(bucket_root_);
+    base_env_->NewLogger(test::TmpDir(base_env_) + "/rocksdb-cloud-local.log",
+                         &options_.info_log);
+    options_.info_log->SetInfoLogLevel(InfoLogLevel::DEBUG_LEVEL);
+  }
+
+  virtual ~CloudLocalTest() {
+    CloseDB();
+    DestroyDir(dbname_);
+    DestroyDir(bucket_root_);
+  }
+
+  void DestroyDir(const std::string& dir) {
+    std::string cmd = "rm -rf " + dir;
+    int rc = system(cmd.c_str());
+    ASSERT_EQ(rc, 0);
+  }
+
+  void CreateCloudEnv() {
+    CloudEnvOptions copt = cloud_env_options_;
+    ASSERT_OK(CloudStorageProviderImpl::CreateLocalProvider(
+        bucket_root_, &copt.storage_provider, local_options_));
+    CloudEnv* cenv;
+    ASSERT_OK(CloudEnv::NewCloudEnv(base_env_, copt, options_.info_log, &cenv));
+    static_cast<CloudEnvImpl*>(cenv)->TEST_SetFileDeletionDelay(
+        std::chrono::seconds(0));
+    cenv_.reset(cenv);
+  }
+
+  void OpenDB() {
+    CreateCloudEnv();
+    options_.env = cenv_.get();
+    ASSERT_TRUE(db_ == nullptr);
+    ASSERT_OK(DBCloud::Open(options_, dbname_, "", 0, &db_));
+  }
+
+  void CloseDB() {
+    if (db_) {
+      db_->Flush(FlushOptions());
+      delete db_;
+      db_ = nullptr;
+    }
+    cenv_.reset();
+  }
+
+  // Returns the sst objects that are in the bucket
+  std::vector<std::string> GetCloudSstFiles() {
+    std::vector<std::string> objects, result;
+    EXPECT_OK(cenv_->GetCloudEnvOptions().storage_provider->ListCloudObjects(
+        cenv_->GetDestBucketName(), cenv_->GetDestObjectPath(), &objects));
+    for (const auto& o : objects) {
+      if (IsSstFile(RemoveEpoch(o))) {
+        result.push_back(o);
+      }
+    }
+    return result;
+  }
+
+ protected:
+  std::string test_id_;
+  Env* base_env_;
+  std::string dbname_;
+  std::string bucket_root_;
+  CloudEnvOptions cloud_env_options_;
+  LocalStorageProviderOptions local_options_;
+  Options options_;
+  std::unique_ptr<CloudEnv> cenv_;
+  DBCloud* db_ = nullptr;
+};
+
+TEST_F(CloudLocalTest, BasicTest) {
+  OpenDB();
+  ASSERT_OK(db_->Put(WriteOptions(), "Hello", "World"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  ASSERT_EQ(GetCloudSstFiles().size(), 1u);
+  CloseDB();
+
+  // Reopen from an empty local directory. Everything comes from the bucket.
+  DestroyDir(dbname_);
+  OpenDB();
+  std::string value;
+  ASSERT_OK(db_->Get(ReadOptions(), "Hello", &value));
+  ASSERT_EQ(value, "World");
+}
+
+TEST_F(CloudLocalTest, AsyncUpload) {
+  cloud_env_options_.async_upload_threads = 2;
+  cloud_env_options_.max_pending_uploads = 2;
+  OpenDB();
+  for (int i = 0; i < 5; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       "Value" + std::to_string(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  // Every flush syncs the MANIFEST, which waits for the uploads of the files
+  // that it references.
+  ASSERT_GE(GetCloudSstFiles().size(), 5u);
+  CloseDB();
+
+  DestroyDir(dbname_);
+  OpenDB();
+  for (int i = 0; i < 5; i++) {
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &value));
+    ASSERT_EQ(value, "Value" + std::to_string(i));
+  }
+}
+
+TEST_F(CloudLocalTest, ManifestDeltaUpload) {
+  cloud_env_options_.manifest_delta_upload = true;
+  cloud_env_options_.manifest_delta_compaction_trigger = 3;
+  OpenDB();
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider;
+  auto count_deltas = [&]() {
+    std::vector<std::string> objects;
+    EXPECT_OK(provider->ListCloudObjects(cenv_->GetDestBucketName(),
+                                         cenv_->GetDestObjectPath(),
+                                         &objects));
+    size_t n = 0;
+    for (const auto& o : objects) {
+      if (o.find(".delta-") != std::string::npos) {
+        n++;
+      }
+    }
+    return n;
+  };
+  // The first flush after open rolls a new MANIFEST, which is uploaded whole;
+  // the second one appends to it.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       "Value" + std::to_string(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  ASSERT_GT(count_deltas(), 0u);
+  for (int i = 2; i < 10; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       "Value" + std::to_string(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  // Compaction of the deltas bounds how many of them are kept
+  ASSERT_LE(count_deltas(), 6u);
+  CloseDB();
+
+  // Reopen from the bucket: the MANIFEST is rebuilt from its deltas
+  DestroyDir(dbname_);
+  OpenDB();
+  for (int i = 0; i < 10; i++) {
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &value));
+    ASSERT_EQ(value, "Value" + std::to_string(i));
+  }
+}
+
+TEST_F(CloudLocalTest, ManifestDeltaGap) {
+  cloud_env_options_.manifest_delta_upload = true;
+  cloud_env_options_.manifest_delta_compaction_trigger = 100;
+  OpenDB();
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       "Value" + std::to_string(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  CloseDB();
+
+  // Only the deltas are listed
+  CreateCloudEnv();
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider;
+  std::vector<std::string> objects;
+  ASSERT_OK(provider->ListCloudObjects(cenv_->GetDestBucketName(),
+                                       cenv_->GetDestObjectPath(), &objects));
+  std::string manifest;
+  for (const auto& o : objects) {
+    if (o.find(".delta-") == std::string::npos &&
+        o.compare(0, 9, "MANIFEST-") == 0) {
+      manifest = o;
+    }
+  }
+  ASSERT_FALSE(manifest.empty());
+  std::vector<std::string> deltas;
+  ASSERT_OK(provider->ListCloudObjectsWithPrefix(
+      cenv_->GetDestBucketName(), cenv_->GetDestObjectPath(),
+      ManifestDeltaPrefix(manifest), &deltas));
+  ASSERT_GE(deltas.size(), 2u);
+  for (const auto& d : deltas) {
+    ASSERT_TRUE(IsManifestDeltaFile(manifest, d));
+  }
+
+  // A missing delta fails the open rather than losing the later ones
+  ASSERT_OK(provider->DeleteCloudObject(
+      cenv_->GetDestBucketName(),
+      cenv_->GetDestObjectPath() + pathsep + deltas[0]));
+  cenv_.reset();
+  DestroyDir(dbname_);
+  CreateCloudEnv();
+  options_.env = cenv_.get();
+  ASSERT_NOK(DBCloud::Open(options_, dbname_, "", 0, &db_));
+  ASSERT_TRUE(db_ == nullptr);
+}
+
+TEST_F(CloudLocalTest, SstBlockCache) {
+  const std::string cache_dir = dbname_ + "-blockcache";
+  DestroyDir(cache_dir);
+  cloud_env_options_.keep_local_sst_files = false;
+  cloud_env_options_.sst_block_cache_path = cache_dir;
+  cloud_env_options_.sst_block_cache_size = 64 << 20;
+  cloud_env_options_.sst_block_cache_block_size = 4096;
+  cloud_env_options_.statistics = CreateDBStatistics();
+  OpenDB();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       std::string(100, 'a' + i % 26)));
+  }
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  CloseDB();
+
+  auto read_all = [&]() {
+    for (int i = 0; i < 100; i++) {
+      std::string value;
+      ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &value));
+      ASSERT_EQ(value, std::string(100, 'a' + i % 26));
+    }
+  };
+  auto cache = [&]() {
+    return static_cast<CloudEnvImpl*>(cenv_.get())->GetSstBlockCache();
+  };
+
+  // The blocks were cached when the flush verified the new table
+  OpenDB();
+  ASSERT_NE(cache(), nullptr);
+  read_all();
+  ASSERT_GT(cache()->GetStats().hits, 0u);
+  ASSERT_EQ(cache()->GetStats().misses, 0u);
+  CloseDB();
+
+  // Blocks that are not cached are read from cloud storage
+  DestroyDir(cache_dir);
+  OpenDB();
+  read_all();
+  ASSERT_GT(cache()->GetStats().misses, 0u);
+  ASSERT_GT(cache()->GetStats().bytes_inserted, 0u);
+  CloseDB();
+
+  // The cache survives a restart
+  OpenDB();
+  read_all();
+  auto stats = cache()->GetStats();
+  ASSERT_GT(stats.hits, 0u);
+  ASSERT_GT(stats.usage, 0u);
+  auto statistics = cloud_env_options_.statistics;
+  ASSERT_GE(statistics->getTickerCount(PERSISTENT_CACHE_HIT), stats.hits);
+  ASSERT_GT(statistics->getTickerCount(PERSISTENT_CACHE_MISS), 0u);
+  CloseDB();
+  DestroyDir(cache_dir);
+}
+
+TEST_F(CloudLocalTest, SstBlockCacheRecovery) {
+  const std::string cache_dir = dbname_ + "-blockcache";
+  DestroyDir(cache_dir);
+  std::unique_ptr<CloudBlockCache> cache;
+  ASSERT_OK(CloudBlockCache::Open(base_env_, cache_dir, 3 * 1024, 1024,
+                                  options_.info_log, nullptr, &cache));
+  const std::string block(1000, 'x');
+  ASSERT_OK(cache->Insert("bucket/000001.sst", "v1", 0, block));
+  ASSERT_OK(cache->Insert("bucket/000001.sst", "v1", 1, block));
+  std::string data;
+  ASSERT_OK(cache->Lookup("bucket/000001.sst", "v1", 0, 0, 1024, &data));
+  ASSERT_EQ(data, block);
+  ASSERT_OK(cache->Lookup("bucket/000001.sst", "v1", 0, 100, 200, &data));
+  ASSERT_EQ(data, block.substr(100, 200));
+  ASSERT_OK(cache->Lookup("bucket/000001.sst", "v1", 0, 900, 200, &data));
+  ASSERT_EQ(data, block.substr(900));
+  // another version of the object, whose block is dropped
+  ASSERT_TRUE(cache->Lookup("bucket/000001.sst", "v2", 0, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_TRUE(cache->Lookup("bucket/000001.sst", "v1", 0, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_OK(cache->Insert("bucket/000001.sst", "v1", 0, block));
+
+  // Evicts block 1, the least recently used one
+  ASSERT_OK(cache->Insert("bucket/000002.sst", "v1", 0, block));
+  ASSERT_GT(cache->GetStats().evictions, 0u);
+  ASSERT_TRUE(cache->Lookup("bucket/000001.sst", "v1", 1, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_OK(cache->Lookup("bucket/000001.sst", "v1", 0, 0, 1024, &data));
+
+  // The LRU order survives a restart: 000002.sst is the least recently used
+  // block now and is evicted first
+  cache.reset();
+  ASSERT_OK(CloudBlockCache::Open(base_env_, cache_dir, 3 * 1024, 1024,
+                                  options_.info_log, nullptr, &cache));
+  ASSERT_OK(cache->Insert("bucket/000004.sst", "v1", 0, block));
+  ASSERT_TRUE(cache->Lookup("bucket/000002.sst", "v1", 0, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_OK(cache->Lookup("bucket/000001.sst", "v1", 0, 0, 1024, &data));
+
+  // A torn block and a leftover temporary file from a crash
+  std::vector<std::string> files;
+  ASSERT_OK(base_env_->GetChildren(cache_dir, &files));
+  for (const auto& f : files) {
+    if (f.size() > 4 && f.substr(f.size() - 4) == ".blk") {
+      ASSERT_OK(WriteStringToFile(base_env_, "torn", cache_dir + "/" + f));
+    }
+  }
+  ASSERT_OK(WriteStringToFile(base_env_, "partial", cache_dir + "/7.tmp"));
+  cache.reset();
+
+  ASSERT_OK(CloudBlockCache::Open(base_env_, cache_dir, 3 * 1024, 1024,
+                                  options_.info_log, nullptr, &cache));
+  ASSERT_TRUE(base_env_->FileExists(cache_dir + "/7.tmp").IsNotFound());
+  ASSERT_GT(cache->GetStats().usage, 0u);
+  ASSERT_TRUE(cache->Lookup("bucket/000001.sst", "v1", 0, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_TRUE(cache->Lookup("bucket/000004.sst", "v1", 0, 0, 1024, &data)
+                  .IsNotFound());
+  ASSERT_EQ(cache->GetStats().usage, 0u);
+
+  ASSERT_OK(cache->Insert("bucket/000003.sst", "v1", 0, block));
+  cache->Erase("bucket/000003.sst");
+  ASSERT_TRUE(cache->Lookup("bucket/000003.sst", "v1", 0, 0, 1024, &data)
+                  .IsNotFound());
+  cache.reset();
+  DestroyDir(cache_dir);
+}
+
+namespace {
+// A cloud file backed by a string that counts the requests made to it
+class StringCloudReadableFile : public CloudStorageReadableFileImpl {
+ public:
+  StringCloudReadableFile(const std::shared_ptr<Logger>& info_log,
+                          const std::string& data)
+      : CloudStorageReadableFileImpl(info_log, "bucket", "000001.sst",
+                                     data.size()),
+        data_(data),
+        requests_(0) {}
+
+  int requests() const { return requests_.load(); }
+
+ protected:
+  Status DoCloudRead(uint64_t offset, size_t n, char* scratch,
+                     uint64_t* bytes_read) const override {
+    requests_++;
+    *bytes_read = std::min<uint64_t>(n, data_.size() - offset);
+    memcpy(scratch, data_.data() + offset, *bytes_read);
+    return Status::OK();
+  }
+
+ private:
+  const std::string data_;
+  mutable std::atomic<int> requests_;
+};
+}  // namespace
+
+TEST_F(CloudLocalTest, Readahead) {
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 1024 * 1024; i++) {
+    data.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  StringCloudReadableFile file(options_.info_log, data);
+  file.SetReadahead(64 * 1024, 256 * 1024);
+  const RandomAccessFile& rfile = file;
+
+  // A sequential scan in 4KB reads grows the readahead to 256KB
+  char scratch[4096];
+  for (size_t offset = 0; offset < data.size(); offset += sizeof(scratch)) {
+    Slice result;
+    ASSERT_OK(rfile.Read(offset, sizeof(scratch), &result, scratch));
+    ASSERT_EQ(result.ToString(), data.substr(offset, sizeof(scratch)));
+  }
+  ASSERT_LT(file.requests(), 10);
+
+  // Random reads do not read ahead
+  int before = file.requests();
+  for (int i = 0; i < 10; i++) {
+    uint64_t offset = (i * 7919 * 13) % (data.size() - sizeof(scratch));
+    Slice result;
+    ASSERT_OK(rfile.Read(offset, 100, &result, scratch));
+    ASSERT_EQ(result.ToString(), data.substr(offset, 100));
+  }
+  ASSERT_EQ(file.requests(), before + 10);
+
+  // Nearby reads of a batch are merged, far away ones are not
+  std::vector<std::string> buffers(5, std::string(4096, '\0'));
+  std::vector<ReadRequest> reqs(5);
+  const uint64_t offsets[] = {40960, 8192, 0, 900 * 1024, 20000};
+  for (size_t i = 0; i < reqs.size(); i++) {
+    reqs[i].offset = offsets[i];
+    reqs[i].len = 4096;
+    reqs[i].scratch = &buffers[i][0];
+  }
+  before = file.requests();
+  ASSERT_OK(file.MultiRead(reqs.data(), reqs.size()));
+  ASSERT_EQ(file.requests(), before + 2);
+  for (const auto& req : reqs) {
+    ASSERT_OK(req.status);
+    ASSERT_EQ(req.result.ToString(), data.substr(req.offset, req.len));
+  }
+
+  // Reads of a prefetched range, in any order, take no further request,
+  // also when other reads come in between; the range is dropped once enough
+  // other readers came along
+  const uint64_t tail = data.size() - 512 * 1024;
+  before = file.requests();
+  ASSERT_OK(file.Prefetch(tail, 512 * 1024));
+  ASSERT_EQ(file.requests(), before + 1);
+  const uint64_t tail_offsets[] = {data.size() - 48, tail + 1000, tail};
+  for (uint64_t offset : tail_offsets) {
+    Slice result;
+    ASSERT_OK(rfile.Read(offset, 48, &result, scratch));
+    ASSERT_EQ(result.ToString(), data.substr(offset, 48));
+  }
+  ASSERT_EQ(file.requests(), before + 1);
+  Slice result;
+  ASSERT_OK(rfile.Read(0, 100, &result, scratch));
+  ASSERT_OK(rfile.Read(tail + 100, 100, &result, scratch));
+  ASSERT_EQ(result.ToString(), data.substr(tail + 100, 100));
+  ASSERT_EQ(file.requests(), before + 2);
+  for (int i = 1; i <= 4; i++) {
+    ASSERT_OK(rfile.Read(i * 1000, 100, &result, scratch));
+  }
+  ASSERT_OK(rfile.Read(tail + 5000, 100, &result, scratch));
+  ASSERT_EQ(result.ToString(), data.substr(tail + 5000, 100));
+  ASSERT_EQ(file.requests(), before + 7);
+
+  // Interleaved scans of two halves of the file both read ahead
+  before = file.requests();
+  const size_t half = data.size() / 2;
+  for (size_t offset = 0; offset < half; offset += sizeof(scratch)) {
+    for (size_t start : {size_t(0), half}) {
+      ASSERT_OK(rfile.Read(start + offset, sizeof(scratch), &result, scratch));
+      ASSERT_EQ(result.ToString(),
+                data.substr(start + offset, sizeof(scratch)));
+    }
+  }
+  ASSERT_LT(file.requests(), before + 40);
+}
+
+TEST_F(CloudLocalTest, SstBlockCacheMultiRead) {
+  const std::string cache_dir = dbname_ + "-blockcache";
+  DestroyDir(cache_dir);
+  std::unique_ptr<CloudBlockCache> cache;
+  ASSERT_OK(CloudBlockCache::Open(base_env_, cache_dir, 1024 * 1024, 4096,
+                                  options_.info_log, nullptr, &cache));
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 256 * 1024; i++) {
+    data.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  auto string_file = new StringCloudReadableFile(options_.info_log, data);
+  string_file->SetReadahead(64 * 1024, 256 * 1024);
+  std::unique_ptr<CloudStorageReadableFile> file = cache->NewReadableFile(
+      std::unique_ptr<CloudStorageReadableFile>(string_file),
+      "bucket/000001.sst", "v1", data.size());
+
+  // The missing blocks of a batch are read with one request per group of
+  // nearby blocks, and then served from the cache
+  const uint64_t offsets[] = {40960, 8000, 0, 200 * 1024, 20000};
+  std::vector<std::string> buffers(5, std::string(6000, '\0'));
+  std::vector<ReadRequest> reqs(5);
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < reqs.size(); i++) {
+      reqs[i].offset = offsets[i];
+      reqs[i].len = 6000;
+      reqs[i].scratch = &buffers[i][0];
+    }
+    ASSERT_OK(file->MultiRead(reqs.data(), reqs.size()));
+    for (const auto& req : reqs) {
+      ASSERT_OK(req.status);
+      ASSERT_EQ(req.result.ToString(), data.substr(req.offset, req.len));
+    }
+    ASSERT_EQ(string_file->requests(), 2);
+  }
+  ASSERT_GT(cache->GetStats().hits, 0u);
+  file.reset();
+  cache.reset();
+  DestroyDir(cache_dir);
+}
+
+TEST_F(CloudLocalTest, ParallelTransfer) {
+  cloud_env_options_.transfer_threads = 4;
+  cloud_env_options_.transfer_part_size = 4096;
+  CreateCloudEnv();
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider;
+  ASSERT_OK(provider->CreateBucket("localtest"));
+
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 100 * 1000; i++) {
+    data.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  ASSERT_OK(base_env_->CreateDirIfMissing(dbname_));
+  const std::string src = dbname_ + "/src";
+  const std::string dest = dbname_ + "/dest";
+  ASSERT_OK(WriteStringToFile(base_env_, data, src));
+  ASSERT_OK(provider->PutCloudObject(src, "localtest", "dir/object"));
+  uint64_t size = 0;
+  ASSERT_OK(provider->GetCloudObjectSize("localtest", "dir/object", &size));
+  ASSERT_EQ(size, data.size());
+
+  // An object of unknown size is downloaded in one request
+  ASSERT_OK(provider->GetCloudObject("localtest", "dir/object", dest));
+  std::string result;
+  ASSERT_OK(ReadFileToString(base_env_, dest, &result));
+  ASSERT_TRUE(result == data);
+
+  // The checksums of the parts are stored with the object and verified by a
+  // download in parts
+  CloudObjectInformation info;
+  ASSERT_OK(provider->GetCloudObjectMetadata("localtest", "dir/object", &info));
+  ASSERT_EQ(info.metadata.count("part-crc32c"), 1u);
+  ASSERT_OK(base_env_->DeleteFile(dest));
+  ASSERT_OK(provider->GetCloudObjectOfSize("localtest", "dir/object", dest,
+                                           data.size()));
+  ASSERT_OK(ReadFileToString(base_env_, dest, &result));
+  ASSERT_TRUE(result == data);
+
+  std::string corrupt = data;
+  corrupt[5000] ^= 1;
+  ASSERT_OK(WriteStringToFile(
+      base_env_, corrupt, bucket_root_ + "/localtest/dir/object", false));
+  ASSERT_TRUE(provider
+                  ->GetCloudObjectOfSize("localtest", "dir/object", dest,
+                                         data.size())
+                  .IsCorruption());
+  cenv_.reset();
+
+  // A database whose files are transferred in parts
+  OpenDB();
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       data.substr(i * 50, 50)));
+  }
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  CloseDB();
+  DestroyDir(dbname_);
+  OpenDB();
+  for (int i = 0; i < 1000; i++) {
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &value));
+    ASSERT_TRUE(value == data.substr(i * 50, 50));
+  }
+}
+
+TEST_F(CloudLocalTest, EmulatedObjectStore) {
+  ASSERT_OK(base_env_->CreateDirIfMissing(dbname_));
+  const std::string src = dbname_ + "/src";
+  ASSERT_OK(WriteStringToFile(base_env_, std::string(300 * 1024, 'x'), src));
+
+  // Listings are paged, and every page takes the latency of a request
+  cloud_env_options_.number_objects_listed_in_one_iteration = 2;
+  local_options_.latency_micros = 10 * 1000;
+  CreateCloudEnv();
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider;
+  ASSERT_OK(provider->CreateBucket("localtest"));
+  for (int i = 0; i < 5; i++) {
+    ASSERT_OK(provider->PutCloudObjectMetadata(
+        "localtest", "dir/object" + std::to_string(i), {}));
+  }
+  std::vector<std::string> objects;
+  uint64_t start = base_env_->NowMicros();
+  ASSERT_OK(provider->ListCloudObjects("localtest", "dir", &objects));
+  ASSERT_GE(base_env_->NowMicros() - start, 3 * 10 * 1000u);
+  ASSERT_EQ(objects.size(), 5u);
+  ASSERT_EQ(objects[0], "object0");
+  ASSERT_EQ(objects[4], "object4");
+  // A listing of a prefix pages through the objects that match it
+  objects.clear();
+  ASSERT_OK(provider->ListCloudObjectsWithPrefix("localtest", "dir", "object3",
+                                                 &objects));
+  ASSERT_EQ(objects, std::vector<std::string>{"object3"});
+
+  // Objects that were just written are not listed yet
+  local_options_ = LocalStorageProviderOptions();
+  local_options_.list_visibility_delay_micros = 3600ull * 1000 * 1000;
+  CreateCloudEnv();
+  provider = cenv_->GetCloudEnvOptions().storage_provider;
+  ASSERT_OK(provider->PutCloudObject(src, "localtest", "dir/new"));
+  ASSERT_OK(provider->ExistsCloudObject("localtest", "dir/new"));
+  objects.clear();
+  ASSERT_OK(provider->ListCloudObjects("localtest", "dir", &objects));
+  ASSERT_EQ(objects.size(), 5u);
+
+  // Transfers share the bandwidth
+  local_options_ = LocalStorageProviderOptions();
+  local_options_.bandwidth_bytes_per_sec = 1024 * 1024;
+  CreateCloudEnv();
+  provider = cenv_->GetCloudEnvOptions().storage_provider;
+  start = base_env_->NowMicros();
+  ASSERT_OK(provider->PutCloudObject(src, "localtest", "dir/new"));
+  ASSERT_GE(base_env_->NowMicros() - start, 100 * 1000u);
+
+  // A repeatable fraction of the requests fails
+  local_options_ = LocalStorageProviderOptions();
+  local_options_.failure_rate = 0.5;
+  int failures[2] = {0, 0};
+  for (int run = 0; run < 2; run++) {
+    CreateCloudEnv();
+    provider = cenv_->GetCloudEnvOptions().storage_provider;
+    for (int i = 0; i < 100; i++) {
+      Status st = provider->ExistsCloudObject("localtest", "dir/new");
+      if (!st.ok()) {
+        ASSERT_TRUE(st.IsIOError());
+        failures[run]++;
+      }
+    }
+  }
+  ASSERT_GT(failures[0], 20);
+  ASSERT_LT(failures[0], 80);
+  ASSERT_EQ(failures[0], failures[1]);
+}
+
+TEST_F(CloudLocalTest, SstPrefetch) {
+  cloud_env_options_.keep_local_sst_files = true;
+  cloud_env_options_.sst_prefetch_threads = 1;
+  // Leave the opening of the tables to the reads
+  options_.max_open_files = 20;
+  options_.skip_stats_update_on_db_open = true;
+  // Every file stays in L0, where files are prefetched newest first
+  options_.disable_auto_compactions = true;
+  options_.compression = kNoCompression;
+  auto value = [](int i) {
+    return "Value" + std::to_string(i) + std::string(64 * 1024, 'x');
+  };
+  OpenDB();
+  for (int i = 0; i < 8; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i), value(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  CloseDB();
+
+  // The slow transfers keep most files queued after the open, so the opens
+  // below claim the files that are still queued and wait for the one that
+  // is being downloaded. The files are opened oldest first.
+  DestroyDir(dbname_);
+  local_options_.bandwidth_bytes_per_sec = 1024 * 1024;
+  OpenDB();
+  std::vector<LiveFileMetaData> live;
+  db_->GetLiveFilesMetaData(&live);
+  ASSERT_EQ(live.size(), 8u);
+  std::sort(live.begin(), live.end(),
+            [](const LiveFileMetaData& a, const LiveFileMetaData& b) {
+              return a.largest_seqno < b.largest_seqno;
+            });
+  for (const auto& f : live) {
+    std::unique_ptr<RandomAccessFile> file;
+    ASSERT_OK(
+        cenv_->NewRandomAccessFile(dbname_ + f.name, &file, EnvOptions()));
+  }
+  for (int i = 0; i < 8; i++) {
+    std::string v;
+    ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &v));
+    ASSERT_EQ(v, value(i));
+  }
+  static_cast<CloudEnvImpl*>(cenv_.get())->TEST_WaitForSstPrefetch();
+  // Every live file is local, whether it was claimed or prefetched
+  for (const auto& f : live) {
+    ASSERT_OK(base_env_->FileExists(
+        cenv_->RemapFilename(dbname_ + f.name)));
+  }
+}
+
+TEST_F(CloudLocalTest, ValidateFileSize) {
+  cloud_env_options_.keep_local_sst_files = true;
+  cloud_env_options_.validate_filesize = true;
+  OpenDB();
+  ASSERT_OK(db_->Put(WriteOptions(), "Hello", "World"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  CloseDB();
+
+  // Reopening checks the local sst files against the sizes in the MANIFEST
+  OpenDB();
+  CloseDB();
+
+  std::vector<std::string> children;
+  ASSERT_OK(base_env_->GetChildren(dbname_, &children));
+  std::string sst;
+  for (const auto& c : children) {
+    if (IsSstFile(RemoveEpoch(c))) {
+      sst = dbname_ + "/" + c;
+    }
+  }
+  ASSERT_FALSE(sst.empty());
+  std::string data;
+  ASSERT_OK(ReadFileToString(base_env_, sst, &data));
+  ASSERT_OK(WriteStringToFile(base_env_, data.substr(0, data.size() - 1), sst));
+
+  CreateCloudEnv();
+  options_.env = cenv_.get();
+  ASSERT_TRUE(DBCloud::Open(options_, dbname_, "", 0, &db_).IsIOError());
+}
+
+TEST_F(CloudLocalTest, ObjectMetadataCache) {
+  cloud_env_options_.keep_local_sst_files = false;
+  cloud_env_options_.use_object_metadata_cache = true;
+  OpenDB();
+  ASSERT_OK(db_->Put(WriteOptions(), "Hello", "World"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+
+  auto cimpl = static_cast<CloudEnvImpl*>(cenv_.get());
+  std::vector<LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  ASSERT_EQ(files.size(), 1u);
+  std::string sst = dbname_ + files[0].name;
+  ASSERT_TRUE(base_env_->FileExists(cenv_->RemapFilename(sst)).IsNotFound());
+
+  // The upload of the sst file was recorded in the cache
+  auto before = cimpl->GetObjectMetadataCacheStats();
+  uint64_t size = 0;
+  ASSERT_OK(cenv_->GetFileSize(sst, &size));
+  ASSERT_EQ(size, files[0].size);
+  ASSERT_OK(cenv_->FileExists(sst));
+  auto after = cimpl->GetObjectMetadataCacheStats();
+  ASSERT_EQ(after.hits, before.hits + 2);
+  ASSERT_EQ(after.misses, before.misses);
+
+  // The second listing is answered by the cache
+  std::vector<std::string> children;
+  ASSERT_OK(cenv_->GetChildren(dbname_, &children));
+  ASSERT_OK(cenv_->GetChildren(dbname_, &children));
+  before = after;
+  after = cimpl->GetObjectMetadataCacheStats();
+  ASSERT_GE(after.listing_hits, before.listing_hits + 1);
+
+  // Files that were never uploaded are known not to exist
+  std::string missing = dbname_ + "/999999.sst";
+  ASSERT_TRUE(cenv_->FileExists(missing).IsNotFound());
+  ASSERT_TRUE(cenv_->GetFileSize(missing, &size).IsNotFound());
+
+  // Deleted files are dropped from the cache once their objects are deleted.
+  // The env outlives the db here.
+  delete db_;
+  db_ = nullptr;
+  cimpl->TEST_SetFileDeletionDelay(std::chrono::seconds(0));
+  ASSERT_OK(cimpl->DeleteCloudFileFromDest(cenv_->RemapFilename(sst)));
+  cimpl->TEST_WaitForDeletions();
+  ASSERT_TRUE(cenv_->FileExists(sst).IsNotFound());
+}
+
+TEST_F(CloudLocalTest, ObjectMetadataCacheCapacity) {
+  CloudMetadataCache cache(base_env_, 1000000, 2);
+  CloudObjectInformation info;
+  info.size = 1;
+  cache.Add("bucket", "db/1.sst", info, false);
+  cache.Add("bucket", "db/2.sst", info, false);
+  ASSERT_OK(cache.Lookup("bucket", "db/1.sst", &info));
+  // 2.sst is the least recently used one
+  cache.Add("bucket", "db/3.sst", info, false);
+  ASSERT_OK(cache.Lookup("bucket", "db/1.sst", &info));
+  ASSERT_TRUE(cache.Lookup("bucket", "db/2.sst", &info).IsIncomplete());
+  ASSERT_OK(cache.Lookup("bucket", "db/3.sst", &info));
+
+  // A dropped object that is in a listing is not reported as missing
+  cache.AddListing("bucket", "db", {"1.sst", "2.sst", "3.sst"}, {}, false);
+  ASSERT_TRUE(cache.Lookup("bucket", "db/2.sst", &info).IsIncomplete());
+  ASSERT_TRUE(cache.Lookup("bucket", "db/4.sst", &info).IsNotFound());
+}
+
+// A log controller without a stream, that applies the records it is given
+class TestLogController : public CloudLogControllerImpl {
+ public:
+  const char* Name() const override { return "testlog"; }
+  Status CreateStream(const std::string& /*topic*/) override {
+    return Status::OK();
+  }
+  Status WaitForStreamReady(const std::string& /*topic*/) override {
+    return Status::OK();
+  }
+  Status TailStream() override { return Status::OK(); }
+  CloudLogWritableFile* CreateWritableFile(
+      const std::string& /*fname*/, const EnvOptions& /*options*/) override {
+    return nullptr;
+  }
+  using CloudLogControllerImpl::Apply;
+  using CloudLogControllerImpl::Initialize;
+};
+
+TEST_F(CloudLocalTest, LogBatches) {
+  CompressionType compression = kNoCompression;
+  for (auto c : {kSnappyCompression, kLZ4Compression, kZSTD}) {
+    if (CompressionTypeSupported(c)) {
+      compression = c;
+      break;
+    }
+  }
+  cloud_env_options_.log_batch_size = 1024;
+  cloud_env_options_.log_batch_delay_micros = 20 * 1000;
+  cloud_env_options_.log_compression = compression;
+  CreateCloudEnv();
+  TestLogController controller;
+  ASSERT_OK(controller.Initialize(cenv_.get()));
+
+  std::mutex mutex;
+  std::vector<std::string> messages;
+  auto num_messages = [&]() {
+    std::lock_guard<std::mutex> lk(mutex);
+    return messages.size();
+  };
+  auto batcher = controller.NewBatcher([&](const Slice& message) {
+    std::lock_guard<std::mutex> lk(mutex);
+    messages.push_back(message.ToString());
+    return Status::OK();
+  });
+  ASSERT_TRUE(batcher != nullptr);
+
+  // Full batches are sent right away
+  const std::string fname = "/wal/000001.log";
+  std::string expected;
+  std::string record;
+  for (int i = 0; i < 20; i++) {
+    std::string data(100, static_cast<char>('a' + i));
+    record.clear();
+    CloudLogControllerImpl::SerializeLogRecordAppend(fname, data,
+                                                     expected.size(), &record);
+    expected += data;
+    ASSERT_OK(batcher->Add(record));
+  }
+  ASSERT_EQ(num_messages(), 2u);
+  if (compression != kNoCompression) {
+    ASSERT_LT(messages[0].size(), 1024u);
+  }
+
+  // The rest is sent once it is due
+  for (int i = 0; i < 100 && num_messages() < 3; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(num_messages(), 3u);
+
+  record.clear();
+  CloudLogControllerImpl::SerializeLogRecordClosed(fname, expected.size(),
+                                                   &record);
+  ASSERT_OK(batcher->Add(record));
+  ASSERT_OK(batcher->Stop());
+  ASSERT_EQ(num_messages(), 4u);
+  ASSERT_TRUE(batcher->Add(record).IsIOError());
+
+  // The tailer unpacks the batches
+  for (const auto& m : messages) {
+    ASSERT_OK(controller.Apply(m));
+  }
+  std::string contents;
+  ASSERT_OK(ReadFileToString(
+      base_env_, controller.GetCacheDir() + "/000001.log", &contents));
+  ASSERT_TRUE(contents == expected);
+  // The appends of a batch are applied with a single write
+  auto stats = controller.GetTailerStats();
+  ASSERT_EQ(stats.records_applied, 21u);
+  ASSERT_EQ(stats.bytes_applied, expected.size());
+  ASSERT_EQ(stats.writes, 3u);
+  ASSERT_EQ(stats.records_behind, 0u);
+  DestroyDir(controller.GetCacheDir());
+}
+
+TEST_F(CloudLocalTest, LocalLogStream) {
+  LocalLogControllerOptions log_options;
+  log_options.ack_latency_micros = 1000;
+  log_options.ack_latency_jitter_micros = 5000;
+  log_options.bandwidth_bytes_per_sec = 1 << 20;
+  log_options.reorder_probability = 0.3;
+  log_options.reorder_delay_micros = 10 * 1000;
+  ASSERT_OK(CloudLogControllerImpl::CreateLocalController(
+      &cloud_env_options_.cloud_log_controller, log_options));
+  cloud_env_options_.keep_local_log_files = false;
+  CreateCloudEnv();
+
+  // A replica in the same process tails the stream of the same topic
+  CloudEnvOptions replica_options = cloud_env_options_;
+  ASSERT_OK(CloudStorageProviderImpl::CreateLocalProvider(
+      bucket_root_, &replica_options.storage_provider));
+  ASSERT_OK(CloudLogControllerImpl::CreateLocalController(
+      &replica_options.cloud_log_controller));
+  CloudEnv* env;
+  ASSERT_OK(CloudEnv::NewCloudEnv(base_env_, replica_options,
+                                  options_.info_log, &env));
+  std::unique_ptr<CloudEnv> replica(env);
+
+  // The sync waits until the bandwidth let every write through
+  const std::string fname = dbname_ + "/000042.log";
+  std::unique_ptr<WritableFile> file;
+  ASSERT_OK(cenv_->NewWritableFile(fname, &file, EnvOptions()));
+  std::string expected;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 64; i++) {
+    std::string data(1024, static_cast<char>('a' + (i % 26)));
+    ASSERT_OK(file->Append(data));
+    expected += data;
+  }
+  ASSERT_OK(file->Sync());
+  ASSERT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(60));
+  ASSERT_OK(file->Close());
+
+  // Reordered acknowledgements do not reorder the stream
+  auto replica_log = static_cast<CloudLogControllerImpl*>(
+      replica_options.cloud_log_controller.get());
+  for (int i = 0; i < 500; i++) {
+    auto stats = replica_log->GetTailerStats();
+    if (stats.records_applied == 65 && stats.records_behind == 0) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(replica_log->GetTailerStats().records_applied, 65u);
+  std::string contents;
+  ASSERT_OK(ReadFileToString(replica.get(), fname, &contents));
+  ASSERT_TRUE(contents == expected);
+
+  std::vector<std::string> cache_dirs = {
+      cloud_env_options_.cloud_log_controller->GetCacheDir(),
+      replica_log->GetCacheDir()};
+  replica.reset();
+  CloseDB();
+  for (const auto& dir : cache_dirs) {
+    DestroyDir(dir);
+  }
+}
+
+TEST_F(CloudLocalTest, LogApplier) {
+  const std::string dir = test::TmpDir() + "/log_applier-" + test_id_;
+  ASSERT_OK(base_env_->CreateDirIfMissing(dir));
+  const uint32_t kAppend = CloudLogControllerImpl::kAppend;
+
+  // Appends at adjacent offsets are coalesced, and files stay open
+  {
+    CloudLogApplier applier(base_env_, 0, options_.info_log);
+    const std::string a = dir + "/a.log";
+    const std::string b = dir + "/b.log";
+    for (int i = 0; i < 10; i++) {
+      ASSERT_OK(applier.Add(kAppend, a, i * 3, 0, "aaa"));
+      ASSERT_OK(applier.Add(kAppend, b, i, 0, "b"));
+    }
+    ASSERT_EQ(applier.GetStats().records_behind, 20u);
+    ASSERT_EQ(applier.GetStats().bytes_behind, 40u);
+    ASSERT_OK(applier.ApplyPending());
+    ASSERT_OK(applier.Add(kAppend, a, 30, 0, "aaa"));
+    ASSERT_OK(applier.Add(CloudLogControllerImpl::kClosed, a, 0, 33, ""));
+    ASSERT_OK(applier.Add(CloudLogControllerImpl::kDelete, b, 0, 0, ""));
+    ASSERT_OK(applier.ApplyPending());
+    auto stats = applier.GetStats();
+    ASSERT_EQ(stats.records_behind, 0u);
+    ASSERT_EQ(stats.records_applied, 23u);
+    ASSERT_EQ(stats.bytes_applied, 43u);
+    ASSERT_EQ(stats.writes, 3u);
+    std::string contents;
+    ASSERT_OK(ReadFileToString(base_env_, a, &contents));
+    ASSERT_EQ(contents, std::string(33, 'a'));
+    ASSERT_TRUE(base_env_->FileExists(b).IsNotFound());
+  }
+
+  // An error only fails the records of its file, and is reported once
+  {
+    CloudLogApplier applier(base_env_, 0, options_.info_log);
+    const std::string bad = dir + "/missing/bad.log";
+    const std::string c = dir + "/c.log";
+    ASSERT_OK(applier.Add(kAppend, bad, 0, 0, "xxx"));
+    ASSERT_OK(applier.Add(kAppend, c, 0, 0, "ccc"));
+    ASSERT_OK(applier.Add(kAppend, bad, 3, 0, "xxx"));
+    ASSERT_OK(applier.Add(CloudLogControllerImpl::kDelete, bad, 0, 0, ""));
+    ASSERT_OK(applier.Add(kAppend, c, 3, 0, "ccc"));
+    ASSERT_OK(applier.Add(CloudLogControllerImpl::kClosed, c, 0, 6, ""));
+    ASSERT_NOK(applier.ApplyPending());
+    ASSERT_EQ(applier.GetStats().records_behind, 0u);
+    ASSERT_EQ(applier.GetStats().records_applied, 6u);
+    std::string contents;
+    ASSERT_OK(ReadFileToString(base_env_, c, &contents));
+    ASSERT_EQ(contents, "cccccc");
+    ASSERT_OK(applier.Add(kAppend, bad, 6, 0, "xxx"));
+    ASSERT_OK(applier.Add(kAppend, c, 6, 0, "ccc"));
+    ASSERT_NOK(applier.ApplyPending());
+    ASSERT_OK(applier.Add(kAppend, c, 9, 0, "ccc"));
+    ASSERT_OK(applier.ApplyPending());
+  }
+
+  // Files are applied in parallel, the records of each file in order
+  {
+    CloudLogApplier applier(base_env_, 4, options_.info_log);
+    const size_t kFiles = 8;
+    const size_t kRecords = 200;
+    for (size_t i = 0; i < kRecords; i++) {
+      for (size_t f = 0; f < kFiles; f++) {
+        std::string fname = dir + "/" + std::to_string(f) + ".log";
+        std::string data(1, static_cast<char>('a' + (i % 26)));
+        ASSERT_OK(applier.Add(kAppend, fname, i, 0, data));
+      }
+    }
+    ASSERT_OK(applier.WaitForApplied());
+    auto stats = applier.GetStats();
+    ASSERT_EQ(stats.records_behind, 0u);
+    ASSERT_EQ(stats.bytes_behind, 0u);
+    ASSERT_EQ(stats.records_applied, kFiles * kRecords);
+    ASSERT_LE(stats.writes, kFiles * kRecords);
+    for (size_t f = 0; f < kFiles; f++) {
+      std::string contents;
+      ASSERT_OK(ReadFileToString(
+          base_env_, dir + "/" + std::to_string(f) + ".log", &contents));
+      ASSERT_EQ(contents.size(), kRecords);
+      for (size_t i = 0; i < kRecords; i++) {
+        ASSERT_EQ(contents[i], static_cast<char>('a' + (i % 26)));
+      }
+    }
+  }
+  DestroyDir(dir);
+}
+
+TEST_F(CloudLocalTest, PipelinedLogSyncs) {
+  // A sync waits for the messages before it, acknowledged in any order
+  CloudLogSyncTracker tracker;
+  ASSERT_EQ(tracker.Sent(), 1u);
+  ASSERT_EQ(tracker.Sent(), 2u);
+  ASSERT_EQ(tracker.Sent(), 3u);
+  tracker.Acknowledge(2, Status::OK());
+  ASSERT_EQ(tracker.durable(), 0u);
+  tracker.Acknowledge(1, Status::OK());
+  ASSERT_EQ(tracker.durable(), 2u);
+  ASSERT_OK(tracker.Wait(2, std::chrono::seconds(10)));
+  ASSERT_TRUE(tracker.Wait(3, std::chrono::milliseconds(10)).IsTimedOut());
+  tracker.Acknowledge(3, Status::IOError("lost"));
+  ASSERT_TRUE(tracker.Wait(3, std::chrono::seconds(10)).IsIOError());
+
+  // The syncs of concurrent log files overlap their round trips
+  const uint64_t latency = 50 * 1000;
+  LocalLogControllerOptions log_options;
+  log_options.ack_latency_micros = latency;
+  ASSERT_OK(CloudLogControllerImpl::CreateLocalController(
+      &cloud_env_options_.cloud_log_controller, log_options));
+  cloud_env_options_.keep_local_log_files = false;
+  OpenDB();
+  const int kThreads = 8;
+  const int kSyncs = 4;
+  std::vector<std::thread> threads;
+  std::atomic<int> failures(0);
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      std::unique_ptr<WritableFile> file;
+      std::string fname = dbname_ + "/00090" + std::to_string(t) + ".log";
+      if (!cenv_->NewWritableFile(fname, &file, EnvOptions()).ok()) {
+        failures++;
+        return;
+      }
+      for (int i = 0; i < kSyncs; i++) {
+        if (!file->Append("record").ok() || !file->Sync().ok()) {
+          failures++;
+        }
+      }
+      file->Close();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  ASSERT_EQ(failures.load(), 0);
+  ASSERT_LT(static_cast<uint64_t>(elapsed.count()),
+            kThreads * kSyncs * latency / 2);
+
+  // Durable writes go through the stream and are applied by the tailer
+  WriteOptions wo;
+  wo.sync = true;
+  ASSERT_OK(db_->Put(wo, "Hello", "World"));
+  std::string value;
+  ASSERT_OK(db_->Get(ReadOptions(), "Hello", &value));
+  ASSERT_EQ(value, "World");
+  uint64_t size = 0;
+  for (int i = 0; i < 100 && size < kSyncs * strlen("record"); i++) {
+    ASSERT_OK(cenv_->GetFileSize(dbname_ + "/000900.log", &size));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(size, kSyncs * strlen("record"));
+  std::string cache_dir =
+      cloud_env_options_.cloud_log_controller->GetCacheDir();
+  CloseDB();
+  cloud_env_options_.cloud_log_controller.reset();
+  DestroyDir(cache_dir);
+}
+
+TEST_F(CloudLocalTest, CheckpointToCloud) {
+  // The sst files are only in cloud storage, so they are copied there
+  cloud_env_options_.keep_local_sst_files = false;
+  OpenDB();
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "Key" + std::to_string(i),
+                       "Value" + std::to_string(i)));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+  }
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider;
+  BucketOptions checkpoint;
+  checkpoint.SetBucketName("localtest");
+  checkpoint.SetObjectPath("db_cloud_local_checkpoint");
+  ASSERT_OK(db_->CheckpointToCloud(checkpoint, CheckpointToCloudOptions()));
+
+  std::vector<std::string> names;
+  std::vector<CloudObjectInformation> infos;
+  ASSERT_OK(provider->ListCloudObjectsWithInfo(checkpoint.GetBucketName(),
+                                               checkpoint.GetObjectPath(),
+                                               &names, &infos));
+  std::string sst;
+  uint64_t sst_size = 0;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (IsSstFile(RemoveEpoch(names[i]))) {
+      sst = names[i];
+      sst_size = infos[i].size;
+    }
+  }
+  ASSERT_FALSE(sst.empty());
+
+  // Replace a checkpointed file by one of the same size. It is taken for
+  // the same file by the next checkpoint, which skips it.
+  const std::string sst_object = checkpoint.GetObjectPath() + "/" + sst;
+  const std::string local_copy = dbname_ + "-sst";
+  ASSERT_OK(WriteStringToFile(base_env_, std::string(sst_size, 'x'),
+                              local_copy));
+  ASSERT_OK(provider->PutCloudObject(local_copy, checkpoint.GetBucketName(),
+                                     sst_object));
+  auto read_sst = [&]() {
+    std::string contents;
+    EXPECT_OK(provider->GetCloudObject(checkpoint.GetBucketName(), sst_object,
+                                       local_copy));
+    EXPECT_OK(ReadFileToString(base_env_, local_copy, &contents));
+    return contents;
+  };
+  ASSERT_OK(db_->CheckpointToCloud(checkpoint, CheckpointToCloudOptions()));
+  ASSERT_EQ(read_sst(), std::string(sst_size, 'x'));
+
+  CheckpointToCloudOptions no_skip;
+  no_skip.skip_existing_files = false;
+  no_skip.copy_thread_count = 1;
+  ASSERT_OK(db_->CheckpointToCloud(checkpoint, no_skip));
+  ASSERT_NE(read_sst(), std::string(sst_size, 'x'));
+  ASSERT_OK(base_env_->DeleteFile(local_copy));
+  CloseDB();
+
+  // The checkpoint opens as a db of its own
+  DestroyDir(dbname_);
+  cloud_env_options_.src_bucket = checkpoint;
+  cloud_env_options_.dest_bucket = checkpoint;
+  OpenDB();
+  for (int i = 0; i < 3; i++) {
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), "Key" + std::to_string(i), &value));
+    ASSERT_EQ(value, "Value" + std::to_string(i));
+  }
+}
+
+TEST_F(CloudLocalTest, UploadPipelineErrors) {
+  const auto backoff = std::chrono::milliseconds(10);
+  CloudUploadPipeline pipeline(2, 4, options_.info_log, backoff);
+  std::atomic<int> uploads(0);
+  auto ok_upload = [&uploads]() {
+    uploads++;
+    return Status::OK();
+  };
+  ASSERT_OK(pipeline.Enqueue("a", ok_upload));
+  ASSERT_OK(pipeline.Enqueue("b", ok_upload));
+  ASSERT_OK(pipeline.WaitForPending());
+  ASSERT_EQ(uploads.load(), 2);
+  ASSERT_FALSE(pipeline.IsPending("a"));
+
+  // A cancelled upload does not fail the pipeline
+  ASSERT_OK(pipeline.Enqueue("gone", []() { return Status::IOError("gone"); }));
+  pipeline.Cancel("gone");
+  ASSERT_FALSE(pipeline.IsPending("gone"));
+  ASSERT_OK(pipeline.WaitForPending());
+
+  // Cancel() waits for an upload that is already running
+  std::atomic<bool> started(false);
+  std::atomic<bool> finished(false);
+  ASSERT_OK(pipeline.Enqueue("slow", [&started, &finished]() {
+    started = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    finished = true;
+    return Status::OK();
+  }));
+  while (!started.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  pipeline.Cancel("slow");
+  ASSERT_TRUE(finished.load());
+  ASSERT_FALSE(pipeline.IsPending("slow"));
+
+  // A transient failure is retried after a growing backoff
+  std::atomic<int> flaky_attempts(0);
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_OK(pipeline.Enqueue("flaky", [&flaky_attempts]() {
+    return ++flaky_attempts < CloudUploadPipeline::kMaxAttempts
+               ? Status::IOError("flaky")
+               : Status::OK();
+  }));
+  ASSERT_OK(pipeline.WaitForPending());
+  ASSERT_EQ(flaky_attempts.load(), CloudUploadPipeline::kMaxAttempts);
+  ASSERT_GE(std::chrono::steady_clock::now() - start, backoff + 2 * backoff);
+
+  // An upload that keeps failing is reported, and does not stop the others
+  std::atomic<bool> healthy(false);
+  std::atomic<int> bad_attempts(0);
+  ASSERT_OK(pipeline.Enqueue("c", [&healthy, &bad_attempts]() {
+    bad_attempts++;
+    return healthy.load() ? Status::OK() : Status::IOError("c");
+  }));
+  ASSERT_TRUE(pipeline.WaitForPending().IsIOError());
+  ASSERT_TRUE(pipeline.IsPending("c"));
+  ASSERT_OK(pipeline.Enqueue("d", ok_upload));
+  ASSERT_TRUE(pipeline.WaitForPending().IsIOError());
+  ASSERT_EQ(uploads.load(), 3);
+  ASSERT_FALSE(pipeline.IsPending("d"));
+
+  // It is retried on the next wait, until it succeeds
+  int attempts = bad_attempts.load();
+  ASSERT_GE(attempts, 2 * CloudUploadPipeline::kMaxAttempts);
+  healthy = true;
+  ASSERT_OK(pipeline.WaitForPending());
+  ASSERT_EQ(bad_attempts.load(), attempts + 1);
+  ASSERT_FALSE(pipeline.IsPending("c"));
+
+  // Cancel() drops a failed upload
+  ASSERT_OK(pipeline.Enqueue("e", []() { return Status::IOError("e"); }));
+  ASSERT_TRUE(pipeline.WaitForPending().IsIOError());
+  pipeline.Cancel("e");
+  ASSERT_FALSE(pipeline.IsPending("e"));
+  ASSERT_OK(pipeline.WaitForPending());
+}
+
+TEST_F(CloudLocalTest, DeletionJournal) {
+  std::mutex mu;
+  std::set<std::string> deleted;
+  auto delete_fn = [&](const std::string& name) {
+    std::lock_guard<std::mutex> lk(mu);
+    deleted.insert(name);
+    return Status::OK();
+  };
+  std::string journal;
+  auto journal_fn = [&](const std::string& contents) {
+    std::lock_guard<std::mutex> lk(mu);
+    journal = contents;
+    return Status::OK();
+  };
+
+  {
+    CloudDeletionQueue queue(base_env_, 2, 0, delete_fn, options_.info_log);
+    queue.EnableJournal(journal_fn);
+    queue.Add("a");
+    queue.Add("b");
+    queue.Add("c");
+    // A file that is written again is not deleted
+    ASSERT_TRUE(queue.Remove("c"));
+    ASSERT_FALSE(queue.Remove("d"));
+    ASSERT_EQ(queue.NumPending(), 2u);
+  }
+  // The pending deletions are journaled when the queue stops
+  std::map<std::string, uint64_t> deadlines;
+  ASSERT_OK(CloudDeletionQueue::DecodeJournal(journal, &deadlines));
+  ASSERT_EQ(deadlines.size(), 2u);
+  ASSERT_EQ(deadlines.count("a"), 1u);
+  ASSERT_EQ(deadlines.count("b"), 1u);
+  ASSERT_TRUE(deleted.empty());
+
+  // The next instance carries out the recovered deletions when they are due,
+  // except those of files that are live again
+  deadlines["a"] = 0;
+  deadlines["live"] = 0;
+  std::string rewritten;
+  CloudDeletionQueue::EncodeJournal(deadlines, &rewritten);
+  {
+    CloudDeletionQueue queue(base_env_, 2, 0, delete_fn, options_.info_log);
+    ASSERT_OK(queue.Recover(
+        rewritten, [](const std::string& name) { return name == "live"; }));
+    queue.EnableJournal(journal_fn);
+    queue.TEST_WaitForIdle();
+    ASSERT_EQ(queue.NumPending(), 1u);
+  }
+  ASSERT_EQ(deleted, std::set<std::string>({"a"}));
+  deadlines.clear();
+  ASSERT_OK(CloudDeletionQueue::DecodeJournal(journal, &deadlines));
+  ASSERT_EQ(deadlines.size(), 1u);
+  ASSERT_EQ(deadlines.count("b"), 1u);
+
+  ASSERT_TRUE(CloudDeletionQueue::DecodeJournal(Slice(rewritten.data(), 3),
+                                                &deadlines)
+                  .IsCorruption());
+
+  // A file that is written again while its batch is being deleted is not
+  // deleted, unless its deletion already started
+  deleted.clear();
+  std::atomic<bool> blocked(false);
+  std::atomic<bool> release(false);
+  auto blocking_delete_fn = [&](const std::string& name) {
+    blocked = true;
+    while (!release.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return delete_fn(name);
+  };
+  {
+    CloudDeletionQueue queue(base_env_, 1, 0, blocking_delete_fn,
+                             options_.info_log);
+    // Both are due, so they are deleted in one batch
+    std::string due;
+    CloudDeletionQueue::EncodeJournal({{"x", 0}, {"y", 0}}, &due);
+    ASSERT_OK(
+        queue.Recover(due, [](const std::string& /*name*/) { return false; }));
+    while (!blocked.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(queue.NumPending(), 0u);
+    ASSERT_TRUE(queue.Remove("y"));
+    ASSERT_FALSE(queue.Remove("x"));
+    release = true;
+    queue.TEST_WaitForIdle();
+  }
+  ASSERT_EQ(deleted, std::set<std::string>({"x"}));
+}
+
+}  //  namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+#else  // ROCKSDB_LITE
+
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+  fprintf(stderr, "SKIPPED as DBCloud is not supported in ROCKSDB_LITE\n");
+  return 0;
+}
+
+#endif  // !ROCKSDB_LITE
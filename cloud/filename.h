@@ -3,6 +3,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cinttypes>
+#include <cstdio>
 #include <functional>
 #include <string>
 
@@ -82,12 +84,37 @@ inline std::string CloudManifestFile(const std::string& dbname) {
   return dbname + "/CLOUDMANIFEST";
 }
 
+// The journal of the objects that are waiting to be deleted
+inline std::string DeletionJournalFile(const std::string& dbname) {
+  return dbname + "/DELETIONJOURNAL";
+}
+
 inline std::string ManifestFileWithEpoch(const std::string& dbname,
                                          const std::string& epoch) {
   return epoch.empty() ? (dbname + "/MANIFEST")
                        : (dbname + "/MANIFEST-" + epoch);
 }
 
+// Objects holding the bytes appended to a MANIFEST since offset
+// (see CloudEnvOptions::manifest_delta_upload). The zero padded offset keeps
+// the deltas of a MANIFEST sorted in the order in which they apply.
+inline std::string ManifestDeltaPrefix(const std::string& manifest) {
+  return manifest + ".delta-";
+}
+
+inline std::string ManifestDeltaFile(const std::string& manifest,
+                                     uint64_t offset) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%020" PRIu64, offset);
+  return ManifestDeltaPrefix(manifest) + buf;
+}
+
+inline bool IsManifestDeltaFile(const std::string& manifest_basename,
+                                const std::string& fname) {
+  const std::string prefix = ManifestDeltaPrefix(manifest_basename);
+  return fname.compare(0, prefix.size(), prefix) == 0;
+}
+
 inline std::string RemoveEpoch(const std::string& path) {
   auto lastDash = path.rfind('-');
   if (lastDash == std::string::npos) {
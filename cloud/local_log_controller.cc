@@ -0,0 +1,481 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+//
+// This file defines a log controller whose stream is kept in memory. It
+// stands in for Kinesis and Kafka when remote log files are benchmarked or
+// tested without a cloud account.
+//
+// The controllers of a process that use the same topic share a stream, so
+// that a replica can tail the log files of a primary. Every controller sends
+// its messages through a link of its own, which emulates the latency,
+// bandwidth and reordering of LocalLogControllerOptions.
+//
+#ifndef ROCKSDB_LITE
+#include <algorithm>
+#include <cinttypes>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cloud/cloud_log_controller_impl.h"
+#include "port/port.h"
+#include "rocksdb/cloud/cloud_env_options.h"
+#include "rocksdb/status.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+namespace {
+class LocalLogController;
+
+/***************************************************/
+/*              LocalLogWritableFile               */
+/***************************************************/
+
+// Behaves like the Kafka writable file: messages are acknowledged by the
+// stream after a while, and a sync waits only for the messages that were
+// sent before it.
+class LocalLogWritableFile : public CloudLogWritableFile {
+ public:
+  static const std::chrono::microseconds kFlushTimeout;
+
+  LocalLogWritableFile(CloudEnv* env, const std::string& fname,
+                       const EnvOptions& options,
+                       LocalLogController* controller);
+  ~LocalLogWritableFile();
+
+  Status Append(const Slice& data) override;
+  Status Close() override;
+  bool IsSyncThreadSafe() const override { return true; }
+  Status Sync() override;
+  Status Flush() override;
+  Status LogDelete() override;
+
+ private:
+  Status SendRaw(const Slice& message);
+  // Sends the record right away, or adds it to the batch
+  Status Send(const Slice& record);
+  // Waits until the stream has acknowledged every message that the file sent
+  // so far
+  Status WaitForAcknowledgements();
+
+  LocalLogController* controller_;
+  std::shared_ptr<CloudLogSyncTracker> tracker_;
+  std::shared_ptr<CloudLogBatcher> batcher_;
+  uint64_t current_offset_;
+};
+const std::chrono::microseconds LocalLogWritableFile::kFlushTimeout =
+    std::chrono::seconds(10);
+
+/***************************************************/
+/*                 LocalLogStream                  */
+/***************************************************/
+
+// The messages of a topic, in the order they became durable. Every tailer
+// reads all of them; messages are dropped once every tailer has read them.
+class LocalLogStream {
+ public:
+  // Returns the stream of the topic, which lives as long as it is used
+  static std::shared_ptr<LocalLogStream> Get(const std::string& topic);
+
+  LocalLogStream() : first_offset_(0), next_consumer_(0) {}
+
+  // Makes a message visible to the tailers
+  void Publish(std::string message);
+
+  // Registers a tailer that starts at the oldest message that is kept
+  uint64_t Subscribe();
+  void Unsubscribe(uint64_t consumer);
+
+  // Returns the messages that the tailer did not read yet, waiting up to
+  // timeout for some to arrive
+  void Consume(uint64_t consumer, std::chrono::microseconds timeout,
+               std::vector<std::string>* messages);
+
+ private:
+  // REQUIRES: mutex_
+  void TrimLocked();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::string> messages_;
+  // The offset of messages_.front()
+  uint64_t first_offset_;
+  // The offset of the next message that each tailer reads
+  std::map<uint64_t, uint64_t> consumers_;
+  uint64_t next_consumer_;
+};
+
+std::shared_ptr<LocalLogStream> LocalLogStream::Get(const std::string& topic) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<LocalLogStream>> streams;
+  std::lock_guard<std::mutex> lk(mutex);
+  auto stream = streams[topic].lock();
+  if (!stream) {
+    stream = std::make_shared<LocalLogStream>();
+    streams[topic] = stream;
+  }
+  return stream;
+}
+
+void LocalLogStream::Publish(std::string message) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    messages_.push_back(std::move(message));
+    TrimLocked();
+  }
+  cv_.notify_all();
+}
+
+uint64_t LocalLogStream::Subscribe() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  const uint64_t consumer = next_consumer_++;
+  consumers_[consumer] = first_offset_;
+  return consumer;
+}
+
+void LocalLogStream::Unsubscribe(uint64_t consumer) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  consumers_.erase(consumer);
+  TrimLocked();
+}
+
+void LocalLogStream::Consume(uint64_t consumer,
+                             std::chrono::microseconds timeout,
+                             std::vector<std::string>* messages) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  uint64_t& offset = consumers_[consumer];
+  cv_.wait_for(lk, timeout, [this, &offset]() {
+    return offset < first_offset_ + messages_.size();
+  });
+  for (; offset < first_offset_ + messages_.size(); offset++) {
+    messages->push_back(messages_[offset - first_offset_]);
+  }
+  TrimLocked();
+}
+
+void LocalLogStream::TrimLocked() {
+  uint64_t read = first_offset_ + messages_.size();
+  for (const auto& c : consumers_) {
+    read = std::min(read, c.second);
+  }
+  while (first_offset_ < read) {
+    messages_.pop_front();
+    first_offset_++;
+  }
+}
+
+/***************************************************/
+/*               LocalLogController                */
+/***************************************************/
+
+class LocalLogController : public CloudLogControllerImpl {
+ public:
+  explicit LocalLogController(const LocalLogControllerOptions& options)
+      : options_(options),
+        consumer_(0),
+        rng_(options.seed),
+        next_id_(0),
+        link_free_(Clock::now()),
+        stopping_(false) {}
+  ~LocalLogController();
+
+  const char* Name() const override { return "locallog"; }
+
+  Status CreateStream(const std::string& /*topic*/) override {
+    return status_;
+  }
+  Status WaitForStreamReady(const std::string& /*topic*/) override {
+    return status_;
+  }
+  Status TailStream() override;
+  CloudLogWritableFile* CreateWritableFile(const std::string& fname,
+                                           const EnvOptions& options) override;
+
+  // Sends a message to the stream. Message seq of the tracker is acknowledged
+  // once the stream made it durable.
+  void Send(const Slice& message,
+            const std::shared_ptr<CloudLogSyncTracker>& tracker, uint64_t seq);
+
+ protected:
+  Status Initialize(CloudEnv* env) override;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  struct InFlight {
+    uint64_t id;
+    std::shared_ptr<CloudLogSyncTracker> tracker;
+    uint64_t seq;
+  };
+  struct Unpublished {
+    std::string message;
+    bool acknowledged;
+  };
+
+  // Returns when a message of the size that is sent now is acknowledged.
+  // REQUIRES: mutex_
+  Clock::time_point DueTimeLocked(size_t size);
+  // Acknowledges the messages once they are due
+  void AcknowledgeMessages();
+
+  const LocalLogControllerOptions options_;
+  std::shared_ptr<LocalLogStream> stream_;
+  // The tailer of this controller. It subscribes before anything is sent,
+  // so that it reads every message of the controller.
+  uint64_t consumer_;
+
+  std::mutex mutex_;
+  std::condition_variable in_flight_cv_;
+  Random64 rng_;
+  uint64_t next_id_;
+  // When the link has sent the messages that are queued on it
+  Clock::time_point link_free_;
+  // The messages that were sent but not acknowledged yet, by due time
+  std::multimap<Clock::time_point, InFlight> in_flight_;
+  // The messages that are not published yet, by the order they were sent.
+  // The stream gets them in that order once they are acknowledged.
+  std::map<uint64_t, Unpublished> unpublished_;
+  bool stopping_;
+  std::thread acknowledger_;
+};
+
+LocalLogWritableFile::LocalLogWritableFile(CloudEnv* env,
+                                           const std::string& fname,
+                                           const EnvOptions& options,
+                                           LocalLogController* controller)
+    : CloudLogWritableFile(env, fname, options),
+      controller_(controller),
+      tracker_(std::make_shared<CloudLogSyncTracker>()),
+      current_offset_(0) {
+  batcher_ = controller->NewBatcher(
+      [this](const Slice& message) { return SendRaw(message); });
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[locallog] WritableFile opened file %s", fname_.c_str());
+}
+
+LocalLogWritableFile::~LocalLogWritableFile() {
+  if (batcher_) {
+    batcher_->Stop();
+  }
+}
+
+Status LocalLogWritableFile::SendRaw(const Slice& message) {
+  controller_->Send(message, tracker_, tracker_->Sent());
+  return Status::OK();
+}
+
+Status LocalLogWritableFile::Send(const Slice& record) {
+  if (!status_.ok()) {
+    return status_;
+  }
+  if (batcher_) {
+    return batcher_->Add(record);
+  }
+  return SendRaw(record);
+}
+
+Status LocalLogWritableFile::Append(const Slice& data) {
+  std::string serialized_data;
+  CloudLogControllerImpl::SerializeLogRecordAppend(
+      fname_, data, current_offset_, &serialized_data);
+
+  Status st = Send(serialized_data);
+  if (st.ok()) {
+    current_offset_ += data.size();
+  }
+  return st;
+}
+
+Status LocalLogWritableFile::Close() {
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[locallog] WritableFile closing %s", fname_.c_str());
+
+  std::string serialized_data;
+  CloudLogControllerImpl::SerializeLogRecordClosed(fname_, current_offset_,
+                                                   &serialized_data);
+
+  Status st = Send(serialized_data);
+  if (batcher_) {
+    Status ss = batcher_->Stop();
+    if (st.ok()) {
+      st = ss;
+    }
+  }
+  return st;
+}
+
+Status LocalLogWritableFile::Sync() {
+  if (batcher_) {
+    Status st = batcher_->Send();
+    if (!st.ok()) {
+      return st;
+    }
+  }
+  return WaitForAcknowledgements();
+}
+
+Status LocalLogWritableFile::Flush() {
+  if (batcher_) {
+    // The batch is sent when it is full or due, and acknowledged on Sync()
+    return status_;
+  }
+  return WaitForAcknowledgements();
+}
+
+Status LocalLogWritableFile::WaitForAcknowledgements() {
+  if (!status_.ok()) {
+    return status_;
+  }
+  Status st = tracker_->Wait(tracker_->last_sent(), kFlushTimeout);
+  if (!st.ok()) {
+    Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+        "[locallog] WritableFile src %s Sync failed: %s", fname_.c_str(),
+        st.ToString().c_str());
+  }
+  return st;
+}
+
+Status LocalLogWritableFile::LogDelete() {
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_, "[locallog] LogDelete %s",
+      fname_.c_str());
+
+  std::string serialized_data;
+  CloudLogControllerImpl::SerializeLogRecordDelete(fname_, &serialized_data);
+
+  Status st = Send(serialized_data);
+  if (st.ok() && batcher_) {
+    st = batcher_->Send();
+  }
+  return st;
+}
+
+LocalLogController::~LocalLogController() {
+  // The tailer uses the members of this class
+  StopTailingStream();
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stopping_ = true;
+  }
+  in_flight_cv_.notify_all();
+  if (acknowledger_.joinable()) {
+    acknowledger_.join();
+  }
+  if (stream_) {
+    stream_->Unsubscribe(consumer_);
+  }
+}
+
+Status LocalLogController::Initialize(CloudEnv* env) {
+  Status s = CloudLogControllerImpl::Initialize(env);
+  if (s.ok()) {
+    stream_ = LocalLogStream::Get(env->GetSrcBucketName());
+    consumer_ = stream_->Subscribe();
+    acknowledger_ = std::thread([this]() { AcknowledgeMessages(); });
+  }
+  return s;
+}
+
+LocalLogController::Clock::time_point LocalLogController::DueTimeLocked(
+    size_t size) {
+  auto now = Clock::now();
+  auto sent = now;
+  if (options_.bandwidth_bytes_per_sec > 0) {
+    // The link sends one message after the other
+    link_free_ = std::max(link_free_, now) +
+                 std::chrono::microseconds(
+                     size * 1000000 /
+                     static_cast<uint64_t>(options_.bandwidth_bytes_per_sec));
+    sent = link_free_;
+  }
+  uint64_t delay = options_.ack_latency_micros;
+  if (options_.ack_latency_jitter_micros > 0) {
+    delay += rng_.Uniform(options_.ack_latency_jitter_micros + 1);
+  }
+  if (options_.reorder_probability > 0 &&
+      rng_.Uniform(1000000) < options_.reorder_probability * 1000000) {
+    delay += options_.reorder_delay_micros;
+  }
+  return sent + std::chrono::microseconds(delay);
+}
+
+void LocalLogController::Send(
+    const Slice& message, const std::shared_ptr<CloudLogSyncTracker>& tracker,
+    uint64_t seq) {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    const uint64_t id = next_id_++;
+    unpublished_[id] = Unpublished{message.ToString(), false};
+    in_flight_.emplace(DueTimeLocked(message.size()),
+                       InFlight{id, tracker, seq});
+  }
+  in_flight_cv_.notify_one();
+}
+
+void LocalLogController::AcknowledgeMessages() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    if (in_flight_.empty()) {
+      if (stopping_) {
+        return;
+      }
+      in_flight_cv_.wait(lk);
+      continue;
+    }
+    auto it = in_flight_.begin();
+    if (!stopping_ && it->first > Clock::now()) {
+      in_flight_cv_.wait_until(lk, it->first);
+      continue;
+    }
+    InFlight acked = std::move(it->second);
+    in_flight_.erase(it);
+    unpublished_[acked.id].acknowledged = true;
+    while (!unpublished_.empty() &&
+           unpublished_.begin()->second.acknowledged) {
+      stream_->Publish(std::move(unpublished_.begin()->second.message));
+      unpublished_.erase(unpublished_.begin());
+    }
+
+    // Messages are acknowledged concurrently with new ones being sent
+    lk.unlock();
+    acked.tracker->Acknowledge(acked.seq, Status::OK());
+    lk.lock();
+  }
+}
+
+Status LocalLogController::TailStream() {
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_, "[%s] TailStream started",
+      Name());
+  std::vector<std::string> messages;
+  while (IsRunning()) {
+    stream_->Consume(consumer_, std::chrono::milliseconds(100), &messages);
+    for (const auto& message : messages) {
+      status_ = Apply(message);
+      if (!status_.ok()) {
+        Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+            "[%s] error processing message size %" ROCKSDB_PRIszt
+            " extracted from stream %s",
+            Name(), message.size(), status_.ToString().c_str());
+      }
+    }
+    messages.clear();
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[%s] TailStream finished: %s", Name(), status_.ToString().c_str());
+  return status_;
+}
+
+CloudLogWritableFile* LocalLogController::CreateWritableFile(
+    const std::string& fname, const EnvOptions& options) {
+  return new LocalLogWritableFile(env_, fname, options, this);
+}
+}  // namespace
+
+Status CloudLogControllerImpl::CreateLocalController(
+    std::shared_ptr<CloudLogController>* result,
+    const LocalLogControllerOptions& options) {
+  result->reset(new LocalLogController(options));
+  return Status::OK();
+}
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
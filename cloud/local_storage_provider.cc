@@ -0,0 +1,888 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+//
+// A storage provider that keeps its "cloud" objects in a directory of the
+// local filesystem. Each bucket is a subdirectory of the root directory and
+// each object is a file in it. It makes it possible to run rocksdb-cloud
+// (tests, db_bench) without any cloud credentials or network access.
+//
+// It can also emulate the latency, bandwidth, failures and eventually
+// consistent listings of a remote object store (see
+// LocalStorageProviderOptions).
+//
+#ifndef ROCKSDB_LITE
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "cloud/cloud_env_impl.h"
+#include "cloud/cloud_storage_provider_impl.h"
+#include "cloud/filename.h"
+#include "env/composite_env_wrapper.h"
+#include "file/file_util.h"
+#include "rocksdb/cloud/cloud_env_options.h"
+#include "rocksdb/env.h"
+#include "rocksdb/rate_limiter.h"
+#include "rocksdb/status.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+/******************** Emulator ******************/
+// Applies the latency, bandwidth and failures of LocalStorageProviderOptions
+// to the requests of the provider and its readable files
+class LocalRequestEmulator {
+ public:
+  LocalRequestEmulator(Env* env, const LocalStorageProviderOptions& options,
+                       const std::shared_ptr<Logger>& info_log)
+      : env_(env),
+        options_(options),
+        info_log_(info_log),
+        rng_(options.seed) {
+    if (options_.bandwidth_bytes_per_sec > 0) {
+      limiter_.reset(NewGenericRateLimiter(
+          options_.bandwidth_bytes_per_sec, 100 * 1000 /* refill_period_us */,
+          10 /* fairness */, RateLimiter::Mode::kAllIo));
+    }
+  }
+
+  // Waits for the latency of a request and returns the injected failure, if
+  // any
+  Status StartRequest(const char* op, const std::string& object) {
+    uint64_t delay = options_.latency_micros;
+    bool fail = false;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      if (options_.latency_jitter_micros > 0) {
+        delay += rng_.Uniform(options_.latency_jitter_micros + 1);
+      }
+      if (options_.tail_latency_probability > 0 &&
+          RandomFraction() < options_.tail_latency_probability) {
+        delay += options_.tail_latency_micros;
+      }
+      fail = options_.failure_rate > 0 &&
+             RandomFraction() < options_.failure_rate;
+    }
+    if (delay > 0) {
+      env_->SleepForMicroseconds(static_cast<int>(delay));
+    }
+    if (fail) {
+      Log(InfoLogLevel::WARN_LEVEL, info_log_,
+          "[local] Injected failure of %s %s", op, object.c_str());
+      return Status::IOError("Injected failure of " + std::string(op),
+                             object);
+    }
+    return Status::OK();
+  }
+
+  // Waits until the bandwidth allows bytes to be transferred
+  void Transfer(uint64_t bytes) {
+    if (!limiter_) {
+      return;
+    }
+    const uint64_t burst =
+        static_cast<uint64_t>(limiter_->GetSingleBurstBytes());
+    while (bytes > 0) {
+      uint64_t n = std::min(bytes, burst);
+      limiter_->Request(static_cast<int64_t>(n), Env::IO_HIGH, nullptr);
+      bytes -= n;
+    }
+  }
+
+  void ObjectWritten(const std::string& path) {
+    if (options_.list_visibility_delay_micros > 0) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      const uint64_t now = env_->NowMicros();
+      ExpireWrittenLocked(now);
+      written_[path] = now;
+      write_order_.emplace_back(now, path);
+    }
+  }
+
+  void ObjectDeleted(const std::string& path) {
+    if (options_.list_visibility_delay_micros > 0) {
+      std::lock_guard<std::mutex> lk(mutex_);
+      written_.erase(path);
+    }
+  }
+
+  // Whether a listing includes the object yet
+  bool IsListed(const std::string& path) {
+    if (options_.list_visibility_delay_micros == 0) {
+      return true;
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    ExpireWrittenLocked(env_->NowMicros());
+    return written_.find(path) == written_.end();
+  }
+
+ private:
+  // Forgets the objects that are listed by now, whether or not a listing
+  // asked for them. REQUIRES: mutex_
+  void ExpireWrittenLocked(uint64_t now) {
+    while (!write_order_.empty() &&
+           now - write_order_.front().first >=
+               options_.list_visibility_delay_micros) {
+      auto it = written_.find(write_order_.front().second);
+      // unless the object was written again since
+      if (it != written_.end() && it->second == write_order_.front().first) {
+        written_.erase(it);
+      }
+      write_order_.pop_front();
+    }
+  }
+
+  // REQUIRES: mutex_
+  double RandomFraction() {
+    return static_cast<double>(rng_.Uniform(1000000)) / 1000000;
+  }
+
+  Env* env_;
+  const LocalStorageProviderOptions options_;
+  std::shared_ptr<Logger> info_log_;
+  std::unique_ptr<RateLimiter> limiter_;
+  std::mutex mutex_;
+  Random64 rng_;
+  // When the objects that are not listed yet were written
+  std::unordered_map<std::string, uint64_t> written_;
+  // The writes of the last list_visibility_delay_micros, oldest first
+  std::deque<std::pair<uint64_t, std::string>> write_order_;
+};
+
+/******************** Readablefile ******************/
+class LocalReadableFile : public CloudStorageReadableFileImpl {
+ public:
+  LocalReadableFile(std::unique_ptr<RandomAccessFile>&& file,
+                    const std::shared_ptr<LocalRequestEmulator>& emulator,
+                    const std::shared_ptr<Logger>& info_log,
+                    const std::string& bucket, const std::string& fname,
+                    uint64_t size)
+      : CloudStorageReadableFileImpl(info_log, bucket, fname, size),
+        file_(std::move(file)),
+        emulator_(emulator) {}
+
+  virtual const char* Name() const override { return "local"; }
+
+  size_t GetUniqueId(char* id, size_t max_size) const override {
+    return file_->GetUniqueId(id, max_size);
+  }
+
+ protected:
+  Status DoCloudRead(uint64_t offset, size_t n, char* scratch,
+                     uint64_t* bytes_read) const override {
+    Status st = emulator_->StartRequest("GetObject", fname_);
+    if (!st.ok()) {
+      return st;
+    }
+    Slice result;
+    st = file_->Read(offset, n, &result, scratch);
+    if (st.ok()) {
+      if (result.data() != scratch) {
+        memcpy(scratch, result.data(), result.size());
+      }
+      *bytes_read = result.size();
+      emulator_->Transfer(result.size());
+    }
+    return st;
+  }
+
+ private:
+  std::unique_ptr<RandomAccessFile> file_;
+  std::shared_ptr<LocalRequestEmulator> emulator_;
+};
+
+/******************** Writablefile ******************/
+class LocalWritableFile : public CloudStorageWritableFileImpl {
+ public:
+  LocalWritableFile(CloudEnv* env, const std::string& local_fname,
+                    const std::string& bucket, const std::string& cloud_fname,
+                    const EnvOptions& options)
+      : CloudStorageWritableFileImpl(env, local_fname, bucket, cloud_fname,
+                                     options) {}
+  virtual const char* Name() const override { return "local"; }
+};
+
+/******************** LocalStorageProvider ******************/
+class LocalStorageProvider : public CloudStorageProviderImpl {
+ public:
+  LocalStorageProvider(const std::string& root,
+                       const LocalStorageProviderOptions& options)
+      : root_(root), options_(options) {}
+  ~LocalStorageProvider() override {}
+  virtual const char* Name() const override { return "local"; }
+  Status CreateBucket(const std::string& bucket) override;
+  Status ExistsBucket(const std::string& bucket) override;
+  Status EmptyBucket(const std::string& bucket_name,
+                     const std::string& object_path) override;
+  Status DeleteCloudObject(const std::string& bucket_name,
+                           const std::string& object_path) override;
+  Status ListCloudObjects(const std::string& bucket_name,
+                          const std::string& object_path,
+                          std::vector<std::string>* result) override;
+  Status ListCloudObjectsWithInfo(
+      const std::string& bucket_name, const std::string& object_path,
+      std::vector<std::string>* path_names,
+      std::vector<CloudObjectInformation>* infos) override;
+  Status ListCloudObjectsWithPrefix(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& name_prefix,
+      std::vector<std::string>* path_names) override;
+  Status ExistsCloudObject(const std::string& bucket_name,
+                           const std::string& object_path) override;
+  Status GetCloudObjectSize(const std::string& bucket_name,
+                            const std::string& object_path,
+                            uint64_t* filesize) override;
+  Status GetCloudObjectModificationTime(const std::string& bucket_name,
+                                        const std::string& object_path,
+                                        uint64_t* time) override;
+  Status GetCloudObjectMetadata(const std::string& bucket_name,
+                                const std::string& object_path,
+                                CloudObjectInformation* info) override;
+  Status PutCloudObjectMetadata(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::unordered_map<std::string, std::string>& metadata) override;
+  Status CopyCloudObject(const std::string& bucket_name_src,
+                         const std::string& object_path_src,
+                         const std::string& bucket_name_dest,
+                         const std::string& object_path_dest) override;
+  Status DoNewCloudReadableFile(
+      const std::string& bucket, const std::string& fname, uint64_t fsize,
+      const std::string& content_hash,
+      std::unique_ptr<CloudStorageReadableFile>* result,
+      const EnvOptions& options) override;
+  Status NewCloudWritableFile(const std::string& local_path,
+                              const std::string& bucket_name,
+                              const std::string& object_path,
+                              std::unique_ptr<CloudStorageWritableFile>* result,
+                              const EnvOptions& options) override;
+
+ protected:
+  Status Initialize(CloudEnv* env) override;
+  Status DoGetCloudObject(const std::string& bucket_name,
+                          const std::string& object_path,
+                          const std::string& destination,
+                          uint64_t* remote_size) override;
+  Status DoPutCloudObject(const std::string& local_file,
+                          const std::string& bucket_name,
+                          const std::string& object_path,
+                          uint64_t file_size) override;
+  Status DoCreateMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::unordered_map<std::string, std::string>& metadata,
+      std::string* upload_id) override;
+  Status DoUploadPart(const std::string& bucket_name,
+                      const std::string& object_path,
+                      const std::string& upload_id, int part_number,
+                      const Slice& data, uint32_t crc,
+                      std::string* etag) override;
+  Status DoCompleteMultipartUpload(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& upload_id,
+      const std::vector<std::string>& etags) override;
+  Status DoAbortMultipartUpload(const std::string& bucket_name,
+                                const std::string& object_path,
+                                const std::string& upload_id) override;
+
+ private:
+  // Object keys never start with a '/', just like in S3
+  std::string ObjectPath(const std::string& bucket,
+                         const std::string& object) const {
+    return root_ + pathsep + bucket + pathsep + ltrim_if(object, '/');
+  }
+  std::string MetadataPath(const std::string& bucket,
+                           const std::string& object) const {
+    return root_ + pathsep + ".metadata" + pathsep + bucket + pathsep +
+           ltrim_if(object, '/');
+  }
+  // Creates all missing directories leading to the specified file
+  Status CreateParentDirs(const std::string& path);
+  // Atomically replaces dest with a copy of src
+  Status CopyFileAtomically(const std::string& src, const std::string& dest);
+  // Appends the names of all files below dir (relative to dir) to result
+  Status ListFiles(const std::string& dir, const std::string& relative,
+                   std::vector<std::string>* result);
+  // The size and modification time of an object, without a request
+  Status StatObject(const std::string& bucket, const std::string& object,
+                    CloudObjectInformation* info);
+  // The parts of a multipart upload are kept in a directory of their own
+  std::string UploadDir(const std::string& upload_id) const {
+    return root_ + pathsep + ".tmp" + pathsep + "upload-" + upload_id;
+  }
+  std::string PartPath(const std::string& upload_id, int part_number) const {
+    return UploadDir(upload_id) + pathsep + "part-" +
+           std::to_string(part_number);
+  }
+  // The metadata of the object, until the upload is complete
+  std::string UploadMetadataPath(const std::string& upload_id) const {
+    return UploadDir(upload_id) + pathsep + "metadata";
+  }
+  static std::string EncodeMetadata(
+      const std::unordered_map<std::string, std::string>& metadata);
+
+  Env* base_env_ = nullptr;
+  std::string root_;
+  const LocalStorageProviderOptions options_;
+  std::shared_ptr<LocalRequestEmulator> emulator_;
+  std::atomic<uint64_t> next_upload_id_{0};
+};
+
+Status LocalStorageProvider::Initialize(CloudEnv* env) {
+  Status st = CloudStorageProviderImpl::Initialize(env);
+  if (st.ok()) {
+    base_env_ = env->GetBaseEnv();
+    emulator_ = std::make_shared<LocalRequestEmulator>(base_env_, options_,
+                                                       env->info_log_);
+    if (root_.empty()) {
+      st = Status::InvalidArgument("Local storage provider needs a root dir");
+    } else {
+      st = base_env_->CreateDirIfMissing(root_);
+    }
+  }
+  if (st.ok()) {
+    st = base_env_->CreateDirIfMissing(root_ + pathsep + ".tmp");
+  }
+  Log(InfoLogLevel::INFO_LEVEL, env->info_log_,
+      "[local] Initialize storage provider at %s %s", root_.c_str(),
+      st.ToString().c_str());
+  return st;
+}
+
+Status LocalStorageProvider::CreateParentDirs(const std::string& path) {
+  std::string dir = dirname(path);
+  if (dir.size() <= root_.size() || base_env_->FileExists(dir).ok()) {
+    return Status::OK();
+  }
+  Status st = CreateParentDirs(dir);
+  if (st.ok()) {
+    st = base_env_->CreateDirIfMissing(dir);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::CopyFileAtomically(const std::string& src,
+                                                const std::string& dest) {
+  Status st = CreateParentDirs(dest);
+  if (!st.ok()) {
+    return st;
+  }
+  std::string tmp = root_ + pathsep + ".tmp" + pathsep + basename(dest) +
+                    ".tmp-" + std::to_string(NextRandom());
+  LegacyFileSystemWrapper fs(base_env_);
+  st = CopyFile(&fs, src, tmp, 0, false);
+  if (st.ok()) {
+    st = base_env_->RenameFile(tmp, dest);
+  }
+  if (!st.ok()) {
+    base_env_->DeleteFile(tmp);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::ListFiles(const std::string& dir,
+                                       const std::string& relative,
+                                       std::vector<std::string>* result) {
+  std::vector<std::string> children;
+  Status st = base_env_->GetChildren(dir, &children);
+  if (!st.ok()) {
+    return st;
+  }
+  for (const auto& child : children) {
+    if (child == "." || child == "..") {
+      continue;
+    }
+    std::string path = dir + pathsep + child;
+    bool is_dir = false;
+    st = base_env_->IsDirectory(path, &is_dir);
+    if (!st.ok()) {
+      if (base_env_->FileExists(path).IsNotFound()) {
+        // Deleted since the directory was read, so S3 would not list it
+        continue;
+      }
+      return st;
+    }
+    if (is_dir) {
+      st = ListFiles(path, relative + child + pathsep, result);
+      if (!st.ok()) {
+        return st;
+      }
+    } else {
+      result->push_back(relative + child);
+    }
+  }
+  return Status::OK();
+}
+
+Status LocalStorageProvider::StatObject(const std::string& bucket,
+                                        const std::string& object,
+                                        CloudObjectInformation* info) {
+  // S3 reports the modification time in milliseconds
+  auto path = ObjectPath(bucket, object);
+  Status st = base_env_->GetFileSize(path, &info->size);
+  if (!st.ok() && base_env_->FileExists(path).IsNotFound()) {
+    // As S3 reports a missing object
+    return Status::NotFound(path);
+  }
+  if (st.ok()) {
+    st = base_env_->GetFileModificationTime(path, &info->modification_time);
+  }
+  if (st.ok()) {
+    info->modification_time *= 1000;
+  }
+  return st;
+}
+
+Status LocalStorageProvider::CreateBucket(const std::string& bucket) {
+  return base_env_->CreateDirIfMissing(root_ + pathsep + bucket);
+}
+
+Status LocalStorageProvider::ExistsBucket(const std::string& bucket) {
+  return base_env_->FileExists(root_ + pathsep + bucket);
+}
+
+Status LocalStorageProvider::EmptyBucket(const std::string& bucket_name,
+                                         const std::string& object_path) {
+  std::vector<std::string> results;
+  Status st = ListCloudObjects(bucket_name, object_path, &results);
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[local] EmptyBucket unable to find objects in bucket %s %s",
+        bucket_name.c_str(), st.ToString().c_str());
+    return st;
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[local] EmptyBucket going to delete %" ROCKSDB_PRIszt
+      " objects in bucket %s",
+      results.size(), bucket_name.c_str());
+
+  auto prefix = ensure_ends_with_pathsep(ltrim_if(object_path, '/'));
+  for (const auto& path : results) {
+    st = DeleteCloudObject(bucket_name, prefix + path);
+    if (!st.ok()) {
+      Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+          "[local] EmptyBucket Unable to delete %s in bucket %s %s",
+          path.c_str(), bucket_name.c_str(), st.ToString().c_str());
+    }
+  }
+  return st;
+}
+
+Status LocalStorageProvider::DeleteCloudObject(const std::string& bucket_name,
+                                               const std::string& object_path) {
+  Status st = emulator_->StartRequest("DeleteObject", object_path);
+  if (!st.ok()) {
+    return st;
+  }
+  st = base_env_->DeleteFile(ObjectPath(bucket_name, object_path));
+  if (st.ok() || st.IsNotFound()) {
+    base_env_->DeleteFile(MetadataPath(bucket_name, object_path));
+    emulator_->ObjectDeleted(ObjectPath(bucket_name, object_path));
+  }
+  if (st.IsPathNotFound()) {
+    st = Status::NotFound(object_path);
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, env_->info_log_,
+      "[local] DeleteFromLocal %s/%s, status %s", bucket_name.c_str(),
+      object_path.c_str(), st.ToString().c_str());
+  return st;
+}
+
+Status LocalStorageProvider::ListCloudObjects(
+    const std::string& bucket_name, const std::string& object_path,
+    std::vector<std::string>* result) {
+  return ListCloudObjectsWithPrefix(bucket_name, object_path, "", result);
+}
+
+Status LocalStorageProvider::ListCloudObjectsWithPrefix(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& name_prefix, std::vector<std::string>* result) {
+  auto dir = root_ + pathsep + bucket_name + pathsep +
+             ltrim_if(object_path, '/');
+  const size_t page_size = static_cast<size_t>(std::max(
+      env_->GetCloudEnvOptions().number_objects_listed_in_one_iteration, 1));
+  // Like S3, the objects that match the prefix are listed in order, a page
+  // per request. Every page continues after the last object of the previous
+  // one, so that the objects that are written or deleted meanwhile show up
+  // as they would in S3. Listing a prefix that has no objects is not an
+  // error.
+  std::string continuation;
+  bool first_page = true;
+  while (true) {
+    Status st = emulator_->StartRequest("ListObjects", object_path);
+    if (!st.ok()) {
+      return st;
+    }
+    std::vector<std::string> names;
+    if (base_env_->FileExists(dir).ok()) {
+      st = ListFiles(dir, "", &names);
+      if (!st.ok()) {
+        return st;
+      }
+    }
+    std::sort(names.begin(), names.end());
+    auto it =
+        first_page
+            ? std::lower_bound(names.begin(), names.end(), name_prefix)
+            : std::upper_bound(names.begin(), names.end(), continuation);
+    first_page = false;
+    size_t listed = 0;
+    for (; it != names.end() && listed < page_size &&
+           Slice(*it).starts_with(name_prefix);
+         ++it) {
+      continuation = *it;
+      if (emulator_->IsListed(dir + pathsep + *it)) {
+        result->push_back(*it);
+        listed++;
+      }
+    }
+    if (it == names.end() || !Slice(*it).starts_with(name_prefix)) {
+      return Status::OK();
+    }
+  }
+}
+
+Status LocalStorageProvider::ListCloudObjectsWithInfo(
+    const std::string& bucket_name, const std::string& object_path,
+    std::vector<std::string>* path_names,
+    std::vector<CloudObjectInformation>* infos) {
+  std::vector<std::string> names;
+  Status st = ListCloudObjects(bucket_name, object_path, &names);
+  if (!st.ok()) {
+    return st;
+  }
+  const std::string prefix =
+      ensure_ends_with_pathsep(ltrim_if(object_path, '/'));
+  for (const auto& name : names) {
+    // The listing itself carries the size and modification time
+    CloudObjectInformation info;
+    st = StatObject(bucket_name, prefix + name, &info);
+    if (st.IsNotFound()) {
+      // deleted since it was listed
+      continue;
+    } else if (!st.ok()) {
+      return st;
+    }
+    path_names->push_back(name);
+    infos->push_back(std::move(info));
+  }
+  return Status::OK();
+}
+
+Status LocalStorageProvider::ExistsCloudObject(const std::string& bucket_name,
+                                               const std::string& object_path) {
+  Status st = emulator_->StartRequest("HeadObject", object_path);
+  if (st.ok()) {
+    st = base_env_->FileExists(ObjectPath(bucket_name, object_path));
+  }
+  return st;
+}
+
+Status LocalStorageProvider::GetCloudObjectSize(const std::string& bucket_name,
+                                                const std::string& object_path,
+                                                uint64_t* filesize) {
+  Status st = emulator_->StartRequest("HeadObject", object_path);
+  if (st.ok()) {
+    st = base_env_->GetFileSize(ObjectPath(bucket_name, object_path),
+                                filesize);
+  }
+  if (st.IsPathNotFound()) {
+    st = Status::NotFound(object_path);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::GetCloudObjectModificationTime(
+    const std::string& bucket_name, const std::string& object_path,
+    uint64_t* time) {
+  Status st = emulator_->StartRequest("HeadObject", object_path);
+  CloudObjectInformation info;
+  if (st.ok()) {
+    st = StatObject(bucket_name, object_path, &info);
+  }
+  if (st.ok()) {
+    *time = info.modification_time;
+  }
+  return st;
+}
+
+Status LocalStorageProvider::GetCloudObjectMetadata(
+    const std::string& bucket_name, const std::string& object_path,
+    CloudObjectInformation* info) {
+  assert(info != nullptr);
+  Status st = emulator_->StartRequest("HeadObject", object_path);
+  if (st.ok()) {
+    st = StatObject(bucket_name, object_path, info);
+  }
+  if (!st.ok()) {
+    return st;
+  }
+  info->content_hash.clear();
+  info->metadata.clear();
+  std::string data;
+  auto mpath = MetadataPath(bucket_name, object_path);
+  if (base_env_->FileExists(mpath).ok()) {
+    st = ReadFileToString(base_env_, mpath, &data);
+  }
+  Slice input(data);
+  Slice key, value;
+  while (st.ok() && !input.empty()) {
+    if (!GetLengthPrefixedSlice(&input, &key) ||
+        !GetLengthPrefixedSlice(&input, &value)) {
+      st = Status::Corruption("Bad metadata for object", object_path);
+    } else {
+      info->metadata[key.ToString()] = value.ToString();
+    }
+  }
+  return st;
+}
+
+std::string LocalStorageProvider::EncodeMetadata(
+    const std::unordered_map<std::string, std::string>& metadata) {
+  std::string data;
+  for (const auto& m : metadata) {
+    PutLengthPrefixedSlice(&data, m.first);
+    PutLengthPrefixedSlice(&data, m.second);
+  }
+  return data;
+}
+
+Status LocalStorageProvider::PutCloudObjectMetadata(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::unordered_map<std::string, std::string>& metadata) {
+  // Like S3, this creates an empty object carrying the metadata
+  std::string data = EncodeMetadata(metadata);
+  auto path = ObjectPath(bucket_name, object_path);
+  auto mpath = MetadataPath(bucket_name, object_path);
+  Status st = emulator_->StartRequest("PutObject", object_path);
+  if (st.ok()) {
+    st = CreateParentDirs(path);
+  }
+  if (st.ok()) {
+    st = CreateParentDirs(mpath);
+  }
+  if (st.ok()) {
+    st = WriteStringToFile(base_env_, data, mpath, true);
+  }
+  if (st.ok()) {
+    emulator_->ObjectWritten(path);
+    st = WriteStringToFile(base_env_, "", path, true);
+  }
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[local] Bucket %s error in saving metadata %s", bucket_name.c_str(),
+        st.ToString().c_str());
+  }
+  return st;
+}
+
+Status LocalStorageProvider::CopyCloudObject(
+    const std::string& bucket_name_src, const std::string& object_path_src,
+    const std::string& bucket_name_dest, const std::string& object_path_dest) {
+  const std::string dest = ObjectPath(bucket_name_dest, object_path_dest);
+  Status st = emulator_->StartRequest("CopyObject", object_path_src);
+  if (st.ok()) {
+    emulator_->ObjectWritten(dest);
+    st = CopyFileAtomically(ObjectPath(bucket_name_src, object_path_src),
+                            dest);
+  }
+  Log(InfoLogLevel::INFO_LEVEL, env_->info_log_,
+      "[local] CopyCloudObject src %s/%s dest %s/%s %s",
+      bucket_name_src.c_str(), object_path_src.c_str(),
+      bucket_name_dest.c_str(), object_path_dest.c_str(),
+      st.ToString().c_str());
+  return st;
+}
+
+Status LocalStorageProvider::DoNewCloudReadableFile(
+    const std::string& bucket, const std::string& fname, uint64_t fsize,
+    const std::string& /*content_hash*/,
+    std::unique_ptr<CloudStorageReadableFile>* result,
+    const EnvOptions& options) {
+  std::unique_ptr<RandomAccessFile> file;
+  Status st =
+      base_env_->NewRandomAccessFile(ObjectPath(bucket, fname), &file, options);
+  if (st.ok()) {
+    result->reset(new LocalReadableFile(std::move(file), emulator_,
+                                        env_->info_log_, bucket, fname,
+                                        fsize));
+  }
+  return st;
+}
+
+Status LocalStorageProvider::NewCloudWritableFile(
+    const std::string& local_path, const std::string& bucket_name,
+    const std::string& object_path,
+    std::unique_ptr<CloudStorageWritableFile>* result,
+    const EnvOptions& options) {
+  result->reset(new LocalWritableFile(env_, local_path, bucket_name,
+                                      object_path, options));
+  return (*result)->status();
+}
+
+Status LocalStorageProvider::DoGetCloudObject(const std::string& bucket_name,
+                                              const std::string& object_path,
+                                              const std::string& destination,
+                                              uint64_t* remote_size) {
+  auto path = ObjectPath(bucket_name, object_path);
+  Status st = emulator_->StartRequest("GetObject", object_path);
+  if (st.ok()) {
+    st = base_env_->GetFileSize(path, remote_size);
+  }
+  if (st.ok()) {
+    emulator_->Transfer(*remote_size);
+    LegacyFileSystemWrapper fs(base_env_);
+    st = CopyFile(&fs, path, destination, 0, false);
+  }
+  if (st.IsPathNotFound()) {
+    st = Status::NotFound(object_path);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::DoPutCloudObject(const std::string& local_file,
+                                              const std::string& bucket_name,
+                                              const std::string& object_path,
+                                              uint64_t file_size) {
+  Status st = emulator_->StartRequest("PutObject", object_path);
+  if (st.ok()) {
+    emulator_->Transfer(file_size);
+    // A new version of an object does not keep the old metadata
+    base_env_->DeleteFile(MetadataPath(bucket_name, object_path));
+    emulator_->ObjectWritten(ObjectPath(bucket_name, object_path));
+    st = CopyFileAtomically(local_file, ObjectPath(bucket_name, object_path));
+  }
+  if (!st.ok()) {
+    Log(InfoLogLevel::ERROR_LEVEL, env_->info_log_,
+        "[local] PutCloudObject %s/%s, error %s", bucket_name.c_str(),
+        object_path.c_str(), st.ToString().c_str());
+  } else {
+    Log(InfoLogLevel::INFO_LEVEL, env_->info_log_,
+        "[local] PutCloudObject %s/%s, size %" PRIu64 ", OK",
+        bucket_name.c_str(), object_path.c_str(), file_size);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::DoCreateMultipartUpload(
+    const std::string& /*bucket_name*/, const std::string& object_path,
+    const std::unordered_map<std::string, std::string>& metadata,
+    std::string* upload_id) {
+  Status st = emulator_->StartRequest("CreateMultipartUpload", object_path);
+  if (!st.ok()) {
+    return st;
+  }
+  *upload_id = std::to_string(base_env_->NowMicros()) + "-" +
+               std::to_string(next_upload_id_++);
+  st = base_env_->CreateDirIfMissing(UploadDir(*upload_id));
+  if (st.ok() && !metadata.empty()) {
+    st = WriteStringToFile(base_env_, EncodeMetadata(metadata),
+                           UploadMetadataPath(*upload_id), false);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::DoUploadPart(const std::string& /*bucket_name*/,
+                                          const std::string& object_path,
+                                          const std::string& upload_id,
+                                          int part_number, const Slice& data,
+                                          uint32_t crc, std::string* etag) {
+  Status st = emulator_->StartRequest("UploadPart", object_path);
+  if (!st.ok()) {
+    return st;
+  }
+  emulator_->Transfer(data.size());
+  // Like the Content-MD5 of an S3 part, the checksum is verified on arrival
+  if (crc32c::Value(data.data(), data.size()) != crc) {
+    return Status::Corruption("Checksum mismatch in part of " + object_path);
+  }
+  st = WriteStringToFile(base_env_, data, PartPath(upload_id, part_number),
+                         false);
+  if (st.ok()) {
+    *etag = std::to_string(crc);
+  }
+  return st;
+}
+
+Status LocalStorageProvider::DoCompleteMultipartUpload(
+    const std::string& bucket_name, const std::string& object_path,
+    const std::string& upload_id, const std::vector<std::string>& etags) {
+  // Concatenate the parts, verifying them against their etags, and move the
+  // result into place
+  const std::string dest = ObjectPath(bucket_name, object_path);
+  const std::string tmp = UploadDir(upload_id) + pathsep + "object";
+  std::unique_ptr<WritableFile> out;
+  Status st = emulator_->StartRequest("CompleteMultipartUpload", object_path);
+  if (st.ok()) {
+    st = base_env_->NewWritableFile(tmp, &out, EnvOptions());
+  }
+  for (size_t i = 0; st.ok() && i < etags.size(); i++) {
+    std::string part;
+    st = ReadFileToString(base_env_,
+                          PartPath(upload_id, static_cast<int>(i + 1)), &part);
+    if (st.ok() && std::to_string(crc32c::Value(part.data(), part.size())) !=
+                       etags[i]) {
+      st = Status::Corruption("Checksum mismatch in part of " + object_path);
+    }
+    if (st.ok()) {
+      st = out->Append(part);
+    }
+  }
+  if (out) {
+    Status cs = out->Close();
+    if (st.ok()) {
+      st = cs;
+    }
+  }
+  if (st.ok()) {
+    st = CreateParentDirs(dest);
+  }
+  const std::string mpath = MetadataPath(bucket_name, object_path);
+  if (st.ok() && base_env_->FileExists(UploadMetadataPath(upload_id)).ok()) {
+    st = CreateParentDirs(mpath);
+    if (st.ok()) {
+      st = base_env_->RenameFile(UploadMetadataPath(upload_id), mpath);
+    }
+  } else if (st.ok()) {
+    base_env_->DeleteFile(mpath);
+  }
+  if (st.ok()) {
+    emulator_->ObjectWritten(dest);
+    st = base_env_->RenameFile(tmp, dest);
+  }
+  DoAbortMultipartUpload(bucket_name, object_path, upload_id);
+  Log(InfoLogLevel::INFO_LEVEL, env_->info_log_,
+      "[local] CompleteMultipartUpload %s/%s with %" ROCKSDB_PRIszt
+      " parts: %s",
+      bucket_name.c_str(), object_path.c_str(), etags.size(),
+      st.ToString().c_str());
+  return st;
+}
+
+Status LocalStorageProvider::DoAbortMultipartUpload(
+    const std::string& /*bucket_name*/, const std::string& /*object_path*/,
+    const std::string& upload_id) {
+  const std::string dir = UploadDir(upload_id);
+  std::vector<std::string> children;
+  Status st = base_env_->GetChildren(dir, &children);
+  for (const auto& c : children) {
+    if (c != "." && c != "..") {
+      base_env_->DeleteFile(dir + pathsep + c);
+    }
+  }
+  if (st.ok()) {
+    st = base_env_->DeleteDir(dir);
+  }
+  return st;
+}
+
+Status CloudStorageProviderImpl::CreateLocalProvider(
+    const std::string& root, std::shared_ptr<CloudStorageProvider>* result,
+    const LocalStorageProviderOptions& options) {
+  result->reset(new LocalStorageProvider(root, options));
+  return Status::OK();
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
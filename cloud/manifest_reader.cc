@@ -3,19 +3,170 @@
 
 #include "cloud/manifest_reader.h"
 
+#include <map>
+
 #include "cloud/aws/aws_env.h"
 #include "cloud/cloud_manifest.h"
 #include "cloud/db_cloud_impl.h"
 #include "cloud/filename.h"
 #include "db/version_set.h"
 #include "env/composite_env_wrapper.h"
+#include "rocksdb/cloud/cloud_storage_provider.h"
 #include "rocksdb/db.h"
 #include "rocksdb/env.h"
 #include "rocksdb/options.h"
 #include "rocksdb/status.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
 
 namespace ROCKSDB_NAMESPACE {
 
+namespace {
+// How many times a MANIFEST is read again when its deltas are rewritten
+// underneath the reader
+const int kMaxManifestDeltaAttempts = 3;
+
+// Reads n bytes unless the end of the file is reached first
+Status ReadFully(SequentialFile* file, size_t n, Slice* result,
+                 char* scratch) {
+  size_t read = 0;
+  while (read < n) {
+    Slice chunk;
+    Status s = file->Read(n - read, &chunk, scratch + read);
+    if (!s.ok()) {
+      return s;
+    }
+    if (chunk.empty()) {
+      break;
+    }
+    if (chunk.data() != scratch + read) {
+      memcpy(scratch + read, chunk.data(), chunk.size());
+    }
+    read += chunk.size();
+  }
+  *result = Slice(scratch, read);
+  return Status::OK();
+}
+
+//
+// Reads a MANIFEST object followed by the delta objects that continue it.
+// Deltas that are already covered by what has been read are skipped.
+//
+class ManifestWithDeltasFile : public SequentialFile {
+ public:
+  // base may be null, in which case reading starts with the deltas that
+  // follow the first pos bytes of the MANIFEST, whose checksum is crc.
+  ManifestWithDeltasFile(CloudEnv* cenv, const std::string& bucket,
+                         const std::vector<std::string>& deltas,
+                         std::unique_ptr<SequentialFile> base, uint64_t pos,
+                         uint32_t crc, bool last_attempt)
+      : cenv_(cenv),
+        bucket_(bucket),
+        deltas_(deltas),
+        next_(0),
+        current_(std::move(base)),
+        pos_(pos),
+        crc_(crc),
+        last_attempt_(last_attempt) {}
+
+  Status Read(size_t n, Slice* result, char* scratch) override {
+    *result = Slice();
+    while (true) {
+      if (!current_) {
+        if (next_ >= deltas_.size()) {
+          return Status::OK();  // end of file
+        }
+        Status s = OpenNextDelta();
+        if (!s.ok()) {
+          return s;
+        }
+        continue;
+      }
+      Status s = current_->Read(n, result, scratch);
+      if (!s.ok()) {
+        return s;
+      }
+      if (!result->empty()) {
+        crc_ = crc32c::Extend(crc_, result->data(), result->size());
+        pos_ += result->size();
+        return s;
+      }
+      current_.reset();
+    }
+  }
+
+  Status Skip(uint64_t /*n*/) override {
+    return Status::NotSupported("Skip on a MANIFEST with deltas");
+  }
+
+ private:
+  // Positions current_ at the payload of the next delta that continues the
+  // bytes read so far.
+  Status OpenNextDelta() {
+    const std::string& delta = deltas_[next_++];
+    std::unique_ptr<SequentialFile> file;
+    Status s =
+        cenv_->NewSequentialFileCloud(bucket_, delta, &file, EnvOptions());
+    if (s.IsNotFound()) {
+      // deleted by a concurrent upload of the full MANIFEST
+      if (last_attempt_) {
+        return Status::Corruption("MANIFEST delta disappeared", delta);
+      }
+      return Status::TryAgain("MANIFEST delta disappeared", delta);
+    }
+    if (!s.ok()) {
+      return s;
+    }
+    char buf[ManifestReader::kDeltaHeaderSize];
+    Slice header;
+    s = ReadFully(file.get(), sizeof(buf), &header, buf);
+    if (!s.ok()) {
+      return s;
+    }
+    if (header.size() != sizeof(buf)) {
+      return Status::Corruption("Truncated MANIFEST delta", delta);
+    }
+    uint64_t offset = DecodeFixed64(header.data());
+    uint64_t length = DecodeFixed64(header.data() + 8);
+    uint32_t prefix_crc = crc32c::Unmask(DecodeFixed32(header.data() + 16));
+    if (offset + length <= pos_) {
+      // already part of the full MANIFEST
+      return Status::OK();
+    }
+    if (offset == pos_ && prefix_crc == crc_) {
+      current_ = std::move(file);
+      return Status::OK();
+    }
+    if (offset > pos_) {
+      // A delta that we need is missing, e.g. it was deleted by a concurrent
+      // upload of the full MANIFEST; never return the truncated MANIFEST.
+      if (last_attempt_) {
+        return Status::Corruption("Gap before MANIFEST delta", delta);
+      }
+      return Status::TryAgain("Gap before MANIFEST delta", delta);
+    }
+    // This delta overlaps the MANIFEST that we have read but does not continue
+    // it. It was left behind by an earlier MANIFEST with the same name; so are
+    // all deltas after it.
+    Log(InfoLogLevel::WARN_LEVEL, cenv_->info_log_,
+        "[mn] Ignoring stale MANIFEST delta %s at offset %" PRIu64
+        ", MANIFEST size %" PRIu64,
+        delta.c_str(), offset, pos_);
+    next_ = deltas_.size();
+    return Status::OK();
+  }
+
+  CloudEnv* cenv_;
+  const std::string bucket_;
+  const std::vector<std::string> deltas_;
+  size_t next_;
+  std::unique_ptr<SequentialFile> current_;
+  uint64_t pos_;
+  uint32_t crc_;
+  const bool last_attempt_;
+};
+}  // namespace
+
 ManifestReader::ManifestReader(std::shared_ptr<Logger> info_log, CloudEnv* cenv,
                                const std::string& bucket_prefix)
     : info_log_(info_log), cenv_(cenv), bucket_prefix_(bucket_prefix) {}
@@ -45,16 +196,46 @@ Status ManifestReader::GetLiveFiles(const std::string bucket_path,
       return s;
     }
   }
+  auto manifestFile = ManifestFileWithEpoch(
+      bucket_path, cloud_manifest->GetCurrentEpoch().ToString());
+  for (int attempt = 1;; attempt++) {
+    std::set<uint64_t> live;
+    s = ReadLiveFiles(manifestFile, attempt == kMaxManifestDeltaAttempts,
+                      &live);
+    if (s.ok()) {
+      list->insert(live.begin(), live.end());
+    }
+    if (!s.IsTryAgain() || attempt >= kMaxManifestDeltaAttempts) {
+      break;
+    }
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
+      "[mn] manifest for db %s: %s", bucket_path.c_str(),
+      s.ToString().c_str());
+  return s;
+}
+
+Status ManifestReader::ReadLiveFiles(const std::string& manifestFile,
+                                     bool last_attempt,
+                                     std::set<uint64_t>* list) {
+  std::vector<std::string> deltas;
+  Status s = ListManifestDeltas(cenv_, bucket_prefix_, manifestFile, &deltas);
+  if (!s.ok()) {
+    return s;
+  }
   std::unique_ptr<SequentialFileReader> file_reader;
   {
-    auto manifestFile = ManifestFileWithEpoch(
-        bucket_path, cloud_manifest->GetCurrentEpoch().ToString());
     std::unique_ptr<SequentialFile> file;
     s = cenv_->NewSequentialFileCloud(bucket_prefix_, manifestFile, &file,
                                       EnvOptions());
     if (!s.ok()) {
       return s;
     }
+    if (!deltas.empty()) {
+      file.reset(new ManifestWithDeltasFile(cenv_, bucket_prefix_, deltas,
+                                            std::move(file), 0, 0,
+                                            last_attempt));
+    }
     file_reader.reset(new SequentialFileReader(
         NewLegacySequentialFileWrapper(file), manifestFile));
   }
@@ -90,10 +271,112 @@ Status ManifestReader::GetLiveFiles(const std::string bucket_path,
       list->erase(num);
     }
   }
-  file_reader.reset();
   Log(InfoLogLevel::DEBUG_LEVEL, info_log_,
-      "[mn] manifest for db %s has %d entries %s", bucket_path.c_str(), count,
-      s.ToString().c_str());
+      "[mn] manifest %s with %" ROCKSDB_PRIszt " deltas has %d entries %s",
+      manifestFile.c_str(), deltas.size(), count, s.ToString().c_str());
+  return s;
+}
+
+void ManifestReader::EncodeDeltaHeader(uint64_t offset, uint64_t length,
+                                       uint32_t prefix_crc, std::string* dst) {
+  PutFixed64(dst, offset);
+  PutFixed64(dst, length);
+  PutFixed32(dst, crc32c::Mask(prefix_crc));
+}
+
+Status ManifestReader::ListManifestDeltas(CloudEnv* cenv,
+                                          const std::string& bucket,
+                                          const std::string& manifest_object,
+                                          std::vector<std::string>* deltas) {
+  std::vector<std::string> objects;
+  const std::string dir = dirname(manifest_object);
+  const std::string name = basename(manifest_object);
+  // Only list the deltas, not every object of the db
+  const auto& provider = cenv->GetCloudEnvOptions().storage_provider;
+  Status s = provider->ListCloudObjectsWithPrefix(
+      bucket, dir, ManifestDeltaPrefix(name), &objects);
+  if (s.IsNotSupported()) {
+    objects.clear();
+    s = provider->ListCloudObjects(bucket, dir, &objects);
+  }
+  if (s.IsNotFound()) {
+    return Status::OK();
+  } else if (!s.ok()) {
+    return s;
+  }
+  for (const auto& o : objects) {
+    if (IsManifestDeltaFile(name, o)) {
+      deltas->push_back(dir + pathsep + o);
+    }
+  }
+  // the zero padded offset in the name orders them
+  std::sort(deltas->begin(), deltas->end());
+  return s;
+}
+
+Status ManifestReader::ApplyManifestDeltas(CloudEnv* cenv,
+                                           const std::string& bucket,
+                                           const std::string& manifest_object,
+                                           const std::string& local_manifest,
+                                           bool last_attempt) {
+  std::vector<std::string> deltas;
+  Status s = ListManifestDeltas(cenv, bucket, manifest_object, &deltas);
+  if (!s.ok() || deltas.empty()) {
+    return s;
+  }
+  Env* env = cenv->GetBaseEnv();
+  const size_t kBufferSize = 1024 * 1024;
+  std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+
+  // The deltas are chained by the checksum of the bytes that precede them
+  uint64_t pos = 0;
+  uint32_t crc = 0;
+  {
+    std::unique_ptr<SequentialFile> file;
+    s = env->NewSequentialFile(local_manifest, &file, EnvOptions());
+    while (s.ok()) {
+      Slice chunk;
+      s = file->Read(kBufferSize, &chunk, buffer.get());
+      if (!s.ok() || chunk.empty()) {
+        break;
+      }
+      crc = crc32c::Extend(crc, chunk.data(), chunk.size());
+      pos += chunk.size();
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  std::unique_ptr<WritableFile> out;
+  s = env->ReopenWritableFile(local_manifest, &out, EnvOptions());
+  if (!s.ok()) {
+    return s;
+  }
+  ManifestWithDeltasFile reader(cenv, bucket, deltas, nullptr, pos, crc,
+                                last_attempt);
+  uint64_t appended = 0;
+  while (s.ok()) {
+    Slice chunk;
+    s = reader.Read(kBufferSize, &chunk, buffer.get());
+    if (!s.ok() || chunk.empty()) {
+      break;
+    }
+    s = out->Append(chunk);
+    appended += chunk.size();
+  }
+  if (s.ok()) {
+    s = out->Sync();
+  }
+  Status cs = out->Close();
+  if (s.ok()) {
+    s = cs;
+  }
+  Log(InfoLogLevel::INFO_LEVEL, cenv->info_log_,
+      "[mn] Applied %" ROCKSDB_PRIszt " deltas (%" PRIu64
+      " bytes) of %s to %s: %s",
+      deltas.size(), appended, manifest_object.c_str(),
+      local_manifest.c_str(), s.ToString().c_str());
   return s;
 }
 
@@ -139,5 +422,48 @@ Status ManifestReader::GetMaxFileNumberFromManifest(Env* env,
   }
   return s;
 }
+
+Status ManifestReader::GetLiveFilesFromManifest(Env* env,
+                                                const std::string& fname,
+                                                std::vector<LiveFile>* files) {
+  std::unique_ptr<SequentialFile> file;
+  Status s = env->NewSequentialFile(fname, &file, EnvOptions());
+  if (!s.ok()) {
+    return s;
+  }
+  VersionSet::LogReporter reporter;
+  reporter.status = &s;
+  log::Reader reader(
+      nullptr,
+      std::unique_ptr<SequentialFileReader>(new SequentialFileReader(
+          NewLegacySequentialFileWrapper(file), fname)),
+      &reporter, true /*checksum*/, 0);
+
+  Slice record;
+  std::string scratch;
+  std::map<uint64_t, LiveFile> live;
+  while (reader.ReadRecord(&record, &scratch) && s.ok()) {
+    VersionEdit edit;
+    s = edit.DecodeFrom(record);
+    if (!s.ok()) {
+      break;
+    }
+    // A file that is moved to another level is deleted and added by the
+    // same edit, so apply the deletions first
+    for (const auto& one : edit.GetDeletedFiles()) {
+      live.erase(one.second);
+    }
+    for (const auto& one : edit.GetNewFiles()) {
+      uint64_t num = one.second.fd.GetNumber();
+      live[num] = LiveFile{num, one.first, one.second.fd.GetFileSize()};
+    }
+  }
+  if (s.ok()) {
+    for (const auto& one : live) {
+      files->push_back(one.second);
+    }
+  }
+  return s;
+}
 }  // namespace ROCKSDB_NAMESPACE
 #endif /* ROCKSDB_LITE */
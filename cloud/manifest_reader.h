@@ -10,6 +10,7 @@
 #include "cloud/cloud_env_impl.h"
 #include "rocksdb/db.h"
 #include "rocksdb/env.h"
+#include "rocksdb/status.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -29,7 +30,45 @@ class ManifestReader {
   static Status GetMaxFileNumberFromManifest(Env* env, const std::string& fname,
                                              uint64_t* maxFileNumber);
 
+  struct LiveFile {
+    uint64_t number;
+    int level;
+    uint64_t size;
+  };
+  // Returns the live sst files of a local MANIFEST file, ordered by number
+  static Status GetLiveFilesFromManifest(Env* env, const std::string& fname,
+                                         std::vector<LiveFile>* files);
+
+  // Every MANIFEST delta object starts with a header that stores the offset
+  // and length of the bytes that it holds, and the crc32c of the MANIFEST
+  // bytes before offset. The checksum ties a delta to the MANIFEST contents
+  // that it continues, so that deltas that were left behind by an earlier
+  // MANIFEST with the same name are never applied.
+  static const size_t kDeltaHeaderSize = 20;
+  static void EncodeDeltaHeader(uint64_t offset, uint64_t length,
+                                uint32_t prefix_crc, std::string* dst);
+
+  // Returns the delta objects of the specified MANIFEST object, sorted in the
+  // order in which they apply
+  static Status ListManifestDeltas(CloudEnv* cenv, const std::string& bucket,
+                                   const std::string& manifest_object,
+                                   std::vector<std::string>* deltas);
+
+  // Appends the deltas of manifest_object that continue the local file
+  // local_manifest, typically a fresh download of manifest_object.
+  // Returns TryAgain if the deltas were rewritten while they were being read;
+  // the caller should download the MANIFEST again. If last_attempt is set,
+  // a missing delta is reported as Corruption instead. Stale deltas, which
+  // overlap the local file without continuing it, are ignored.
+  static Status ApplyManifestDeltas(CloudEnv* cenv, const std::string& bucket,
+                                    const std::string& manifest_object,
+                                    const std::string& local_manifest,
+                                    bool last_attempt);
+
  private:
+  Status ReadLiveFiles(const std::string& manifest_file, bool last_attempt,
+                       std::set<uint64_t>* list);
+
   std::shared_ptr<Logger> info_log_;
   CloudEnv* cenv_;
   std::string bucket_prefix_;
@@ -2,17 +2,20 @@
 
 #ifndef ROCKSDB_LITE
 
-#ifdef USE_AWS
-
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cinttypes>
+#include <thread>
 
 #include "cloud/aws/aws_env.h"
 #include "cloud/aws/aws_file.h"
+#include "cloud/cloud_storage_provider_impl.h"
 #include "cloud/db_cloud_impl.h"
 #include "cloud/filename.h"
 #include "cloud/manifest_reader.h"
+#include "cloud/remote_compaction_worker.h"
+#include "db/compaction/compaction_offload_scheduler.h"
 #include "db/db_impl/db_impl.h"
 #include "file/filename.h"
 #include "logging/logging.h"
@@ -29,6 +32,7 @@
 
 namespace ROCKSDB_NAMESPACE {
 
+#ifdef USE_AWS
 class RemoteCompactionTest : public testing::Test {
  public:
   RemoteCompactionTest() {
@@ -494,6 +498,452 @@ TEST_F(RemoteCompactionTest, ColumnFamilyTest) {
   CloseDB();
 }
 
+#endif  // USE_AWS
+
+//
+// Runs the compactions of a db in a RemoteCompactionWorker that is connected
+// to it by pipes, with both of them on the local storage provider.
+//
+class RemoteCompactionWorkerTest : public testing::Test {
+ public:
+  RemoteCompactionWorkerTest() {
+    base_env_ = Env::Default();
+    dbname_ = test::TmpDir() + "/db_remote_compaction";
+    bucket_root_ = test::TmpDir() + "/db_remote_compaction_bucket";
+    worker_dir_ = test::TmpDir() + "/db_remote_compaction_worker";
+    cloud_env_options_.src_bucket.SetBucketName("localtest");
+    cloud_env_options_.src_bucket.SetObjectPath("db_remote_compaction");
+    cloud_env_options_.dest_bucket = cloud_env_options_.src_bucket;
+    options_.create_if_missing = true;
+    options_.disable_auto_compactions = true;
+
+    DestroyDir(dbname_);
+    DestroyDir(bucket_root_);
+    DestroyDir(worker_dir_);
+    base_env_->NewLogger(test::TmpDir(base_env_) + "/rocksdb-cloud.log",
+                         &options_.info_log);
+    options_.info_log->SetInfoLogLevel(InfoLogLevel::DEBUG_LEVEL);
+    EXPECT_OK(CloudStorageProviderImpl::CreateLocalProvider(
+        bucket_root_, &cloud_env_options_.storage_provider));
+  }
+
+  virtual ~RemoteCompactionWorkerTest() {
+    // Also when a test fails before it stops the worker
+    StopWorker();
+    CloseDB();
+    DestroyDir(dbname_);
+    DestroyDir(bucket_root_);
+    DestroyDir(worker_dir_);
+  }
+
+  void DestroyDir(const std::string& dir) {
+    std::string cmd = "rm -rf " + dir;
+    int rc = system(cmd.c_str());
+    ASSERT_EQ(rc, 0);
+  }
+
+  void OpenDB() {
+    CloudEnv* cenv;
+    ASSERT_OK(CloudEnv::NewCloudEnv(base_env_, cloud_env_options_,
+                                    options_.info_log, &cenv));
+    static_cast<CloudEnvImpl*>(cenv)->TEST_SetFileDeletionDelay(
+        std::chrono::seconds(0));
+    cenv_.reset(cenv);
+    options_.env = cenv_.get();
+    ASSERT_TRUE(db_ == nullptr);
+    ASSERT_OK(DBCloud::Open(options_, dbname_, "", 0, &db_));
+  }
+
+  void CloseDB() {
+    if (db_) {
+      db_->UnRegisterPluggableCompactionService();
+      delete db_;
+      db_ = nullptr;
+    }
+    cenv_.reset();
+  }
+
+  // Runs a worker in a thread and registers a client of it with the db
+  void StartWorker() {
+    ASSERT_EQ(pipe(requests_), 0);
+    ASSERT_EQ(pipe(results_), 0);
+    RemoteCompactionWorkerOptions worker_options;
+    worker_options.cloud_env_options = cloud_env_options_;
+    // A provider is initialized with the env that uses it, so the worker
+    // needs one of its own on the same buckets
+    ASSERT_OK(CloudStorageProviderImpl::CreateLocalProvider(
+        bucket_root_, &worker_options.cloud_env_options.storage_provider));
+    worker_options.options.info_log = options_.info_log;
+    worker_options.local_dir = worker_dir_;
+    worker_options.readahead_size = 1 << 20;
+    worker_.reset(new RemoteCompactionWorker(base_env_, worker_options));
+    worker_thread_ = port::Thread(
+        [this]() { worker_st_ = worker_->Serve(requests_[0], results_[1]); });
+    ASSERT_OK(db_->RegisterPluggableCompactionService(
+        std::unique_ptr<PluggableCompactionService>(
+            new RemoteCompactionClient(db_, requests_[1], results_[0]))));
+  }
+
+  // Ends the request stream, which stops the worker
+  void StopWorker() {
+    if (db_) {
+      db_->UnRegisterPluggableCompactionService();
+    }
+    if (worker_thread_.joinable()) {
+      close(requests_[1]);
+      worker_thread_.join();
+      close(requests_[0]);
+      close(results_[0]);
+      close(results_[1]);
+    }
+  }
+
+  // Returns the objects below the object path in the bucket
+  std::vector<std::string> ListObjects(const std::string& object_path) {
+    std::vector<std::string> objects;
+    Status st = cloud_env_options_.storage_provider->ListCloudObjects(
+        cloud_env_options_.dest_bucket.GetBucketName(), object_path, &objects);
+    EXPECT_TRUE(st.ok() || st.IsNotFound());
+    return objects;
+  }
+
+ protected:
+  Env* base_env_;
+  std::string dbname_;
+  std::string bucket_root_;
+  std::string worker_dir_;
+  CloudEnvOptions cloud_env_options_;
+  Options options_;
+  std::unique_ptr<CloudEnv> cenv_;
+  DBCloud* db_ = nullptr;
+
+  int requests_[2];
+  int results_[2];
+  std::unique_ptr<RemoteCompactionWorker> worker_;
+  port::Thread worker_thread_;
+  Status worker_st_;
+};
+
+TEST_F(RemoteCompactionWorkerTest, Codec) {
+  RemoteCompactionRequest request;
+  request.db_bucket.SetBucketName("bucket", "prefix.");
+  request.db_bucket.SetObjectPath("db");
+  request.output_bucket.SetBucketName("bucket");
+  request.output_bucket.SetObjectPath("db_compaction/1");
+  request.column_families = {kDefaultColumnFamilyName, "T"};
+  request.param.compact_options.compression = kSnappyCompression;
+  request.param.compact_options.output_file_size_limit = 64 << 20;
+  request.param.column_family_name = "T";
+  request.param.existing_snapshots = {10, 20};
+  request.param.input_files.push_back(
+      FilesInOneLevel{0, {"/db/000010.sst", "/db/000012.sst"}});
+  request.param.output_level = 1;
+  request.output_objects = {"db/000030.sst-abc"};
+  std::string encoded;
+  EncodeRemoteCompactionRequest(request, &encoded);
+  RemoteCompactionRequest decoded;
+  ASSERT_OK(DecodeRemoteCompactionRequest(encoded, &decoded));
+  ASSERT_TRUE(decoded.db_bucket == request.db_bucket);
+  ASSERT_EQ(decoded.db_bucket.GetBucketName(), "prefix.bucket");
+  ASSERT_EQ(decoded.output_bucket.GetBucketName(),
+            request.output_bucket.GetBucketName());
+  ASSERT_EQ(decoded.output_bucket.GetObjectPath(), "db_compaction/1");
+  ASSERT_EQ(decoded.column_families, request.column_families);
+  ASSERT_EQ(decoded.param.compact_options.compression, kSnappyCompression);
+  ASSERT_EQ(decoded.param.compact_options.output_file_size_limit, 64u << 20);
+  ASSERT_EQ(decoded.param.existing_snapshots,
+            request.param.existing_snapshots);
+  ASSERT_EQ(decoded.param.input_files[0].files,
+            request.param.input_files[0].files);
+  ASSERT_EQ(decoded.param.output_level, 1);
+  ASSERT_EQ(decoded.output_objects, request.output_objects);
+  ASSERT_TRUE(DecodeRemoteCompactionRequest(
+                  Slice(encoded.data(), encoded.size() - 1), &decoded)
+                  .IsCorruption());
+
+  PluggableCompactionResult result;
+  result.output_files.resize(1);
+  result.output_files[0].pathname = "db_compaction/1/000020-abc.sst";
+  result.output_files[0].file_size = 1234;
+  result.output_files[0].largest_seqno = 99;
+  result.total_bytes = 1234;
+  encoded.clear();
+  EncodeRemoteCompactionResult(Status::OK(), result, &encoded);
+  Status remote_st;
+  PluggableCompactionResult decoded_result;
+  ASSERT_OK(DecodeRemoteCompactionResult(encoded, &remote_st,
+                                         &decoded_result));
+  ASSERT_OK(remote_st);
+  ASSERT_EQ(decoded_result.output_files[0].pathname,
+            result.output_files[0].pathname);
+  ASSERT_EQ(decoded_result.output_files[0].largest_seqno, 99u);
+  ASSERT_EQ(decoded_result.total_bytes, 1234u);
+
+  encoded.clear();
+  EncodeRemoteCompactionResult(Status::Aborted("busy"), result, &encoded);
+  ASSERT_OK(DecodeRemoteCompactionResult(encoded, &remote_st,
+                                         &decoded_result));
+  ASSERT_TRUE(remote_st.IsAborted());
+
+  // Subcodes and severities survive the trip
+  encoded.clear();
+  EncodeRemoteCompactionResult(
+      Status(Status::NoSpace("disk full"), Status::kHardError), result,
+      &encoded);
+  ASSERT_OK(DecodeRemoteCompactionResult(encoded, &remote_st,
+                                         &decoded_result));
+  ASSERT_TRUE(remote_st.IsNoSpace());
+  ASSERT_EQ(remote_st.severity(), Status::kHardError);
+  ASSERT_EQ(remote_st.ToString(), Status::NoSpace("disk full").ToString());
+
+  // Messages keep their ids on a pipe
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_OK(WriteRemoteCompactionMessage(fds[1], 7, "seven"));
+  ASSERT_OK(WriteRemoteCompactionMessage(fds[1], 3, ""));
+  close(fds[1]);
+  uint64_t id = 0;
+  std::string message;
+  ASSERT_OK(ReadRemoteCompactionMessage(fds[0], &id, &message));
+  ASSERT_EQ(id, 7u);
+  ASSERT_EQ(message, "seven");
+  ASSERT_OK(ReadRemoteCompactionMessage(fds[0], &id, &message));
+  ASSERT_EQ(id, 3u);
+  ASSERT_EQ(message, "");
+  ASSERT_TRUE(ReadRemoteCompactionMessage(fds[0], &id, &message).IsNotFound());
+  close(fds[0]);
+}
+
+TEST_F(RemoteCompactionWorkerTest, CompactThroughPipes) {
+  // The db does not keep its sst files locally either, so that nothing is
+  // read from or written to its local directory by the compaction
+  cloud_env_options_.keep_local_sst_files = false;
+  OpenDB();
+  ASSERT_OK(db_->Put(WriteOptions(), "Hello", "WorldOne"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  ASSERT_OK(db_->Put(WriteOptions(), "Hello", "WorldNextGen"));
+  ASSERT_OK(db_->Put(WriteOptions(), "Aurora", "Borealis"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  std::vector<LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  ASSERT_EQ(files.size(), 2u);
+
+  StartWorker();
+  auto dbimpl = dynamic_cast<DBImpl*>(db_->GetBaseDB());
+  ASSERT_OK(dbimpl->TEST_CompactRange(0, nullptr, nullptr, nullptr, true));
+
+  files.clear();
+  db_->GetLiveFilesMetaData(&files);
+  ASSERT_EQ(files.size(), 1u);
+  ASSERT_EQ(files[0].level, 1);
+  std::string value;
+  ASSERT_OK(db_->Get(ReadOptions(), "Hello", &value));
+  ASSERT_EQ(value, "WorldNextGen");
+  ASSERT_OK(db_->Get(ReadOptions(), "Aurora", &value));
+  ASSERT_EQ(value, "Borealis");
+  // The output file was written as the file of the db that it is installed
+  // as, and the output path of the compaction was cleaned up
+  const std::string object = basename(
+      cenv_->RemapFilename(MakeTableFileName(dbname_, files[0].file_number)));
+  auto objects = ListObjects("db_remote_compaction");
+  ASSERT_NE(std::find(objects.begin(), objects.end(), object), objects.end());
+  ASSERT_EQ(ListObjects("db_remote_compaction_compaction/0").size(), 0u);
+  // The worker unregistered the db that it opened, and only the dbid of the
+  // db is left
+  ASSERT_EQ(ListObjects(".rockset/dbid").size(), 1u);
+
+  // The worker stops at the end of the request stream
+  StopWorker();
+  ASSERT_OK(worker_st_);
+  CloseDB();
+
+  // The installed file is in the bucket
+  DestroyDir(dbname_);
+  OpenDB();
+  ASSERT_OK(db_->Get(ReadOptions(), "Hello", &value));
+  ASSERT_EQ(value, "WorldNextGen");
+  ASSERT_OK(db_->Get(ReadOptions(), "Aurora", &value));
+  ASSERT_EQ(value, "Borealis");
+}
+
+TEST_F(RemoteCompactionWorkerTest, DiscardOutputs) {
+  OpenDB();
+  auto provider = cloud_env_options_.storage_provider;
+  const std::string& bucket = cloud_env_options_.dest_bucket.GetBucketName();
+  const std::string local = dbname_ + "/object";
+  ASSERT_OK(WriteStringToFile(base_env_, "data", local));
+  // Outputs adopted as files of the db are listed before and after the
+  // outputs in a directory of the worker
+  PluggableCompactionResult result;
+  for (const std::string& name : std::vector<std::string>{
+           "db_remote_compaction/000100.sst",
+           "db_remote_compaction_compaction/5/000001.sst",
+           "db_remote_compaction_compaction/5/000002.sst",
+           "db_remote_compaction/000101.sst"}) {
+    ASSERT_OK(provider->PutCloudObject(local, bucket, name));
+    OutputFile f;
+    f.pathname = name;
+    if (name.find("_compaction/") == std::string::npos) {
+      f.file_number = result.output_files.size() + 100;
+    }
+    result.output_files.push_back(f);
+  }
+  // Another output of the worker that the result does not list
+  ASSERT_OK(provider->PutCloudObject(
+      local, bucket, "db_remote_compaction_compaction/5/000003.sst"));
+
+  RemoteCompactionClient client(db_, -1, -1);
+  client.Discard(result);
+  ASSERT_EQ(ListObjects("db_remote_compaction_compaction/5").size(), 0u);
+  auto objects = ListObjects("db_remote_compaction");
+  for (const std::string name : {"000100.sst", "000101.sst"}) {
+    ASSERT_EQ(std::find(objects.begin(), objects.end(), name), objects.end());
+  }
+}
+
+TEST_F(RemoteCompactionWorkerTest, ConcurrentCompactions) {
+  cloud_env_options_.keep_local_sst_files = false;
+  OpenDB();
+  ColumnFamilyHandle* cf = nullptr;
+  ASSERT_OK(db_->CreateColumnFamily(ColumnFamilyOptions(options_), "T", &cf));
+  std::vector<ColumnFamilyHandle*> cfs = {db_->DefaultColumnFamily(), cf};
+  for (auto h : cfs) {
+    // The newer file starts at the largest key of the older one, so that the
+    // files overlap and are compacted rather than moved
+    ASSERT_OK(db_->Put(WriteOptions(), h, "Aurora", "Borealis"));
+    ASSERT_OK(db_->Put(WriteOptions(), h, "Hello", "WorldOne"));
+    ASSERT_OK(db_->Flush(FlushOptions(), h));
+    ASSERT_OK(db_->Put(WriteOptions(), h, "Hello", "WorldNextGen"));
+    ASSERT_OK(db_->Flush(FlushOptions(), h));
+  }
+  StartWorker();
+
+  // The compactions of both column families share the pipes
+  std::vector<Status> statuses(cfs.size());
+  std::vector<port::Thread> threads;
+  for (size_t i = 0; i < cfs.size(); i++) {
+    threads.emplace_back([&, i]() {
+      statuses[i] = db_->CompactRange(CompactRangeOptions(), cfs[i], nullptr,
+                                      nullptr);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& st : statuses) {
+    ASSERT_OK(st);
+  }
+  std::vector<LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  ASSERT_EQ(files.size(), 2u);
+  for (const auto& f : files) {
+    ASSERT_EQ(f.level, 1);
+  }
+  for (auto h : cfs) {
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), h, "Hello", &value));
+    ASSERT_EQ(value, "WorldNextGen");
+  }
+  StopWorker();
+  ASSERT_OK(worker_st_);
+  ASSERT_OK(db_->DestroyColumnFamilyHandle(cf));
+}
+
+// A compaction service that fails every compaction after a delay
+class SlowCompactionService : public PluggableCompactionService {
+ public:
+  explicit SlowCompactionService(std::chrono::milliseconds delay)
+      : delay_(delay) {}
+
+  Status Run(const PluggableCompactionParam& /*job*/,
+             PluggableCompactionResult* /*result*/) override {
+    runs_++;
+    std::this_thread::sleep_for(delay_);
+    return Status::Aborted("Remote compactions are not supported");
+  }
+
+  std::vector<Status> InstallFiles(
+      const std::vector<std::string>& remote_paths,
+      const std::vector<std::string>& /*local_paths*/,
+      const EnvOptions& /*env_options*/, Env* /*local_env*/) override {
+    return std::vector<Status>(remote_paths.size(),
+                               Status::NotSupported("No outputs"));
+  }
+
+  std::atomic<int> runs_{0};
+
+ private:
+  const std::chrono::milliseconds delay_;
+};
+
+TEST_F(RemoteCompactionWorkerTest, OffloadCost) {
+  CompactionOffloadOptions offload_options;
+  offload_options.local_bytes_per_sec = 1 << 20;
+  offload_options.remote_bytes_per_sec = 4 << 20;
+  PluggableCompactionParam job;
+  job.input_bytes = 4 << 20;
+  auto cost = CompactionOffloadScheduler::EstimateCost(job, offload_options);
+  ASSERT_EQ(cost.cpu_micros, 4000000u);
+  ASSERT_EQ(cost.io_bytes, 8u << 20);
+  ASSERT_EQ(cost.io_micros, 2000000u);
+}
+
+TEST_F(RemoteCompactionWorkerTest, OffloadFallsBackToLocal) {
+  OpenDB();
+  auto dbimpl = dynamic_cast<DBImpl*>(db_->GetBaseDB());
+  auto compact = [&]() {
+    ASSERT_OK(db_->Put(WriteOptions(), "Hello", "WorldOne"));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+    ASSERT_OK(db_->Put(WriteOptions(), "Hello", "WorldNextGen"));
+    ASSERT_OK(db_->Flush(FlushOptions()));
+    ASSERT_OK(dbimpl->TEST_CompactRange(0, nullptr, nullptr, nullptr, true));
+    std::string value;
+    ASSERT_OK(db_->Get(ReadOptions(), "Hello", &value));
+    ASSERT_EQ(value, "WorldNextGen");
+  };
+
+  auto pool = std::make_shared<SlowCompactionService>(
+      std::chrono::milliseconds(0));
+  CompactionOffloadScheduler* scheduler = nullptr;
+  auto register_scheduler = [&](CompactionOffloadOptions offload_options) {
+    offload_options.pools.resize(1);
+    offload_options.pools[0].service = pool;
+    std::unique_ptr<PluggableCompactionService> service =
+        NewCompactionOffloadScheduler(offload_options);
+    scheduler = static_cast<CompactionOffloadScheduler*>(service.get());
+    ASSERT_OK(db_->RegisterPluggableCompactionService(std::move(service)));
+  };
+
+  // A small compaction is not offloaded
+  register_scheduler(CompactionOffloadOptions());
+  compact();
+  ASSERT_EQ(pool->runs_, 0);
+  ASSERT_EQ(scheduler->GetStats().too_small, 1u);
+  db_->UnRegisterPluggableCompactionService();
+
+  // Nor is one that takes longer to move its data than to run locally
+  CompactionOffloadOptions offload_options;
+  offload_options.min_cpu_micros = 0;
+  offload_options.min_l0_cpu_micros = 0;
+  offload_options.remote_bytes_per_sec = 1024;
+  register_scheduler(offload_options);
+  compact();
+  ASSERT_EQ(pool->runs_, 0);
+  ASSERT_EQ(scheduler->GetStats().io_bound, 1u);
+  db_->UnRegisterPluggableCompactionService();
+
+  // A compaction that misses its deadline runs locally
+  offload_options.remote_bytes_per_sec = 0;
+  offload_options.deadline_micros = 1000;
+  pool = std::make_shared<SlowCompactionService>(
+      std::chrono::milliseconds(200));
+  register_scheduler(offload_options);
+  compact();
+  ASSERT_EQ(pool->runs_, 1);
+  ASSERT_EQ(scheduler->GetStats().timed_out, 1u);
+  db_->UnRegisterPluggableCompactionService();
+}
+
 }  //  namespace ROCKSDB_NAMESPACE
 
 // Run all pluggable compaction tests
@@ -502,17 +952,6 @@ int main(int argc, char** argv) {
   return RUN_ALL_TESTS();
 }
 
-#else  // USE_AWS
-
-#include <stdio.h>
-
-int main(int, char**) {
-  fprintf(stderr,
-          "SKIPPED as DBCloud is supported only when USE_AWS is defined.\n");
-  return 0;
-}
-#endif
-
 #else  // ROCKSDB_LITE
 
 #include <stdio.h>
@@ -0,0 +1,726 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+#ifndef ROCKSDB_LITE
+#include "cloud/remote_compaction_worker.h"
+
+#include <errno.h>
+#ifndef OS_WIN
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cinttypes>
+#include <set>
+#include <unordered_map>
+
+#include "cloud/cloud_env_impl.h"
+#include "cloud/filename.h"
+#include "file/filename.h"
+#include "logging/logging.h"
+#include "port/port.h"
+#include "rocksdb/cloud/cloud_storage_provider.h"
+#include "rocksdb/cloud/db_cloud.h"
+#include "rocksdb/db.h"
+#include "rocksdb/env.h"
+#include "util/coding.h"
+#include "util/string_util.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+const uint32_t kFormatVersion = 1;
+
+void EncodeBucket(const BucketOptions& bucket, std::string* dst) {
+  const std::string& name = bucket.GetBucketName();
+  const std::string& prefix = bucket.GetBucketPrefix();
+  // The name is empty or starts with the prefix
+  PutLengthPrefixedSlice(dst, prefix);
+  PutLengthPrefixedSlice(
+      dst, Slice(name).starts_with(prefix) ? name.substr(prefix.size()) : name);
+  PutLengthPrefixedSlice(dst, bucket.GetObjectPath());
+  PutLengthPrefixedSlice(dst, bucket.GetRegion());
+}
+
+bool DecodeBucket(Slice* input, BucketOptions* bucket) {
+  Slice prefix, name, object_path, region;
+  if (!GetLengthPrefixedSlice(input, &prefix) ||
+      !GetLengthPrefixedSlice(input, &name) ||
+      !GetLengthPrefixedSlice(input, &object_path) ||
+      !GetLengthPrefixedSlice(input, &region)) {
+    return false;
+  }
+  bucket->SetBucketName(name.ToString(), prefix.ToString());
+  bucket->SetObjectPath(object_path.ToString());
+  bucket->SetRegion(region.ToString());
+  return true;
+}
+
+bool GetString(Slice* input, std::string* value) {
+  Slice s;
+  if (!GetLengthPrefixedSlice(input, &s)) {
+    return false;
+  }
+  value->assign(s.data(), s.size());
+  return true;
+}
+
+// Recreates a status that was sent as its code, subcode, severity and
+// message
+class RemoteStatus : public Status {
+ public:
+  RemoteStatus(Code code, SubCode subcode, const std::string& msg)
+      : Status(code, subcode, msg, Slice()) {}
+};
+
+Status MakeStatus(uint32_t code, uint32_t subcode, uint32_t severity,
+                  const std::string& msg) {
+  if (code == Status::kOk) {
+    return Status::OK();
+  }
+  if (code >= Status::kMaxCode) {
+    return Status::IOError(msg);
+  }
+  if (subcode >= Status::kMaxSubCode) {
+    subcode = Status::kNone;
+  }
+  Status st = RemoteStatus(static_cast<Status::Code>(code),
+                           static_cast<Status::SubCode>(subcode), msg);
+  if (severity > Status::kNoError && severity < Status::kMaxSeverity) {
+    st = Status(st, static_cast<Status::Severity>(severity));
+  }
+  return st;
+}
+}  // namespace
+
+void EncodeRemoteCompactionRequest(const RemoteCompactionRequest& request,
+                                   std::string* dst) {
+  PutVarint32(dst, kFormatVersion);
+  EncodeBucket(request.db_bucket, dst);
+  EncodeBucket(request.output_bucket, dst);
+  PutVarint32(dst, static_cast<uint32_t>(request.column_families.size()));
+  for (const auto& cf : request.column_families) {
+    PutLengthPrefixedSlice(dst, cf);
+  }
+
+  const PluggableCompactionParam& param = request.param;
+  PutVarint32(dst, static_cast<uint32_t>(param.compact_options.compression));
+  PutVarint64(dst, param.compact_options.output_file_size_limit);
+  PutVarint32(dst,
+              static_cast<uint32_t>(param.compact_options.max_subcompactions));
+  PutLengthPrefixedSlice(dst, param.column_family_name);
+  PutVarint32(dst, static_cast<uint32_t>(param.existing_snapshots.size()));
+  for (auto snapshot : param.existing_snapshots) {
+    PutVarint64(dst, snapshot);
+  }
+  PutVarint32(dst, static_cast<uint32_t>(param.input_files.size()));
+  for (const auto& level : param.input_files) {
+    PutVarint32(dst, static_cast<uint32_t>(level.level));
+    PutVarint32(dst, static_cast<uint32_t>(level.files.size()));
+    for (const auto& f : level.files) {
+      PutLengthPrefixedSlice(dst, f);
+    }
+  }
+  PutVarint32(dst, static_cast<uint32_t>(param.output_level));
+  PutVarint32(dst, static_cast<uint32_t>(request.output_objects.size()));
+  for (const auto& o : request.output_objects) {
+    PutLengthPrefixedSlice(dst, o);
+  }
+}
+
+Status DecodeRemoteCompactionRequest(Slice input,
+                                     RemoteCompactionRequest* request) {
+  const Status corrupt =
+      Status::Corruption("Invalid remote compaction request");
+  uint32_t version = 0, count = 0, value = 0;
+  if (!GetVarint32(&input, &version)) {
+    return corrupt;
+  }
+  if (version != kFormatVersion) {
+    return Status::NotSupported("Unknown remote compaction request version",
+                                ToString(version));
+  }
+  if (!DecodeBucket(&input, &request->db_bucket) ||
+      !DecodeBucket(&input, &request->output_bucket) ||
+      !GetVarint32(&input, &count)) {
+    return corrupt;
+  }
+  request->column_families.resize(count);
+  for (auto& cf : request->column_families) {
+    if (!GetString(&input, &cf)) {
+      return corrupt;
+    }
+  }
+
+  PluggableCompactionParam* param = &request->param;
+  uint64_t output_file_size_limit = 0;
+  uint32_t max_subcompactions = 0;
+  if (!GetVarint32(&input, &value) ||
+      !GetVarint64(&input, &output_file_size_limit) ||
+      !GetVarint32(&input, &max_subcompactions) ||
+      !GetString(&input, &param->column_family_name) ||
+      !GetVarint32(&input, &count)) {
+    return corrupt;
+  }
+  param->compact_options.compression = static_cast<CompressionType>(value);
+  param->compact_options.output_file_size_limit = output_file_size_limit;
+  param->compact_options.max_subcompactions = max_subcompactions;
+  param->existing_snapshots.resize(count);
+  for (auto& snapshot : param->existing_snapshots) {
+    if (!GetVarint64(&input, &snapshot)) {
+      return corrupt;
+    }
+  }
+  if (!GetVarint32(&input, &count)) {
+    return corrupt;
+  }
+  param->input_files.resize(count);
+  for (auto& level : param->input_files) {
+    if (!GetVarint32(&input, &value) || !GetVarint32(&input, &count)) {
+      return corrupt;
+    }
+    level.level = static_cast<int>(value);
+    level.files.resize(count);
+    for (auto& f : level.files) {
+      if (!GetString(&input, &f)) {
+        return corrupt;
+      }
+    }
+  }
+  if (!GetVarint32(&input, &value)) {
+    return corrupt;
+  }
+  param->output_level = static_cast<int>(value);
+  if (!GetVarint32(&input, &count)) {
+    return corrupt;
+  }
+  request->output_objects.resize(count);
+  for (auto& o : request->output_objects) {
+    if (!GetString(&input, &o)) {
+      return corrupt;
+    }
+  }
+  return Status::OK();
+}
+
+void EncodeRemoteCompactionResult(const Status& status,
+                                  const PluggableCompactionResult& result,
+                                  std::string* dst) {
+  PutVarint32(dst, kFormatVersion);
+  PutVarint32(dst, static_cast<uint32_t>(status.code()));
+  PutVarint32(dst, static_cast<uint32_t>(status.subcode()));
+  PutVarint32(dst, static_cast<uint32_t>(status.severity()));
+  PutLengthPrefixedSlice(dst,
+                         status.getState() ? status.getState() : Slice());
+  if (!status.ok()) {
+    return;
+  }
+  PutVarint32(dst, static_cast<uint32_t>(result.output_files.size()));
+  for (const auto& f : result.output_files) {
+    PutLengthPrefixedSlice(dst, f.pathname);
+    PutVarint64(dst, f.file_size);
+    PutVarint64(dst, f.num_entries);
+    PutVarint64(dst, f.num_deletions);
+    PutVarint64(dst, f.raw_key_size);
+    PutVarint64(dst, f.raw_value_size);
+    PutLengthPrefixedSlice(dst, f.smallest_internal_key);
+    PutLengthPrefixedSlice(dst, f.largest_internal_key);
+    PutVarint64(dst, f.smallest_seqno);
+    PutVarint64(dst, f.largest_seqno);
+  }
+  PutVarint64(dst, result.total_bytes);
+  PutVarint64(dst, result.num_input_records);
+  PutVarint64(dst, result.num_output_records);
+}
+
+Status DecodeRemoteCompactionResult(Slice input, Status* status,
+                                    PluggableCompactionResult* result) {
+  const Status corrupt = Status::Corruption("Invalid remote compaction result");
+  uint32_t version = 0, code = 0, subcode = 0, severity = 0, count = 0;
+  std::string msg;
+  if (!GetVarint32(&input, &version)) {
+    return corrupt;
+  }
+  if (version != kFormatVersion) {
+    return Status::NotSupported("Unknown remote compaction result version",
+                                ToString(version));
+  }
+  if (!GetVarint32(&input, &code) || !GetVarint32(&input, &subcode) ||
+      !GetVarint32(&input, &severity) || !GetString(&input, &msg)) {
+    return corrupt;
+  }
+  *status = MakeStatus(code, subcode, severity, msg);
+  if (!status->ok()) {
+    return Status::OK();
+  }
+  if (!GetVarint32(&input, &count)) {
+    return corrupt;
+  }
+  result->output_files.resize(count);
+  for (auto& f : result->output_files) {
+    if (!GetString(&input, &f.pathname) ||
+        !GetVarint64(&input, &f.file_size) ||
+        !GetVarint64(&input, &f.num_entries) ||
+        !GetVarint64(&input, &f.num_deletions) ||
+        !GetVarint64(&input, &f.raw_key_size) ||
+        !GetVarint64(&input, &f.raw_value_size) ||
+        !GetString(&input, &f.smallest_internal_key) ||
+        !GetString(&input, &f.largest_internal_key) ||
+        !GetVarint64(&input, &f.smallest_seqno) ||
+        !GetVarint64(&input, &f.largest_seqno)) {
+      return corrupt;
+    }
+  }
+  if (!GetVarint64(&input, &result->total_bytes) ||
+      !GetVarint64(&input, &result->num_input_records) ||
+      !GetVarint64(&input, &result->num_output_records)) {
+    return corrupt;
+  }
+  return Status::OK();
+}
+
+#ifndef OS_WIN
+Status WriteRemoteCompactionMessage(int fd, uint64_t id,
+                                    const Slice& message) {
+  std::string frame;
+  PutFixed32(&frame, static_cast<uint32_t>(message.size()));
+  PutFixed64(&frame, id);
+  frame.append(message.data(), message.size());
+  const char* p = frame.data();
+  size_t left = frame.size();
+  while (left > 0) {
+    ssize_t done = write(fd, p, left);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("Unable to write remote compaction message",
+                             strerror(errno));
+    }
+    p += done;
+    left -= static_cast<size_t>(done);
+  }
+  return Status::OK();
+}
+
+namespace {
+// Reads exactly n bytes. Returns NotFound if the stream ends before the
+// first byte.
+Status ReadFully(int fd, char* p, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t r = read(fd, p + done, n - done);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::IOError("Unable to read remote compaction message",
+                             strerror(errno));
+    } else if (r == 0) {
+      return done == 0 ? Status::NotFound("End of stream")
+                       : Status::Corruption("Truncated message");
+    }
+    done += static_cast<size_t>(r);
+  }
+  return Status::OK();
+}
+}  // namespace
+
+Status ReadRemoteCompactionMessage(int fd, uint64_t* id,
+                                   std::string* message) {
+  char header[12];
+  Status st = ReadFully(fd, header, sizeof(header));
+  if (!st.ok()) {
+    return st;
+  }
+  *id = DecodeFixed64(header + 4);
+  message->resize(DecodeFixed32(header));
+  st = ReadFully(fd, &(*message)[0], message->size());
+  if (st.IsNotFound() && !message->empty()) {
+    st = Status::Corruption("Truncated message");
+  }
+  return st;
+}
+#else
+Status WriteRemoteCompactionMessage(int /*fd*/, uint64_t /*id*/,
+                                    const Slice& /*message*/) {
+  return Status::NotSupported("Remote compaction pipes");
+}
+
+Status ReadRemoteCompactionMessage(int /*fd*/, uint64_t* /*id*/,
+                                   std::string* /*message*/) {
+  return Status::NotSupported("Remote compaction pipes");
+}
+#endif
+
+RemoteCompactionWorker::RemoteCompactionWorker(
+    Env* base_env, const RemoteCompactionWorkerOptions& options)
+    : base_env_(base_env), options_(options), next_id_(0) {}
+
+Status RemoteCompactionWorker::Compact(const RemoteCompactionRequest& request,
+                                       PluggableCompactionResult* result) {
+  const auto& info_log = options_.options.info_log;
+  const std::string local_dir =
+      options_.local_dir + "/compaction-" + ToString(next_id_++);
+  Log(InfoLogLevel::INFO_LEVEL, info_log,
+      "[compaction_worker] Compacting %s/%s into %s/%s in %s",
+      request.db_bucket.GetBucketName().c_str(),
+      request.db_bucket.GetObjectPath().c_str(),
+      request.output_bucket.GetBucketName().c_str(),
+      request.output_bucket.GetObjectPath().c_str(), local_dir.c_str());
+
+  // The db is opened from its bucket, with the output bucket as its
+  // destination. Its sst files are read from and written to cloud storage.
+  CloudEnvOptions copt = options_.cloud_env_options;
+  copt.src_bucket = request.db_bucket;
+  copt.dest_bucket = request.output_bucket;
+  copt.keep_local_sst_files = false;
+  copt.run_purger = false;
+  CloudEnv* env = nullptr;
+  Status st = copt.storage_provider
+                  ? CloudEnv::NewCloudEnv(base_env_, copt, info_log, &env)
+                  : CloudEnv::NewAwsEnv(base_env_, copt, info_log, &env);
+  std::unique_ptr<CloudEnv> cenv(env);
+  if (st.ok()) {
+    st = base_env_->CreateDirIfMissing(options_.local_dir);
+  }
+  if (!st.ok()) {
+    return st;
+  }
+
+  Options options = options_.options;
+  options.env = cenv.get();
+  options.create_if_missing = false;
+  options.disable_auto_compactions = true;
+  options.compaction_readahead_size = options_.readahead_size;
+  std::vector<ColumnFamilyDescriptor> column_families;
+  for (const auto& cf : request.column_families) {
+    column_families.emplace_back(cf, ColumnFamilyOptions(options));
+  }
+  std::vector<ColumnFamilyHandle*> handles;
+  DBCloud* db = nullptr;
+  st = DBCloud::Open(options, local_dir, column_families, "", 0, &handles,
+                     &db);
+  if (st.ok()) {
+    // The output files are not part of this db. Keep them until the db that
+    // requested them installs them.
+    st = db->DisableFileDeletions();
+  }
+  // The output files that are written to the output objects, by their
+  // local names
+  std::mutex objects_mutex;
+  std::unordered_map<std::string, std::string> objects;
+  if (st.ok() && !request.output_objects.empty()) {
+    static_cast<CloudEnvImpl*>(cenv.get())
+        ->SetSstObjectNamer([&](const std::string& fname) {
+          std::lock_guard<std::mutex> lk(objects_mutex);
+          if (objects.size() == request.output_objects.size()) {
+            return std::string();
+          }
+          const std::string& o = request.output_objects[objects.size()];
+          objects[fname] = o;
+          return o;
+        });
+  }
+  if (st.ok()) {
+    st = db->ExecuteRemoteCompactionRequest(request.param, result, false);
+  }
+  static_cast<CloudEnvImpl*>(cenv.get())->SetSstObjectNamer(nullptr);
+  if (st.ok()) {
+    for (auto& f : result->output_files) {
+      auto it = objects.find(f.pathname);
+      if (it != objects.end()) {
+        f.pathname = it->second;
+        objects.erase(it);
+      } else {
+        f.pathname =
+            request.output_bucket.GetObjectPath() + "/" + basename(f.pathname);
+      }
+    }
+  }
+  // The files of a failed compaction, and those that the compaction dropped,
+  // like empty ones, whose deletion the env only queues
+  for (const auto& o : objects) {
+    cenv->GetCloudEnvOptions().storage_provider->DeleteCloudObject(
+        request.output_bucket.GetBucketName(), o.second);
+  }
+  std::string dbid;
+  if (db != nullptr) {
+    db->GetDbIdentity(dbid);
+  }
+  for (auto h : handles) {
+    delete h;
+  }
+  delete db;
+  // The db registered itself in the output bucket as a clone at the output
+  // path, which is deleted by the client
+  std::string dbid_path;
+  if (!dbid.empty() &&
+      cenv->GetPathForDbid(request.output_bucket.GetBucketName(), dbid,
+                           &dbid_path)
+          .ok() &&
+      dbid_path == request.output_bucket.GetObjectPath()) {
+    cenv->DeleteDbid(request.output_bucket.GetBucketName(), dbid);
+  }
+  cenv.reset();
+
+  // The scratch directory has no subdirectories
+  std::vector<std::string> children;
+  if (base_env_->GetChildren(local_dir, &children).ok()) {
+    for (const auto& c : children) {
+      if (c != "." && c != "..") {
+        base_env_->DeleteFile(local_dir + "/" + c);
+      }
+    }
+    base_env_->DeleteDir(local_dir);
+  }
+  Log(InfoLogLevel::INFO_LEVEL, info_log,
+      "[compaction_worker] Compacted %s/%s into %" ROCKSDB_PRIszt
+      " files of %" PRIu64 " bytes: %s",
+      request.db_bucket.GetBucketName().c_str(),
+      request.db_bucket.GetObjectPath().c_str(), result->output_files.size(),
+      result->total_bytes, st.ToString().c_str());
+  return st;
+}
+
+Status RemoteCompactionWorker::Serve(int in_fd, int out_fd) {
+  // Every thread reads a request, runs it and writes its result, until the
+  // stream ends or fails
+  std::mutex read_mutex, write_mutex;
+  std::mutex status_mutex;
+  Status serve_st;
+  auto serve = [&]() {
+    std::string message;
+    while (true) {
+      uint64_t id = 0;
+      Status st;
+      {
+        std::lock_guard<std::mutex> lk(read_mutex);
+        st = ReadRemoteCompactionMessage(in_fd, &id, &message);
+      }
+      if (st.ok()) {
+        RemoteCompactionRequest request;
+        PluggableCompactionResult result;
+        Status compact_st = DecodeRemoteCompactionRequest(message, &request);
+        if (compact_st.ok()) {
+          compact_st = Compact(request, &result);
+        }
+        message.clear();
+        EncodeRemoteCompactionResult(compact_st, result, &message);
+        std::lock_guard<std::mutex> lk(write_mutex);
+        st = WriteRemoteCompactionMessage(out_fd, id, message);
+      }
+      if (!st.ok()) {
+        if (!st.IsNotFound()) {
+          std::lock_guard<std::mutex> lk(status_mutex);
+          if (serve_st.ok()) {
+            serve_st = st;
+          }
+        }
+        return;
+      }
+    }
+  };
+  std::vector<port::Thread> threads;
+  for (int i = 1; i < options_.max_concurrent_compactions; i++) {
+    threads.emplace_back(serve);
+  }
+  serve();
+  for (auto& t : threads) {
+    t.join();
+  }
+  return serve_st;
+}
+
+RemoteCompactionClient::RemoteCompactionClient(
+    DBCloud* db, int request_fd, int result_fd,
+    const std::string& output_path_suffix)
+    : db_(db),
+      cenv_(static_cast<CloudEnvImpl*>(db->GetEnv())),
+      request_fd_(request_fd),
+      result_fd_(result_fd),
+      output_path_(cenv_->GetDestObjectPath() + output_path_suffix),
+      next_id_(0),
+      reading_(false) {}
+
+Status RemoteCompactionClient::Run(const PluggableCompactionParam& job,
+                                   PluggableCompactionResult* result) {
+  if (!cenv_->HasDestBucket()) {
+    return Status::InvalidArgument(
+        "Remote compaction needs a destination bucket");
+  }
+  RemoteCompactionRequest request;
+  request.param = job;
+  request.db_bucket = cenv_->GetCloudEnvOptions().dest_bucket;
+  request.output_bucket = request.db_bucket;
+  Status st = DB::ListColumnFamilies(db_->GetDBOptions(), db_->GetName(),
+                                     &request.column_families);
+  if (!st.ok()) {
+    return st;
+  }
+  // The worker writes the first output files as the reserved files of the db
+  std::unordered_map<std::string, uint64_t> file_numbers;
+  for (uint64_t n : job.output_file_numbers) {
+    request.output_objects.push_back(FileObject(n));
+    file_numbers[request.output_objects.back()] = n;
+  }
+
+  uint64_t id;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    id = next_id_++;
+  }
+  // Every compaction has an output path of its own, which is deleted when
+  // its files are installed. A path that is left by a crash is reused.
+  request.output_bucket.SetObjectPath(output_path_ + "/" + ToString(id));
+  std::string message;
+  EncodeRemoteCompactionRequest(request, &message);
+  {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    st = WriteRemoteCompactionMessage(request_fd_, id, message);
+  }
+  if (st.ok()) {
+    st = ReadResult(id, &message);
+  }
+  Status remote_st;
+  if (st.ok()) {
+    st = DecodeRemoteCompactionResult(message, &remote_st, result);
+  }
+  if (st.ok()) {
+    st = remote_st;
+  }
+  bool installs = false;
+  if (st.ok()) {
+    for (auto& f : result->output_files) {
+      auto it = file_numbers.find(f.pathname);
+      if (it != file_numbers.end()) {
+        f.file_number = it->second;
+        cenv_->InvalidateObjectMetadata(f.pathname);
+      } else {
+        installs = true;
+      }
+    }
+  }
+  if (!installs) {
+    // Nothing is installed from this path
+    DeleteOutputs(request.output_bucket.GetObjectPath());
+  }
+  Log(InfoLogLevel::INFO_LEVEL, cenv_->info_log_,
+      "[compaction_client] Remote compaction into %s: %s",
+      request.output_bucket.GetObjectPath().c_str(), st.ToString().c_str());
+  return st;
+}
+
+std::vector<Status> RemoteCompactionClient::InstallFiles(
+    const std::vector<std::string>& remote_paths,
+    const std::vector<std::string>& local_paths,
+    const EnvOptions& /*env_options*/, Env* /*local_env*/) {
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider.get();
+  const std::string& bucket = cenv_->GetDestBucketName();
+  const bool keep_local = cenv_->GetCloudEnvOptions().keep_local_sst_files;
+  std::vector<Status> statuses;
+  for (size_t i = 0; i < remote_paths.size(); i++) {
+    // The output file is copied within cloud storage to the name of the new
+    // file of the db, and downloaded only if the db keeps its files locally
+    const std::string local = cenv_->RemapFilename(local_paths[i]);
+    const std::string object =
+        cenv_->GetDestObjectPath() + "/" + basename(local);
+    Status st = provider->CopyCloudObject(bucket, remote_paths[i], bucket,
+                                          object);
+    cenv_->InvalidateObjectMetadata(object);
+    if (st.ok() && keep_local) {
+      st = provider->GetCloudObject(bucket, object, local);
+    }
+    Log(InfoLogLevel::DEBUG_LEVEL, cenv_->info_log_,
+        "[compaction_client] Installed %s as %s: %s", remote_paths[i].c_str(),
+        object.c_str(), st.ToString().c_str());
+    statuses.push_back(st);
+  }
+  if (!remote_paths.empty()) {
+    DeleteOutputs(dirname(remote_paths[0]));
+  }
+  return statuses;
+}
+
+Status RemoteCompactionClient::ReadResult(uint64_t id, std::string* message) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    auto it = results_.find(id);
+    if (it != results_.end()) {
+      *message = std::move(it->second);
+      results_.erase(it);
+      return Status::OK();
+    }
+    if (!read_status_.ok()) {
+      return read_status_;
+    }
+    if (reading_) {
+      // Another compaction reads the results, and hands over this one
+      results_cv_.wait(lk);
+      continue;
+    }
+    reading_ = true;
+    lk.unlock();
+    uint64_t result_id = 0;
+    std::string result;
+    Status st = ReadRemoteCompactionMessage(result_fd_, &result_id, &result);
+    lk.lock();
+    reading_ = false;
+    if (st.ok()) {
+      results_[result_id] = std::move(result);
+    } else {
+      // The results of the compactions that are still running are lost
+      read_status_ = st.IsNotFound()
+                         ? Status::IOError("Remote compaction worker is gone")
+                         : st;
+    }
+    results_cv_.notify_all();
+  }
+}
+
+uint64_t RemoteCompactionClient::OutputFileNumbersToReserve(
+    const PluggableCompactionParam& job) {
+  const uint64_t limit =
+      std::max<uint64_t>(job.compact_options.output_file_size_limit, 1);
+  // Twice the files of the input size, for the files that are cut short
+  return 2 * (job.input_bytes / limit + 1);
+}
+
+void RemoteCompactionClient::Discard(const PluggableCompactionResult& result) {
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider.get();
+  // The outputs without a reserved number are in directories of the worker,
+  // which are deleted as a whole
+  std::set<std::string> worker_dirs;
+  for (const auto& f : result.output_files) {
+    if (f.file_number != 0) {
+      // Ignore errors
+      provider->DeleteCloudObject(cenv_->GetDestBucketName(), f.pathname);
+    } else {
+      worker_dirs.insert(dirname(f.pathname));
+    }
+  }
+  for (const auto& dir : worker_dirs) {
+    DeleteOutputs(dir);
+  }
+}
+
+std::string RemoteCompactionClient::FileObject(uint64_t file_number) {
+  return cenv_->GetDestObjectPath() + "/" +
+         basename(cenv_->RemapFilename(
+             MakeTableFileName(db_->GetName(), file_number)));
+}
+
+void RemoteCompactionClient::DeleteOutputs(const std::string& object_path) {
+  auto provider = cenv_->GetCloudEnvOptions().storage_provider.get();
+  const std::string& bucket = cenv_->GetDestBucketName();
+  std::vector<std::string> objects;
+  Status st = provider->ListCloudObjects(bucket, object_path, &objects);
+  for (const auto& o : objects) {
+    // Ignore errors
+    provider->DeleteCloudObject(bucket, object_path + "/" + o);
+  }
+  Log(InfoLogLevel::DEBUG_LEVEL, cenv_->info_log_,
+      "[compaction_client] Deleted %" ROCKSDB_PRIszt " objects of %s: %s",
+      objects.size(), object_path.c_str(), st.ToString().c_str());
+}
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,180 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#pragma once
+#ifndef ROCKSDB_LITE
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rocksdb/cloud/cloud_env_options.h"
+#include "rocksdb/options.h"
+#include "rocksdb/pluggable_compaction.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+class CloudEnvImpl;
+class DBCloud;
+class Logger;
+
+//
+// A compaction request as it is sent to a compaction worker.
+//
+struct RemoteCompactionRequest {
+  // The bucket and object path of the db whose files are compacted
+  BucketOptions db_bucket;
+  // The bucket and object path below which the worker writes the output
+  // files. Nothing else may use this path.
+  BucketOptions output_bucket;
+  // All the column families of the db. A db opens with all of them.
+  std::vector<std::string> column_families;
+  PluggableCompactionParam param;
+  // The objects in the output bucket that the output files are written to,
+  // in the order they are created, before the output path is used. They are
+  // the names of reserved files of the db, which adopts them as they are.
+  std::vector<std::string> output_objects;
+};
+
+// The wire format of the requests and results. The table properties of the
+// output files are not sent: the db that installs the files does not use
+// them.
+void EncodeRemoteCompactionRequest(const RemoteCompactionRequest& request,
+                                   std::string* dst);
+Status DecodeRemoteCompactionRequest(Slice input,
+                                     RemoteCompactionRequest* request);
+void EncodeRemoteCompactionResult(const Status& status,
+                                  const PluggableCompactionResult& result,
+                                  std::string* dst);
+Status DecodeRemoteCompactionResult(Slice input, Status* status,
+                                    PluggableCompactionResult* result);
+
+// Messages are framed by a fixed32 length and a fixed64 id on a pipe or
+// socket. A result has the id of its request.
+Status WriteRemoteCompactionMessage(int fd, uint64_t id, const Slice& message);
+// Returns NotFound at the end of the stream
+Status ReadRemoteCompactionMessage(int fd, uint64_t* id, std::string* message);
+
+struct RemoteCompactionWorkerOptions {
+  // The cloud options of the dbs that the worker opens, for the storage
+  // provider and its credentials. The buckets are those of the requests.
+  // Without a storage provider, the worker uses S3.
+  CloudEnvOptions cloud_env_options;
+
+  // The options of the dbs that the worker opens. They have to match those
+  // of the db that sends the requests in everything that shapes its files:
+  // comparator, merge operator, compaction filter, table factory.
+  Options options;
+
+  // The local directory below which the worker keeps the few files of a db
+  // that it does not stream from cloud storage, like its MANIFEST.
+  std::string local_dir;
+
+  // The input files are read sequentially with this much readahead, directly
+  // from cloud storage.
+  // Default: 8MB
+  size_t readahead_size = 8 << 20;
+
+  // The number of requests of a stream that Serve runs at the same time.
+  // Their results are written as they complete.
+  // Default: 4
+  int max_concurrent_compactions = 4;
+};
+
+//
+// Runs compactions for dbs in cloud storage, away from the hosts that serve
+// the dbs.
+//
+// For every request, the worker opens the db from its bucket in a scratch
+// directory, without downloading any sst file. The input files are streamed
+// from the bucket, the output files are written to the output bucket of the
+// request, and the result names their objects there. The first output files
+// are written to the output objects of the request, if it has any.
+//
+class RemoteCompactionWorker {
+ public:
+  RemoteCompactionWorker(Env* base_env,
+                         const RemoteCompactionWorkerOptions& options);
+
+  Status Compact(const RemoteCompactionRequest& request,
+                 PluggableCompactionResult* result);
+
+  // Runs the requests that are read from in_fd and writes their results to
+  // out_fd, until in_fd is closed, max_concurrent_compactions at a time
+  Status Serve(int in_fd, int out_fd);
+
+ private:
+  Env* base_env_;
+  RemoteCompactionWorkerOptions options_;
+  std::atomic<uint64_t> next_id_;
+};
+
+//
+// A pluggable compaction service that sends the compactions of a cloud db to
+// a RemoteCompactionWorker and installs their output files.
+//
+// The requests are written to request_fd and the results read from
+// result_fd, which the compactions share: each of them waits for the result
+// with the id of its request. File numbers are reserved for the
+// output files, and the worker writes them under the names of these files in
+// the db's bucket, so that they are adopted without any copy. The output
+// files beyond those are copied into the db's bucket within cloud storage
+// and then deleted from the output path.
+//
+class RemoteCompactionClient : public PluggableCompactionService {
+ public:
+  // The outputs of the compactions are written below the db's destination
+  // object path plus output_path_suffix, in the destination bucket
+  RemoteCompactionClient(DBCloud* db, int request_fd, int result_fd,
+                         const std::string& output_path_suffix = "_compaction");
+
+  Status Run(const PluggableCompactionParam& job,
+             PluggableCompactionResult* result) override;
+
+  std::vector<Status> InstallFiles(
+      const std::vector<std::string>& remote_paths,
+      const std::vector<std::string>& local_paths,
+      const EnvOptions& env_options, Env* local_env) override;
+
+  // Enough for the output files of the compaction, unless it cuts its files
+  // at many boundaries of the next level
+  uint64_t OutputFileNumbersToReserve(
+      const PluggableCompactionParam& job) override;
+
+  void Discard(const PluggableCompactionResult& result) override;
+
+ private:
+  // Deletes the objects below the output path of a compaction
+  void DeleteOutputs(const std::string& object_path);
+  // The object of the file of the db with this number
+  std::string FileObject(uint64_t file_number);
+  // Waits for the result of the request with this id. The results are read
+  // by one waiting compaction at a time, for all of them.
+  Status ReadResult(uint64_t id, std::string* message);
+
+  DBCloud* db_;
+  CloudEnvImpl* cenv_;
+  int request_fd_;
+  int result_fd_;
+  std::string output_path_;
+
+  // Keeps the requests whole on the pipe
+  std::mutex write_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable results_cv_;
+  uint64_t next_id_;
+  // Whether a compaction is reading from result_fd
+  bool reading_;
+  // The results that were read for other compactions, by request id
+  std::map<uint64_t, std::string> results_;
+  // Set once result_fd fails or ends
+  Status read_status_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
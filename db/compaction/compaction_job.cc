@@ -569,7 +569,10 @@ Status CompactionJob::Run() {
   TEST_SYNC_POINT("CompactionJob::Run():Start");
   log_buffer_->FlushBufferToLog();
   LogCompaction();
+  return RunLocal();
+}
 
+Status CompactionJob::RunLocal() {
   const size_t num_threads = compact_->sub_compact_states.size();
   assert(num_threads > 0);
   const uint64_t start_micros = env_->NowMicros();
@@ -1753,6 +1756,7 @@ void CompactionJob::RunRemote(PluggableCompactionService* service) {
       compact_->compaction->column_family_data()->GetName();
   param.existing_snapshots = existing_snapshots_;
   param.output_level = compact_->compaction->output_level();
+  param.input_bytes = c->CalculateTotalInputSize();
   for (CompactionInputFiles f : *(c->inputs())) {
     FilesInOneLevel files_in_one_level;
     files_in_one_level.level = f.level;
@@ -1764,9 +1768,22 @@ void CompactionJob::RunRemote(PluggableCompactionService* service) {
     }
     param.input_files.push_back(files_in_one_level);
   }
+  // The pending outputs of this compaction protect these numbers too
+  const uint64_t reserve = service->OutputFileNumbersToReserve(param);
+  for (uint64_t i = 0; i < reserve; i++) {
+    param.output_file_numbers.push_back(versions_->NewFileNumber());
+  }
 
   // make the RPC
   status = service->Run(param, &result);
+  if (status.IsBusy() || status.IsTimedOut()) {
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "[%s] [JOB %d] Running compaction locally: %s",
+                   c->column_family_data()->GetName().c_str(), job_id_,
+                   status.ToString().c_str());
+    RunLocal();
+    return;
+  }
 
   // update compaction stats
   compaction_stats_.cpu_micros = 0;
@@ -1796,6 +1813,25 @@ void CompactionJob::RunRemote(PluggableCompactionService* service) {
 
   // Iterate through all output files
   for (const auto& result_file : result.output_files) {
+    if (result_file.file_number != 0) {
+      // The file already is a file of this db, and only needs to be recorded
+      // in the MANIFEST
+      if (std::find(param.output_file_numbers.begin(),
+                    param.output_file_numbers.end(),
+                    result_file.file_number) ==
+          param.output_file_numbers.end()) {
+        compact_->status = Status::Corruption(
+            "Pluggable compaction output has an unreserved file number",
+            result_file.pathname);
+        // The result is never installed
+        service->Discard(result);
+        return;
+      }
+      file_numbers.push_back(result_file.file_number);
+      ROCKS_LOG_INFO(db_options_.info_log, "Going to adopt file %s as %" PRIu64,
+                     result_file.pathname.c_str(), file_numbers.back());
+      continue;
+    }
     // Generate a new file number
     file_numbers.push_back(versions_->NewFileNumber());
     sources.push_back(result_file.pathname);
@@ -1810,8 +1846,11 @@ void CompactionJob::RunRemote(PluggableCompactionService* service) {
   }
 
   // Install all remotely compacted file into local files.
-  auto statuses =
-      service->InstallFiles(sources, destinations, file_options_, env_);
+  std::vector<Status> statuses;
+  if (!sources.empty()) {
+    statuses =
+        service->InstallFiles(sources, destinations, file_options_, env_);
+  }
   compaction_stats_.micros = env_->NowMicros() - start_micros;
 
   for (uint32_t i = 0; i < statuses.size(); ++i) {
@@ -1823,7 +1862,9 @@ void CompactionJob::RunRemote(PluggableCompactionService* service) {
                      statuses[i].ToString().c_str());
       return;
     }
+  }
 
+  for (uint32_t i = 0; i < result.output_files.size(); ++i) {
     const auto& result_file = result.output_files[i];
 
     // create new output file data structure
@@ -101,7 +101,8 @@ class CompactionJob {
   // Add compaction input/output to the current version
   Status Install(const MutableCFOptions& mutable_cf_options);
 
-  // Invoke a pluggable compaction logic.
+  // Invoke a pluggable compaction logic. The compaction runs locally if the
+  // service returns Busy or TimedOut.
   void RunRemote(PluggableCompactionService* service);
 
   // Retrieve results of this compaction and clean it up
@@ -148,6 +149,8 @@ class CompactionJob {
       int* num_files, uint64_t* bytes_read, int input_level);
 
   void LogCompaction();
+  // The part of Run() after the compaction is logged
+  Status RunLocal();
 
   int job_id_;
 
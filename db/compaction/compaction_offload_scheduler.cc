@@ -0,0 +1,234 @@
+//  Copyright (c) 2019-present, Rockset, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "db/compaction/compaction_offload_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// The output file that InstallFiles gets first; the files that are adopted
+// are not installed. Empty if every file is adopted.
+std::string FirstInstalledFile(const PluggableCompactionResult& result) {
+  for (const auto& f : result.output_files) {
+    if (f.file_number == 0) {
+      return f.pathname;
+    }
+  }
+  return std::string();
+}
+}  // namespace
+
+std::unique_ptr<PluggableCompactionService> NewCompactionOffloadScheduler(
+    const CompactionOffloadOptions& options) {
+  return std::unique_ptr<PluggableCompactionService>(
+      new CompactionOffloadScheduler(options));
+}
+
+// A remote compaction that runs in a thread of its own, so that it can be
+// abandoned when its deadline passes. Guarded by the scheduler's mutex.
+struct CompactionOffloadScheduler::Call {
+  PluggableCompactionParam job;
+  PluggableCompactionResult result;
+  Status status;
+  bool done = false;
+  bool abandoned = false;
+};
+
+CompactionCost CompactionOffloadScheduler::EstimateCost(
+    const PluggableCompactionParam& job,
+    const CompactionOffloadOptions& options) {
+  CompactionCost cost;
+  // Compaction is bound by decoding and encoding the key-values, which is
+  // linear in the input. The output is at most as large as the input.
+  cost.cpu_micros =
+      options.local_bytes_per_sec == 0
+          ? 0
+          : static_cast<uint64_t>(static_cast<double>(job.input_bytes) *
+                                  1000000 / options.local_bytes_per_sec);
+  cost.io_bytes = 2 * job.input_bytes;
+  cost.io_micros =
+      options.remote_bytes_per_sec == 0
+          ? 0
+          : static_cast<uint64_t>(static_cast<double>(cost.io_bytes) *
+                                  1000000 / options.remote_bytes_per_sec);
+  return cost;
+}
+
+CompactionOffloadScheduler::CompactionOffloadScheduler(
+    const CompactionOffloadOptions& options)
+    : options_(options), outstanding_(0) {
+  for (const auto& pool : options_.pools) {
+    pools_.emplace_back(new Pool{pool.service, pool.max_running, 0});
+  }
+}
+
+CompactionOffloadScheduler::~CompactionOffloadScheduler() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  cv_.wait(lk, [this]() { return outstanding_ == 0; });
+}
+
+Status CompactionOffloadScheduler::Run(const PluggableCompactionParam& job,
+                                       PluggableCompactionResult* result) {
+  const CompactionCost cost = EstimateCost(job, options_);
+  bool from_l0 = false;
+  for (const auto& level : job.input_files) {
+    if (level.level == 0 && !level.files.empty()) {
+      from_l0 = true;
+    }
+  }
+  Pool* pool = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (cost.cpu_micros <
+        (from_l0 ? options_.min_l0_cpu_micros : options_.min_cpu_micros)) {
+      stats_.too_small++;
+      return Status::Busy("Compaction is too small to offload");
+    }
+    if (cost.cpu_micros <= cost.io_micros) {
+      stats_.io_bound++;
+      return Status::Busy("Compaction moves more data than it is worth");
+    }
+    // The pool with the most room
+    for (auto& p : pools_) {
+      if (p->running < p->max_running &&
+          (pool == nullptr ||
+           p->max_running - p->running > pool->max_running - pool->running)) {
+        pool = p.get();
+      }
+    }
+    if (pool == nullptr) {
+      stats_.pools_busy++;
+      return Status::Busy("Every compaction pool is busy");
+    }
+    pool->running++;
+  }
+
+  Status st;
+  if (options_.deadline_micros == 0) {
+    st = pool->service->Run(job, result);
+    std::lock_guard<std::mutex> lk(mutex_);
+    pool->running--;
+  } else {
+    st = RunWithDeadline(pool, job, result);
+  }
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (st.IsTimedOut()) {
+    stats_.timed_out++;
+  } else {
+    stats_.offloaded++;
+  }
+  if (st.ok()) {
+    const std::string first = FirstInstalledFile(*result);
+    if (!first.empty()) {
+      installers_[first] = pool;
+    }
+  }
+  return st;
+}
+
+uint64_t CompactionOffloadScheduler::OutputFileNumbersToReserve(
+    const PluggableCompactionParam& job) {
+  std::vector<std::shared_ptr<PluggableCompactionService>> services;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (const auto& p : pools_) {
+      services.push_back(p->service);
+    }
+  }
+  uint64_t reserve = 0;
+  for (const auto& s : services) {
+    reserve = std::max(reserve, s->OutputFileNumbersToReserve(job));
+  }
+  return reserve;
+}
+
+Status CompactionOffloadScheduler::RunWithDeadline(
+    Pool* pool, const PluggableCompactionParam& job,
+    PluggableCompactionResult* result) {
+  auto call = std::make_shared<Call>();
+  call->job = job;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    outstanding_++;
+  }
+  std::thread([this, pool, call]() {
+    PluggableCompactionResult r;
+    Status s = pool->service->Run(call->job, &r);
+    std::unique_lock<std::mutex> lk(mutex_);
+    pool->running--;
+    if (call->abandoned) {
+      lk.unlock();
+      if (s.ok()) {
+        pool->service->Discard(r);
+      }
+      lk.lock();
+    } else {
+      call->result = std::move(r);
+      call->status = s;
+      call->done = true;
+    }
+    outstanding_--;
+    cv_.notify_all();
+  }).detach();
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  const bool done =
+      cv_.wait_for(lk, std::chrono::microseconds(options_.deadline_micros),
+                   [&call]() { return call->done; });
+  if (!done) {
+    call->abandoned = true;
+    return Status::TimedOut("Remote compaction did not complete in time");
+  }
+  *result = std::move(call->result);
+  return call->status;
+}
+
+std::vector<Status> CompactionOffloadScheduler::InstallFiles(
+    const std::vector<std::string>& remote_paths,
+    const std::vector<std::string>& local_paths,
+    const EnvOptions& env_options, Env* local_env) {
+  if (remote_paths.empty()) {
+    return std::vector<Status>();
+  }
+  Pool* pool = TakeInstaller(remote_paths[0]);
+  if (pool == nullptr) {
+    return std::vector<Status>(
+        remote_paths.size(),
+        Status::InvalidArgument("No pool ran compaction", remote_paths[0]));
+  }
+  return pool->service->InstallFiles(remote_paths, local_paths, env_options,
+                                     local_env);
+}
+
+void CompactionOffloadScheduler::Discard(
+    const PluggableCompactionResult& result) {
+  Pool* pool = TakeInstaller(FirstInstalledFile(result));
+  if (pool != nullptr) {
+    pool->service->Discard(result);
+  }
+}
+
+CompactionOffloadScheduler::Pool* CompactionOffloadScheduler::TakeInstaller(
+    const std::string& path) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = installers_.find(path);
+  if (it == installers_.end()) {
+    return nullptr;
+  }
+  Pool* pool = it->second;
+  installers_.erase(it);
+  return pool;
+}
+
+CompactionOffloadScheduler::Stats CompactionOffloadScheduler::GetStats() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return stats_;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
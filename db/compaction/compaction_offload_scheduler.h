@@ -0,0 +1,102 @@
+//  Copyright (c) 2019-present, Rockset, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rocksdb/pluggable_compaction.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// The estimated cost of a compaction
+struct CompactionCost {
+  // The CPU time that the compaction takes on one local core
+  uint64_t cpu_micros = 0;
+  // The bytes that the compaction reads and writes
+  uint64_t io_bytes = 0;
+  // The time it takes to move those bytes to and from a remote worker
+  uint64_t io_micros = 0;
+};
+
+//
+// A pluggable compaction service that offloads only the compactions that
+// are worth it to pools of remote workers, and has the others run locally.
+// See NewCompactionOffloadScheduler.
+//
+// Every pool is a service of its own that runs up to max_running
+// compactions at a time.
+//
+class CompactionOffloadScheduler : public PluggableCompactionService {
+ public:
+  struct Stats {
+    // Compactions that ran in a pool
+    uint64_t offloaded = 0;
+    // Compactions that were too small to offload
+    uint64_t too_small = 0;
+    // Compactions that take longer to move their data than to run locally
+    uint64_t io_bound = 0;
+    // Compactions for which every pool was busy
+    uint64_t pools_busy = 0;
+    // Compactions that ran locally after their deadline passed
+    uint64_t timed_out = 0;
+  };
+
+  static CompactionCost EstimateCost(const PluggableCompactionParam& job,
+                                     const CompactionOffloadOptions& options);
+
+  explicit CompactionOffloadScheduler(const CompactionOffloadOptions& options);
+  // Waits for the remote compactions that are still running
+  ~CompactionOffloadScheduler() override;
+
+  Status Run(const PluggableCompactionParam& job,
+             PluggableCompactionResult* result) override;
+
+  // As many as any of the pools reserves
+  uint64_t OutputFileNumbersToReserve(
+      const PluggableCompactionParam& job) override;
+
+  std::vector<Status> InstallFiles(
+      const std::vector<std::string>& remote_paths,
+      const std::vector<std::string>& local_paths,
+      const EnvOptions& env_options, Env* local_env) override;
+
+  // Forwards to the pool that ran the compaction
+  void Discard(const PluggableCompactionResult& result) override;
+
+  Stats GetStats();
+
+ private:
+  struct Pool {
+    std::shared_ptr<PluggableCompactionService> service;
+    int max_running;
+    int running;
+  };
+  struct Call;
+
+  Status RunWithDeadline(Pool* pool, const PluggableCompactionParam& job,
+                         PluggableCompactionResult* result);
+  // Forgets and returns the pool that ran the compaction whose first
+  // installed output file is path, or null if there is none
+  Pool* TakeInstaller(const std::string& path);
+
+  const CompactionOffloadOptions options_;
+  std::mutex mutex_;
+  // Signalled when a remote compaction completes
+  std::condition_variable cv_;
+  std::vector<std::unique_ptr<Pool>> pools_;
+  // The pool that ran a compaction, by the first of its output files that
+  // is installed, until the files are installed or discarded
+  std::map<std::string, Pool*> installers_;
+  // The remote compactions that are running in threads of their own
+  int outstanding_;
+  Stats stats_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -10,6 +10,7 @@
 #include "cache/lru_cache.h"
 #include "db/db_test_util.h"
 #include "port/stack_trace.h"
+#include "rocksdb/secondary_cache.h"
 #include "util/compression.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -285,6 +286,86 @@ TEST_F(DBBlockCacheTest, TestWithCompressedBlockCache) {
 }
 #endif  // SNAPPY
 
+TEST_F(DBBlockCacheTest, SecondaryCache) {
+  ReadOptions read_options;
+  auto table_options = GetTableOptions();
+  auto options = GetOptions(table_options);
+  InitTable(options);
+
+  CompressedSecondaryCacheOptions secondary_opts(
+      1 << 20, 0 /* num_shard_bits */,
+      LZ4_Supported() ? kLZ4Compression : kNoCompression);
+  std::shared_ptr<SecondaryCache> secondary =
+      NewCompressedSecondaryCache(secondary_opts);
+  ASSERT_NE(secondary, nullptr);
+  // With no capacity, every block is evicted as soon as it is released
+  LRUCacheOptions cache_opts(0 /* capacity */, 0 /* num_shard_bits */,
+                             false /* strict_capacity_limit */,
+                             0.0 /* high_pri_pool_ratio */);
+  cache_opts.secondary_cache = secondary;
+  table_options.block_cache = NewLRUCache(cache_opts);
+  options.table_factory.reset(new BlockBasedTableFactory(table_options));
+  Reopen(options);
+
+  std::string value(kValueSize, 'a');
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    ASSERT_EQ(value, Get(ToString(i)));
+  }
+  ASSERT_EQ(0, TestGetTickerCount(options, SECONDARY_CACHE_HITS));
+  ASSERT_LT(0, secondary->GetUsage());
+
+  // The blocks come back from the secondary cache instead of the file
+  uint64_t misses = TestGetTickerCount(options, BLOCK_CACHE_MISS);
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    ASSERT_EQ(value, Get(ToString(i)));
+  }
+  ASSERT_EQ(kNumBlocks, TestGetTickerCount(options, SECONDARY_CACHE_HITS));
+  ASSERT_EQ(misses + kNumBlocks,
+            TestGetTickerCount(options, BLOCK_CACHE_MISS));
+
+  // Reads that do not fill the block cache leave the secondary cache alone
+  read_options.fill_cache = false;
+  std::string result;
+  ASSERT_OK(db_->Get(read_options, "0", &result));
+  ASSERT_EQ(value, result);
+  ASSERT_EQ(kNumBlocks, TestGetTickerCount(options, SECONDARY_CACHE_HITS));
+}
+
+TEST_F(DBBlockCacheTest, MultiGetBatchedLookup) {
+  auto table_options = GetTableOptions();
+  table_options.block_cache = NewLRUCache(1 << 20, 2 /* num_shard_bits */);
+  auto options = GetOptions(table_options);
+  Reopen(options);
+  InitTable(options);
+  ASSERT_OK(Flush());
+
+  // One key per block, over the shards of the block cache
+  std::vector<std::string> key_strs;
+  for (size_t i = 0; i < kNumBlocks; i++) {
+    key_strs.push_back(ToString(i));
+  }
+  std::vector<Slice> keys(key_strs.begin(), key_strs.end());
+  std::string value(kValueSize, 'a');
+  for (int round = 0; round < 2; round++) {
+    uint64_t misses = TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS);
+    uint64_t hits = TestGetTickerCount(options, BLOCK_CACHE_DATA_HIT);
+    std::vector<PinnableSlice> values(keys.size());
+    std::vector<Status> statuses(keys.size());
+    db_->MultiGet(ReadOptions(), db_->DefaultColumnFamily(), keys.size(),
+                  keys.data(), values.data(), statuses.data());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_OK(statuses[i]);
+      ASSERT_EQ(value, values[i].ToString());
+    }
+    // The first round reads the blocks into the cache, and the second one
+    // finds all of them there
+    ASSERT_EQ(misses + (round == 0 ? kNumBlocks : 0),
+              TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS));
+    ASSERT_EQ(hits + (round == 0 ? 0 : kNumBlocks),
+              TestGetTickerCount(options, BLOCK_CACHE_DATA_HIT));
+  }
+}
+
 #ifndef ROCKSDB_LITE
 
 // Make sure that when options.block_cache is set, after a new table is
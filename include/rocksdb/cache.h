@@ -34,6 +34,7 @@ namespace ROCKSDB_NAMESPACE {
 
 class Cache;
 struct ConfigOptions;
+class SecondaryCache;
 
 extern const bool kDefaultToAdaptiveMutex;
 
@@ -87,6 +88,25 @@ struct LRUCacheOptions {
   CacheMetadataChargePolicy metadata_charge_policy =
       kDefaultCacheMetadataChargePolicy;
 
+  // If non-nullptr, the entries that the cache evicts for lack of space are
+  // saved to this secondary cache, if they were inserted with a
+  // SaveToCallback. The block based table looks a block up in the secondary
+  // cache when it misses the cache, and inserts it back into the cache. See
+  // include/rocksdb/secondary_cache.h.
+  std::shared_ptr<SecondaryCache> secondary_cache;
+
+  // If true, a low priority entry that would evict the least recently used
+  // entry is only inserted if its key was looked up more often, as estimated
+  // by a TinyLFU-style count-min sketch of the recent lookups of each shard.
+  // This keeps blocks that are read only once, such as those of long range
+  // scans, from evicting the blocks of frequent point lookups. High priority
+  // entries are always inserted.
+  //
+  // An entry that is not admitted is freed right away, or when the returned
+  // handle is released, and Insert returns Status::OkNotAdmitted(). With
+  // strict_capacity_limit, an insert that asks for a handle fails instead.
+  bool frequency_admission = false;
+
   LRUCacheOptions() {}
   LRUCacheOptions(size_t _capacity, int _num_shard_bits,
                   bool _strict_capacity_limit, double _high_pri_pool_ratio,
@@ -131,12 +151,68 @@ extern std::shared_ptr<Cache> NewClockCache(
     bool strict_capacity_limit = false,
     CacheMetadataChargePolicy metadata_charge_policy =
         kDefaultCacheMetadataChargePolicy);
+
+struct FastClockCacheOptions {
+  // Capacity of the cache.
+  size_t capacity = 0;
+
+  // The expected charge of an entry. The hash table of every shard has a
+  // fixed number of slots, which is derived from the capacity of the shard
+  // divided by this. When the table fills up with smaller entries, the
+  // entries are evicted before the cache reaches its capacity, and if they
+  // are larger, part of the table stays unused. For a block cache, use the
+  // block size plus a bit.
+  size_t estimated_entry_charge = 4 * 1024;
+
+  // Cache is sharded into 2^num_shard_bits shards,
+  // by hash of key. Refer to NewLRUCache for further
+  // information.
+  int num_shard_bits = -1;
+
+  // If strict_capacity_limit is set,
+  // insert to the cache will fail when cache is full.
+  bool strict_capacity_limit = false;
+
+  // If non-nullptr will use this allocator instead of system allocator when
+  // allocating memory for cache blocks. See LRUCacheOptions.
+  std::shared_ptr<MemoryAllocator> memory_allocator;
+
+  CacheMetadataChargePolicy metadata_charge_policy =
+      kDefaultCacheMetadataChargePolicy;
+
+  FastClockCacheOptions() {}
+  FastClockCacheOptions(size_t _capacity, size_t _estimated_entry_charge,
+                        int _num_shard_bits = -1,
+                        bool _strict_capacity_limit = false,
+                        CacheMetadataChargePolicy _metadata_charge_policy =
+                            kDefaultCacheMetadataChargePolicy)
+      : capacity(_capacity),
+        estimated_entry_charge(_estimated_entry_charge),
+        num_shard_bits(_num_shard_bits),
+        strict_capacity_limit(_strict_capacity_limit),
+        metadata_charge_policy(_metadata_charge_policy) {}
+};
+
+// Create a cache based on the CLOCK algorithm that takes no lock: lookups
+// and releases only update atomic counters in a fixed-size hash table. It
+// scales better than LRUCache with many threads reading from the cache, and
+// unlike NewClockCache it does not depend on TBB. See
+// cache/fast_clock_cache.h for more detail.
+//
+// Return nullptr if the options are invalid.
+extern std::shared_ptr<Cache> NewFastClockCache(
+    const FastClockCacheOptions& cache_opts);
+
 class Cache {
  public:
   // Depending on implementation, cache entries with high priority could be less
   // likely to get evicted than low priority entries.
   enum class Priority { HIGH, LOW };
 
+  // Returns the bytes that a value can be rebuilt from. The bytes must stay
+  // valid as long as the value does.
+  using SaveToCallback = Slice (*)(void* value);
+
   Cache(std::shared_ptr<MemoryAllocator> allocator = nullptr)
       : memory_allocator_(std::move(allocator)) {}
   // No copying allowed
@@ -190,6 +266,19 @@ class Cache {
                         Handle** handle = nullptr,
                         Priority priority = Priority::LOW) = 0;
 
+  // Same as Insert, but when the cache evicts the entry it may save the
+  // bytes returned by "save_to" to its secondary cache, from which
+  // LookupSecondary can return them. Caches without a secondary cache ignore
+  // "save_to".
+  virtual Status InsertWithSaveTo(const Slice& key, void* value, size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value),
+                                  SaveToCallback /*save_to*/,
+                                  Handle** handle = nullptr,
+                                  Priority priority = Priority::LOW) {
+    return Insert(key, value, charge, deleter, handle, priority);
+  }
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -199,6 +288,28 @@ class Cache {
   // function.
   virtual Handle* Lookup(const Slice& key, Statistics* stats = nullptr) = 0;
 
+  // Looks up "num_keys" keys at once. handles[i] is set to the handle of
+  // keys[i], or to nullptr if it is not found, and each handle that is found
+  // must be released as if it was returned by Lookup(). Sharded caches lock
+  // each shard once for all the keys that map to it, instead of once per key.
+  virtual void LookupBatch(size_t num_keys, const Slice* keys,
+                           Handle** handles, Statistics* stats = nullptr) {
+    for (size_t i = 0; i < num_keys; i++) {
+      handles[i] = Lookup(keys[i], stats);
+    }
+  }
+
+  // Returns the bytes saved for "key" in the secondary cache, in a new buffer,
+  // and removes them from the secondary cache. The caller is expected to
+  // rebuild the value and insert it into this cache. Returns NotFound if the
+  // secondary cache has no such entry, and NotSupported if there is no
+  // secondary cache.
+  virtual Status LookupSecondary(const Slice& /*key*/,
+                                 std::unique_ptr<char[]>* /*contents*/,
+                                 size_t* /*size*/) {
+    return Status::NotSupported("Cache has no secondary cache");
+  }
+
   // Increments the reference count for the handle if it refers to an entry in
   // the cache. Returns true if refcount was incremented; otherwise, returns
   // false.
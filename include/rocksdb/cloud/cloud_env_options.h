@@ -22,6 +22,9 @@ namespace ROCKSDB_NAMESPACE {
 class CloudEnv;
 class CloudLogController;
 class CloudStorageProvider;
+class CloudStorageReadableFile;
+class Statistics;
+enum CompressionType : unsigned char;
 
 enum CloudType : unsigned char {
   kCloudNone = 0x0,       // Not really a cloud env
@@ -121,6 +124,8 @@ class BucketOptions {
   // If no prefix is specified, the bucket name will use the existing prefix
   void SetBucketName(const std::string& bucket, const std::string& prefix = "");
   const std::string& GetBucketName() const { return name_; }
+  // The prefix that the bucket name starts with
+  const std::string& GetBucketPrefix() const { return prefix_; }
   const std::string& GetObjectPath() const { return object_; }
   void SetObjectPath(const std::string& object) { object_ = object; }
   const std::string& GetRegion() const { return region_; }
@@ -208,6 +213,9 @@ class CloudEnvOptions {
   // The time period when the purger checks and deleted obselete files.
   // This is the time when the purger wakes up, scans the cloud bucket
   // for files that are not part of any DB and then deletes them.
+  // The files that a db drops are deleted through its deletion journal
+  // (see deletion_threads), so the scans only reconcile the objects that
+  // leak otherwise.
   // Default: 10 minutes
   uint64_t purger_periodicity_millis;
 
@@ -300,6 +308,159 @@ class CloudEnvOptions {
   // Default: false.
   bool skip_cloud_files_in_getchildren;
 
+  // Number of background threads that upload sst files to the destination
+  // bucket. If zero, an sst file is uploaded synchronously when it is closed,
+  // which stalls flushes and compactions on cloud storage latency. If
+  // positive, the upload is queued and the file is closed right away; every
+  // MANIFEST sync waits for the queued uploads first, so the MANIFEST in cloud
+  // storage never references a file that has not been uploaded.
+  // Default: 0
+  int async_upload_threads;
+
+  // Maximum number of sst uploads that may be queued or running at the same
+  // time. Closing an sst file blocks once this many uploads are outstanding.
+  // Only used if async_upload_threads > 0.
+  // Default: 16
+  int max_pending_uploads;
+
+  // If true, a MANIFEST sync uploads only the bytes that were appended since
+  // the previous sync, as a small delta object next to the MANIFEST, instead
+  // of uploading the whole MANIFEST again. Readers rebuild the MANIFEST from
+  // the last full copy plus its deltas.
+  // Default: false
+  bool manifest_delta_upload;
+
+  // Number of MANIFEST deltas after which the full MANIFEST is uploaded again
+  // in the background and the deltas it covers are deleted. Only used if
+  // manifest_delta_upload is true.
+  // Default: 64
+  int manifest_delta_compaction_trigger;
+
+  // A directory on local storage that caches blocks of the sst files that
+  // are read from cloud storage because keep_local_sst_files is false. The
+  // cache survives restarts. If empty, or if sst_block_cache_size is zero,
+  // every read of such a file goes to cloud storage.
+  // Default: ""
+  std::string sst_block_cache_path;
+
+  // Capacity of the sst block cache in bytes.
+  // Default: 0
+  uint64_t sst_block_cache_size;
+
+  // Size of the blocks that the sst block cache reads from cloud storage and
+  // caches. Reads are rounded up to whole blocks.
+  // Default: 1MB
+  size_t sst_block_cache_block_size;
+
+  // If set, the sst block cache records its hits and misses here as
+  // PERSISTENT_CACHE_HIT and PERSISTENT_CACHE_MISS. Typically the statistics
+  // of the db (Options::statistics).
+  // Default: nullptr
+  std::shared_ptr<Statistics> statistics;
+
+  // Files that are read directly from cloud storage detect sequential reads
+  // and read ahead, starting with min_readahead_size bytes and doubling the
+  // readahead on every further sequential read up to max_readahead_size.
+  // Every sequential reader of a file reads ahead on its own, but the data
+  // read ahead for all readers of a file stays within max_readahead_size.
+  // MultiRead() batches are served by merging reads that are at most
+  // min_readahead_size bytes apart into one request of up to
+  // max_readahead_size bytes. A max_readahead_size of zero disables both.
+  // Default: 64KB and 2MB
+  size_t min_readahead_size;
+  size_t max_readahead_size;
+
+  // Number of threads that download or upload the parts of an object larger
+  // than transfer_part_size in parallel. The threads are shared by all
+  // transfers of the env. Uploads are split into parts only if the storage
+  // provider supports multipart uploads, and downloads only if the size of
+  // the object is known beforehand, like that of an sst file from the
+  // MANIFEST. If zero, every object is transferred as a single stream.
+  // Default: 0
+  int transfer_threads;
+
+  // Size of the parts of a parallel transfer. S3 requires parts of at least
+  // 5MB.
+  // Default: 16MB
+  uint64_t transfer_part_size;
+
+  // If keep_local_sst_files is true, the number of threads that download
+  // the live sst files of the cloud MANIFEST when the db is opened, L0 and
+  // last level files first. Files that are opened before they are prefetched
+  // are downloaded on demand as usual. If zero, sst files are only ever
+  // downloaded on demand.
+  // Default: 0
+  int sst_prefetch_threads;
+
+  // If true, the size and modification time of the sst objects that were
+  // listed, uploaded or deleted by this env are remembered, so that
+  // FileExists, GetFileSize and GetFileModificationTime of sst files that
+  // are not on local storage are answered without a request to cloud
+  // storage. Objects in the destination bucket are only ever changed by
+  // this env, and their entries never expire.
+  // Default: false
+  bool use_object_metadata_cache;
+
+  // Time after which the cached listings of a bucket, and the cached objects
+  // of a source bucket that differs from the destination, are looked up in
+  // cloud storage again.
+  // Default: 60 seconds
+  uint64_t object_metadata_cache_ttl_millis;
+
+  // The most objects whose information is kept by the object metadata cache.
+  // The least recently used ones are looked up in cloud storage again.
+  // Default: 100000
+  size_t object_metadata_cache_capacity;
+
+  // If keep_local_log_files is false, the records of a log file are packed
+  // into stream messages of up to log_batch_size bytes instead of one
+  // message each. A batch is sent when it is full, log_batch_delay_micros
+  // after its first record was added, and on Sync() and Close(). Flush() no
+  // longer waits for the stream to acknowledge the records; Sync() does.
+  // Kinesis records cannot be larger than 1MB. If zero, every record is a
+  // message of its own.
+  // Default: 0
+  size_t log_batch_size;
+
+  // The longest time that a record waits in a batch before it is sent
+  // Default: 5ms
+  uint64_t log_batch_delay_micros;
+
+  // The compression of the log batches. A batch is sent uncompressed if the
+  // compression is not supported or does not pay off.
+  // Default: kNoCompression
+  CompressionType log_compression;
+
+  // Number of threads that apply the records of the log stream to the local
+  // cache of the log files. The records of different log files are applied
+  // in parallel, those of one file in order. If zero, the tailer applies the
+  // records itself.
+  // Default: 0
+  int log_apply_threads;
+
+  // Number of threads that delete the objects of the sst files that a db
+  // dropped, once their grace period is over. The pending deletions are
+  // journaled in the destination bucket and carried out by the next instance
+  // of the db if this one goes away before they are due.
+  // Default: 1
+  int deletion_threads;
+
+  // The most objects of obsolete files that are deleted per second. Zero
+  // deletes them as fast as the threads can.
+  // Default: 0
+  uint64_t max_deletions_per_sec;
+
+  // Number of workers of the scheduler that the cloud envs of the process
+  // share, e.g. for the batches of the cloud log. The shared pool grows to
+  // the largest number that an env asks for.
+  // Default: 4
+  int scheduler_threads;
+
+  // The statistics of the jobs of the shared scheduler are written to the
+  // info log every this many seconds. Zero disables it.
+  // Default: 600
+  unsigned int scheduler_stats_dump_period_sec;
+
   CloudEnvOptions(
       CloudType _cloud_type = CloudType::kCloudAws,
       LogType _log_type = LogType::kLogKafka,
@@ -314,7 +475,28 @@ class CloudEnvOptions {
       bool _use_aws_transfer_manager = false,
       int _number_objects_listed_in_one_iteration = 5000,
       int _constant_sst_file_size_in_sst_file_manager = -1,
-      bool _skip_cloud_files_in_getchildren = false)
+      bool _skip_cloud_files_in_getchildren = false,
+      int _async_upload_threads = 0, int _max_pending_uploads = 16,
+      bool _manifest_delta_upload = false,
+      int _manifest_delta_compaction_trigger = 64,
+      std::string _sst_block_cache_path = "",
+      uint64_t _sst_block_cache_size = 0,
+      size_t _sst_block_cache_block_size = 1024 * 1024,
+      size_t _min_readahead_size = 64 * 1024,
+      size_t _max_readahead_size = 2 * 1024 * 1024,
+      int _transfer_threads = 0,
+      uint64_t _transfer_part_size = 16 * 1024 * 1024,
+      int _sst_prefetch_threads = 0,
+      bool _use_object_metadata_cache = false,
+      uint64_t _object_metadata_cache_ttl_millis = 60 * 1000,
+      size_t _log_batch_size = 0, uint64_t _log_batch_delay_micros = 5000,
+      // kNoCompression
+      CompressionType _log_compression = static_cast<CompressionType>(0x0),
+      int _log_apply_threads = 0, int _deletion_threads = 1,
+      uint64_t _max_deletions_per_sec = 0,
+      size_t _object_metadata_cache_capacity = 100000,
+      int _scheduler_threads = 4,
+      unsigned int _scheduler_stats_dump_period_sec = 600)
       : cloud_type(_cloud_type),
         log_type(_log_type),
         keep_local_sst_files(_keep_local_sst_files),
@@ -334,7 +516,30 @@ class CloudEnvOptions {
             _number_objects_listed_in_one_iteration),
         constant_sst_file_size_in_sst_file_manager(
             _constant_sst_file_size_in_sst_file_manager),
-        skip_cloud_files_in_getchildren(_skip_cloud_files_in_getchildren) {}
+        skip_cloud_files_in_getchildren(_skip_cloud_files_in_getchildren),
+        async_upload_threads(_async_upload_threads),
+        max_pending_uploads(_max_pending_uploads),
+        manifest_delta_upload(_manifest_delta_upload),
+        manifest_delta_compaction_trigger(_manifest_delta_compaction_trigger),
+        sst_block_cache_path(std::move(_sst_block_cache_path)),
+        sst_block_cache_size(_sst_block_cache_size),
+        sst_block_cache_block_size(_sst_block_cache_block_size),
+        min_readahead_size(_min_readahead_size),
+        max_readahead_size(_max_readahead_size),
+        transfer_threads(_transfer_threads),
+        transfer_part_size(_transfer_part_size),
+        sst_prefetch_threads(_sst_prefetch_threads),
+        use_object_metadata_cache(_use_object_metadata_cache),
+        object_metadata_cache_ttl_millis(_object_metadata_cache_ttl_millis),
+        object_metadata_cache_capacity(_object_metadata_cache_capacity),
+        log_batch_size(_log_batch_size),
+        log_batch_delay_micros(_log_batch_delay_micros),
+        log_compression(_log_compression),
+        log_apply_threads(_log_apply_threads),
+        deletion_threads(_deletion_threads),
+        max_deletions_per_sec(_max_deletions_per_sec),
+        scheduler_threads(_scheduler_threads),
+        scheduler_stats_dump_period_sec(_scheduler_stats_dump_period_sec) {}
 
   // print out all options to the log
   void Dump(Logger* log) const;
@@ -349,8 +554,16 @@ class CloudEnvOptions {
 };
 
 struct CheckpointToCloudOptions {
+  // Number of files that are uploaded from local storage at the same time
   int thread_count = 8;
   bool flush_memtable = false;
+  // Skip the sst files that the destination has already, with the same size
+  // and content hash. The destination is listed once to find them.
+  bool skip_existing_files = true;
+  // Number of sst files that are copied within cloud storage at the same
+  // time. Such copies do not pass through this host, so many more of them
+  // can run than uploads.
+  int copy_thread_count = 32;
 };
 
 // A map of dbid to the pathname where the db is stored
@@ -437,6 +650,24 @@ class CloudEnv : public Env {
   virtual Status CopyLocalFileToDest(const std::string& local_name,
                                      const std::string& cloud_name) = 0;
 
+  // Queues the upload of a local sst file to the destination bucket if the
+  // env uploads files in the background (see async_upload_threads), and
+  // returns NotSupported otherwise.
+  virtual Status CopyLocalFileToDestAsync(const std::string& /*local_name*/,
+                                          const std::string& /*cloud_name*/) {
+    return Status::NotSupported("CopyLocalFileToDestAsync", Name());
+  }
+  // Blocks until the background uploads that were queued before have
+  // reached the destination bucket.
+  virtual Status WaitForPendingUploads() { return Status::OK(); }
+
+  // Called on every file opened on a cloud object of the given size, so that
+  // the env can wrap it, e.g. to read it through a local cache.
+  virtual void WrapCloudReadableFile(
+      const std::string& /*bucket*/, const std::string& /*object_path*/,
+      uint64_t /*size*/,
+      std::unique_ptr<CloudStorageReadableFile>* /*file*/) {}
+
   // Transfers the filename from RocksDB's domain to the physical domain, based
   // on information stored in CLOUDMANIFEST.
   // For example, it will map 00010.sst to 00010.sst-[epoch] where [epoch] is
@@ -467,6 +698,14 @@ class CloudEnv : public Env {
   static Status NewAwsEnv(Env* base_env, const CloudEnvOptions& env_options,
                           const std::shared_ptr<Logger>& logger,
                           CloudEnv** cenv);
+
+  // Create a new cloud env that uses the storage provider (and, if remote log
+  // files are used, the log controller) configured in env_options. Unlike
+  // NewAwsEnv, this does not require the AWS SDK, so it can be used with
+  // storage providers that do not talk to S3.
+  static Status NewCloudEnv(Env* base_env, const CloudEnvOptions& env_options,
+                            const std::shared_ptr<Logger>& logger,
+                            CloudEnv** cenv);
 };
 
 }  // namespace ROCKSDB_NAMESPACE
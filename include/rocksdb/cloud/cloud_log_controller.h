@@ -11,6 +11,20 @@ namespace ROCKSDB_NAMESPACE {
 class CloudEnv;
 class CloudEnvOptions;
 
+// How far the local cache of the log files is behind the cloud log stream
+struct CloudLogTailerStats {
+  // Records that the tailer read from the stream but did not apply yet
+  uint64_t records_behind = 0;
+  // Bytes of log file data that the tailer did not apply yet
+  uint64_t bytes_behind = 0;
+  // Records applied to the local cache of the log files
+  uint64_t records_applied = 0;
+  // Bytes of log file data applied to the local cache
+  uint64_t bytes_applied = 0;
+  // Writes to the cached files. Appends at adjacent offsets share a write.
+  uint64_t writes = 0;
+};
+
 // Creates a new file, appends data to a file or delete an existing file via
 // logging into a cloud stream (such as Kinesis).
 //
@@ -72,6 +86,12 @@ class CloudLogController {
   virtual const std::string& GetCacheDir() const = 0;
   virtual Status const status() const = 0;
 
+  // How far the local cache of the log files is behind the stream. Empty if
+  // the controller does not tail a stream.
+  virtual CloudLogTailerStats GetTailerStats() {
+    return CloudLogTailerStats();
+  }
+
   virtual Status StartTailingStream(const std::string& topic) = 0;
   virtual void StopTailingStream() = 0;
   virtual Status GetFileModificationTime(const std::string& fname,
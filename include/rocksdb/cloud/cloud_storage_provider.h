@@ -66,6 +66,24 @@ class CloudStorageProvider {
                                   const std::string& object_path,
                                   std::vector<std::string>* path_names) = 0;
 
+  // Like ListCloudObjects, but also returns the size, modification time and
+  // content hash of every object in infos, in the same order as path_names.
+  // The user metadata of the objects is not returned. Listing the
+  // information costs no more requests than listing the names.
+  // Returns NotSupported if the provider cannot do that.
+  virtual Status ListCloudObjectsWithInfo(
+      const std::string& bucket_name, const std::string& object_path,
+      std::vector<std::string>* path_names,
+      std::vector<CloudObjectInformation>* infos);
+
+  // Like ListCloudObjects, but only returns the objects whose names start
+  // with name_prefix. The provider lists no other object, so this costs
+  // requests in proportion to the matching objects only.
+  // Returns NotSupported if the provider cannot do that.
+  virtual Status ListCloudObjectsWithPrefix(
+      const std::string& bucket_name, const std::string& object_path,
+      const std::string& name_prefix, std::vector<std::string>* path_names);
+
   // Does the specified object exist in the cloud storage
   virtual Status ExistsCloudObject(const std::string& bucket_name,
                                    const std::string& object_path) = 0;
@@ -97,6 +115,16 @@ class CloudStorageProvider {
                                 const std::string& object_path,
                                 const std::string& local_path) = 0;
 
+  // Like GetCloudObject(), for an object whose size is already known, e.g.
+  // from the MANIFEST, so that the provider need not look it up to decide
+  // how to download it. The default ignores the size.
+  virtual Status GetCloudObjectOfSize(const std::string& bucket_name,
+                                      const std::string& object_path,
+                                      const std::string& local_path,
+                                      uint64_t /*size*/) {
+    return GetCloudObject(bucket_name, object_path, local_path);
+  }
+
   // Uploads object to the cloud
   virtual Status PutCloudObject(const std::string& local_path,
                                 const std::string& bucket_name,
@@ -121,6 +149,16 @@ class CloudStorageProvider {
       std::unique_ptr<CloudStorageReadableFile>* result,
       const EnvOptions& options) = 0;
 
+  // Like NewCloudReadableFile, for an object whose size is known, e.g. from
+  // the MANIFEST, so that the provider can open it without asking for its
+  // metadata. A size of zero is unknown. The default ignores the size.
+  virtual Status NewCloudReadableFileOfSize(
+      const std::string& bucket, const std::string& fname, uint64_t /*size*/,
+      std::unique_ptr<CloudStorageReadableFile>* result,
+      const EnvOptions& options) {
+    return NewCloudReadableFile(bucket, fname, result, options);
+  }
+
   // Prepares/Initializes the storage provider for the input cloud environment
   virtual Status Prepare(CloudEnv* env);
 };
@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 #include <climits>
+#include <memory>
 #include <vector>
 
 #include "rocksdb/options.h"
@@ -39,6 +40,16 @@ class PluggableCompactionParam {
 
   // The level to which the files are compacted into
   int output_level;
+
+  // The total size of the input files. It is not needed to run the
+  // compaction, but tells a service what the compaction costs.
+  uint64_t input_bytes = 0;
+
+  // File numbers of the db that were reserved for the output files, as many
+  // as the service asked for with OutputFileNumbersToReserve. An output file
+  // that a service writes as one of these files of the db is adopted as it
+  // is. The numbers that are not used are skipped.
+  std::vector<uint64_t> output_file_numbers;
 };
 
 //
@@ -50,13 +61,13 @@ class PluggableCompactionResult {
   std::vector<OutputFile> output_files;
 
   // The total size of the output files
-  uint64_t total_bytes;
+  uint64_t total_bytes = 0;
 
   // The total number of records that were input to this compaction
-  uint64_t num_input_records;
+  uint64_t num_input_records = 0;
 
   // The total number of records that were output from this compaction
-  uint64_t num_output_records;
+  uint64_t num_output_records = 0;
 };
 
 /**
@@ -64,7 +75,11 @@ class PluggableCompactionResult {
  * When it is time to do a compaction, RocksDB will invoke the Run method.
  * If the Run method completes successfully, then RocksDB will invoke the
  * InstallFile method to install the results of that compaction
- * on the local database instance.
+ * on the local database instance. The output files that already are files
+ * of the database (see OutputFile::file_number) are not installed: they are
+ * only recorded in the MANIFEST.
+ * If the Run method returns Busy or TimedOut, then RocksDB runs the
+ * compaction locally instead.
  * All methods of this service are called from background threads.
  */
 class PluggableCompactionService {
@@ -74,6 +89,13 @@ class PluggableCompactionService {
   virtual Status Run(const PluggableCompactionParam& job,
                      PluggableCompactionResult* result) = 0;
 
+  // The number of file numbers to reserve for the output files of a
+  // compaction before it is run, in output_file_numbers of the job.
+  virtual uint64_t OutputFileNumbersToReserve(
+      const PluggableCompactionParam& /*job*/) {
+    return 0;
+  }
+
   // Install files that were generated by a pluggable compaction request into
   // the local database.
   virtual std::vector<Status> InstallFiles(
@@ -81,9 +103,63 @@ class PluggableCompactionService {
       const std::vector<std::string>& local_paths,
       const EnvOptions& env_options, Env* local_env) = 0;
 
+  // Drop the files of a compaction that completed after its result was no
+  // longer wanted, so that they are never installed.
+  virtual void Discard(const PluggableCompactionResult& /*result*/) {}
+
   virtual ~PluggableCompactionService() {}
 };
 
+// A pool of remote workers that compactions are offloaded to, itself a
+// pluggable compaction service
+struct CompactionOffloadPool {
+  std::shared_ptr<PluggableCompactionService> service;
+  // The most compactions that run in the pool at a time
+  int max_running = 1;
+};
+
+struct CompactionOffloadOptions {
+  // The pools that compactions are offloaded to. A compaction goes to the
+  // pool with the most room.
+  // Default: empty
+  std::vector<CompactionOffloadPool> pools;
+
+  // The bytes of input that one local core compacts per second, which the
+  // CPU time of a compaction is estimated from.
+  // Default: 64MB
+  uint64_t local_bytes_per_sec = 64 << 20;
+
+  // The bytes per second that a remote compaction reads its input and
+  // writes its output with. A compaction that would take longer to move its
+  // data than to run locally is not offloaded. Zero ignores the cost of
+  // moving the data.
+  // Default: 256MB
+  uint64_t remote_bytes_per_sec = 256 << 20;
+
+  // Compactions that are estimated to take less CPU time than this run
+  // locally: sending them away costs more time than it saves.
+  // Default: 1 second
+  uint64_t min_cpu_micros = 1000000;
+
+  // The same for the compactions out of L0. They are small and hold back
+  // writes while they wait, so only large ones are offloaded.
+  // Default: 4 seconds
+  uint64_t min_l0_cpu_micros = 4000000;
+
+  // A compaction that has not completed remotely after this long runs
+  // locally instead, and its remote result is discarded. Zero waits for the
+  // remote compaction as long as it takes.
+  // Default: 0
+  uint64_t deadline_micros = 0;
+};
+
+// Creates a pluggable compaction service that offloads only the compactions
+// that are worth it to the pools of the options, and has the others run
+// locally. A compaction is offloaded if its estimated cost is above the
+// thresholds of the options and one of the pools has room for it.
+extern std::unique_ptr<PluggableCompactionService>
+NewCompactionOffloadScheduler(const CompactionOffloadOptions& options);
+
 // A list of all files in a single specified level.
 struct FilesInOneLevel {
   int level;
@@ -104,6 +180,10 @@ struct OutputFile {
   std::string largest_internal_key;
   SequenceNumber smallest_seqno;
   SequenceNumber largest_seqno;
+  // If not zero, the file already is the table file of the db with this
+  // number, one of the output_file_numbers of the compaction, and is
+  // adopted without InstallFiles.
+  uint64_t file_number = 0;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
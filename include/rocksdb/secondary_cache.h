@@ -0,0 +1,85 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+#include "rocksdb/options.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// A second tier under a block cache. The block cache hands it the entries
+// that it evicts for lack of space, as bytes, and asks it for the bytes of
+// a block that it does not have before the block is read from the file. An
+// entry that is found is promoted back to the block cache and leaves the
+// secondary cache.
+//
+// A secondary cache is plugged in through LRUCacheOptions::secondary_cache.
+// All methods must be thread-safe.
+class SecondaryCache {
+ public:
+  virtual ~SecondaryCache() {}
+
+  virtual const char* Name() const = 0;
+
+  // Saves a copy of "contents" under "key", replacing an existing entry. The
+  // secondary cache may drop the entry, or other entries, to stay within its
+  // capacity.
+  virtual Status Insert(const Slice& key, const Slice& contents) = 0;
+
+  // Returns the contents saved under "key" in a new buffer, and removes the
+  // entry. Returns NotFound if there is no such entry.
+  virtual Status Lookup(const Slice& key, std::unique_ptr<char[]>* contents,
+                        size_t* size) = 0;
+
+  // Removes the entry saved under "key", if any
+  virtual void Erase(const Slice& key) = 0;
+
+  // Returns the memory used by the entries
+  virtual size_t GetUsage() const = 0;
+
+  virtual size_t GetCapacity() const = 0;
+
+  virtual std::string GetPrintableOptions() const { return ""; }
+};
+
+struct CompressedSecondaryCacheOptions {
+  // The memory that the compressed entries may use
+  size_t capacity = 0;
+
+  // The entries are kept in an LRU cache sharded into 2^num_shard_bits
+  // shards. -1 means it is determined by the capacity, as in NewLRUCache.
+  int num_shard_bits = -1;
+
+  // The compression of the entries. An entry that does not compress to less
+  // than 7/8 of its size is kept uncompressed.
+  CompressionType compression_type = kLZ4Compression;
+
+  CompressedSecondaryCacheOptions() {}
+  CompressedSecondaryCacheOptions(
+      size_t _capacity, int _num_shard_bits,
+      CompressionType _compression_type = kLZ4Compression)
+      : capacity(_capacity),
+        num_shard_bits(_num_shard_bits),
+        compression_type(_compression_type) {}
+};
+
+// Create a secondary cache that keeps its entries compressed in memory, so
+// that a given amount of memory holds more blocks than the block cache does.
+// A hit costs a decompression, which is much cheaper than a read from the
+// file, in particular for files in cloud storage.
+//
+// Return nullptr if the compression type is not supported by this build.
+// Only kNoCompression, kSnappyCompression, kLZ4Compression and kZSTD are
+// accepted.
+extern std::shared_ptr<SecondaryCache> NewCompressedSecondaryCache(
+    const CompressedSecondaryCacheOptions& opts);
+
+}  // namespace ROCKSDB_NAMESPACE
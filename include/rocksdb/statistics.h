@@ -366,6 +366,14 @@ enum Tickers : uint32_t {
   // # of files deleted immediately by sst file manger through delete scheduler.
   FILES_DELETED_IMMEDIATELY,
 
+  // # of blocks that missed the block cache and were found in its
+  // secondary cache.
+  SECONDARY_CACHE_HITS,
+
+  // # of blocks that the block cache did not admit, because they were read
+  // less frequently than the blocks they would have evicted.
+  BLOCK_CACHE_ADMISSION_REJECTS,
+
   TICKER_ENUM_MAX
 };
 
@@ -113,6 +113,7 @@ class Status {
     kManualCompactionPaused = 11,
     kOverwritten = 12,
     kTxnNotPrepared = 13,
+    kNotAdmitted = 14,
     kMaxSubCode
   };
 
@@ -157,6 +158,9 @@ class Status {
   // changing public APIs.
   static Status OkOverwritten() { return Status(kOk, kOverwritten); }
 
+  // Successful, though the cache did not admit the inserted entry
+  static Status OkNotAdmitted() { return Status(kOk, kNotAdmitted); }
+
   // Return error status of an appropriate type.
   static Status NotFound(const Slice& msg, const Slice& msg2 = Slice()) {
     return Status(kNotFound, msg, msg2);
@@ -297,6 +301,15 @@ class Status {
     return code() == kOk && subcode() == kOverwritten;
   }
 
+  // Returns true iff the status indicates success, but the inserted entry
+  // was not admitted to the cache
+  bool IsOkNotAdmitted() const {
+#ifdef ROCKSDB_ASSERT_STATUS_CHECKED
+    checked_ = true;
+#endif  // ROCKSDB_ASSERT_STATUS_CHECKED
+    return code() == kOk && subcode() == kNotAdmitted;
+  }
+
   // Returns true iff the status indicates a NotFound error.
   bool IsNotFound() const {
 #ifdef ROCKSDB_ASSERT_STATUS_CHECKED
@@ -4949,6 +4949,10 @@ class TickerTypeJni {
         return -0x0E;
       case ROCKSDB_NAMESPACE::Tickers::FILES_DELETED_IMMEDIATELY:
         return -0X0F;
+      case ROCKSDB_NAMESPACE::Tickers::SECONDARY_CACHE_HITS:
+        return -0x10;
+      case ROCKSDB_NAMESPACE::Tickers::BLOCK_CACHE_ADMISSION_REJECTS:
+        return -0x11;
 
       case ROCKSDB_NAMESPACE::Tickers::TICKER_ENUM_MAX:
         // 0x5F for backwards compatibility on current minor version.
@@ -5249,6 +5253,10 @@ class TickerTypeJni {
         return ROCKSDB_NAMESPACE::Tickers::FILES_MARKED_TRASH;
       case -0x0F:
         return ROCKSDB_NAMESPACE::Tickers::FILES_DELETED_IMMEDIATELY;
+      case -0x10:
+        return ROCKSDB_NAMESPACE::Tickers::SECONDARY_CACHE_HITS;
+      case -0x11:
+        return ROCKSDB_NAMESPACE::Tickers::BLOCK_CACHE_ADMISSION_REJECTS;
       case 0x5F:
         // 0x5F for backwards compatibility on current minor version.
         return ROCKSDB_NAMESPACE::Tickers::TICKER_ENUM_MAX;
@@ -732,6 +732,18 @@ public enum TickerType {
      */
     FILES_DELETED_IMMEDIATELY((byte) -0x0f),
 
+    /**
+     * # of blocks that missed the block cache and were found in its
+     * secondary cache
+     */
+    SECONDARY_CACHE_HITS((byte) -0x10),
+
+    /**
+     * # of blocks that the block cache did not admit, because they were read
+     * less frequently than the blocks they would have evicted
+     */
+    BLOCK_CACHE_ADMISSION_REJECTS((byte) -0x11),
+
     TICKER_ENUM_MAX((byte) 0x5F);
 
     private final byte value;
@@ -186,6 +186,8 @@ const std::vector<std::pair<Tickers, std::string>> TickersNameMap = {
      "rocksdb.block.cache.compression.dict.add.redundant"},
     {FILES_MARKED_TRASH, "rocksdb.files.marked.trash"},
     {FILES_DELETED_IMMEDIATELY, "rocksdb.files.deleted.immediately"},
+    {SECONDARY_CACHE_HITS, "rocksdb.secondary.cache.hits"},
+    {BLOCK_CACHE_ADMISSION_REJECTS, "rocksdb.block.cache.admission.rejects"},
 };
 
 const std::vector<std::pair<Histograms, std::string>> HistogramsNameMap = {
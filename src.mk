@@ -2,6 +2,8 @@
 LIB_SOURCES =                                                   \
   cache/cache.cc                                                \
   cache/clock_cache.cc                                          \
+  cache/compressed_secondary_cache.cc                           \
+  cache/fast_clock_cache.cc                                     \
   cache/lru_cache.cc                                            \
   cache/sharded_cache.cc                                        \
   db/arena_wrapped_db_iter.cc                                   \
@@ -18,6 +20,7 @@ LIB_SOURCES =                                                   \
   db/compaction/compaction.cc                                 	\
   db/compaction/compaction_iterator.cc                          \
   db/compaction/compaction_job.cc                               \
+  db/compaction/compaction_offload_scheduler.cc                 \
   db/compaction/compaction_picker.cc                            \
   db/compaction/compaction_picker_fifo.cc                       \
   db/compaction/compaction_picker_level.cc                      \
@@ -176,6 +179,7 @@ LIB_SOURCES =                                                   \
   tools/dump/db_dump_tool.cc                                    \
   trace_replay/trace_replay.cc                                  \
   trace_replay/block_cache_tracer.cc                            \
+  util/bloom_impl.cc                                            \
   util/build_version.cc                                         \
   util/coding.cc                                                \
   util/compaction_job_stats_impl.cc                             \
@@ -253,15 +257,24 @@ LIB_SOURCES =                                                   \
   cloud/aws/aws_retry.cc                                        \
   cloud/aws/aws_s3.cc                                           \
   cloud/db_cloud_impl.cc                                        \
+  cloud/cloud_block_cache.cc                                    \
+  cloud/cloud_deletion_queue.cc                                 \
   cloud/cloud_env.cc                                            \
   cloud/cloud_env_impl.cc                                       \
   cloud/cloud_env_options.cc                                    \
+  cloud/cloud_log_applier.cc                                    \
   cloud/cloud_log_controller.cc                                 \
   cloud/manifest_reader.cc                                      \
   cloud/purge.cc                                                \
   cloud/cloud_manifest.cc                                       \
+  cloud/cloud_metadata_cache.cc                                 \
+  cloud/cloud_prefetcher.cc                                     \
   cloud/cloud_scheduler.cc                                      \
   cloud/cloud_storage_provider.cc                               \
+  cloud/cloud_upload_pipeline.cc                                \
+  cloud/local_log_controller.cc                                 \
+  cloud/local_storage_provider.cc                               \
+  cloud/remote_compaction_worker.cc                             \
   db/db_impl/db_impl_remote_compaction.cc
 
 ifeq ($(ARMCRC_SOURCE),1)
@@ -325,6 +338,7 @@ MAIN_SOURCES =                                                          \
   cloud/db_cloud_test.cc                                                \
   cloud/cloud_manifest_test.cc                                          \
   cloud/cloud_scheduler_test.cc                                         \
+  cloud/db_cloud_local_test.cc                                          \
   db/remote_compaction.cc                                               \
   cache/cache_bench.cc                                                  \
   cache/cache_test.cc                                                   \
@@ -453,6 +467,7 @@ MAIN_SOURCES =                                                          \
   tools/block_cache_analyzer/block_cache_trace_analyzer_tool.cc         \
   tools/db_bench.cc                                                     \
   tools/db_bench_tool_test.cc                                           \
+  tools/cloud_compaction_worker.cc                                      \
   tools/db_sanity_test.cc                                               \
   tools/ldb_cmd_test.cc                                                 \
   tools/reduce_levels_test.cc                                           \
@@ -96,6 +96,12 @@ class BlocklikeTraits<BlockContents> {
     return new BlockContents(std::move(contents));
   }
 
+  static Cache::SaveToCallback GetSaveTo() {
+    return [](void* value) -> Slice {
+      return reinterpret_cast<BlockContents*>(value)->data;
+    };
+  }
+
   static uint32_t GetNumRestarts(const BlockContents& /* contents */) {
     return 0;
   }
@@ -112,6 +118,8 @@ class BlocklikeTraits<ParsedFullFilterBlock> {
     return new ParsedFullFilterBlock(filter_policy, std::move(contents));
   }
 
+  static Cache::SaveToCallback GetSaveTo() { return nullptr; }
+
   static uint32_t GetNumRestarts(const ParsedFullFilterBlock& /* block */) {
     return 0;
   }
@@ -126,6 +134,15 @@ class BlocklikeTraits<Block> {
     return new Block(std::move(contents), read_amp_bytes_per_bit, statistics);
   }
 
+  // A block is rebuilt from its contents when it comes back from the
+  // secondary cache of the block cache
+  static Cache::SaveToCallback GetSaveTo() {
+    return [](void* value) -> Slice {
+      Block* block = reinterpret_cast<Block*>(value);
+      return Slice(block->data(), block->size());
+    };
+  }
+
   static uint32_t GetNumRestarts(const Block& block) {
     return block.NumRestarts();
   }
@@ -143,6 +160,8 @@ class BlocklikeTraits<UncompressionDict> {
                                  using_zstd);
   }
 
+  static Cache::SaveToCallback GetSaveTo() { return nullptr; }
+
   static uint32_t GetNumRestarts(const UncompressionDict& /* dict */) {
     return 0;
   }
@@ -1143,17 +1162,9 @@ Status BlockBasedTable::GetDataBlockFromCache(
     const ReadOptions& read_options, CachableEntry<TBlocklike>* block,
     const UncompressionDict& uncompression_dict, BlockType block_type,
     GetContext* get_context) const {
-  const size_t read_amp_bytes_per_bit =
-      block_type == BlockType::kData
-          ? rep_->table_options.read_amp_bytes_per_bit
-          : 0;
   assert(block);
   assert(block->IsEmpty());
 
-  Status s;
-  BlockContents* compressed_block = nullptr;
-  Cache::Handle* block_cache_compressed_handle = nullptr;
-
   // Lookup uncompressed cache first
   if (block_cache != nullptr) {
     auto cache_handle = GetEntryFromCache(block_cache, block_cache_key,
@@ -1162,45 +1173,97 @@ Status BlockBasedTable::GetDataBlockFromCache(
       block->SetCachedValue(
           reinterpret_cast<TBlocklike*>(block_cache->Value(cache_handle)),
           block_cache, cache_handle);
-      return s;
+      return Status::OK();
     }
   }
 
-  // If not found, search from the compressed block cache.
+  return GetDataBlockFromSecondaryOrCompressedCache(
+      block_cache_key, compressed_block_cache_key, block_cache,
+      block_cache_compressed, read_options, block, uncompression_dict,
+      block_type, get_context);
+}
+
+template <typename TBlocklike>
+Status BlockBasedTable::GetDataBlockFromSecondaryOrCompressedCache(
+    const Slice& block_cache_key, const Slice& compressed_block_cache_key,
+    Cache* block_cache, Cache* block_cache_compressed,
+    const ReadOptions& read_options, CachableEntry<TBlocklike>* block,
+    const UncompressionDict& uncompression_dict, BlockType block_type,
+    GetContext* get_context) const {
+  const size_t read_amp_bytes_per_bit =
+      block_type == BlockType::kData
+          ? rep_->table_options.read_amp_bytes_per_bit
+          : 0;
+  assert(block);
   assert(block->IsEmpty());
 
-  if (block_cache_compressed == nullptr) {
-    return s;
+  Status s;
+  BlockContents* compressed_block = nullptr;
+  Cache::Handle* block_cache_compressed_handle = nullptr;
+
+  // The block cache may have saved the block to its secondary cache when it
+  // evicted it. A lookup there removes the block from the secondary cache,
+  // so only do it when the block goes back to the block cache.
+  Statistics* statistics = rep_->ioptions.statistics;
+  BlockContents contents;
+  bool found = false;
+
+  if (block_cache != nullptr && read_options.fill_cache) {
+    std::unique_ptr<char[]> saved;
+    size_t saved_size = 0;
+    if (block_cache->LookupSecondary(block_cache_key, &saved, &saved_size)
+            .ok()) {
+      RecordTick(statistics, SECONDARY_CACHE_HITS);
+      MemoryAllocator* memory_allocator =
+          GetMemoryAllocator(rep_->table_options);
+      if (memory_allocator == nullptr) {
+        // The buffer was allocated with new[], as CacheAllocationPtr expects
+        // without an allocator
+        contents = BlockContents(CacheAllocationPtr(saved.release()),
+                                 saved_size);
+      } else {
+        CacheAllocationPtr buf = AllocateBlock(saved_size, memory_allocator);
+        memcpy(buf.get(), saved.get(), saved_size);
+        contents = BlockContents(std::move(buf), saved_size);
+      }
+      found = true;
+    }
   }
 
-  assert(!compressed_block_cache_key.empty());
-  block_cache_compressed_handle =
-      block_cache_compressed->Lookup(compressed_block_cache_key);
+  // If not found, search from the compressed block cache.
+  if (!found && block_cache_compressed != nullptr) {
+    assert(!compressed_block_cache_key.empty());
+    block_cache_compressed_handle =
+        block_cache_compressed->Lookup(compressed_block_cache_key);
+
+    // if we found in the compressed cache, then uncompress and insert into
+    // uncompressed cache
+    if (block_cache_compressed_handle == nullptr) {
+      RecordTick(statistics, BLOCK_CACHE_COMPRESSED_MISS);
+      return s;
+    }
 
-  Statistics* statistics = rep_->ioptions.statistics;
+    // found compressed block
+    RecordTick(statistics, BLOCK_CACHE_COMPRESSED_HIT);
+    compressed_block = reinterpret_cast<BlockContents*>(
+        block_cache_compressed->Value(block_cache_compressed_handle));
+    CompressionType compression_type =
+        compressed_block->get_compression_type();
+    assert(compression_type != kNoCompression);
 
-  // if we found in the compressed cache, then uncompress and insert into
-  // uncompressed cache
-  if (block_cache_compressed_handle == nullptr) {
-    RecordTick(statistics, BLOCK_CACHE_COMPRESSED_MISS);
-    return s;
+    // Retrieve the uncompressed contents into a new buffer
+    UncompressionContext context(compression_type);
+    UncompressionInfo info(context, uncompression_dict, compression_type);
+    s = UncompressBlockContents(
+        info, compressed_block->data.data(), compressed_block->data.size(),
+        &contents, rep_->table_options.format_version, rep_->ioptions,
+        GetMemoryAllocator(rep_->table_options));
+    found = true;
   }
 
-  // found compressed block
-  RecordTick(statistics, BLOCK_CACHE_COMPRESSED_HIT);
-  compressed_block = reinterpret_cast<BlockContents*>(
-      block_cache_compressed->Value(block_cache_compressed_handle));
-  CompressionType compression_type = compressed_block->get_compression_type();
-  assert(compression_type != kNoCompression);
-
-  // Retrieve the uncompressed contents into a new buffer
-  BlockContents contents;
-  UncompressionContext context(compression_type);
-  UncompressionInfo info(context, uncompression_dict, compression_type);
-  s = UncompressBlockContents(
-      info, compressed_block->data.data(), compressed_block->data.size(),
-      &contents, rep_->table_options.format_version, rep_->ioptions,
-      GetMemoryAllocator(rep_->table_options));
+  if (!found) {
+    return s;
+  }
 
   // Insert uncompressed block into block cache
   if (s.ok()) {
@@ -1214,15 +1277,22 @@ Status BlockBasedTable::GetDataBlockFromCache(
         read_options.fill_cache) {
       size_t charge = block_holder->ApproximateMemoryUsage();
       Cache::Handle* cache_handle = nullptr;
-      s = block_cache->Insert(block_cache_key, block_holder.get(), charge,
-                              &DeleteCachedEntry<TBlocklike>, &cache_handle);
+      s = block_cache->InsertWithSaveTo(
+          block_cache_key, block_holder.get(), charge,
+          &DeleteCachedEntry<TBlocklike>,
+          BlocklikeTraits<TBlocklike>::GetSaveTo(), &cache_handle);
       if (s.ok()) {
         assert(cache_handle != nullptr);
         block->SetCachedValue(block_holder.release(), block_cache,
                               cache_handle);
 
-        UpdateCacheInsertionMetrics(block_type, get_context, charge,
-                                    s.IsOkOverwritten());
+        if (s.IsOkNotAdmitted()) {
+          // The block is only referenced by the handle
+          RecordTick(statistics, BLOCK_CACHE_ADMISSION_REJECTS);
+        } else {
+          UpdateCacheInsertionMetrics(block_type, get_context, charge,
+                                      s.IsOkOverwritten());
+        }
       } else {
         RecordTick(statistics, BLOCK_CACHE_ADD_FAILURES);
       }
@@ -1232,7 +1302,9 @@ Status BlockBasedTable::GetDataBlockFromCache(
   }
 
   // Release hold on compressed cache entry
-  block_cache_compressed->Release(block_cache_compressed_handle);
+  if (block_cache_compressed_handle != nullptr) {
+    block_cache_compressed->Release(block_cache_compressed_handle);
+  }
   return s;
 }
 
@@ -1319,16 +1391,22 @@ Status BlockBasedTable::PutDataBlockToCache(
   if (block_cache != nullptr && block_holder->own_bytes()) {
     size_t charge = block_holder->ApproximateMemoryUsage();
     Cache::Handle* cache_handle = nullptr;
-    s = block_cache->Insert(block_cache_key, block_holder.get(), charge,
-                            &DeleteCachedEntry<TBlocklike>, &cache_handle,
-                            priority);
+    s = block_cache->InsertWithSaveTo(
+        block_cache_key, block_holder.get(), charge,
+        &DeleteCachedEntry<TBlocklike>,
+        BlocklikeTraits<TBlocklike>::GetSaveTo(), &cache_handle, priority);
     if (s.ok()) {
       assert(cache_handle != nullptr);
       cached_block->SetCachedValue(block_holder.release(), block_cache,
                                    cache_handle);
 
-      UpdateCacheInsertionMetrics(block_type, get_context, charge,
-                                  s.IsOkOverwritten());
+      if (s.IsOkNotAdmitted()) {
+        // The block is only referenced by the handle
+        RecordTick(statistics, BLOCK_CACHE_ADMISSION_REJECTS);
+      } else {
+        UpdateCacheInsertionMetrics(block_type, get_context, charge,
+                                    s.IsOkOverwritten());
+      }
     } else {
       RecordTick(statistics, BLOCK_CACHE_ADD_FAILURES);
     }
@@ -2446,6 +2524,11 @@ void BlockBasedTable::MultiGet(const ReadOptions& read_options,
       size_t total_len = 0;
       ReadOptions ro = read_options;
       ro.read_tier = kBlockCacheTier;
+      // The positions in block_handles of the unique data blocks, to be
+      // looked up in the block caches, and the contexts of their first keys
+      autovector<size_t, MultiGetContext::MAX_BATCH_SIZE> lookup_idxs;
+      autovector<GetContext*, MultiGetContext::MAX_BATCH_SIZE>
+          lookup_get_contexts;
 
       for (auto miter = data_block_range.begin();
            miter != data_block_range.end(); ++miter) {
@@ -2496,30 +2579,75 @@ void BlockBasedTable::MultiGet(const ReadOptions& read_options,
           block_handles.emplace_back(BlockHandle::NullBlockHandle());
           continue;
         }
-        // Lookup the cache for the given data block referenced by an index
-        // iterator value (i.e BlockHandle). If it exists in the cache,
-        // initialize block to the contents of the data block.
+        // The data block referenced by the index iterator value (i.e
+        // BlockHandle) is looked up in the cache below, along with the
+        // blocks of the other keys.
         offset = v.handle.offset();
-        BlockHandle handle = v.handle;
-        BlockCacheLookupContext lookup_data_block_context(
-            TableReaderCaller::kUserMultiGet);
-        const UncompressionDict& dict = uncompression_dict.GetValue()
-                                            ? *uncompression_dict.GetValue()
-                                            : UncompressionDict::GetEmptyDict();
-        Status s = RetrieveBlock(
-            nullptr, ro, handle, dict, &(results.back()), BlockType::kData,
-            miter->get_context, &lookup_data_block_context,
-            /* for_compaction */ false, /* use_cache */ true);
-        if (s.IsIncomplete()) {
-          s = Status::OK();
+        lookup_idxs.push_back(block_handles.size());
+        lookup_get_contexts.push_back(miter->get_context);
+        block_handles.emplace_back(v.handle);
+      }
+
+      Cache* block_cache = rep_->table_options.block_cache.get();
+      Cache* block_cache_compressed =
+          rep_->table_options.block_cache_compressed.get();
+      const size_t num_lookups = lookup_idxs.size();
+      assert(num_lookups <= MultiGetContext::MAX_BATCH_SIZE);
+      char cache_keys[MultiGetContext::MAX_BATCH_SIZE]
+                     [kMaxCacheKeyPrefixSize + kMaxVarint64Length];
+      Slice keys[MultiGetContext::MAX_BATCH_SIZE];
+      Cache::Handle* cache_handles[MultiGetContext::MAX_BATCH_SIZE];
+      if (block_cache != nullptr && num_lookups > 0) {
+        // Look all the blocks up at once, so that each shard of the block
+        // cache is locked once rather than once per block
+        for (size_t i = 0; i < num_lookups; i++) {
+          keys[i] = GetCacheKey(rep_->cache_key_prefix,
+                                rep_->cache_key_prefix_size,
+                                block_handles[lookup_idxs[i]], cache_keys[i]);
         }
-        if (s.ok() && !results.back().IsEmpty()) {
-          // Found it in the cache. Add NULL handle to indicate there is
-          // nothing to read from disk
-          block_handles.emplace_back(BlockHandle::NullBlockHandle());
+        block_cache->LookupBatch(num_lookups, keys, cache_handles,
+                                 rep_->ioptions.statistics);
+      }
+      for (size_t i = 0; i < num_lookups; i++) {
+        const size_t idx = lookup_idxs[i];
+        GetContext* get_context = lookup_get_contexts[i];
+        Status s;
+        if (block_cache != nullptr) {
+          if (cache_handles[i] != nullptr) {
+            UpdateCacheHitMetrics(BlockType::kData, get_context,
+                                  block_cache->GetUsage(cache_handles[i]));
+            results[idx].SetCachedValue(
+                reinterpret_cast<Block*>(block_cache->Value(cache_handles[i])),
+                block_cache, cache_handles[i]);
+          } else {
+            UpdateCacheMissMetrics(BlockType::kData, get_context);
+          }
+        }
+        if (results[idx].IsEmpty() &&
+            (block_cache != nullptr || block_cache_compressed != nullptr)) {
+          char compressed_cache_key[kMaxCacheKeyPrefixSize +
+                                    kMaxVarint64Length];
+          Slice ckey;
+          if (block_cache_compressed != nullptr) {
+            ckey = GetCacheKey(rep_->compressed_cache_key_prefix,
+                               rep_->compressed_cache_key_prefix_size,
+                               block_handles[idx], compressed_cache_key);
+          }
+          const UncompressionDict& dict =
+              uncompression_dict.GetValue()
+                  ? *uncompression_dict.GetValue()
+                  : UncompressionDict::GetEmptyDict();
+          s = GetDataBlockFromSecondaryOrCompressedCache(
+              block_cache != nullptr ? keys[i] : Slice(), ckey, block_cache,
+              block_cache_compressed, ro, &results[idx], dict,
+              BlockType::kData, get_context);
+        }
+        if (s.ok() && !results[idx].IsEmpty()) {
+          // Found it in the cache. Replace the handle with a NULL handle to
+          // indicate there is nothing to read from disk
+          block_handles[idx] = BlockHandle::NullBlockHandle();
         } else {
-          block_handles.emplace_back(handle);
-          total_len += block_size(handle);
+          total_len += block_size(block_handles[idx]);
         }
       }
 
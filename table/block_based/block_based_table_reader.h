@@ -347,6 +347,17 @@ class BlockBasedTable : public TableReader {
       const UncompressionDict& uncompression_dict, BlockType block_type,
       GetContext* get_context) const;
 
+  // The part of GetDataBlockFromCache() after a miss in block_cache: looks
+  // the block up in the secondary cache of block_cache, then in
+  // block_cache_compressed, and inserts it into block_cache if it is found.
+  template <typename TBlocklike>
+  Status GetDataBlockFromSecondaryOrCompressedCache(
+      const Slice& block_cache_key, const Slice& compressed_block_cache_key,
+      Cache* block_cache, Cache* block_cache_compressed,
+      const ReadOptions& read_options, CachableEntry<TBlocklike>* block,
+      const UncompressionDict& uncompression_dict, BlockType block_type,
+      GetContext* get_context) const;
+
   // Put a raw block (maybe compressed) to the corresponding block caches.
   // This method will perform decompression against raw_block if needed and then
   // populate the block caches.
@@ -0,0 +1,82 @@
+//  Copyright (c) 2016-present, Rockset, Inc.  All rights reserved.
+
+#ifndef ROCKSDB_LITE
+#ifndef GFLAGS
+#include <cstdio>
+int main() {
+  fprintf(stderr, "Please install gflags to run rocksdb tools\n");
+  return 1;
+}
+#else
+
+#include <cstdio>
+
+#include "cloud/cloud_storage_provider_impl.h"
+#include "cloud/remote_compaction_worker.h"
+#include "rocksdb/env.h"
+#include "util/gflags_compat.h"
+
+// Runs the compaction requests that are read from stdin and writes their
+// results to stdout, until stdin is closed. The process is started by the
+// host of a cloud db, which sends its compactions with a
+// RemoteCompactionClient that is connected to the pipes of the process.
+//
+// The worker opens the dbs with the default options, so their comparator,
+// merge operator and compaction filter have to be the default ones. Embed
+// RemoteCompactionWorker in a binary of its own for any other options.
+
+using namespace ROCKSDB_NAMESPACE;
+
+using GFLAGS_NAMESPACE::ParseCommandLineFlags;
+using GFLAGS_NAMESPACE::SetUsageMessage;
+
+DEFINE_string(work_dir, "/tmp/cloud_compaction_worker",
+              "The local directory of the dbs that are compacted");
+DEFINE_string(local_bucket_root, "",
+              "Use the local storage provider with its buckets below this "
+              "directory, instead of S3");
+DEFINE_uint64(readahead_size, 8 << 20,
+              "Readahead of the compaction input files");
+DEFINE_int32(max_concurrent_compactions, 4,
+             "The number of compactions that run at the same time");
+
+int main(int argc, const char** argv) {
+  SetUsageMessage(
+      std::string("\nUSAGE:\n") + std::string(argv[0]) +
+      " [--work_dir=...] [--local_bucket_root=...] [--readahead_size=...]"
+      " [--max_concurrent_compactions=...]");
+  ParseCommandLineFlags(&argc, const_cast<char***>(&argv), true);
+
+  Env* env = Env::Default();
+  RemoteCompactionWorkerOptions options;
+  options.local_dir = FLAGS_work_dir;
+  options.readahead_size = static_cast<size_t>(FLAGS_readahead_size);
+  options.max_concurrent_compactions = FLAGS_max_concurrent_compactions;
+  Status st = env->CreateDirIfMissing(FLAGS_work_dir);
+  if (st.ok()) {
+    st = env->NewLogger(FLAGS_work_dir + "/LOG", &options.options.info_log);
+  }
+  if (st.ok() && !FLAGS_local_bucket_root.empty()) {
+    st = CloudStorageProviderImpl::CreateLocalProvider(
+        FLAGS_local_bucket_root, &options.cloud_env_options.storage_provider);
+  }
+  if (st.ok()) {
+    RemoteCompactionWorker worker(env, options);
+    st = worker.Serve(0 /* stdin */, 1 /* stdout */);
+  }
+  if (!st.ok()) {
+    fprintf(stderr, "%s\n", st.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
+
+#endif  // GFLAGS
+
+#else  // ROCKSDB_LITE
+#include <stdio.h>
+int main(int /*argc*/, char** /*argv*/) {
+  fprintf(stderr, "Not supported in lite mode.\n");
+  return 1;
+}
+#endif  // ROCKSDB_LITE
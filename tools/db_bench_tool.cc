@@ -30,6 +30,8 @@
 #include <unordered_map>
 
 #include "cloud/aws/aws_env.h"
+#include "cloud/cloud_log_controller_impl.h"
+#include "cloud/cloud_storage_provider_impl.h"
 #include "db/db_impl/db_impl.h"
 #include "db/malloc_stats.h"
 #include "db/version_set.h"
@@ -951,6 +953,69 @@ DEFINE_string(aws_secret_key, "", "Secret key for AWS");
 DEFINE_string(aws_region, "", "AWS region");
 DEFINE_bool(keep_local_sst_files, true,
             "Keep all files in local storage as well as cloud storage");
+DEFINE_int32(cloud_async_upload_threads, 0,
+             "Number of background threads that upload sst files to cloud "
+             "storage. 0 uploads each sst file synchronously when it is "
+             "closed.");
+DEFINE_bool(cloud_manifest_delta_upload, false,
+            "Upload only the bytes appended to the MANIFEST on each sync "
+            "instead of the whole MANIFEST");
+DEFINE_string(cloud_sst_block_cache_path, "",
+              "Directory that caches blocks of sst files read from cloud "
+              "storage when --keep_local_sst_files is false");
+DEFINE_uint64(cloud_sst_block_cache_size, 0,
+              "Capacity of --cloud_sst_block_cache_path in bytes");
+DEFINE_int32(cloud_transfer_threads, 0,
+             "Number of threads that transfer the parts of large objects "
+             "to and from cloud storage in parallel");
+DEFINE_uint64(cloud_transfer_part_size, 16 << 20,
+              "Part size of parallel transfers to and from cloud storage");
+DEFINE_int32(cloud_sst_prefetch_threads, 0,
+             "Number of threads that download the live sst files when the "
+             "db is opened with --keep_local_sst_files");
+DEFINE_bool(cloud_object_metadata_cache, false,
+            "Answer sst file metadata queries from the cloud objects that "
+            "were listed, uploaded or deleted instead of cloud storage");
+DEFINE_int32(cloud_log_apply_threads, 0,
+             "Number of threads that apply the cloud log stream to the local "
+             "cache of the log files. 0 applies it in the tailer thread.");
+DEFINE_uint64(localcloud_latency_us, 0,
+              "Latency of every request to a localcloud:// env");
+DEFINE_uint64(localcloud_latency_jitter_us, 0,
+              "Uniformly distributed extra latency of every request to a "
+              "localcloud:// env");
+DEFINE_double(localcloud_tail_latency_probability, 0,
+              "Fraction of the requests to a localcloud:// env that take "
+              "another --localcloud_tail_latency_us");
+DEFINE_uint64(localcloud_tail_latency_us, 0,
+              "Extra latency of the slow requests to a localcloud:// env");
+DEFINE_int64(localcloud_bandwidth, 0,
+             "Bytes per second that the transfers of a localcloud:// env "
+             "share. 0 means unlimited.");
+DEFINE_double(localcloud_failure_rate, 0,
+              "Fraction of the requests to a localcloud:// env that fail");
+DEFINE_uint64(localcloud_list_delay_us, 0,
+              "Time after which written objects show up in the listings of "
+              "a localcloud:// env");
+DEFINE_bool(localcloud_log, false,
+            "Keep the WAL of a localcloud:// env in an in-process log stream "
+            "instead of local files");
+DEFINE_uint64(localcloud_log_ack_latency_us, 0,
+              "Time until the log stream of --localcloud_log acknowledges a "
+              "write");
+DEFINE_uint64(localcloud_log_ack_jitter_us, 0,
+              "Uniformly distributed extra time until the log stream of "
+              "--localcloud_log acknowledges a write");
+DEFINE_int64(localcloud_log_bandwidth, 0,
+             "Bytes per second that the writes to the log stream of "
+             "--localcloud_log share. 0 means unlimited.");
+DEFINE_double(localcloud_log_reorder_probability, 0,
+              "Fraction of the writes to the log stream of --localcloud_log "
+              "that take another --localcloud_log_reorder_delay_us, so that "
+              "later writes are acknowledged first");
+DEFINE_uint64(localcloud_log_reorder_delay_us, 0,
+              "Extra time until the reordered writes of --localcloud_log are "
+              "acknowledged");
 #endif  // ROCKSDB_LITE
 DEFINE_string(hdfs, "", "Name of hdfs environment. Mutually exclusive with"
               " --env_uri.");
@@ -959,6 +1024,9 @@ static std::shared_ptr<ROCKSDB_NAMESPACE::Env> env_guard;
 
 static ROCKSDB_NAMESPACE::Env* FLAGS_env = ROCKSDB_NAMESPACE::Env::Default();
 
+// The cloud env that --env_uri created, if any
+static ROCKSDB_NAMESPACE::CloudEnv* cloud_env = nullptr;
+
 DEFINE_int64(stats_interval, 0, "Stats are reported every N operations when "
              "this is greater than zero. When 0 the interval grows over time.");
 
@@ -1300,6 +1368,15 @@ ROCKSDB_NAMESPACE::Env* CreateAwsEnv(
   assert(coptions.credentials.HasValid().ok());
 
   coptions.keep_local_sst_files = FLAGS_keep_local_sst_files;
+  coptions.async_upload_threads = FLAGS_cloud_async_upload_threads;
+  coptions.manifest_delta_upload = FLAGS_cloud_manifest_delta_upload;
+  coptions.sst_block_cache_path = FLAGS_cloud_sst_block_cache_path;
+  coptions.sst_block_cache_size = FLAGS_cloud_sst_block_cache_size;
+  coptions.transfer_threads = FLAGS_cloud_transfer_threads;
+  coptions.transfer_part_size = FLAGS_cloud_transfer_part_size;
+  coptions.sst_prefetch_threads = FLAGS_cloud_sst_prefetch_threads;
+  coptions.use_object_metadata_cache = FLAGS_cloud_object_metadata_cache;
+  coptions.log_apply_threads = FLAGS_cloud_log_apply_threads;
   if (FLAGS_db.empty()) {
     coptions.TEST_Initialize("dbbench.", "db-bench", region);
   } else {
@@ -1311,6 +1388,7 @@ ROCKSDB_NAMESPACE::Env* CreateAwsEnv(
   assert(st.ok());
   ((ROCKSDB_NAMESPACE::CloudEnvImpl*)s)->TEST_DisableCloudManifest();
   result->reset(s);
+  cloud_env = s;
   return s;
 }
 
@@ -1325,6 +1403,79 @@ static const auto& s3_reg __attribute__((__unused__)) =
             });
 #endif /* USE_AWS */
 
+#ifndef ROCKSDB_LITE
+// create Factory for cloud Envs that keep their buckets in a local directory,
+// e.g. --env_uri=localcloud:///tmp/buckets
+ROCKSDB_NAMESPACE::Env* CreateLocalCloudEnv(
+    const std::string& uri, std::unique_ptr<ROCKSDB_NAMESPACE::Env>* result) {
+  const std::string root = uri.substr(strlen("localcloud://"));
+  fprintf(stderr, "Creating local cloud env with buckets in %s\n",
+          root.c_str());
+  std::shared_ptr<ROCKSDB_NAMESPACE::Logger> info_log;
+  info_log.reset(new ROCKSDB_NAMESPACE::StderrLogger(
+      ROCKSDB_NAMESPACE::InfoLogLevel::WARN_LEVEL));
+  ROCKSDB_NAMESPACE::CloudEnvOptions coptions;
+  coptions.keep_local_sst_files = FLAGS_keep_local_sst_files;
+  coptions.async_upload_threads = FLAGS_cloud_async_upload_threads;
+  coptions.manifest_delta_upload = FLAGS_cloud_manifest_delta_upload;
+  coptions.sst_block_cache_path = FLAGS_cloud_sst_block_cache_path;
+  coptions.sst_block_cache_size = FLAGS_cloud_sst_block_cache_size;
+  coptions.transfer_threads = FLAGS_cloud_transfer_threads;
+  coptions.transfer_part_size = FLAGS_cloud_transfer_part_size;
+  coptions.sst_prefetch_threads = FLAGS_cloud_sst_prefetch_threads;
+  coptions.use_object_metadata_cache = FLAGS_cloud_object_metadata_cache;
+  coptions.log_apply_threads = FLAGS_cloud_log_apply_threads;
+  coptions.src_bucket.SetBucketName("localcloud", "dbbench.");
+  coptions.src_bucket.SetObjectPath(FLAGS_db.empty() ? "db-bench" : FLAGS_db);
+  coptions.dest_bucket = coptions.src_bucket;
+  ROCKSDB_NAMESPACE::LocalStorageProviderOptions loptions;
+  loptions.latency_micros = FLAGS_localcloud_latency_us;
+  loptions.latency_jitter_micros = FLAGS_localcloud_latency_jitter_us;
+  loptions.tail_latency_probability = FLAGS_localcloud_tail_latency_probability;
+  loptions.tail_latency_micros = FLAGS_localcloud_tail_latency_us;
+  loptions.bandwidth_bytes_per_sec = FLAGS_localcloud_bandwidth;
+  loptions.failure_rate = FLAGS_localcloud_failure_rate;
+  loptions.list_visibility_delay_micros = FLAGS_localcloud_list_delay_us;
+  ROCKSDB_NAMESPACE::Status st =
+      ROCKSDB_NAMESPACE::CloudStorageProviderImpl::CreateLocalProvider(
+          root, &coptions.storage_provider, loptions);
+  if (st.ok() && FLAGS_localcloud_log) {
+    ROCKSDB_NAMESPACE::LocalLogControllerOptions log_options;
+    log_options.ack_latency_micros = FLAGS_localcloud_log_ack_latency_us;
+    log_options.ack_latency_jitter_micros = FLAGS_localcloud_log_ack_jitter_us;
+    log_options.bandwidth_bytes_per_sec = FLAGS_localcloud_log_bandwidth;
+    log_options.reorder_probability = FLAGS_localcloud_log_reorder_probability;
+    log_options.reorder_delay_micros = FLAGS_localcloud_log_reorder_delay_us;
+    st = ROCKSDB_NAMESPACE::CloudLogControllerImpl::CreateLocalController(
+        &coptions.cloud_log_controller, log_options);
+    coptions.keep_local_log_files = false;
+  }
+  ROCKSDB_NAMESPACE::CloudEnv* s = nullptr;
+  if (st.ok()) {
+    st = ROCKSDB_NAMESPACE::CloudEnv::NewCloudEnv(
+        ROCKSDB_NAMESPACE::Env::Default(), coptions, std::move(info_log), &s);
+  }
+  if (!st.ok()) {
+    fprintf(stderr, "Unable to create local cloud env: %s\n",
+            st.ToString().c_str());
+    return nullptr;
+  }
+  ((ROCKSDB_NAMESPACE::CloudEnvImpl*)s)->TEST_DisableCloudManifest();
+  result->reset(s);
+  cloud_env = s;
+  return s;
+}
+
+static const auto& localcloud_reg __attribute__((__unused__)) =
+    ROCKSDB_NAMESPACE::ObjectLibrary::Default()
+        -> Register<ROCKSDB_NAMESPACE::Env>(
+            "localcloud://.*",
+            [](const std::string& uri,
+               std::unique_ptr<ROCKSDB_NAMESPACE::Env>* guard, std::string*) {
+              return CreateLocalCloudEnv(uri, guard);
+            });
+#endif  // ROCKSDB_LITE
+
 static enum RepFactory StringToRepFactory(const char* ctype) {
   assert(ctype);
 
@@ -3347,6 +3498,17 @@ class Benchmark {
           stdout, "SIMULATOR CACHE STATISTICS:\n%s\n",
           static_cast_with_check<SimCache>(cache_.get())->ToString().c_str());
     }
+    if (cloud_env != nullptr &&
+        cloud_env->GetCloudEnvOptions().cloud_log_controller) {
+      CloudLogTailerStats stats = cloud_env->GetCloudEnvOptions()
+                                      .cloud_log_controller->GetTailerStats();
+      fprintf(stdout,
+              "Cloud log tailer: %" PRIu64 " records (%" PRIu64
+              " bytes) behind, %" PRIu64 " records (%" PRIu64
+              " bytes) applied in %" PRIu64 " writes\n",
+              stats.records_behind, stats.bytes_behind, stats.records_applied,
+              stats.bytes_applied, stats.writes);
+    }
 
 #ifndef ROCKSDB_LITE
     if (FLAGS_use_secondary_db) {
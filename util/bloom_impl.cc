@@ -0,0 +1,60 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "util/bloom_impl.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+typedef void (*BatchFunction)(int num_keys, const uint32_t *h2s,
+                              const uint32_t *byte_offsets, int num_probes,
+                              const char *data, bool *may_match);
+
+// Uses the AVX2 kernel when the build targets AVX2
+void HashMayMatchPreparedBatchDefault(int num_keys, const uint32_t *h2s,
+                                      const uint32_t *byte_offsets,
+                                      int num_probes, const char *data,
+                                      bool *may_match) {
+  for (int i = 0; i < num_keys; ++i) {
+    may_match[i] = FastLocalBloomImpl::HashMayMatchPrepared(
+        h2s[i], num_probes, data + byte_offsets[i]);
+  }
+}
+
+#if defined(BLOOM_IMPL_AVX2_KERNEL) && !defined(HAVE_AVX2)
+// For portable builds on CPUs that have AVX2
+BLOOM_IMPL_AVX2_TARGET void HashMayMatchPreparedBatchAVX2(
+    int num_keys, const uint32_t *h2s, const uint32_t *byte_offsets,
+    int num_probes, const char *data, bool *may_match) {
+  for (int i = 0; i < num_keys; ++i) {
+    may_match[i] = FastLocalBloomImpl::HashMayMatchPreparedAVX2(
+        h2s[i], num_probes, data + byte_offsets[i]);
+  }
+}
+#endif
+
+BatchFunction ChooseBatch() {
+#if defined(BLOOM_IMPL_AVX2_KERNEL) && !defined(HAVE_AVX2)
+  // Can run before the constructors that initialize the CPU model
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return HashMayMatchPreparedBatchAVX2;
+  }
+#endif
+  return HashMayMatchPreparedBatchDefault;
+}
+
+BatchFunction chosen_batch = ChooseBatch();
+
+}  // namespace
+
+void FastLocalBloomImpl::HashMayMatchPreparedBatch(
+    int num_keys, const uint32_t *h2s, const uint32_t *byte_offsets,
+    int num_probes, const char *data, bool *may_match) {
+  chosen_batch(num_keys, h2s, byte_offsets, num_probes, data, may_match);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -12,11 +12,20 @@
 #include <stdint.h>
 #include <cmath>
 
+#include "port/port.h"
 #include "rocksdb/slice.h"
 #include "util/hash.h"
 
 #ifdef HAVE_AVX2
 #include <immintrin.h>
+#define BLOOM_IMPL_AVX2_KERNEL
+#define BLOOM_IMPL_AVX2_TARGET
+#elif defined(__GNUC__) && defined(__x86_64__) && !defined(IOS_CROSS_COMPILE)
+// The AVX2 kernel is also compiled into builds that do not target AVX2, for
+// callers that check for AVX2 at runtime
+#include <immintrin.h>
+#define BLOOM_IMPL_AVX2_KERNEL
+#define BLOOM_IMPL_AVX2_TARGET __attribute__((__target__("avx2")))
 #endif
 
 namespace ROCKSDB_NAMESPACE {
@@ -222,10 +231,39 @@ class FastLocalBloomImpl {
     return HashMayMatchPrepared(h2, num_probes, data + bytes_to_cache_line);
   }
 
+  // Same as HashMayMatchPrepared for each of "num_keys" keys of one filter:
+  // may_match[i] is set for h2s[i] and the cache line at
+  // data + byte_offsets[i], as returned by PrepareHash. Unlike
+  // HashMayMatchPrepared, this uses AVX2 whenever the CPU supports it, even
+  // if the build does not target AVX2.
+  static void HashMayMatchPreparedBatch(int num_keys, const uint32_t *h2s,
+                                        const uint32_t *byte_offsets,
+                                        int num_probes, const char *data,
+                                        bool *may_match);
+
   static inline bool HashMayMatchPrepared(uint32_t h2, int num_probes,
                                           const char *data_at_cache_line) {
-    uint32_t h = h2;
 #ifdef HAVE_AVX2
+    return HashMayMatchPreparedAVX2(h2, num_probes, data_at_cache_line);
+#else
+    uint32_t h = h2;
+    for (int i = 0; i < num_probes; ++i, h *= uint32_t{0x9e3779b9}) {
+      // 9-bit address within 512 bit cache line
+      int bitpos = h >> (32 - 9);
+      if ((data_at_cache_line[bitpos >> 3] & (char(1) << (bitpos & 7))) == 0) {
+        return false;
+      }
+    }
+    return true;
+#endif
+  }
+
+#ifdef BLOOM_IMPL_AVX2_KERNEL
+  // HashMayMatchPrepared with AVX2. Without HAVE_AVX2, this is still compiled
+  // for AVX2, and may only be called after checking that the CPU has AVX2.
+  BLOOM_IMPL_AVX2_TARGET static inline bool HashMayMatchPreparedAVX2(
+      uint32_t h2, int num_probes, const char *data_at_cache_line) {
+    uint32_t h = h2;
     int rem_probes = num_probes;
 
     // NOTE: For better performance for num_probes in {1, 2, 9, 10, 17, 18,
@@ -325,17 +363,8 @@ class FastLocalBloomImpl {
       h *= 0xab25f4c1;
       rem_probes -= 8;
     }
-#else
-    for (int i = 0; i < num_probes; ++i, h *= uint32_t{0x9e3779b9}) {
-      // 9-bit address within 512 bit cache line
-      int bitpos = h >> (32 - 9);
-      if ((data_at_cache_line[bitpos >> 3] & (char(1) << (bitpos & 7))) == 0) {
-        return false;
-      }
-    }
-    return true;
-#endif
   }
+#endif  // BLOOM_IMPL_AVX2_KERNEL
 };
 
 // A legacy Bloom filter implementation with no locality of probes (slow).
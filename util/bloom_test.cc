@@ -23,6 +23,7 @@ int main() {
 #include "memory/arena.h"
 #include "rocksdb/filter_policy.h"
 #include "table/block_based/filter_policy_internal.h"
+#include "table/multiget_context.h"
 #include "test_util/testharness.h"
 #include "test_util/testutil.h"
 #include "util/gflags_compat.h"
@@ -327,6 +328,18 @@ class FullBloomTest : public testing::TestWithParam<BloomFilterPolicy::Mode> {
     return bits_reader_->MayMatch(s);
   }
 
+  // Checks "num_keys" keys through the batched MayMatch
+  void MatchesBatch(int num_keys, const Slice* keys, bool* may_match) {
+    if (bits_reader_ == nullptr) {
+      Build();
+    }
+    std::vector<Slice*> key_ptrs;
+    for (int i = 0; i < num_keys; i++) {
+      key_ptrs.push_back(const_cast<Slice*>(&keys[i]));
+    }
+    bits_reader_->MayMatch(num_keys, key_ptrs.data(), may_match);
+  }
+
   // Provides a kind of fingerprint on the Bloom filter's
   // behavior, for reasonbly high FP rates.
   uint64_t PackedMatches() {
@@ -499,6 +512,37 @@ TEST_P(FullBloomTest, FullVaryingLengths) {
   ASSERT_LE(mediocre_filters, good_filters/5);
 }
 
+TEST_P(FullBloomTest, BatchedMayMatch) {
+  // Covers fewer and more than 8 probes, and batches that are and are not
+  // a multiple of 8 keys
+  char buffer[sizeof(int)];
+  for (double bits_per_key : {3.0, 10.0, 30.0}) {
+    ResetPolicy(bits_per_key);
+    for (int i = 0; i < 1000; i += 2) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    std::vector<std::string> key_strs;
+    for (int i = 0; i < MultiGetContext::MAX_BATCH_SIZE; i++) {
+      // Every other key was added
+      key_strs.push_back(Key(i + 500, buffer).ToString());
+    }
+    std::vector<Slice> keys(key_strs.begin(), key_strs.end());
+    for (int num_keys = 1; num_keys <= MultiGetContext::MAX_BATCH_SIZE;
+         num_keys++) {
+      bool may_match[MultiGetContext::MAX_BATCH_SIZE];
+      MatchesBatch(num_keys, keys.data(), may_match);
+      for (int i = 0; i < num_keys; i++) {
+        ASSERT_EQ(Matches(keys[i]), may_match[i])
+            << "bits_per_key " << bits_per_key << "; batch " << num_keys
+            << "; key " << i;
+      }
+    }
+  }
+  ResetPolicy();
+}
+
 namespace {
 inline uint32_t SelectByCacheLineSize(uint32_t for64, uint32_t for128,
                                       uint32_t for256) {
@@ -0,0 +1,5 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "build_version.h"
+const char* rocksdb_build_git_sha = "rocksdb_build_git_sha:6c56c46a58d3af4c0425365b0b1e08170cedec61";
+const char* rocksdb_build_git_date = "rocksdb_build_git_date:2026-10-18";
+const char* rocksdb_build_compile_date = __DATE__;
@@ -224,6 +224,22 @@ Status BlockCacheTraceSimulator::InitializeCaches() {
             NewLRUCache(simulate_cache_capacity, config.num_shard_bits,
                         /*strict_capacity_limit=*/false,
                         /*high_pri_pool_ratio=*/0.5));
+      } else if (cache_name == "lru_admission" ||
+                 cache_name == "lru_priority_admission") {
+        // LRU with the frequency based admission of LRUCacheOptions
+        LRUCacheOptions cache_opts(simulate_cache_capacity,
+                                   config.num_shard_bits,
+                                   /*strict_capacity_limit=*/false,
+                                   /*high_pri_pool_ratio=*/0);
+        cache_opts.frequency_admission = true;
+        if (cache_name == "lru_admission") {
+          sim_cache = std::make_shared<CacheSimulator>(std::move(ghost_cache),
+                                                       NewLRUCache(cache_opts));
+        } else {
+          cache_opts.high_pri_pool_ratio = 0.5;
+          sim_cache = std::make_shared<PrioritizedCacheSimulator>(
+              std::move(ghost_cache), NewLRUCache(cache_opts));
+        }
       } else if (cache_name == "lru_hybrid") {
         sim_cache = std::make_shared<HybridRowBlockCacheSimulator>(
             std::move(ghost_cache),
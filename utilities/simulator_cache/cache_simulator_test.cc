@@ -195,6 +195,46 @@ TEST_F(CacheSimulatorTest, GhostPrioritizedCacheSimulator) {
   ASSERT_EQ(100, cache_simulator->miss_ratio_stats().miss_ratio());
 }
 
+TEST_F(CacheSimulatorTest, AdmissionCacheSimulator) {
+  // Hot blocks that fit in the cache, read between scans of blocks that are
+  // read once
+  std::vector<std::string> hot_blocks;
+  for (uint32_t i = 0; i < 8; i++) {
+    hot_blocks.push_back(kBlockKeyPrefix + "hot-" + std::to_string(i));
+  }
+  uint64_t num_misses[2];
+  for (bool frequency_admission : {false, true}) {
+    LRUCacheOptions cache_opts(/*capacity=*/16 * 4096, /*num_shard_bits=*/0,
+                               /*strict_capacity_limit=*/false,
+                               /*high_pri_pool_ratio=*/0);
+    cache_opts.frequency_admission = frequency_admission;
+    std::unique_ptr<CacheSimulator> cache_simulator(
+        new CacheSimulator(nullptr, NewLRUCache(cache_opts)));
+    BlockCacheTraceRecord access = GenerateGetRecord(kGetId);
+    uint64_t scan_block_id = 0;
+    for (uint32_t round = 0; round < 5; round++) {
+      for (uint32_t i = 0; i < 4; i++) {
+        for (const auto& block : hot_blocks) {
+          access.block_key = block;
+          cache_simulator->Access(access);
+        }
+      }
+      for (uint32_t i = 0; i < 100; i++) {
+        access.block_key = kBlockKeyPrefix + std::to_string(scan_block_id++);
+        cache_simulator->Access(access);
+      }
+    }
+    ASSERT_EQ(5U * (4 * 8 + 100),
+              cache_simulator->miss_ratio_stats().total_accesses());
+    num_misses[frequency_admission] =
+        cache_simulator->miss_ratio_stats().total_misses();
+  }
+  // Without admission, every scan pushes out the hot blocks. With it, they
+  // only miss the first time they are read.
+  ASSERT_EQ(5U * (8 + 100), num_misses[false]);
+  ASSERT_EQ(8U + 5 * 100, num_misses[true]);
+}
+
 TEST_F(CacheSimulatorTest, HybridRowBlockCacheSimulator) {
   uint64_t block_id = 100;
   BlockCacheTraceRecord first_get = GenerateGetRecord(kGetId);